@@ -7,6 +7,9 @@
 
 #include "datetime/calendar.hpp"
 #include "satellite.hpp"
+#include "sp3_checkpoint.hpp"
+#include "sp3_index.hpp"
+#include "sp3_mapped_file.hpp"
 #include "sp3flag.hpp"
 #include <algorithm>
 #include <fstream>
@@ -29,13 +32,76 @@ struct Sp3DataBlock {
   Sp3Flag flag;         /** flag for state */
 };                      /* Sp3DataBlock */
 
+/** @class Sp3EpochBuffer
+ * Data records of one data block (aka one epoch), for all SVs recorded in
+ * the block. Instances are meant to be re-used, so that reading a file
+ * epoch-by-epoch does not allocate memory, once the buffer is warmed-up.
+ */
+struct Sp3EpochBuffer {
+  /** The epoch of the data block */
+  dso::datetime<dso::nanoseconds> t{dso::datetime<dso::nanoseconds>::min()};
+  /** SVs included in the data block, in the order they are recorded */
+  std::vector<sp3::SatelliteId> sats;
+  /** Data records; blocks[i] is the record of sats[i] */
+  std::vector<Sp3DataBlock> blocks;
+
+  /** Number of SVs (records) in buffer */
+  int size() const noexcept { return sats.size(); }
+
+  /** Clear records (memory is not released) */
+  void clear() noexcept {
+    sats.clear();
+    blocks.clear();
+  }
+
+  /** Index of SV sv in the buffer, or -1 if not included */
+  int find(const sp3::SatelliteId &sv) const noexcept {
+    const auto it = std::find(sats.cbegin(), sats.cend(), sv);
+    return (it == sats.cend()) ? -1 : (int)(it - sats.cbegin());
+  }
+}; /* struct Sp3EpochBuffer */
+
+/** @class Sp3SvSelection
+ * A selection of SVs, by constellation (system) and/or id; an empty
+ * selection accepts any SV.
+ */
+struct Sp3SvSelection {
+  /** System identifiers accepted (e.g. "GE"); empty: any system */
+  std::string systems;
+  /** SVs accepted; empty: any SV */
+  std::vector<sp3::SatelliteId> svs;
+
+  /** Check if SV sv is selected */
+  bool accepts(const sp3::SatelliteId &sv) const noexcept {
+    if (!systems.empty() && systems.find(sv.id[0]) == std::string::npos)
+      return false;
+    return svs.empty() || std::find(svs.cbegin(), svs.cend(), sv) != svs.cend();
+  }
+
+  /** Check if the selection accepts any SV */
+  bool accepts_all() const noexcept { return systems.empty() && svs.empty(); }
+}; /* struct Sp3SvSelection */
+
+class Sp3Cursor;
+
+/** @class Sp3c
+ * An opened Sp3 file; on construction, the header is read and the file is
+ * mapped (read-only) to memory. Any number of independent read cursors
+ * (see Sp3Cursor) can traverse the file concurrently, sharing the mapping,
+ * the header info and the epoch index (if any) of the instance. The
+ * instance itself also has its own (legacy) stream position.
+ */
 class Sp3c {
+  friend class Sp3Cursor;
+
 public:
   /** Let's not write this more than once. */
   typedef std::ifstream::pos_type pos_type;
 
-  /** @brief Constructor from filename */
-  explicit Sp3c(const char *fn);
+  /** @brief Constructor from filename; the file is mapped (or read into a
+   * private snapshot, see sp3::MapMode) per mode
+   */
+  explicit Sp3c(const char *fn, sp3::MapMode mode = sp3::MapMode::shared);
 
   /** @brief Copy not allowed ! */
   Sp3c(const Sp3c &) = delete;
@@ -60,12 +126,40 @@ public:
   /** get the initial epoch (datetime) in the Sp3 file */
   auto start_epoch() const noexcept { return start_epoch__; }
 
+  /** get the (nominal) last epoch in the Sp3 file, as per its header, i.e.
+   * start_epoch() + (num_epochs() - 1) * interval()
+   */
+  dso::datetime<dso::nanoseconds> stop_epoch() const noexcept;
+
+  /** get the filename of the Sp3 file */
+  const std::string &filename() const noexcept { return __filename; }
+
   /** Rewind to the start of data blocks (i.e. just after the header) */
   void rewind() noexcept { __istream.seekg(__end_of_head, std::ios::beg); }
 
   /** @brief Time System/Scale as string (as reported in the Sp3). */
   const char *time_sys() const noexcept { return time_sys__;}
 
+  /** @brief Version of the file, 'c' or 'd' */
+  char version() const noexcept { return version__; }
+
+  /** @brief Check if the header declares velocity records ('V' flag) */
+  bool has_velocities() const noexcept { return pv_flag__ == 'V'; }
+
+  /** @brief Data used descriptor, coordinate system, orbit type and agency
+   * (as reported in the Sp3)
+   */
+  const char *data_used() const noexcept { return data_used__; }
+  const char *coordinate_system() const noexcept { return crd_sys__; }
+  const char *orbit_type() const noexcept { return orb_type__; }
+  const char *agency() const noexcept { return agency__; }
+
+  /** @brief Floating point bases of position/velocity and clock/clock-rate
+   * std. deviations
+   */
+  double fp_base_pos() const noexcept { return fpb_pos__; }
+  double fp_base_clk() const noexcept { return fpb_clk__; }
+
   /** @brief Read the next data block and parse holding for a given SV
    * @param[in] satid The SV to collect records for
    * @param[out] block An Sp3DataBlock instance; if we encounter records
@@ -124,6 +218,131 @@ public:
     return sat_vec__;
   }
 
+  /** @brief Scan the file and build the epoch index.
+   *
+   * The stream position is not altered.
+   * @return Anything other than 0 denotes an error.
+   */
+  int build_index() noexcept;
+
+  /** @brief Load the epoch index from a sidecar index file.
+   *
+   * @param[in] fn The index file; if not given, use sidecar_filename()
+   * @return  0: index loaded
+   *         <0: index file is missing, or it does not match the Sp3 file
+   *             (e.g. the fingerprint has changed); index is left empty
+   *         >0: ERROR
+   */
+  int load_index(const char *fn = nullptr) noexcept;
+
+  /** @brief Write the epoch index to a sidecar index file.
+   *
+   * The index must already be built (or loaded). The file is first written
+   * to a temporary and then renamed, so that concurrent readers never see a
+   * partially written index.
+   * @param[in] fn The index file; if not given, use sidecar_filename()
+   * @return Anything other than 0 denotes an error.
+   */
+  int write_index(const char *fn = nullptr) const noexcept;
+
+  /** @brief Load the sidecar index if it is valid, else (re-)build it.
+   *
+   * @param[in] persist If true and the index had to be (re-)built, write it
+   *            to the sidecar file for later use.
+   * @return Anything other than 0 denotes an error; failing to write the
+   *         sidecar file is not considered an error.
+   */
+  int use_sidecar_index(bool persist = true) noexcept;
+
+  /** @brief Name of the sidecar index file for this instance.
+   *
+   * That is the Sp3 filename, with an 'i' appended if it ends in '.sp3'
+   * (e.g. 'foo.sp3' -> 'foo.sp3i') else with '.sp3i' appended.
+   */
+  std::string sidecar_filename() const noexcept;
+
+  /** @brief Check if an epoch index is available */
+  bool has_index() const noexcept { return !index__.empty(); }
+
+  /** @brief Return the epoch index (may be empty) */
+  const Sp3EpochIndex &index() const noexcept { return index__; }
+
+  /** @brief Fingerprint of the Sp3 file, as mapped.
+   *
+   * Computed (off from the mapping, not the file on disk) once the file is
+   * mapped, and again whenever it is re-mapped (see remap).
+   */
+  const Sp3Fingerprint &fingerprint() const noexcept { return fingerprint__; }
+
+  /** @brief Compute a fingerprint for the records of each satellite.
+   *
+   * That is a hash of the satellite's record lines (Position, Velocity and
+   * correlation records), along with the epoch lines of the data blocks
+   * they are recorded in. Reissued files can thus be compared satellite by
+   * satellite, to tell which satellites have changed. Trailing white space
+   * (including carriage returns) is not considered.
+   * @param[out] hashes One hash per satellite, in the order of
+   *             sattellite_vector()
+   * @return Anything other than 0 denotes an error
+   */
+  int sv_fingerprints(std::vector<uint64_t> &hashes) const noexcept;
+
+  /** @brief Set the stream position at the Epoch Header of the data block
+   * with index idx (using the epoch index), so that the next call to
+   * get_next_data_block will read this block.
+   *
+   * @return Anything other than 0 denotes an error (e.g. no index available
+   *         or idx out of range).
+   */
+  int seek_epoch(int idx) noexcept;
+
+  /** @brief Read the records for a given SV at a given data block (using
+   * the epoch index), without parsing any other line in the file.
+   *
+   * Records are read off from the file mapping, hence this function does
+   * not alter the stream position and can be called concurrently.
+   * @param[in] idx Index of the data block (epoch)
+   * @param[in] satid The SV to collect records for
+   * @param[out] block Parsed records; see get_next_data_block
+   * @return 0: All ok
+   *        -1: No records for satid in the data block
+   *        >0: ERROR
+   */
+  int get_data_block(int idx, sp3::SatelliteId satid,
+                     Sp3DataBlock &block) const noexcept;
+
+  /** @brief Create a new, independent read cursor, positioned at the first
+   * data block; see Sp3Cursor.
+   */
+  Sp3Cursor cursor() const noexcept;
+
+  /** @brief Re-map the file after data blocks were appended to it (or it
+   * was otherwise changed in place), without reading the header again.
+   *
+   * Cursors remain valid; pointers off from raw_data() do not. The
+   * fingerprint is re-computed.
+   * @return Anything other than 0 denotes an error
+   */
+  int remap() noexcept;
+
+  /** @brief Hint that the data blocks of the file will be read soon, so
+   * that the system starts reading in the file (asynchronously).
+   */
+  void prefetch() const noexcept { map__.will_need(); }
+
+  /** @brief Raw bytes of the (mapped) file, e.g. to copy header lines or
+   * records verbatim; nullptr if the file is not mapped
+   */
+  const char *raw_data() const noexcept { return map__.data(); }
+
+  /** @brief Size of the (mapped) file in bytes */
+  std::size_t raw_size() const noexcept { return map__.size(); }
+
+  /** @brief Byte offset of the first data block, aka size of the header */
+  int64_t header_size() const noexcept {
+    return static_cast<int64_t>(__end_of_head);
+  }
+
 #ifdef DEBUG
   void print_members() const noexcept;
 #endif
@@ -132,9 +351,16 @@ private:
   /** @brief Read sp3c header; assign info */
   int read_header() noexcept;
 
+  /** @brief Compute the fingerprint of the (mapped) file */
+  void compute_fingerprint() noexcept;
+
   /** @brief Resolve an Epoch Header Record line */
   int resolve_epoch_line(dso::datetime<dso::nanoseconds> &t) noexcept;
 
+  /** @brief Resolve an Epoch Header Record line, given as string */
+  int resolve_epoch_line(const char *line,
+                         dso::datetime<dso::nanoseconds> &t) const noexcept;
+
   /** @brief Get and resolve the next Position and Clock Record */
   int get_next_position(sp3::SatelliteId &sat, double &xkm, double &ykm,
                         double &zkm, double &clk, double &xstdv, double &ystdv,
@@ -147,12 +373,30 @@ private:
                         double &zstdv, double &cstdv, Sp3Flag &flag,
                         const sp3::SatelliteId *wsat = nullptr) noexcept;
 
+  /** @brief Resolve a Position and Clock Record line */
+  int resolve_position_line(const char *line, double &xkm, double &ykm,
+                            double &zkm, double &clk, double &xstdv,
+                            double &ystdv, double &zstdv, double &cstdv,
+                            Sp3Flag &flag) const noexcept;
+
+  /** @brief Resolve a Velocity and ClockRate-of-Change Record line */
+  int resolve_velocity_line(const char *line, double &xkm, double &ykm,
+                            double &zkm, double &clk, double &xstdv,
+                            double &ystdv, double &zstdv, double &cstdv,
+                            Sp3Flag &flag) const noexcept;
+
   /** The name of the file */
   std::string __filename;
   /** The infput (file) stream */
   std::ifstream __istream;
+  /** Read-only mapping of the file, shared by all cursors */
+  sp3::MappedFile map__;
+  /** Fingerprint of the mapped file (see compute_fingerprint) */
+  Sp3Fingerprint fingerprint__;
   /** the version 'c' or 'd' */
   char version__;
+  /** Position ('P') or velocity ('V') flag */
+  char pv_flag__{'P'};
   /** Start epoch */
   dso::datetime<dso::nanoseconds> start_epoch__;
   /** Number of epochs in file */
@@ -161,6 +405,8 @@ private:
       num_sats__;
   /** Coordinate system (last char always '\0') */
   char crd_sys__[6] = {'\0'},
+       /** Data used descriptor (last char always '\0') */
+      data_used__[6] = {'\0'},
        /** Orbit type (last char always '\0') */
       orb_type__[4] = {'\0'},
        /** Agency (last char always '\0') */
@@ -177,18 +423,141 @@ private:
   double fpb_pos__,
       /** floating point base for clock std. dev (psec or 10**-4 psec/sec) */
       fpb_clk__;
+  /** Epoch index (empty unless built or loaded) */
+  Sp3EpochIndex index__;
 }; /* class Sp3c */
 
-/** Utility class, to iterate through the data blocks of an Sp3 file */
+/** @class Sp3Cursor
+ * A cheap, independent read position within an (opened) Sp3c instance. All
+ * cursors created off from the same Sp3c share its file mapping, header
+ * info and epoch index, so creating (or copying) a cursor neither re-opens
+ * the file nor re-reads the header. Different cursors can be used from
+ * different threads; a single cursor is not thread-safe.
+ *
+ * @warning A cursor holds a pointer to the Sp3c instance it was created
+ *          from; it must not outlive (or be used after moving) it.
+ */
+class Sp3Cursor {
+  friend class Sp3c;
+
+  /** The Sp3 source */
+  const Sp3c *sp3_;
+  /** Current position (byte offset from start of file) */
+  int64_t pos_;
+
+  /** @brief Copy the next line (at most MAX_RECORD_CHARS-1 chars) to line,
+   * and advance the cursor to the start of the following line.
+   * @return Number of chars in line, or -1 if the cursor was at the end of
+   *         data
+   */
+  int next_line(char *line) noexcept;
+
+  /** @brief Read the records (Position and, if present, Velocity) of a
+   * given SV; the cursor must be placed at the SV's Position Record.
+   * @return Anything other than 0 denotes an error
+   */
+  int get_sv_records(sp3::SatelliteId satid, Sp3DataBlock &block) noexcept;
+
+  /** @brief First char of the next line (or '\0' at end of data) */
+  char peek() const noexcept {
+    return (pos_ < (int64_t)sp3_->map__.size()) ? sp3_->map__.data()[pos_]
+                                                : '\0';
+  }
+
+public:
+  /** @brief Constructor; cursor is placed at the first data block */
+  explicit Sp3Cursor(const Sp3c &sp3) noexcept;
+
+  /** @brief The Sp3 source of the cursor */
+  const Sp3c &sp3() const noexcept { return *sp3_; }
+
+  /** @brief Rewind to the start of data blocks (i.e. just after the header) */
+  void rewind() noexcept;
+
+  /** @brief Current position, as byte offset from the start of file */
+  int64_t tell() const noexcept { return pos_; }
+
+  /** @brief Set the cursor at a given byte offset from the start of file.
+   *
+   * The offset should point to the start of an Epoch Header Record.
+   * @return Anything other than 0 denotes an error (offset out of range)
+   */
+  int seek(int64_t offset) noexcept;
+
+  /** @brief Set the cursor at the Epoch Header of the data block with
+   * index idx, using the source's epoch index.
+   * @return Anything other than 0 denotes an error (e.g. no index available
+   *         or idx out of range).
+   */
+  int seek_epoch(int idx) noexcept;
+
+  /** @brief Read the next data block and parse holding for a given SV; see
+   * Sp3c::get_next_data_block for a description of parameters and return
+   * values.
+   */
+  int get_next_data_block(sp3::SatelliteId satid,
+                          Sp3DataBlock &block) noexcept;
+
+  /** @brief Read the next data block, collecting the records of all SVs.
+   *
+   * Contrary to get_next_data_block, a data block followed by the 'EOF'
+   * line is reported as a normal read (i.e. 0); -1 is only returned when
+   * no more data blocks are available.
+   * @param[out] buf On success, holds the epoch and records of the block.
+   *            Units are the same as in get_next_data_block.
+   * @return -1: EOF encountered (no data block read)
+   *          0: All ok
+   *         >0: ERROR
+   */
+  int get_next_epoch(Sp3EpochBuffer &buf) noexcept;
+
+  /** @brief Read the next data block, collecting only the records of the
+   * SVs selected; records of other SVs are skipped without being parsed.
+   * See get_next_epoch(Sp3EpochBuffer &).
+   */
+  int get_next_epoch(Sp3EpochBuffer &buf, const Sp3SvSelection &sel) noexcept;
+
+  /** @brief Move past the next data block, without parsing its records.
+   * @param[out] t If not nullptr, set to the epoch of the block skipped
+   * @return -1: EOF encountered (no data block skipped)
+   *          0: All ok
+   *         >0: ERROR
+   */
+  int skip_epoch(dso::datetime<dso::nanoseconds> *t = nullptr) noexcept;
+
+  /** @brief Resolve the date of the next data block, without moving the
+   * cursor; see Sp3c::peak_next_data_block.
+   */
+  int peak_next_data_block(dso::datetime<dso::nanoseconds> &t) const noexcept;
+
+  /** @brief Record the cursor's position (byte offset and epoch of the next
+   * data block), along with the file's fingerprint.
+   * @return Anything other than 0 denotes an error
+   */
+  int checkpoint(Sp3Checkpoint &cp) const noexcept;
+
+  /** @brief Set the cursor at a position recorded via checkpoint.
+   * @return 0 on success; -1 if the checkpoint does not match the file
+   *         (e.g. the file has changed since); >0 on error
+   */
+  int restore(const Sp3Checkpoint &cp) noexcept;
+}; /* Sp3Cursor */
+
+/** Utility class, to iterate through the data blocks of an Sp3 file, for a
+ * given SV. Each instance uses its own Sp3Cursor, hence any number of
+ * iterators can traverse the same Sp3c instance.
+ */
 class Sp3Iterator {
-  Sp3c *sp3_;
+  Sp3Cursor cursor_;
   sp3::SatelliteId id_;
   Sp3DataBlock block_;
+  /** Byte offset of the (epoch header of the) current data block */
+  int64_t block_pos_{0};
 
 public:
-  Sp3Iterator(Sp3c &sp3) : sp3_(&sp3) {
-    sp3_->rewind();
-    if (sp3_->get_next_data_block(id_, block_)) {
+  Sp3Iterator(const Sp3c &sp3, sp3::SatelliteId sv = sp3::SatelliteId())
+      : cursor_(sp3), id_(sv), block_pos_(cursor_.tell()) {
+    if (cursor_.get_next_data_block(id_, block_)) {
       throw std::runtime_error(
           "ERROR Failed to create Sp3Iterator instance!\n");
     }
@@ -196,23 +565,65 @@ public:
 
   const Sp3DataBlock &data_block() const noexcept { return block_; }
 
+  /** @brief The cursor used by the instance */
+  const Sp3Cursor &cursor() const noexcept { return cursor_; }
+
   void begin() {
-    sp3_->rewind();
-    if (sp3_->get_next_data_block(id_, block_)) {
+    cursor_.rewind();
+    block_pos_ = cursor_.tell();
+    if (cursor_.get_next_data_block(id_, block_)) {
       throw std::runtime_error(
           "ERROR Failed to create Sp3Iterator instance!\n");
     }
     return;
   }
 
-  int advance() noexcept { return sp3_->get_next_data_block(id_, block_); }
+  int advance() noexcept {
+    block_pos_ = cursor_.tell();
+    return cursor_.get_next_data_block(id_, block_);
+  }
+
+  /** @brief Record the iterator's state (the SV, and byte offset and epoch
+   * of the current data block), along with the file's fingerprint.
+   * @return Anything other than 0 denotes an error
+   */
+  int checkpoint(Sp3Checkpoint &cp) const noexcept {
+    if (int error = cursor_.checkpoint(cp); error)
+      return error;
+    cp.sv = id_;
+    cp.offset = block_pos_;
+    cp.epoch = block_.t;
+    return 0;
+  }
+
+  /** @brief Restore a state recorded via checkpoint; only the current data
+   * block is re-read. On failure, the iterator is left as it was.
+   * @return 0 on success; -1 if the checkpoint does not match the file
+   *         or the iterator's SV; >0 on error
+   */
+  int restore(const Sp3Checkpoint &cp) noexcept {
+    if (!(cp.sv == id_))
+      return -1;
+    /* restore a copy; only commit if the checkpoint matches */
+    Sp3Iterator it(*this);
+    Sp3Checkpoint at(cp);
+    at.epoch = dso::datetime<dso::nanoseconds>::min();
+    if (int error = it.cursor_.restore(at); error)
+      return error;
+    if (int error = it.advance(); error > 0)
+      return error;
+    if (it.block_.t != cp.epoch)
+      return -1;
+    *this = it;
+    return 0;
+  }
 
   dso::datetime<dso::nanoseconds> current_time() const noexcept {
     return block_.t;
   }
 
   int peak_next_epoch(dso::datetime<dso::nanoseconds> &t) const noexcept {
-    return sp3_->peak_next_data_block(t);
+    return cursor_.peak_next_data_block(t);
   }
 
   int goto_epoch(const dso::datetime<dso::nanoseconds> &t) noexcept {
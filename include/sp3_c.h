@@ -0,0 +1,155 @@
+/** @file
+ * A C API over the Sp3 loader and interpolators, for use from other
+ * languages (via FFI, e.g. ctypes/cffi, Julia's ccall, R's .Call).
+ *
+ * Data are exposed as raw arrays, so that foreign callers can wrap them
+ * without copying:
+ *  - the records of each satellite are held in columns (time, state and
+ *    std. deviation components, flags), owned by the product and valid
+ *    until sp3c_close;
+ *  - batch interpolation writes to caller-owned arrays (sp3c_interpolate),
+ *    or to arrays owned by a batch result (sp3c_interpolate_batch), valid
+ *    until sp3c_batch_free.
+ *
+ * Epochs are given as seconds w.r.t. the product's reference epoch (its
+ * start epoch, see sp3c_info). Functions return 0 on success, -1 if the
+ * item asked for does not exist and >0 on error; no function throws. Link
+ * against a shared build of the library (-DBUILD_SHARED_LIBS=ON) to load
+ * it at runtime.
+ */
+
+#ifndef __SP3C_C_API_H__
+#define __SP3C_C_API_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Version of the C API; changes only on incompatible changes */
+#define SP3C_API_VERSION 2
+
+/** Number of state components (X, Y, Z, clk, Vx, Vy, Vz, Vc) */
+#define SP3C_NUM_STATE 8
+
+/** @brief Header information of an Sp3 product */
+typedef struct sp3c_info {
+  /** Reference (i.e. start) epoch: MJD and nanoseconds of day */
+  int64_t ref_mjd;
+  int64_t ref_nsec;
+  /** Interval of records (seconds) */
+  double interval_sec;
+  /** Number of epochs and satellites, as declared in the header */
+  int32_t num_epochs;
+  int32_t num_sats;
+  /** Time system, e.g. "GPS" (null-terminated) */
+  char time_sys[4];
+} sp3c_info;
+
+/** @brief Columns of the records of one satellite; each array holds
+ * num_records values, in chronological order. Units are as in the Sp3
+ * file (km, microsec, dm/sec, 1e-4 microsec/sec; std. deviations in mm,
+ * psec, 1e-4 mm/sec, 1e-4 psec/sec).
+ */
+typedef struct sp3c_columns {
+  int64_t num_records;
+  /** Epochs, as seconds w.r.t. the reference epoch */
+  const double *time;
+  /** State components; see SP3C_NUM_STATE */
+  const double *state[SP3C_NUM_STATE];
+  /** Std. deviations of state components */
+  const double *sdev[SP3C_NUM_STATE];
+  /** Record flags (bit i set: event i of dso::Sp3Event) */
+  const uint32_t *flags;
+} sp3c_columns;
+
+/** @brief Output of a batch interpolation, for n epochs; owned by the
+ * library, release via sp3c_batch_free. pos and erpos hold n rows of
+ * (X, Y, Z) values, vel and ervel n rows of (Vx, Vy, Vz) values (or are
+ * NULL, if velocities were not asked for); status[i] is 0 if epoch i
+ * was interpolated, else it holds the error code.
+ */
+typedef struct sp3c_batch {
+  int64_t size;
+  double *pos;
+  double *erpos;
+  double *vel;
+  double *ervel;
+  int32_t *status;
+} sp3c_batch;
+
+/** @brief An (opened) Sp3 product; opaque */
+typedef struct sp3c_product sp3c_product;
+
+/** @brief Version of the C API the library implements */
+int sp3c_api_version(void);
+
+/** @brief Read the header of an Sp3 file; data records are not read */
+int sp3c_probe(const char *fn, sp3c_info *info);
+
+/** @brief Open an Sp3 file (its header is parsed); returns NULL on error,
+ * in which case error (if not NULL) is set
+ */
+sp3c_product *sp3c_open(const char *fn, int *error);
+
+/** @brief Read the data records of an opened product into columns and
+ * build its interpolators; max_window_sec is the max time distance of data
+ * points (from a requested epoch) used in interpolation
+ */
+int sp3c_load(sp3c_product *p, double max_window_sec);
+
+/** @brief Close a product; any arrays handed out by it become invalid */
+void sp3c_close(sp3c_product *p);
+
+/** @brief Header information of an opened product */
+int sp3c_product_info(const sp3c_product *p, sp3c_info *info);
+
+/** @brief Number of satellites of an opened product */
+int sp3c_num_satellites(const sp3c_product *p);
+
+/** @brief Id of satellite i (e.g. "G01"), or NULL; the string is owned by
+ * the product. Functions taking a satellite id expect exactly 3 characters
+ * (null-terminated); anything else is not found (-1).
+ */
+const char *sp3c_satellite(const sp3c_product *p, int i);
+
+/** @brief Get the columns of a satellite (of a loaded product); arrays are
+ * owned by the product and valid until sp3c_close
+ */
+int sp3c_columns_of(const sp3c_product *p, const char *sv,
+                    sp3c_columns *cols);
+
+/** @brief Interpolate the state of a satellite at n epochs t (seconds
+ * w.r.t. the reference epoch), into caller-owned arrays.
+ *
+ * pos and erpos must hold 3*n values, as must vel and ervel, or both be
+ * NULL (velocities not computed); status (n values) and num_failed may be
+ * NULL. Epochs are best given in chronological order. A product must not
+ * interpolate from more than one thread at a time.
+ * @param[out] num_failed If not NULL, set to the number of epochs that
+ *             failed (see status for which ones)
+ * @return 0 if the epochs were processed (see num_failed), -1 if the
+ *         satellite is not in the product, >0 on error (invalid arguments,
+ *         product not loaded)
+ */
+int sp3c_interpolate(sp3c_product *p, const char *sv, const double *t,
+                     int64_t n, double *pos, double *erpos, double *vel,
+                     double *ervel, int32_t *status, int64_t *num_failed);
+
+/** @brief Same as sp3c_interpolate, but outputs are allocated by the
+ * library; returns NULL if the satellite is not in the product (or on
+ * allocation failure). Check the status of each epoch in the result.
+ */
+sp3c_batch *sp3c_interpolate_batch(sp3c_product *p, const char *sv,
+                                   const double *t, int64_t n,
+                                   int with_velocity);
+
+/** @brief Release a batch result (and its arrays) */
+void sp3c_batch_free(sp3c_batch *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,190 @@
+/** @file
+ * Define a cache of (parsed) Sp3 products, for serving queries on time
+ * ranges spread over a large archive of files. Products are registered
+ * with their time span; queries locate the covering product(s), load them
+ * into compressed orbit stores (see Sp3OrbitStore) and keep the most
+ * recently used ones, up to a memory budget.
+ */
+
+#ifndef __SP3C_PRODUCT_CACHE_HPP__
+#define __SP3C_PRODUCT_CACHE_HPP__
+
+#include "sp3_store.hpp"
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3CacheStats Statistics of an Sp3ProductCache */
+struct Sp3CacheStats {
+  /** Product look-ups served off from memory */
+  uint64_t hits{0};
+  /** Product look-ups that had to parse the product */
+  uint64_t misses{0};
+  /** Product look-ups that waited for a load in flight (on another thread)
+   * to complete
+   */
+  uint64_t waits{0};
+  /** Loads that failed (e.g. missing or corrupt file) */
+  uint64_t failures{0};
+  /** Product look-ups refused without trying to load, since the product
+   * failed to load recently (see Sp3ProductCache::set_retry_interval)
+   */
+  uint64_t skipped{0};
+  /** Products dropped to stay within the memory budget */
+  uint64_t evictions{0};
+  /** Number of products currently held in memory */
+  int num_loaded{0};
+  /** Memory used by products held in memory (bytes) */
+  std::size_t memory_bytes{0};
+}; /* struct Sp3CacheStats */
+
+/** @class Sp3ProductCache
+ * A least-recently-used cache of Sp3 products (files), loaded on demand.
+ *
+ * All member functions are thread-safe. Concurrent queries needing the
+ * same product wait for a single load, instead of parsing it more than
+ * once. Products handed out (see stores) remain valid for as long as the
+ * caller holds them, even if evicted meanwhile.
+ */
+class Sp3ProductCache {
+public:
+  using StorePtr = std::shared_ptr<const Sp3OrbitStore>;
+
+private:
+  /** @brief A registered product */
+  struct Product {
+    std::string fn;
+    dso::datetime<dso::nanoseconds> t_start, t_stop;
+    /** The loaded product (if loaded) */
+    StorePtr store;
+    /** Set while the product is being loaded */
+    std::shared_future<StorePtr> loading;
+    /** Position in LRU list (if loaded) */
+    std::list<Product *>::iterator lru_pos;
+    /** Set if the last load failed, and when */
+    bool failed{false};
+    std::chrono::steady_clock::time_point failed_at;
+  }; /* struct Product */
+
+  mutable std::mutex mtx_;
+  /** Registered products, sorted on t_start */
+  std::vector<std::unique_ptr<Product>> products_;
+  /** Loaded products, most recently used first */
+  std::list<Product *> lru_;
+  /** Max time span of any registered product (nanoseconds) */
+  int64_t max_span_{0};
+  /** Memory budget (bytes) */
+  std::size_t budget_;
+  /** Time before a product that failed to load is tried again */
+  std::chrono::milliseconds retry_interval_{60 * 1000};
+  Sp3CacheStats stats_;
+
+  /** @brief Get the (loaded) store of a product, loading it if needed;
+   * nullptr if the product fails (or recently failed) to load
+   */
+  StorePtr acquire(Product *p);
+
+  /** @brief Collect records for SV sv (see range) and report the interval
+   * of the (first) product used
+   */
+  int collect(const sp3::SatelliteId &sv,
+              const dso::datetime<dso::nanoseconds> &t0,
+              const dso::datetime<dso::nanoseconds> &t1,
+              std::vector<Sp3DataBlock> &out, dso::nanoseconds &interval);
+
+  /** @brief Drop least recently used products (but keep) until within
+   * budget; called with mtx_ locked
+   */
+  void evict(const Product *keep) noexcept;
+
+public:
+  /** @brief Constructor
+   * @param[in] memory_budget Max memory (bytes) used by loaded products.
+   *            The product(s) needed by a query are always loaded, even
+   *            if that means exceeding the budget.
+   */
+  explicit Sp3ProductCache(std::size_t memory_budget) noexcept
+      : budget_(memory_budget) {}
+
+  /** @brief Copy not allowed ! */
+  Sp3ProductCache(const Sp3ProductCache &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  Sp3ProductCache &operator=(const Sp3ProductCache &) = delete;
+
+  /** @brief Register a product, with its time span read off from its
+   * header.
+   * @return Anything other than 0 denotes an error
+   */
+  int add_product(const char *fn) noexcept;
+
+  /** @brief Register a product, covering the time span [t_start, t_stop]
+   * (e.g. as known from an archive's naming convention); the file is not
+   * touched until needed.
+   */
+  void add_product(const char *fn,
+                   const dso::datetime<dso::nanoseconds> &t_start,
+                   const dso::datetime<dso::nanoseconds> &t_stop);
+
+  /** @brief Number of registered products */
+  int num_products() const noexcept;
+
+  /** @brief Get the products overlapping the range [t0, t1], loading them
+   * if needed.
+   *
+   * @param[out] out Cleared and filled with the products, in chronological
+   *             order of their start epochs
+   * @return 0 on success; -1 if no registered product overlaps the range,
+   *         >0 if any product failed to load
+   */
+  int stores(const dso::datetime<dso::nanoseconds> &t0,
+             const dso::datetime<dso::nanoseconds> &t1,
+             std::vector<StorePtr> &out);
+
+  /** @brief Collect the records of SV sv in [t0, t1], off from all
+   * products overlapping the range.
+   *
+   * Records are merged on their epochs, so that products fill in any gaps
+   * of one another; epochs recorded in more than one product are taken from
+   * the product that starts first.
+   * @param[out] out Cleared and filled with records, in chronological order
+   * @return 0 on success; -1 if no records are available, >0 on error
+   */
+  int range(const sp3::SatelliteId &sv,
+            const dso::datetime<dso::nanoseconds> &t0,
+            const dso::datetime<dso::nanoseconds> &t1,
+            std::vector<Sp3DataBlock> &out);
+
+  /** @brief Feed an interpolator with the records of SV sv in [t0, t1]
+   * (see range), across product boundaries.
+   * @return 0 on success; -1 if no records are available, >0 on error
+   */
+  int load_interpolator(const sp3::SatelliteId &sv,
+                        const dso::datetime<dso::nanoseconds> &t0,
+                        const dso::datetime<dso::nanoseconds> &t1,
+                        SvInterpolator &intrp,
+                        std::vector<Sp3DataBlock> &scratch);
+
+  /** @brief Set the time a product that failed to load is not tried
+   * again for (default 60 sec); queries needing it meanwhile fail right
+   * away. Products that fail to load are retried on every query, if zero.
+   */
+  void set_retry_interval(dso::milliseconds interval) noexcept;
+
+  /** @brief Change the memory budget; products are evicted if needed */
+  void set_memory_budget(std::size_t memory_budget) noexcept;
+
+  /** @brief Get a snapshot of the cache statistics */
+  Sp3CacheStats stats() const noexcept;
+}; /* class Sp3ProductCache */
+
+} /* namespace dso */
+
+#endif
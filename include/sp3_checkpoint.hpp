@@ -0,0 +1,63 @@
+/** @file
+ * Define checkpoints of read positions within Sp3 files (cursors,
+ * iterators and interpolators), so that (pre-empted) jobs can be restarted
+ * from where they stopped, instead of from the start of each file.
+ */
+
+#ifndef __SP3C_CHECKPOINT_HPP__
+#define __SP3C_CHECKPOINT_HPP__
+
+#include "datetime/calendar.hpp"
+#include "satellite.hpp"
+#include "sp3_index.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3Checkpoint
+ * The state of a read position within an Sp3 file.
+ *
+ * The fingerprint of the file is recorded, so that a checkpoint is only
+ * restored against the file (version) it was taken off from.
+ */
+struct Sp3Checkpoint {
+  /** The Sp3 file (may be empty, e.g. for interpolators not fed off from a
+   * file)
+   */
+  std::string fn;
+  /** Fingerprint of the file */
+  Sp3Fingerprint fingerprint;
+  /** The SV (iterators and interpolators) */
+  sp3::SatelliteId sv;
+  /** Byte offset of the data block to resume at, or -1 if not applicable
+   * (interpolators)
+   */
+  int64_t offset{-1};
+  /** Epoch of the data block at offset (cursors), of the current data
+   * block (iterators) or of the last data point used (interpolators)
+   */
+  dso::datetime<dso::nanoseconds> epoch{
+      dso::datetime<dso::nanoseconds>::min()};
+  /** Index of the last data point used (interpolators), else -1 */
+  int32_t last_index{-1};
+}; /* struct Sp3Checkpoint */
+
+/** @brief Write checkpoints to a file.
+ *
+ * The file is first written to a temporary and then renamed, so that a job
+ * killed while writing leaves the previous checkpoint file intact.
+ * @return Anything other than 0 denotes an error
+ */
+int save_checkpoints(const char *fn,
+                     const std::vector<Sp3Checkpoint> &cps) noexcept;
+
+/** @brief Read checkpoints off from a file (see save_checkpoints)
+ * @return 0 on success; -1 if the file does not exist, >0 on error
+ */
+int load_checkpoints(const char *fn, std::vector<Sp3Checkpoint> &cps) noexcept;
+
+} /* namespace dso */
+
+#endif
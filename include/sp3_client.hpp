@@ -0,0 +1,96 @@
+/** @file
+ * Define a client of the interpolation daemon (sp3d), which loads Sp3
+ * products once and serves interpolation requests to any number of local
+ * processes, over a Unix domain socket.
+ */
+
+#ifndef __SP3C_CLIENT_HPP__
+#define __SP3C_CLIENT_HPP__
+
+#include "datetime/calendar.hpp"
+#include "satellite.hpp"
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3ClientQuery A query for a batched request (see Sp3Client) */
+struct Sp3ClientQuery {
+  sp3::SatelliteId sv;
+  dso::datetime<dso::nanoseconds> t;
+}; /* struct Sp3ClientQuery */
+
+/** @class Sp3ClientResult Result of a query of a batched request
+ *
+ * Units and status are the same as for SvInterpolator::interpolate_at;
+ * status is -1 if the SV/epoch is not covered by any product the daemon
+ * holds.
+ */
+struct Sp3ClientResult {
+  int status;
+  double pos[3], erpos[3];
+  double vel[3], ervel[3];
+}; /* struct Sp3ClientResult */
+
+/** @class Sp3Client
+ * A connection to the interpolation daemon.
+ *
+ * Instances are not thread-safe; use one per thread (each holds its own
+ * connection).
+ */
+class Sp3Client {
+  /** The connected socket */
+  int fd_{-1};
+  /** Buffers for requests/responses, re-used between calls */
+  std::vector<char> req_, resp_;
+
+  /** @brief Send a request of count items (already in req_) and receive
+   * the response (to resp_)
+   */
+  int round_trip(int op, int flags, int count) noexcept;
+
+public:
+  /** @brief Constructor; connects to the daemon
+   * @param[in] socket_path Path of the daemon's socket; if nullptr, the
+   *            default path is used
+   * @throw std::runtime_error if the connection fails
+   */
+  explicit Sp3Client(const char *socket_path = nullptr);
+
+  /** @brief Copy not allowed ! */
+  Sp3Client(const Sp3Client &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  Sp3Client &operator=(const Sp3Client &) = delete;
+
+  /** @brief Destructor; closes the connection */
+  ~Sp3Client() noexcept;
+
+  /** @brief Interpolate the state of SV sv at epoch t; same as
+   * SvInterpolator::interpolate_at.
+   * @return 0 on success; -1 if the SV/epoch is not covered by any product
+   *         the daemon holds; >0 on error (including communication errors)
+   */
+  int interpolate_at(const sp3::SatelliteId &sv,
+                     const dso::datetime<dso::nanoseconds> &t, double *pos,
+                     double *erpos, double *vel = nullptr,
+                     double *ervel = nullptr) noexcept;
+
+  /** @brief Interpolate a batch of queries, in a single round trip.
+   * @param[in]  queries Array of count queries
+   * @param[out] results Array of (at least) count results
+   * @param[in]  velocity Also compute velocities
+   * @return 0 if the request was served (see the status of each result),
+   *         >0 on error
+   */
+  int interpolate(const Sp3ClientQuery *queries, int count,
+                  Sp3ClientResult *results, bool velocity = false) noexcept;
+
+  /** @brief Send an empty request (e.g. to check the connection)
+   * @return 0 on success, >0 on error
+   */
+  int ping() noexcept;
+}; /* class Sp3Client */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,120 @@
+/** @file
+ * Define the (weighted) combination of the Sp3 products of several analysis
+ * centres into a single product. Centres are weighted according to how well
+ * they agree with the combination, after removing a 7-parameter Helmert
+ * transformation (per centre) and the clock datum (per centre and epoch);
+ * weights, transformations and the combination are estimated iteratively.
+ */
+
+#ifndef __SP3C_COMBINE_HPP__
+#define __SP3C_COMBINE_HPP__
+
+#include "sp3.hpp"
+#include "sp3_compare.hpp"
+#include "sp3_executor.hpp"
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3CombineOptions
+ * Options of sp3::combine.
+ */
+struct Sp3CombineOptions {
+  /** Max number of iterations */
+  int max_iterations{10};
+  /** Iterations stop when no centre RMS changes by more than this
+   * (relative) amount
+   */
+  double tolerance{1e-3};
+  /** Estimate a Helmert transformation per centre */
+  bool helmert{true};
+  /** Use the std. deviations of records (where given) along with the
+   * centre RMS to weight records
+   */
+  bool use_sdev{true};
+  /** Records with residuals larger than this many times their sigma (i.e.
+   * centre RMS and std. deviation, as used for weighting) are left out
+   * (re-evaluated at each iteration)
+   */
+  double outlier_factor{5e0};
+  /** Agency and comment lines of the combined product (header) */
+  std::string agency{"CMB"};
+  std::vector<std::string> comments;
+}; /* struct Sp3CombineOptions */
+
+/** @class Sp3CentreSummary
+ * Weight, agreement and transformation of one centre (aka source product)
+ * w.r.t. the combined product.
+ */
+struct Sp3CentreSummary {
+  /** The Sp3 file of the centre */
+  std::string fn;
+  /** Relative weights (summing up to 1 over all centres) */
+  double weight_pos{0e0};
+  double weight_clk{0e0};
+  /** RMS of (per component) residuals [m] and clock residuals [ns] */
+  double rms_pos{0e0};
+  double rms_clk{0e0};
+  /** Helmert transformation from the combined product to the centre's
+   * (over all epochs); t is the first epoch
+   */
+  Sp3HelmertParams helmert;
+  /** Number of position records used and rejected (as outliers) */
+  long num_used{0};
+  long num_rejected{0};
+}; /* struct Sp3CentreSummary */
+
+/** @class Sp3CombinationReport
+ * The result of sp3::combine.
+ */
+struct Sp3CombinationReport {
+  /** One per centre, in the order given */
+  std::vector<Sp3CentreSummary> centres;
+  /** Number of iterations performed */
+  int num_iterations{0};
+  /** Number of epochs written */
+  int num_epochs{0};
+}; /* struct Sp3CombinationReport */
+
+namespace sp3 {
+
+/** @brief Combine the Sp3 products of several centres to a new Sp3 file.
+ *
+ * Sources should be aligned, i.e. record the same epochs; the epochs of
+ * the first source are combined and records of other sources at any other
+ * epoch are ignored. The satellites of the output are the union of the
+ * sources' satellites. The combined clocks refer to the clock datum of the
+ * first source recording clocks at each epoch.
+ *
+ * A record of centre c is weighted by 1 / (rms_c^2 + sdev^2), where rms_c
+ * is the RMS of the centre's residuals (w.r.t. the combination) and sdev
+ * the record's std. deviation (if given and opts.use_sdev is set). Combined
+ * records are written with their formal std. deviations. Velocities are
+ * not combined (nor written).
+ *
+ * Helmert transformations are only defined up to a common one; they are
+ * constrained to a zero weighted (by weight_pos) sum, i.e. no net
+ * translation, rotation or scale, so the frame of the combination is the
+ * weighted mean of the centres' frames. (If a centre has too few records
+ * for a transformation, no constraint is applied; its untransformed frame
+ * fixes the datum.)
+ *
+ * Epochs are combined in parallel; all sources are held in memory.
+ * @param[in]  sources Sp3 products to combine (at least one)
+ * @param[in]  out     Name of the output file (written via a temporary file)
+ * @param[out] report  If not nullptr, filled with per-centre statistics
+ * @param[in]  opts    Combination options
+ * @param[in]  ex      Executor to run on; if nullptr, the default_executor()
+ *                     is used
+ * @return 0 on success, -1 if no data block could be read, >0 on error
+ */
+int combine(const std::vector<const Sp3c *> &sources, const char *out,
+            Sp3CombinationReport *report = nullptr,
+            const Sp3CombineOptions &opts = {}, Executor *ex = nullptr);
+
+} /* namespace sp3 */
+
+} /* namespace dso */
+
+#endif
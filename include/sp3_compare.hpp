@@ -0,0 +1,135 @@
+/** @file
+ * Define the comparison of two Sp3 products (e.g. a rapid against a final
+ * product, or the products of two analysis centres), satellite by satellite
+ * and epoch by epoch. Position differences are reported in the radial,
+ * along-track and cross-track frame of each satellite, along with clock
+ * differences, optionally after removing a (per-epoch) 7-parameter Helmert
+ * transformation between the two products.
+ */
+
+#ifndef __SP3C_COMPARE_HPP__
+#define __SP3C_COMPARE_HPP__
+
+#include "sp3.hpp"
+#include "sp3_executor.hpp"
+#include "sv_interpolate.hpp"
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3CompareOptions
+ * Options of sp3::compare.
+ */
+struct Sp3CompareOptions {
+  /** Estimate (per epoch) and remove a 7-parameter Helmert transformation
+   * between the products, before computing position differences
+   */
+  bool helmert{false};
+  /** Remove the mean clock difference of each epoch (i.e. the difference
+   * of the products' clock datums) from clock differences
+   */
+  bool remove_clock_mean{true};
+  /** Max window of interpolation, for epochs of the first product not
+   * recorded in the second one
+   */
+  dso::milliseconds max_window{three_min_in_millisec};
+}; /* struct Sp3CompareOptions */
+
+/** @class Sp3DiffStats
+ * Statistics of the differences of a single component (e.g. radial).
+ */
+struct Sp3DiffStats {
+  /** Number of differences */
+  long count{0};
+  /** Mean and RMS */
+  double mean{0e0};
+  double rms{0e0};
+  /** Max, median and 95th percentile of absolute differences */
+  double max_abs{0e0};
+  double p50{0e0};
+  double p95{0e0};
+}; /* struct Sp3DiffStats */
+
+/** @class Sp3SvComparison
+ * Differences (second minus first product) of one satellite. Position
+ * differences are in [m], clock differences in [ns].
+ */
+struct Sp3SvComparison {
+  sp3::SatelliteId sv;
+  Sp3DiffStats radial, along, cross, clock;
+  /** RMS of the 3D position differences */
+  double rms_3d{0e0};
+}; /* struct Sp3SvComparison */
+
+/** @class Sp3HelmertParams
+ * A 7-parameter transformation from the first to the second product, at
+ * one epoch, i.e. x2 = T + (1 + D) R x1.
+ */
+struct Sp3HelmertParams {
+  dso::datetime<dso::nanoseconds> t;
+  /** Number of satellites used */
+  int num_sats{0};
+  /** Translation [m] */
+  double tx{0e0}, ty{0e0}, tz{0e0};
+  /** Rotation angles [mas] */
+  double rx{0e0}, ry{0e0}, rz{0e0};
+  /** Scale factor D [ppb] */
+  double scale{0e0};
+  /** RMS of post-fit (3D) residuals [m] */
+  double rms{0e0};
+}; /* struct Sp3HelmertParams */
+
+/** @class Sp3ComparisonReport
+ * The result of sp3::compare.
+ */
+struct Sp3ComparisonReport {
+  /** Per-satellite statistics, for satellites included in both products,
+   * in the order of the first product
+   */
+  std::vector<Sp3SvComparison> satellites;
+  /** Statistics over all satellites */
+  Sp3SvComparison total;
+  /** Helmert parameters, one per epoch (if estimated) */
+  std::vector<Sp3HelmertParams> helmert;
+  /** Number of epochs compared */
+  int num_epochs{0};
+
+  /** @brief Write the report as JSON to file fn (via a temporary file)
+   * @return Anything other than 0 denotes an error
+   */
+  int write_json(const char *fn) const;
+}; /* struct Sp3ComparisonReport */
+
+namespace sp3 {
+
+/** @brief Compare two Sp3 products, a (the reference) and b.
+ *
+ * Differences are computed at the epochs of a. Where b has a record at the
+ * same epoch, it is used as is; else b is interpolated (positions via
+ * SvInterpolator, clocks linearly between the neighbouring records).
+ * Records with a bad/absent position (or clock) in either product are
+ * skipped. The radial/along-track/cross-track frame is defined by the
+ * position and velocity of a; if a has no velocities, these are computed
+ * off from neighbouring positions. Helmert parameters are only estimated
+ * for epochs with at least 4 satellites.
+ *
+ * Records are aligned and reduced to statistics in parallel, one task per
+ * satellite; Helmert parameters are estimated in parallel across epochs.
+ * @param[in]  a      The first (reference) product
+ * @param[in]  b      The second product
+ * @param[out] report The result of the comparison
+ * @param[in]  opts   Comparison options
+ * @param[in]  ex     Executor to run on; if nullptr, the default_executor()
+ *                    is used
+ * @return 0 on success, -1 if the products have no satellites/epochs in
+ *         common, >0 on error
+ */
+int compare(const Sp3c &a, const Sp3c &b, Sp3ComparisonReport &report,
+            const Sp3CompareOptions &opts = {}, Executor *ex = nullptr);
+
+} /* namespace sp3 */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,155 @@
+/** @file
+ * Define the task scheduling facilities used by all parallel algorithms of
+ * the library. By default, tasks are scheduled onto a (lazily created,
+ * process-wide) work-stealing thread pool. Users can instead hand in their
+ * own executor (e.g. one wrapping the thread pool of the host application)
+ * via set_default_executor, so that the library never spins up threads of
+ * its own.
+ *
+ * Parallel algorithms are built on parallel_for, where the calling thread
+ * takes part in the computation and, while waiting, keeps on executing
+ * pending tasks. Hence nested parallel_for calls (e.g. parsing files in
+ * parallel, each of which interpolates satellites in parallel) neither
+ * dead-lock nor oversubscribe the machine.
+ */
+
+#ifndef __SP3C_EXECUTOR_HPP__
+#define __SP3C_EXECUTOR_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dso::sp3 {
+
+/** @class Executor
+ * Abstract interface for anything that can run tasks; implement this to
+ * plug an external scheduler into the library.
+ */
+class Executor {
+public:
+  virtual ~Executor() noexcept = default;
+
+  /** @brief Schedule a task for (asynchronous) execution */
+  virtual void submit(std::function<void()> task) = 0;
+
+  /** @brief Run (at most) one pending task on the calling thread.
+   *
+   * This is called by threads waiting on the completion of other tasks.
+   * Executors that cannot do this should leave the default implementation.
+   * @return true if a task was executed
+   */
+  virtual bool try_run_one() { return false; }
+
+  /** @brief Number of tasks that can run concurrently */
+  virtual int concurrency() const noexcept = 0;
+}; /* class Executor */
+
+/** @class WorkStealingPool
+ * A thread pool with one task queue per worker. Workers push and pop tasks
+ * at the back of their own queue and, when that is empty, steal from the
+ * front of the queues of other workers. Tasks submitted from threads that
+ * do not belong to the pool are distributed round-robin.
+ */
+class WorkStealingPool : public Executor {
+  struct TaskQueue {
+    std::mutex mtx;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  /** One queue per worker */
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  /** The worker threads */
+  std::vector<std::thread> threads_;
+  /** Guards sleeping/waking of workers */
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  /** Number of tasks queued (but not yet started) */
+  std::atomic<int> pending_{0};
+  /** Queue to place the next task submitted from outside the pool */
+  std::atomic<unsigned> next_queue_{0};
+  /** Set when the pool is shutting down */
+  bool stop_{false};
+
+  /** @brief Get the next task to run for worker self (<0 for threads not
+   * belonging to the pool)
+   */
+  bool pop(int self, std::function<void()> &task) noexcept;
+
+  /** @brief Worker thread main loop */
+  void work(int self) noexcept;
+
+public:
+  /** @brief Constructor
+   * @param[in] num_threads Number of worker threads; if <=0, use the
+   *            number of hardware threads
+   */
+  explicit WorkStealingPool(int num_threads = 0);
+
+  /** @brief Copy not allowed ! */
+  WorkStealingPool(const WorkStealingPool &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  /** @brief Destructor; pending tasks are run before the workers join */
+  ~WorkStealingPool() noexcept override;
+
+  void submit(std::function<void()> task) override;
+
+  bool try_run_one() override;
+
+  int concurrency() const noexcept override { return threads_.size(); }
+}; /* class WorkStealingPool */
+
+/** @brief The executor used by all parallel algorithms of the library,
+ * unless one is explicitly passed in.
+ *
+ * That is the one set via set_default_executor, or else an internal
+ * WorkStealingPool, created on first use.
+ */
+Executor &default_executor();
+
+/** @brief Set the default executor.
+ *
+ * The executor is not owned by the library and must outlive any use of it.
+ * Pass in nullptr to revert to the internal work-stealing pool.
+ */
+void set_default_executor(Executor *ex) noexcept;
+
+/** @brief Call f(b, e) for consecutive chunks [b, e) covering [begin, end),
+ * in parallel.
+ *
+ * The calling thread participates and the call returns when all chunks are
+ * done. If any call to f throws, the (first) exception is re-thrown here.
+ * @param[in] grain Size of chunks; if <=0, a size is chosen based on the
+ *            executor's concurrency
+ * @param[in] ex The executor to use; if nullptr, use default_executor()
+ */
+void parallel_for_chunks(int begin, int end,
+                         const std::function<void(int, int)> &f,
+                         Executor *ex = nullptr, int grain = 0);
+
+/** @brief Call f(i) for every i in [begin, end), in parallel; see
+ * parallel_for_chunks.
+ */
+template <typename F>
+void parallel_for(int begin, int end, F &&f, Executor *ex = nullptr,
+                  int grain = 0) {
+  parallel_for_chunks(
+      begin, end,
+      [&f](int b, int e) {
+        for (int i = b; i < e; i++)
+          f(i);
+      },
+      ex, grain);
+}
+
+} /* namespace dso::sp3 */
+
+#endif
@@ -0,0 +1,172 @@
+/** @file
+ * Define an exporter of Sp3 data records to columnar binary files (NPY or
+ * raw little-endian arrays), along with a JSON manifest describing them,
+ * so that array tools (numpy, Julia, R, ...) can load (or memory-map) them
+ * directly.
+ *
+ * Records are streamed through in chunks, i.e. memory use does not depend
+ * on the amount of data exported and any number of (consecutive) files can
+ * be exported to a single set of columns.
+ */
+
+#ifndef __SP3C_EXPORT_HPP__
+#define __SP3C_EXPORT_HPP__
+
+#include "sp3.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dso {
+
+/** @enum Sp3ExportFormat Format of exported column files */
+enum class Sp3ExportFormat {
+  /** NumPy .npy files (version 1.0) */
+  npy,
+  /** Raw arrays, little-endian, no header (see the manifest for types) */
+  raw
+}; /* enum class Sp3ExportFormat */
+
+/** @enum Sp3ExportLayout How records are grouped into columns */
+enum class Sp3ExportLayout {
+  /** One set of columns for all records, with a satellite column */
+  whole_file,
+  /** One set of columns per satellite, each in a directory of its own */
+  per_satellite
+}; /* enum class Sp3ExportLayout */
+
+/** @class Sp3ExportOptions Options of an Sp3ColumnExporter */
+struct Sp3ExportOptions {
+  Sp3ExportFormat format{Sp3ExportFormat::npy};
+  Sp3ExportLayout layout{Sp3ExportLayout::whole_file};
+  /** Number of records buffered (over all tables) before written out */
+  int chunk_records{1 << 16};
+}; /* struct Sp3ExportOptions */
+
+/** @class Sp3ColumnExporter
+ * Export the data records of one or more Sp3 files to columns.
+ *
+ * Columns exported are: t (epoch, int64 nanoseconds w.r.t. the reference
+ * epoch, i.e. the start epoch of the first file), sv (3-char satellite id;
+ * whole_file layout only), x, y, z, clk, vx, vy, vz, vclk (state, as in
+ * Sp3DataBlock::state), sdev_x, ..., sdev_vclk (std. deviations) and flag
+ * (uint32, see Sp3Flag). All records are exported, including those with
+ * bad/absent values (see flag). Files must be added in chronological
+ * order; records of a satellite not later than the last one exported for
+ * it (e.g. the midnight epoch repeated in consecutive daily files) are
+ * skipped.
+ *
+ * Columns are written to a directory, along with the file manifest.json,
+ * once finish is called. Column files are kept open between flushes (up to
+ * a limit on the number of files open, past which the least recently
+ * written tables are closed).
+ */
+class Sp3ColumnExporter {
+  /** @brief A set of columns: the records of one satellite, or all */
+  struct Table {
+    /** Name (satellite id or "all") and directory of column files */
+    std::string name;
+    std::string dir;
+    /** Records written out */
+    int64_t num_records{0};
+    /** Records buffered: epochs, satellite ids, state and std. deviation
+     * components, flags
+     */
+    std::vector<int64_t> t;
+    std::vector<char> sv;
+    std::vector<double> values[16];
+    std::vector<uint32_t> flags;
+    /** Column files, kept open between flushes (empty if closed) */
+    std::vector<std::FILE *> fps;
+    /** Flush (count) the table was last written out at */
+    uint64_t last_flush{0};
+  }; /* struct Table */
+
+  std::string dir_;
+  Sp3ExportOptions opts_;
+  std::vector<Table> tables_;
+  /** Satellites, in the order first encountered, and epoch (w.r.t. the
+   * reference) of the last record exported for each
+   */
+  std::vector<sp3::SatelliteId> svs_;
+  std::vector<int64_t> last_t_;
+  /** Index in svs_, keyed on (packed) satellite id */
+  std::unordered_map<uint32_t, int> sv_map_;
+  /** Number of records buffered, over all tables */
+  int buffered_{0};
+  /** Reference epoch and time system (off from the first file) */
+  dso::datetime<dso::nanoseconds> ref_;
+  std::string time_sys_;
+  bool has_ref_{false};
+  std::vector<std::string> sources_;
+  bool finished_{false};
+  /** Number of column files open, and of table flushes so far */
+  int num_open_{0};
+  uint64_t num_flushes_{0};
+
+  /** @brief Index of SV sv in svs_; added if needed */
+  int sv_index(const sp3::SatelliteId &sv);
+
+  /** @brief Table for (the index of) an SV; created if needed */
+  Table &table_of(int k);
+
+  /** @brief Path of a column file of a table */
+  std::string column_path(const Table &tbl, const char *column) const;
+
+  /** @brief Open the column files of a table (if not already open),
+   * closing those of the least recently written tables if too many files
+   * are open
+   */
+  int open_files(Table &tbl);
+
+  /** @brief Close the column files of a table */
+  int close_files(Table &tbl) noexcept;
+
+  /** @brief Write out the records buffered in a table */
+  int flush(Table &tbl);
+
+  /** @brief Write out the records buffered in all tables */
+  int flush_all();
+
+  /** @brief Write the manifest */
+  int write_manifest() const;
+
+public:
+  /** @brief Constructor
+   * @param[in] dir Directory to export to; created if it does not exist
+   * @param[in] opts Export options
+   * @throw std::runtime_error if the directory can not be created
+   */
+  explicit Sp3ColumnExporter(const char *dir,
+                             Sp3ExportOptions opts = Sp3ExportOptions());
+
+  /** @brief Copy not allowed ! */
+  Sp3ColumnExporter(const Sp3ColumnExporter &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  Sp3ColumnExporter &operator=(const Sp3ColumnExporter &) = delete;
+
+  /** @brief Destructor; closes any open column files (see finish) */
+  ~Sp3ColumnExporter() noexcept;
+
+  /** @brief Export the records of an Sp3 file (read through an independent
+   * cursor).
+   * @return 0 on success, >0 on error
+   */
+  int add(const Sp3c &sp3);
+
+  /** @brief Write out any buffered records, finalize column files (NPY
+   * headers) and write the manifest; no more files can be added.
+   * @return 0 on success, >0 on error
+   */
+  int finish();
+
+  /** @brief Number of records exported so far */
+  int64_t num_records() const noexcept;
+}; /* class Sp3ColumnExporter */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,48 @@
+/** @file
+ * Define extraction of subsets (time windows, satellites) of Sp3 files to
+ * new Sp3 files. Using the epoch index, header lines and records are copied
+ * verbatim (as raw byte ranges) off from the file mapping; only the header
+ * lines holding the start epoch, the number of epochs and the satellite
+ * list are re-written. No record is decoded or re-formatted.
+ */
+
+#ifndef __SP3C_EXTRACT_HPP__
+#define __SP3C_EXTRACT_HPP__
+
+#include "sp3_filter.hpp"
+#include <string>
+
+namespace dso::sp3 {
+
+/** @brief Extract the epochs and satellites selected by a filter off from
+ * an Sp3 file, to a new Sp3 file.
+ *
+ * The filter may select satellites, a time window and decimate epochs (the
+ * interval in the header is adjusted); flag stages (with_event,
+ * without_event) can not be applied without decoding records and are
+ * refused. Epochs selected are copied as a whole (even if they hold no
+ * record of the satellites selected), so that the output has a regular
+ * interval. If the file has no epoch index, it is built. The output is
+ * written to a temporary file and renamed into place once complete.
+ * @param[in] sp3 The Sp3 file to extract off from
+ * @param[in] out Name of the Sp3 file to create (or replace)
+ * @param[in] f   Selection of satellites and epochs
+ * @return 0 on success; -1 if nothing is selected (no file is written);
+ *         >0 on error
+ */
+int extract(Sp3c &sp3, const char *out, const Sp3Filter &f = Sp3Filter());
+
+/** @brief Split an Sp3 file into one Sp3 file per satellite, in a single
+ * pass over the file; see extract.
+ *
+ * Output files are named prefix + id + ".sp3", e.g. for prefix
+ * "out/igs22950_", files "out/igs22950_G01.sp3", ... are created.
+ * @return 0 on success; -1 if nothing is selected (no file is written);
+ *         >0 on error
+ */
+int split_satellites(Sp3c &sp3, const std::string &prefix,
+                     const Sp3Filter &f = Sp3Filter());
+
+} /* namespace dso::sp3 */
+
+#endif
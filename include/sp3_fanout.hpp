@@ -0,0 +1,156 @@
+/** @file
+ * Define a publish/subscribe stage over the data blocks of an Sp3 file: the
+ * file is parsed once and every epoch is delivered to any number of
+ * subscribers (e.g. a quality monitor, an interpolator builder and a
+ * statistics collector), instead of each of them reading the file on its
+ * own.
+ */
+
+#ifndef __SP3C_FANOUT_HPP__
+#define __SP3C_FANOUT_HPP__
+
+#include "sp3_filter.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3Subscriber
+ * Interface for consumers of the epochs published by an Sp3FanOut.
+ */
+class Sp3Subscriber {
+public:
+  virtual ~Sp3Subscriber() noexcept = default;
+
+  /** @brief Consume an epoch; epochs arrive in file order.
+   * @return 0 to keep on receiving epochs; anything else unsubscribes (the
+   *         value is reported via Sp3FanOut::status)
+   */
+  virtual int on_epoch(const Sp3EpochBuffer &epoch) = 0;
+
+  /** @brief Called once, after the last epoch was delivered
+   * @param[in] status 0 if the file was read through, >0 if parsing failed
+   */
+  virtual void on_end(int /*status*/) {}
+}; /* class Sp3Subscriber */
+
+/** @class Sp3FanOutStats Statistics of a subscription */
+struct Sp3FanOutStats {
+  /** Epochs delivered to the subscriber */
+  uint64_t delivered{0};
+  /** Times the parser had to wait because the subscriber's queue was full */
+  uint64_t stalls{0};
+  /** Max number of epochs queued for the subscriber at any time */
+  int max_queued{0};
+}; /* struct Sp3FanOutStats */
+
+/** @class Sp3FanOut
+ * Parse an Sp3 file once, delivering each epoch to all subscribers.
+ *
+ * Subscribers either run on the parsing thread (inline) or on a thread of
+ * their own, fed through a bounded queue. Epoch buffers are shared (not
+ * copied) among subscribers and are re-used once all subscribers are done
+ * with them. When the queue of a (threaded) subscriber is full, parsing
+ * waits until the subscriber catches up (backpressure), so memory use is
+ * bounded by the queue capacity, whatever the speed of the subscribers.
+ * Subscribers run on dedicated threads (not on an sp3::Executor), since
+ * they block on their queues.
+ */
+class Sp3FanOut {
+  using EpochPtr = std::shared_ptr<const Sp3EpochBuffer>;
+
+  /** @brief A subscription */
+  struct Channel {
+    Sp3Subscriber *sub;
+    bool threaded;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<EpochPtr> queue;
+    /** Set by the parser when there are no more epochs */
+    bool closed{false};
+    /** Set when the subscriber has unsubscribed */
+    bool done{false};
+    int status{0};
+    /** Status of parsing, passed to on_end */
+    int end_status{0};
+    Sp3FanOutStats stats;
+    std::thread thread;
+  }; /* struct Channel */
+
+  std::vector<std::unique_ptr<Channel>> channels_;
+  /** Max number of epochs queued per (threaded) subscriber */
+  int capacity_;
+  /** Epoch buffers allocated, and those not held by any subscriber */
+  std::vector<std::unique_ptr<Sp3EpochBuffer>> buffers_;
+  std::vector<Sp3EpochBuffer *> free_;
+  std::mutex pool_mtx_;
+
+  /** @brief Get a buffer not held by any subscriber; it returns to the
+   * pool once all (shared) references to it are dropped
+   */
+  std::shared_ptr<Sp3EpochBuffer> acquire_buffer();
+
+  /** @brief Deliver an epoch to a channel; wait while its queue is full */
+  static void push(Channel &ch, int capacity, const EpochPtr &epoch);
+
+  /** @brief Loop of a subscriber's thread */
+  static void consume(Channel &ch) noexcept;
+
+public:
+  /** @brief Constructor
+   * @param[in] queue_capacity Max number of epochs queued per (threaded)
+   *            subscriber (at least 1)
+   */
+  explicit Sp3FanOut(int queue_capacity = 16) noexcept
+      : capacity_(queue_capacity > 0 ? queue_capacity : 1) {}
+
+  /** @brief Copy not allowed ! */
+  Sp3FanOut(const Sp3FanOut &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  Sp3FanOut &operator=(const Sp3FanOut &) = delete;
+
+  /** @brief Register a subscriber; it must outlive any call to run.
+   * @param[in] sub The subscriber
+   * @param[in] threaded If true, the subscriber runs on a thread of its
+   *            own; else, on the thread calling run
+   * @return The index of the subscription (see status and stats)
+   */
+  int subscribe(Sp3Subscriber *sub, bool threaded = true);
+
+  /** @brief Number of subscribers */
+  int num_subscribers() const noexcept { return channels_.size(); }
+
+  /** @brief Parse an Sp3 file (through an independent cursor), delivering
+   * the epochs that pass filter f to all subscribers.
+   *
+   * Returns when all subscribers have consumed all epochs (or have
+   * unsubscribed) and on_end has been called on each of them. Parsing
+   * stops early if all subscribers unsubscribe. If publishing fails
+   * half-way (e.g. a subscriber thread can not be started), subscribers
+   * are stopped and on_end is called on each of them with a status >0.
+   * Exceptions thrown by subscribers are reported, never propagated.
+   * @return 0 on success, >0 if parsing (or publishing) failed
+   */
+  int run(const Sp3c &sp3, const Sp3Filter &f = Sp3Filter());
+
+  /** @brief Status of subscription i after run; 0 if the subscriber
+   * consumed all epochs, else the value returned by on_epoch when it
+   * unsubscribed
+   */
+  int status(int i) const noexcept { return channels_[i]->status; }
+
+  /** @brief Statistics of subscription i, after run */
+  const Sp3FanOutStats &stats(int i) const noexcept {
+    return channels_[i]->stats;
+  }
+}; /* class Sp3FanOut */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,88 @@
+/** @file
+ * Define lazy filter stages over the data records of an Sp3 file: by
+ * satellite/constellation, by Sp3Flag events, by time window, and
+ * decimation. Stages compose (via operator|) into a single Sp3Filter, which
+ * is applied while parsing; epochs and records filtered out are skipped
+ * without being parsed (where possible) and no intermediate containers are
+ * built. See also sp3_generator.hpp for a (C++20) coroutine interface.
+ */
+
+#ifndef __SP3C_FILTER_HPP__
+#define __SP3C_FILTER_HPP__
+
+#include "sp3.hpp"
+#include <initializer_list>
+
+namespace dso {
+
+/** @class Sp3Filter
+ * A (composed) filter over the data records of an Sp3 file.
+ *
+ * Epoch-level stages (time window, decimation) are applied before an
+ * epoch's records are parsed; SV selection is applied per record line,
+ * before parsing; flag stages are applied to parsed records.
+ */
+struct Sp3Filter {
+  /** SVs accepted */
+  Sp3SvSelection svs;
+  /** Time window, inclusive */
+  dso::datetime<dso::nanoseconds> t_start{
+      dso::datetime<dso::nanoseconds>::min()};
+  dso::datetime<dso::nanoseconds> t_stop{
+      dso::datetime<dso::nanoseconds>::max()};
+  /** Keep every n-th epoch (of the epochs within the time window) */
+  int every{1};
+  /** Events that must be set/must not be set in a record's flag */
+  sp3::uitype require_bits{0};
+  sp3::uitype reject_bits{0};
+
+  /** @brief Compose two filters; the result accepts what both accept */
+  Sp3Filter operator|(const Sp3Filter &f) const;
+
+  /** @brief Check if a (parsed) record passes the flag stages */
+  bool accepts(const Sp3DataBlock &block) const noexcept {
+    return (block.flag.bits_ & require_bits) == require_bits &&
+           !(block.flag.bits_ & reject_bits);
+  }
+
+  /** @brief Read the next epoch that passes the filter.
+   *
+   * Records not accepted are dropped from the buffer; epochs left with no
+   * records are skipped.
+   * @param[in,out] cursor Cursor to read off from
+   * @param[out] buf Holds the epoch and its accepted records
+   * @param[in,out] count Number of epochs within the time window seen so
+   *             far (used for decimation); set to 0 before the first call
+   * @return 0 on success, -1 if there are no more epochs (or the time
+   *         window is exhausted), >0 on error
+   */
+  int next_epoch(Sp3Cursor &cursor, Sp3EpochBuffer &buf,
+                 long &count) const noexcept;
+}; /* struct Sp3Filter */
+
+namespace sp3 {
+
+/** @brief Stage: keep records of the given constellations, e.g. "GE" */
+Sp3Filter systems(const char *ids);
+
+/** @brief Stage: keep records of the given SVs */
+Sp3Filter satellites(std::initializer_list<SatelliteId> svs);
+
+/** @brief Stage: keep records with event e set in their flag */
+Sp3Filter with_event(Sp3Event e) noexcept;
+
+/** @brief Stage: drop records with event e set in their flag */
+Sp3Filter without_event(Sp3Event e) noexcept;
+
+/** @brief Stage: keep epochs in the range [t0, t1] */
+Sp3Filter time_window(const dso::datetime<dso::nanoseconds> &t0,
+                      const dso::datetime<dso::nanoseconds> &t1) noexcept;
+
+/** @brief Stage: keep every n-th epoch */
+Sp3Filter decimate(int n) noexcept;
+
+} /* namespace sp3 */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,163 @@
+/** @file
+ * Define (C++20) coroutine generators over the data records of an Sp3 file,
+ * yielding epochs or per-satellite records, filtered via lazy stages (see
+ * sp3_filter.hpp). E.g. GPS records, not predicted, every 4th epoch:
+ *
+ *   using namespace dso::sp3;
+ *   const auto f = systems("G") |
+ *                  without_event(Sp3Event::orbit_prediction) | decimate(4);
+ *   for (const auto &rec : records(sp3, f))
+ *     use(rec.sv, rec.block);
+ *
+ * Stages are applied within the parse loop; the generator re-uses a single
+ * epoch buffer, so no intermediate containers are built. This header is
+ * only available when compiling with C++20 (or later); the rest of the
+ * library only requires C++17.
+ */
+
+#ifndef __SP3C_GENERATOR_HPP__
+#define __SP3C_GENERATOR_HPP__
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include "sp3_filter.hpp"
+#include <coroutine>
+#include <exception>
+#include <iterator>
+
+namespace dso {
+
+/** @class Sp3Generator
+ * A (single-pass) generator of values of type T. Values yielded are
+ * referenced (not copied); they remain valid until the generator is
+ * advanced.
+ */
+template <typename T> class Sp3Generator {
+public:
+  struct promise_type {
+    const T *value{nullptr};
+    /** Status the generator finished with (see Sp3Filter::next_epoch) */
+    int status{0};
+
+    Sp3Generator get_return_object() noexcept {
+      return Sp3Generator(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    std::suspend_always final_suspend() const noexcept { return {}; }
+    std::suspend_always yield_value(const T &v) noexcept {
+      value = &v;
+      return {};
+    }
+    void return_value(int s) noexcept { status = s; }
+    void unhandled_exception() { throw; }
+  }; /* struct promise_type */
+
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  class iterator {
+    handle_type h_;
+
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = const T &;
+
+    explicit iterator(handle_type h = nullptr) noexcept : h_(h) {}
+    reference operator*() const noexcept { return *h_.promise().value; }
+    pointer operator->() const noexcept { return h_.promise().value; }
+    iterator &operator++() {
+      h_.resume();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    bool operator==(std::default_sentinel_t) const noexcept {
+      return !h_ || h_.done();
+    }
+  }; /* class iterator */
+
+private:
+  handle_type h_;
+
+  explicit Sp3Generator(handle_type h) noexcept : h_(h) {}
+
+public:
+  Sp3Generator(const Sp3Generator &) = delete;
+  Sp3Generator &operator=(const Sp3Generator &) = delete;
+  Sp3Generator(Sp3Generator &&g) noexcept : h_(g.h_) { g.h_ = nullptr; }
+  Sp3Generator &operator=(Sp3Generator &&g) noexcept {
+    if (this != &g) {
+      if (h_)
+        h_.destroy();
+      h_ = g.h_;
+      g.h_ = nullptr;
+    }
+    return *this;
+  }
+  ~Sp3Generator() noexcept {
+    if (h_)
+      h_.destroy();
+  }
+
+  iterator begin() {
+    h_.resume();
+    return iterator(h_);
+  }
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+  /** @brief Once exhausted, the status the generator finished with: 0 if
+   * all data were read (or the time window was exhausted), >0 on error
+   */
+  int status() const noexcept { return h_ ? h_.promise().status : 0; }
+}; /* class Sp3Generator */
+
+/** @class Sp3Record A record of one SV, as yielded by records() */
+struct Sp3Record {
+  sp3::SatelliteId sv;
+  Sp3DataBlock block;
+}; /* struct Sp3Record */
+
+/** @brief Generate the epochs of an Sp3 file that pass a filter; each epoch
+ * holds the (accepted) records of all SVs.
+ *
+ * The file is read through an independent cursor; sp3 must outlive the
+ * generator.
+ */
+inline Sp3Generator<Sp3EpochBuffer> epochs(const Sp3c &sp3,
+                                           Sp3Filter filter = {}) {
+  Sp3Cursor cursor(sp3);
+  Sp3EpochBuffer buf;
+  long count = 0;
+  int error;
+  while (!(error = filter.next_epoch(cursor, buf, count)))
+    co_yield buf;
+  co_return (error < 0) ? 0 : error;
+}
+
+/** @brief Generate the records of an Sp3 file that pass a filter, one per
+ * SV and epoch, in file order. See epochs.
+ */
+inline Sp3Generator<Sp3Record> records(const Sp3c &sp3,
+                                       Sp3Filter filter = {}) {
+  Sp3Cursor cursor(sp3);
+  Sp3EpochBuffer buf;
+  Sp3Record rec;
+  long count = 0;
+  int error;
+  while (!(error = filter.next_epoch(cursor, buf, count))) {
+    for (int i = 0; i < buf.size(); i++) {
+      rec.sv = buf.sats[i];
+      rec.block = buf.blocks[i];
+      co_yield rec;
+    }
+  }
+  co_return (error < 0) ? 0 : error;
+}
+
+} /* namespace dso */
+
+#endif /* C++20 */
+
+#endif
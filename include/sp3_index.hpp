@@ -0,0 +1,90 @@
+/** @file
+ * Define an epoch index for Sp3 files, i.e. a table of byte offsets for each
+ * data block (epoch) and each satellite record in an Sp3 file. The index can
+ * be persisted to (and recovered from) a small binary sidecar file, so that
+ * the same file can be re-opened with random access and no scan at all.
+ */
+
+#ifndef __SP3C_EPOCH_INDEX__
+#define __SP3C_EPOCH_INDEX__
+
+#include "datetime/calendar.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3Fingerprint
+ * Identify the contents of an Sp3 file, so that we can tell if a (persisted)
+ * index still describes the file it was built for.
+ */
+struct Sp3Fingerprint {
+  /** File size in bytes */
+  uint64_t size{0};
+  /** Last modification time [nsec since the Unix epoch] */
+  int64_t mtime{0};
+  /** FNV-1a hash of the header and of the last few bytes of the file */
+  uint64_t hash{0};
+
+  bool operator==(const Sp3Fingerprint &f) const noexcept {
+    return size == f.size && mtime == f.mtime && hash == f.hash;
+  }
+  bool operator!=(const Sp3Fingerprint &f) const noexcept {
+    return !(this->operator==(f));
+  }
+}; /* struct Sp3Fingerprint */
+
+/** @class Sp3EpochIndex
+ * An index of the data blocks of an Sp3 file. For every epoch (data block)
+ * we store the byte offset of the epoch header line and the resolved epoch.
+ * For every epoch and every satellite (in the order they appear in the
+ * file's header) we also store the offset of the satellite's Position and
+ * Clock record, relative to the epoch header line, or a negative value if
+ * the record is missing.
+ */
+struct Sp3EpochIndex {
+  /** Fingerprint of the file the index was built for */
+  Sp3Fingerprint fingerprint;
+  /** Byte offset of each Epoch Header Record */
+  std::vector<int64_t> epoch_pos;
+  /** Epoch of each data block */
+  std::vector<dso::datetime<dso::nanoseconds>> epochs;
+  /** Offsets of Position records per epoch (row) and satellite (column),
+   * relative to the corresponding epoch_pos; -1 denotes a missing record
+   */
+  std::vector<int32_t> sv_pos;
+  /** Number of satellites (columns in sv_pos) */
+  int num_sats{0};
+
+  /** Number of epochs in index */
+  int num_epochs() const noexcept { return epochs.size(); }
+
+  /** Check if the index is empty (aka not built/loaded) */
+  bool empty() const noexcept { return epochs.empty(); }
+
+  /** Reset to an empty index */
+  void clear() noexcept {
+    epoch_pos.clear();
+    epochs.clear();
+    sv_pos.clear();
+    num_sats = 0;
+    fingerprint = Sp3Fingerprint{};
+  }
+
+  /** Offset of the Position record for epoch at index epoch and satellite
+   * at index sv, relative to the epoch header; <0 if record is missing
+   */
+  int32_t sv_offset(int epoch, int sv) const noexcept {
+    return sv_pos[epoch * num_sats + sv];
+  }
+
+  /** @brief Return the index of the first epoch which is not less than t
+   * @return An index in the range [0, num_epochs()]; num_epochs() denotes
+   *         that all epochs are before t.
+   */
+  int lower_bound(const dso::datetime<dso::nanoseconds> &t) const noexcept;
+}; /* struct Sp3EpochIndex */
+
+} /* namespace dso */
+
+#endif
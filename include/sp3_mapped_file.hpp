@@ -0,0 +1,113 @@
+/** @file
+ * Define a (movable, non-copyable) read-only memory mapping of a file. This
+ * is what Sp3c instances use to share one opened file between any number of
+ * independent read cursors. A file can also be read into a private snapshot
+ * (anonymous memory), e.g. for files that may be truncated or rewritten in
+ * place while being read, where a shared mapping would fault (SIGBUS).
+ */
+
+#ifndef __SP3C_MAPPED_FILE_HPP__
+#define __SP3C_MAPPED_FILE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dso::sp3 {
+
+/** @brief How a file is brought into memory (see MappedFile::map) */
+enum class MapMode : char {
+  /** Shared, read-only mapping of the file */
+  shared,
+  /** Private copy of the file's bytes (read via pread) */
+  snapshot
+}; /* enum class MapMode */
+
+/** @class MappedFile A read-only memory mapping of a whole file */
+class MappedFile {
+  /** Start of mapped memory */
+  const char *data_{nullptr};
+  /** Size of mapped memory (aka file size) in bytes */
+  std::size_t size_{0};
+  /** Mapping mode */
+  MapMode mode_{MapMode::shared};
+  /** Modification time of the file [nsec since the Unix epoch], as mapped */
+  int64_t mtime_{0};
+
+public:
+  MappedFile() noexcept = default;
+
+  /** @brief Copy not allowed ! */
+  MappedFile(const MappedFile &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /** @brief Move constructor; the moved-from instance is left unmapped */
+  MappedFile(MappedFile &&m) noexcept
+      : data_(m.data_), size_(m.size_), mode_(m.mode_), mtime_(m.mtime_) {
+    m.data_ = nullptr;
+    m.size_ = 0;
+  }
+
+  /** @brief Move assignment; any previous mapping is released */
+  MappedFile &operator=(MappedFile &&m) noexcept {
+    if (this != &m) {
+      unmap();
+      data_ = m.data_;
+      size_ = m.size_;
+      mode_ = m.mode_;
+      mtime_ = m.mtime_;
+      m.data_ = nullptr;
+      m.size_ = 0;
+    }
+    return *this;
+  }
+
+  /** @brief Destructor; release mapping */
+  ~MappedFile() noexcept { unmap(); }
+
+  /** @brief Map (the whole of) file fn, read-only, or read it into a
+   * private snapshot (mode MapMode::snapshot).
+   * @return Anything other than 0 denotes an error.
+   */
+  int map(const char *fn, MapMode mode = MapMode::shared) noexcept;
+
+  /** @brief Re-map file fn after it has changed size in place (e.g. data
+   * were appended to it), keeping the mapping if the size is unchanged.
+   *
+   * The file must be the one mapped (not replaced by another one). On
+   * Linux, the mapping is resized (via mremap), elsewhere it is re-created;
+   * either way, pointers off from data() may be invalidated. For snapshots,
+   * only the bytes past the previous size are read, and a file that has
+   * shrunk is an error.
+   * @return Anything other than 0 denotes an error, in which case the
+   *         previous mapping is left intact.
+   */
+  int remap(const char *fn) noexcept;
+
+  /** @brief Release mapping (if any) */
+  void unmap() noexcept;
+
+  /** @brief Advise the kernel that the whole mapping will be needed soon,
+   * so that (asynchronous) read-ahead of the file's pages starts right away.
+   */
+  void will_need() const noexcept;
+
+  /** @brief Start of mapped memory (nullptr if nothing is mapped) */
+  const char *data() const noexcept { return data_; }
+
+  /** @brief Size of mapped memory in bytes */
+  std::size_t size() const noexcept { return size_; }
+
+  /** @brief Mapping mode */
+  MapMode mode() const noexcept { return mode_; }
+
+  /** @brief Modification time of the file [nsec since the Unix epoch], as
+   * reported when (re-)mapped; for snapshots, when the bytes were last read
+   */
+  int64_t mtime() const noexcept { return mtime_; }
+}; /* class MappedFile */
+
+} /* namespace dso::sp3 */
+
+#endif
@@ -0,0 +1,60 @@
+/** @file
+ * Define a (streaming) merge of several Sp3 products into one, e.g. a
+ * GPS-only and a Galileo-only product into a multi-GNSS one. Sources are
+ * read epoch by epoch and merged on their epochs (k-way), so that only one
+ * epoch per source is held in memory, regardless of the size of the inputs.
+ */
+
+#ifndef __SP3C_MERGE_HPP__
+#define __SP3C_MERGE_HPP__
+
+#include "sp3.hpp"
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3MergeOptions
+ * Options of sp3::merge.
+ */
+struct Sp3MergeOptions {
+  /** If a satellite is recorded (at the same epoch) in more than one
+   * source, the record of the source given first is kept; if set, a record
+   * with a bad/absent position is replaced by a valid one of a later source
+   */
+  bool prefer_valid{true};
+  /** Agency of the merged product (header); empty: that of the first
+   * source
+   */
+  std::string agency;
+  /** Comment lines of the merged product (header) */
+  std::vector<std::string> comments;
+}; /* struct Sp3MergeOptions */
+
+namespace sp3 {
+
+/** @brief Merge a list of Sp3 products to a new Sp3 file.
+ *
+ * The satellite list of the output is the union of the sources' lists (in
+ * the order first encountered). Epochs are the union of the sources'
+ * epochs, i.e. an epoch recorded in any source is written, holding the
+ * records of all sources for that epoch; duplicate records are resolved
+ * via options.prefer_valid. The header is based on that of the first source;
+ * the interval is the smallest of the sources' and velocities are written
+ * if any source has them. Sources are read through independent cursors
+ * (their streams are left untouched).
+ *
+ * The output is written to a temporary file, renamed to out on success.
+ * @param[in] sources Sp3 products to merge, in order of priority
+ * @param[in] out     Name of the output file
+ * @param[in] options Merge options
+ * @return 0 on success, -1 if no data block could be read, >0 on error
+ */
+int merge(const std::vector<const Sp3c *> &sources, const char *out,
+          const Sp3MergeOptions &options = {});
+
+} /* namespace sp3 */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,196 @@
+/** @file
+ * Define a publication mechanism for (versions of) Sp3 products, so that
+ * long-running services can switch to a newer product (e.g. a rapid
+ * replacing an ultra-rapid one) without pausing query threads. Versions are
+ * published via atomic shared pointers (RCU-style), and a version is
+ * reclaimed as soon as no reader references it any more. Readers check for
+ * a new version with a single atomic load; only when the version has
+ * changed do they acquire it, which (with libstdc++) briefly takes a lock
+ * of a (global) mutex pool, also taken by writers storing the pointer.
+ * Neither side ever holds it for longer than a reference count update.
+ */
+
+#ifndef __SP3C_PUBLICATION_HPP__
+#define __SP3C_PUBLICATION_HPP__
+
+#include "sv_interpolator_set.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @class AtomicPublication
+ * Publish immutable instances of T, via an atomic shared pointer.
+ *
+ * Readers get a reference-counted snapshot of the current instance; it
+ * remains valid (and unchanged) for as long as it is held, even if newer
+ * instances are published meanwhile. The previous instance is released
+ * when its last reader drops it. Each publication increments a version
+ * counter, which readers can check (a single, lock-free atomic load) to see
+ * if their snapshot is stale; acquire and publish may briefly lock (see
+ * std::atomic_load for shared pointers).
+ */
+template <typename T> class AtomicPublication {
+  std::shared_ptr<const T> current_;
+  std::atomic<uint64_t> version_{0};
+
+public:
+  /** @brief Get (a snapshot of) the current instance; may be nullptr if
+   * nothing is published yet
+   */
+  std::shared_ptr<const T> acquire() const noexcept {
+    return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+  }
+
+  /** @brief Publish a new instance, replacing the current one.
+   * @return The version of the instance published
+   */
+  uint64_t publish(std::shared_ptr<const T> next) noexcept {
+    std::atomic_store_explicit(&current_, std::move(next),
+                               std::memory_order_release);
+    return version_.fetch_add(1, std::memory_order_acq_rel) + 1;
+  }
+
+  /** @brief Version of the current instance (0: nothing published) */
+  uint64_t version() const noexcept {
+    return version_.load(std::memory_order_acquire);
+  }
+}; /* class AtomicPublication */
+
+/** @class Sp3Dataset
+ * A loaded version of an Sp3 product: interpolators for all of its
+ * satellites. Instances are immutable once published; versions share the
+ * interpolators of satellites with unchanged records.
+ */
+struct Sp3Dataset {
+  /** The Sp3 file the dataset was loaded off from */
+  std::string source;
+  /** Version, as assigned by the publisher */
+  uint64_t version{0};
+  /** First and last epoch of the product (as per its header) */
+  dso::datetime<dso::nanoseconds> t_start, t_stop;
+  /** Interpolators, one per satellite */
+  SvInterpolatorSet interpolators;
+
+  explicit Sp3Dataset(dso::milliseconds max_window) noexcept
+      : interpolators(max_window) {}
+}; /* struct Sp3Dataset */
+
+/** @class Sp3Publisher
+ * Load and publish versions of an Sp3 product (see Sp3Dataset).
+ *
+ * Publishing is serialized (one writer at a time) and never waits for
+ * readers to finish with older versions; readers (see Sp3Reader) never
+ * wait for a version to be built.
+ */
+class Sp3Publisher {
+  AtomicPublication<Sp3Dataset> pub_;
+  /** Serializes writers */
+  std::mutex write_mtx_;
+  /** Max window of interpolation of datasets */
+  dso::milliseconds max_window_;
+
+public:
+  /** @brief Constructor; nothing is published until publish is called
+   * @param[in] max_window Max time distance of data points (from the
+   *            requested epoch) used in interpolation
+   */
+  explicit Sp3Publisher(
+      dso::milliseconds max_window = three_min_in_millisec) noexcept
+      : max_window_(max_window) {}
+
+  /** @brief Copy not allowed ! */
+  Sp3Publisher(const Sp3Publisher &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  Sp3Publisher &operator=(const Sp3Publisher &) = delete;
+
+  /** @brief Load an Sp3 product and publish it as the current version.
+   *
+   * The new dataset is built off to the side; interpolators of satellites
+   * with records identical to the current version's are shared with it,
+   * rather than re-read or copied (see SvInterpolatorSet::load). On error,
+   * nothing is published.
+   * @param[in]  fn The Sp3 file
+   * @param[out] rebuilt If not nullptr, satellites that were (re)built
+   * @param[in]  ex Executor to build interpolators on; if nullptr, the
+   *             default_executor() is used
+   * @return 0 on success, anything else denotes an error
+   */
+  int publish(const char *fn, std::vector<sp3::SatelliteId> *rebuilt = nullptr,
+              sp3::Executor *ex = nullptr) noexcept;
+
+  /** @brief Get (a snapshot of) the current version; nullptr if nothing
+   * is published yet
+   */
+  std::shared_ptr<const Sp3Dataset> snapshot() const noexcept {
+    return pub_.acquire();
+  }
+
+  /** @brief Number of versions published so far */
+  uint64_t version() const noexcept { return pub_.version(); }
+}; /* class Sp3Publisher */
+
+/** @class Sp3Reader
+ * Query the current version published by an Sp3Publisher.
+ *
+ * A reader holds on to a snapshot of a version and checks (a single atomic
+ * load) for a newer one at the start of each query; the version a query
+ * starts on is used throughout the query. Readers share the snapshot's
+ * (immutable) interpolators; each only keeps its own interpolation state
+ * (window position and workspace) per satellite queried, hence each query
+ * thread should use its own reader. The state is kept across versions for
+ * satellites whose interpolator is shared between them.
+ */
+class Sp3Reader {
+  const Sp3Publisher *pub_;
+  /** The version held */
+  std::shared_ptr<const Sp3Dataset> snap_;
+  /** Publisher's version counter, when snap_ was acquired */
+  uint64_t seen_{0};
+  /** Interpolation state, per satellite queried */
+  struct LocalState {
+    sp3::SatelliteId sv;
+    /** The snapshot's interpolator for sv (nullptr if none) */
+    const SvInterpolator *intrp;
+    SvInterpolationState state;
+  }; /* struct LocalState */
+  std::vector<LocalState> local_;
+
+public:
+  /** @brief Constructor; nothing is acquired until the first query */
+  explicit Sp3Reader(const Sp3Publisher &pub) noexcept : pub_(&pub) {}
+
+  /** @brief Switch to the publisher's current version, if newer than the
+   * one held
+   * @return 1 if switched, 0 if the version held is current, -1 if
+   *         nothing is published
+   */
+  int refresh() noexcept;
+
+  /** @brief Interpolate the state of SV sv at epoch t, off from the current
+   * version; same as SvInterpolator::interpolate_at
+   * @return 0 on success; -1 if nothing is published or the SV is not in
+   *         the current version, >0 on error
+   */
+  int interpolate_at(const sp3::SatelliteId &sv,
+                     const dso::datetime<dso::nanoseconds> &t, double *pos,
+                     double *erpos, double *vel = nullptr,
+                     double *ervel = nullptr) noexcept;
+
+  /** @brief Drop the version held (e.g. before the reader goes idle for a
+   * long time), so that it can be reclaimed
+   */
+  void release() noexcept;
+
+  /** @brief The version held (nullptr if none) */
+  const Sp3Dataset *dataset() const noexcept { return snap_.get(); }
+}; /* class Sp3Reader */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,171 @@
+/** @file
+ * Define publication of Sp3 data records in POSIX shared memory, so that
+ * any number of processes on a host can interpolate off from a single
+ * (read-only) copy of a product.
+ *
+ * A segment holds the records of one product, per satellite, in columns
+ * (time, state and std. deviation components, flags). All references
+ * within the segment are offsets w.r.t. its start, hence it can be mapped
+ * at any address. Interpolators (see SvShmInterpolator) work directly off
+ * from the mapped columns, i.e. no data are copied.
+ *
+ * The name of a segment refers to a (small) pointer segment, holding the
+ * generation of the current data segment, named "<name>.<generation>".
+ * Re-publishing creates the next generation and only then switches the
+ * pointer over to it, hence readers never find the name missing.
+ */
+
+#ifndef __SP3C_SHM_HPP__
+#define __SP3C_SHM_HPP__
+
+#include "sp3.hpp"
+#include "sv_interpolate.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3ShmSegment
+ * A read-only mapping of a shared-memory segment holding an Sp3 product.
+ *
+ * Segments are created via publish. Re-publishing under the same name
+ * replaces the segment for processes that open it afterwards; processes
+ * that have it mapped keep using the previous one, until they unmap it.
+ * There should be a single publisher per name.
+ */
+class Sp3ShmSegment {
+public:
+  /** Columns of each satellite */
+  enum Column : int {
+    /** Epochs, as seconds w.r.t. the segment's reference epoch */
+    TIME = 0,
+    /** State components; see Sp3DataBlock::state */
+    STATE = 1,
+    /** Std. deviations; see Sp3DataBlock::state_sdev */
+    SDEV = 9,
+    /** Flags, as the bits of Sp3Flag; see Sp3DataBlock::flag */
+    FLAGS = 17,
+    NUM_COLUMNS = 18
+  }; /* enum Column */
+
+private:
+  /** Start of mapped memory */
+  const char *data_{nullptr};
+  /** Size of mapped memory in bytes */
+  std::size_t size_{0};
+
+  /** @brief Index of SV sv in the segment's satellite table, or -1 */
+  int find(const sp3::SatelliteId &sv) const noexcept;
+
+  friend class SvShmInterpolator;
+
+public:
+  /** @brief Publish the data records of an Sp3 file to a shared-memory
+   * segment (replacing any segment of the same name).
+   *
+   * The segment is readable by other users; records with both position
+   * and clock missing are skipped (as in SvInterpolator). The previous
+   * generation (if any) is removed once the new one is in place.
+   * @param[in] name Name of the segment (POSIX, i.e. "/name")
+   * @param[in] sp3  The Sp3 product; read through an independent cursor
+   * @return 0 on success, anything else denotes an error
+   */
+  static int publish(const char *name, const Sp3c &sp3) noexcept;
+
+  /** @brief Remove a shared-memory segment, i.e. its name and current
+   * generation (processes that have it mapped can keep on using it)
+   */
+  static int remove(const char *name) noexcept;
+
+  /** @brief Constructor; map an (existing) segment, read-only
+   * @throw std::runtime_error if the segment can not be mapped or is not
+   *        valid
+   */
+  explicit Sp3ShmSegment(const char *name);
+
+  /** @brief Copy not allowed ! */
+  Sp3ShmSegment(const Sp3ShmSegment &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  Sp3ShmSegment &operator=(const Sp3ShmSegment &) = delete;
+
+  /** @brief Move constructor; the moved-from instance is left unmapped */
+  Sp3ShmSegment(Sp3ShmSegment &&s) noexcept : data_(s.data_), size_(s.size_) {
+    s.data_ = nullptr;
+    s.size_ = 0;
+  }
+
+  /** @brief Destructor; unmaps the segment */
+  ~Sp3ShmSegment() noexcept;
+
+  /** @brief Reference epoch (the product's start epoch) */
+  dso::datetime<dso::nanoseconds> ref_epoch() const noexcept;
+
+  /** @brief Nominal interval of records */
+  dso::nanoseconds interval() const noexcept;
+
+  /** @brief Satellites in the segment */
+  std::vector<sp3::SatelliteId> satellites() const;
+
+  /** @brief Number of records of SV sv (0 if not in the segment) */
+  int num_records(const sp3::SatelliteId &sv) const noexcept;
+
+  /** @brief Column c of SV sv, holding num_records(sv) values; nullptr if
+   * sv is not in the segment
+   */
+  const double *column(const sp3::SatelliteId &sv, Column c) const noexcept;
+
+  /** @brief Size of the segment in bytes */
+  std::size_t size() const noexcept { return size_; }
+}; /* class Sp3ShmSegment */
+
+/** @class SvShmInterpolator
+ * Interpolate the state of an SV off from the records of a shared-memory
+ * segment; same as SvInterpolator, but data points are not copied.
+ *
+ * The segment must outlive the interpolator. Instances keep state between
+ * calls (hence are not thread-safe), but are cheap to create.
+ */
+class SvShmInterpolator {
+  sp3::SatelliteId svid;
+  /** Columns of the SV (in the segment) and number of records */
+  const double *cols[Sp3ShmSegment::NUM_COLUMNS]{};
+  int num_dpts{0};
+  /** Reference epoch of the segment (i.e. t=0) */
+  int64_t ref_mjd{0}, ref_nsec{0};
+  /** Max time distance of data points used (seconds) */
+  double max_sec{0e0};
+  /** last index of data used in the interpolation */
+  int last_index{0};
+  /** workspace used in interpolation */
+  std::vector<double> workspace;
+
+  /** @brief Index of the last record with t <= tsec (or 0) */
+  int index_hunt(double tsec) noexcept;
+
+public:
+  /** @brief Constructor
+   * @param[in] seg The segment to interpolate off from
+   * @param[in] sid The SV
+   * @param[in] max_window Max time distance of data points (from the
+   *            requested epoch) used in interpolation
+   * @throw std::runtime_error if the SV has no records in the segment
+   */
+  SvShmInterpolator(
+      const Sp3ShmSegment &seg, sp3::SatelliteId sid,
+      dso::milliseconds max_window = three_min_in_millisec);
+
+  /** @brief The SV interpolated */
+  sp3::SatelliteId sv() const noexcept { return svid; }
+
+  /** @brief Interpolate the state at epoch t; same as
+   * SvInterpolator::interpolate_at
+   */
+  int interpolate_at(const dso::datetime<dso::nanoseconds> &t, double *pos,
+                     double *erpos, double *vel = nullptr,
+                     double *ervel = nullptr) noexcept;
+}; /* class SvShmInterpolator */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,225 @@
+/** @file
+ * Define an in-memory, compressed store of Sp3 data records, so that orbits
+ * and clocks spanning long time ranges (e.g. years of daily products) can be
+ * held in RAM and interpolated from, without re-parsing any file.
+ *
+ * Records are kept per satellite, in blocks of (up to) BLOCK_SIZE epochs.
+ * Within a block, every field is quantized to the resolution of the Sp3
+ * format (e.g. 1 mm for positions, 1 ps for clocks), differenced in time
+ * (up to MAX_DIFF_ORDER times, whichever order gives the smallest output)
+ * and written out as zig-zag, variable length integers. Since orbits are
+ * smooth, high order differences are small, hence most values take up one
+ * or a few bytes instead of eight. Fields that are constant or absent
+ * (e.g. velocities, standard deviations) or mostly so (e.g. flags) take up
+ * a couple of bytes per block, instead of one per value. Decoding only
+ * touches the blocks that are asked for and is lossless w.r.t. the state
+ * values read off from the Sp3 files; standard deviations are kept to 1e-3
+ * (mm, ps, ...).
+ */
+
+#ifndef __SP3C_ORBIT_STORE_HPP__
+#define __SP3C_ORBIT_STORE_HPP__
+
+#include "sp3.hpp"
+#include "sp3_executor.hpp"
+#include "sv_interpolate.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @enum Sp3OverlapPolicy
+ * How to resolve epochs recorded (for the same satellite) in more than one
+ * of the files loaded into a store, based on the order the files are given.
+ */
+enum class Sp3OverlapPolicy {
+  /** Keep the record of the file given first */
+  first_wins,
+  /** Keep the record of the file given last */
+  last_wins
+}; /* enum class Sp3OverlapPolicy */
+
+/** @class Sp3OrbitStore
+ * A compressed, in-memory store of Sp3 data records, for any number of
+ * satellites and epochs.
+ *
+ * Records are appended in chronological order (per satellite) and are
+ * encoded in blocks. The last, incomplete block of each satellite is held
+ * un-encoded until it is filled up or seal() is called. Const member
+ * functions do not modify the instance and can be called concurrently.
+ */
+class Sp3OrbitStore {
+public:
+  /** Max number of records (epochs) in an encoded block */
+  static constexpr int BLOCK_SIZE = 64;
+  /** Max order of time differences used to encode values */
+  static constexpr int MAX_DIFF_ORDER = 10;
+
+private:
+  /** @brief Header of an encoded block */
+  struct BlockHeader {
+    /** First and last epoch in block, nanoseconds w.r.t. the reference */
+    int64_t t_first, t_last;
+    /** Offset of the encoded block in the satellite's byte stream */
+    uint32_t offset;
+    /** Number of records in block */
+    int32_t count;
+  }; /* struct BlockHeader */
+
+  /** @brief Records of one satellite */
+  struct SvColumn {
+    sp3::SatelliteId sv;
+    /** Headers of encoded blocks */
+    std::vector<BlockHeader> blocks;
+    /** Encoded blocks, one after the other */
+    std::vector<uint8_t> bytes;
+    /** Records not yet encoded (fewer than BLOCK_SIZE) */
+    std::vector<Sp3DataBlock> pending;
+    /** Number of records (encoded and pending) */
+    int64_t num_records{0};
+    /** Epoch (w.r.t. reference) of the last record appended */
+    int64_t t_last{0};
+  }; /* struct SvColumn */
+
+  /** One column per satellite, in the order they are first encountered */
+  std::vector<SvColumn> cols_;
+  /** Reference epoch (MJD, start of day) for time tags; set at first use */
+  long ref_mjd_{0};
+  bool has_ref_{false};
+  /** (Nominal) interval of records; set from the first Sp3 loaded */
+  dso::nanoseconds interval_{0};
+
+  /** @brief Column of a given satellite or nullptr */
+  const SvColumn *column(const sp3::SatelliteId &sv) const noexcept;
+
+  /** @brief Append a record to a column; see append */
+  int append_to(SvColumn &col, const Sp3DataBlock &block);
+
+  /** @brief Encode the pending records of a column to a new block */
+  void encode_pending(SvColumn &col);
+
+  /** @brief Decode an encoded block, appending records to out */
+  void decode_block(const SvColumn &col, int block,
+                    std::vector<Sp3DataBlock> &out) const;
+
+  /** @brief Epoch to nanoseconds w.r.t. the reference epoch */
+  int64_t to_ns(const dso::datetime<dso::nanoseconds> &t) const noexcept;
+
+  /** @brief Nanoseconds w.r.t. the reference epoch to datetime */
+  dso::datetime<dso::nanoseconds> from_ns(int64_t ns) const noexcept;
+
+public:
+  /** @brief Append a data record for SV sv.
+   *
+   * Records of each satellite must be appended in chronological order.
+   * @return 0 on success; 1 if the record is not later than the last one
+   *         appended for the satellite (in which case it is ignored).
+   */
+  int append(const sp3::SatelliteId &sv, const Sp3DataBlock &block);
+
+  /** @brief Append all data records of an Sp3c instance.
+   *
+   * The file is read through an independent cursor (i.e. the stream of the
+   * instance is left untouched); when done, the store is sealed.
+   * @return -1 if no data block could be read, 0 on success, >0 on error
+   */
+  int load(const Sp3c &sp3);
+
+  /** @brief Load a list of Sp3 files into the store, in parallel.
+   *
+   * Any records held by the store are discarded. Files are parsed
+   * concurrently (one task per file) and the records are then merged, one
+   * task per satellite, to time-ordered sequences. The result does not
+   * depend on the order tasks complete in: epochs recorded (for the same
+   * satellite) in more than one file are resolved via policy. Files that
+   * fail to load are skipped.
+   * @param[in] files  Sp3 files to load (in order of priority, see policy)
+   * @param[in] policy How to resolve overlapping epochs
+   * @param[in] ex     Executor to run on; if nullptr, the
+   *                   default_executor() is used
+   * @return 0 on success, -1 if no data block could be read, >0 if any of
+   *         the files failed to load
+   */
+  int load(const std::vector<std::string> &files,
+           Sp3OverlapPolicy policy = Sp3OverlapPolicy::first_wins,
+           sp3::Executor *ex = nullptr);
+
+  /** @brief Encode all pending records and release any spare memory.
+   *
+   * Appending after sealing is allowed; new records start a new block.
+   */
+  void seal();
+
+  /** @brief Remove all records (memory is released) */
+  void clear() noexcept;
+
+  /** @brief Satellites in the store, in the order they were first seen */
+  std::vector<sp3::SatelliteId> satellites() const;
+
+  /** @brief Check if the store holds any records for SV sv */
+  bool has_sv(const sp3::SatelliteId &sv) const noexcept {
+    return column(sv) != nullptr;
+  }
+
+  /** @brief Number of records held for SV sv */
+  int64_t num_records(const sp3::SatelliteId &sv) const noexcept;
+
+  /** @brief (Nominal) interval of records; zero if not known yet */
+  dso::nanoseconds interval() const noexcept { return interval_; }
+
+  /** @brief Set the (nominal) interval of the records */
+  void set_interval(dso::nanoseconds interval) noexcept {
+    interval_ = interval;
+  }
+
+  /** @brief Get the epochs of the first and last record of SV sv
+   * @return 0 on success, -1 if the SV has no records
+   */
+  int span(const sp3::SatelliteId &sv, dso::datetime<dso::nanoseconds> &first,
+           dso::datetime<dso::nanoseconds> &last) const noexcept;
+
+  /** @brief Decode all records of SV sv, with epochs in the range [t0, t1].
+   *
+   * Only the blocks overlapping the range are decoded.
+   * @param[out] out Cleared and filled with records, in chronological order
+   * @return 0 on success, -1 if the SV has no records in the store
+   */
+  int range(const sp3::SatelliteId &sv,
+            const dso::datetime<dso::nanoseconds> &t0,
+            const dso::datetime<dso::nanoseconds> &t1,
+            std::vector<Sp3DataBlock> &out) const;
+
+  /** @brief Decode a window of records for SV sv around epoch t, i.e.
+   * records in the range [t - margin, t + margin].
+   *
+   * This is what an interpolator needs to compute the state at t.
+   * @return 0 on success, -1 if the SV has no records in the store
+   */
+  int window(const sp3::SatelliteId &sv,
+             const dso::datetime<dso::nanoseconds> &t,
+             dso::nanoseconds margin, std::vector<Sp3DataBlock> &out) const;
+
+  /** @brief Feed an interpolator with the records of SV sv in the range
+   * [t0, t1].
+   *
+   * The buffer scratch is used to hold the decoded records (and is re-used
+   * between calls, to avoid allocation).
+   * @return 0 on success; -1 if the SV has no records in the store, >0 if
+   *         the interpolator could not be fed (e.g. no records in range)
+   */
+  int load_interpolator(const sp3::SatelliteId &sv,
+                        const dso::datetime<dso::nanoseconds> &t0,
+                        const dso::datetime<dso::nanoseconds> &t1,
+                        SvInterpolator &intrp,
+                        std::vector<Sp3DataBlock> &scratch) const;
+
+  /** @brief Bytes of memory used by the store (encoded blocks, block
+   * headers and pending records)
+   */
+  std::size_t memory_bytes() const noexcept;
+}; /* class Sp3OrbitStore */
+
+} /* namespace dso */
+
+#endif
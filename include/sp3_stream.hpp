@@ -0,0 +1,169 @@
+/** @file
+ * Define a streaming source of Sp3 data records, spanning any number of
+ * consecutive Sp3 files (e.g. daily products of a multi-month arc). Files
+ * are read in time order and only a sliding window of epochs is held in
+ * memory; the next file is opened (and its pages read-in) in the background,
+ * before the current one is exhausted.
+ */
+
+#ifndef __SP3C_STREAM_HPP__
+#define __SP3C_STREAM_HPP__
+
+#include "sp3.hpp"
+#include "sp3_executor.hpp"
+#include "sv_interpolate.hpp"
+#include <deque>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3Stream
+ * Interpolate continuously over a sequence of consecutive Sp3 files.
+ *
+ * Queries (see interpolate_at and window) must come in chronological order.
+ * For a query at t, the stream holds the epochs in [t - w, t + w], where w
+ * is the max window of interpolation, plus (at most) one epoch on each side;
+ * epochs are evicted as soon as no later query can need them. Windows are
+ * collected across file boundaries, so that interpolation near the start
+ * or end of a file uses data from its neighbour. Epochs duplicated in
+ * consecutive files (e.g. the midnight epoch) are taken from the earlier
+ * file.
+ *
+ * Instances are not thread-safe; use one per thread.
+ */
+class Sp3Stream {
+  using FilePtr = std::unique_ptr<Sp3c>;
+
+  /** Files to stream through, in chronological order */
+  std::vector<std::string> files_;
+  /** Index (in files_) of the next file to open */
+  int next_file_{0};
+  /** Max window of interpolation (on each side of the query epoch) */
+  dso::milliseconds max_window_;
+  /** Executor to open files on (nullptr: default_executor) */
+  sp3::Executor *ex_;
+  /** The file currently read and its cursor */
+  FilePtr current_;
+  std::optional<Sp3Cursor> cursor_;
+  /** The next file, opened in the background (if any) */
+  std::future<FilePtr> prefetch_;
+  /** Interval of the file that was read last */
+  dso::nanoseconds interval_{0};
+  /** Epochs held, in chronological order */
+  std::deque<Sp3EpochBuffer> window_;
+  /** Evicted epoch buffers, kept for re-use */
+  std::vector<Sp3EpochBuffer> spare_;
+  /** Epoch of the last epoch read (of any file) */
+  dso::datetime<dso::nanoseconds> last_read_{
+      dso::datetime<dso::nanoseconds>::min()};
+  /** Epoch of the last query */
+  dso::datetime<dso::nanoseconds> last_query_{
+      dso::datetime<dso::nanoseconds>::min()};
+  /** Set when all files are read through */
+  bool exhausted_{false};
+  /** Incremented whenever epochs are added to/evicted from the window */
+  uint64_t generation_{0};
+
+  /** @brief The interpolator of an SV; re-fed when the window changes */
+  struct SvSlot {
+    SvInterpolator intrp;
+    /** Window generation the interpolator was last fed at */
+    uint64_t generation{0};
+    bool fed{false};
+  }; /* struct SvSlot */
+
+  /** One interpolator per SV queried, in the order first queried */
+  std::vector<SvSlot> slots_;
+  /** Buffer for the records of a single SV, fed to an interpolator */
+  std::vector<Sp3DataBlock> records_;
+
+  /** @brief The slot of SV sv; created if not there yet */
+  SvSlot &slot(const sp3::SatelliteId &sv);
+
+  /** @brief Start opening file files_[next_file_] in the background */
+  void start_prefetch();
+
+  /** @brief Make the next file current.
+   * @return 0 on success, -1 if there are no more files, >0 on error
+   */
+  int next_file() noexcept;
+
+  /** @brief Read the next epoch (of any file) to the end of the window.
+   * @return 0 on success, -1 if all files are exhausted, >0 on error
+   */
+  int read_epoch() noexcept;
+
+  /** @brief Read and evict epochs, so that the window covers
+   * [t - max_window, t + max_window].
+   * @return 0 on success, >0 on error
+   */
+  int slide(const dso::datetime<dso::nanoseconds> &t) noexcept;
+
+public:
+  /** @brief Constructor
+   * @param[in] files Sp3 files to stream through, in chronological order;
+   *            more can be added later, via add_file
+   * @param[in] max_window Max time distance of data points (from the
+   *            requested epoch) used in interpolation
+   * @param[in] ex Executor to open files on; if nullptr, the
+   *            default_executor() is used
+   */
+  explicit Sp3Stream(std::vector<std::string> files,
+                     dso::milliseconds max_window = three_min_in_millisec,
+                     sp3::Executor *ex = nullptr);
+
+  /** @brief Copy not allowed ! */
+  Sp3Stream(const Sp3Stream &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  Sp3Stream &operator=(const Sp3Stream &) = delete;
+
+  /** @brief Destructor; waits for any background work to finish */
+  ~Sp3Stream() noexcept;
+
+  /** @brief Append a file to the list of files to stream through */
+  void add_file(const std::string &fn);
+
+  /** @brief Collect the records of SV sv in [t - max_window, t +
+   * max_window], across files.
+   *
+   * @param[out] out Cleared and filled with records, in chronological order
+   * @return 0 on success; 1 if t is earlier than a previous query (data no
+   *         longer held); >1 on error
+   */
+  int window(const sp3::SatelliteId &sv,
+             const dso::datetime<dso::nanoseconds> &t,
+             std::vector<Sp3DataBlock> &out) noexcept;
+
+  /** @brief Interpolate the state of SV sv at epoch t; same as
+   * SvInterpolator::interpolate_at.
+   *
+   * Each SV gets an interpolator of its own, so that queries alternating
+   * between SVs (at the same epoch) do not re-feed interpolators.
+   * @return 0 on success; 1 if t is earlier than a previous query (data no
+   *         longer held); 2 if reading the files fails; 3 if the SV has no
+   *         records in the window; 10 + the SvInterpolator::interpolate_at
+   *         error code if interpolation fails (e.g. not enough data points
+   *         around t)
+   */
+  int interpolate_at(const sp3::SatelliteId &sv,
+                     const dso::datetime<dso::nanoseconds> &t, double *pos,
+                     double *erpos, double *vel = nullptr,
+                     double *ervel = nullptr) noexcept;
+
+  /** @brief Number of epochs currently held in memory */
+  int num_epochs_held() const noexcept { return window_.size(); }
+
+  /** @brief Number of files opened so far */
+  int num_files_opened() const noexcept {
+    return next_file_ - (prefetch_.valid() ? 1 : 0);
+  }
+}; /* class Sp3Stream */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,121 @@
+/** @file
+ * Define an incremental reader for Sp3 files that grow over time, e.g.
+ * ultra-rapid or real-time products that are appended to (or rewritten)
+ * several times a day. Only epochs appended since the last read are parsed.
+ */
+
+#ifndef __SP3C_TAIL_HPP__
+#define __SP3C_TAIL_HPP__
+
+#include "sp3.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3Tail
+ * Incrementally read the data blocks of a (growing) Sp3 file.
+ *
+ * The instance remembers the byte offset and the epoch of the last data
+ * block read; each call to poll parses only the data blocks appended to
+ * the file since. A data block is only reported once complete, i.e. when
+ * followed by another data block or the 'EOF' line, so that files being
+ * written to can be read at any time. The file is opened (and its header
+ * read) once, into a private snapshot (see sp3::MapMode); as it grows, only
+ * the bytes appended are read in. Whether the file changed is checked on
+ * the file itself (via pread), so that files truncated or rewritten in
+ * place never fault the process (SIGBUS). If the file is rewritten
+ * (i.e. replaced by another file, truncated, or its header or the last data
+ * block read no longer exist as they were), the file is read again from the
+ * start and the caller is notified, so that it can rebuild any state
+ * derived from the previous contents.
+ *
+ * New data blocks can be appended to existing interpolators via
+ * SvInterpolator::append.
+ */
+class Sp3Tail {
+  /** The Sp3 file */
+  std::string fn_;
+  /** Byte offset past the last data block read (0: nothing read yet) */
+  int64_t offset_{0};
+  /** Byte offset of the last data block read, and hash of its bytes, i.e.
+   * the range [last_pos_, offset_)
+   */
+  int64_t last_pos_{0};
+  uint64_t last_hash_{0};
+  /** Epoch of the last data block read */
+  dso::datetime<dso::nanoseconds> last_epoch_{
+      dso::datetime<dso::nanoseconds>::min()};
+  /** Size and modification time of the file, when last polled */
+  int64_t size_{-1};
+  int64_t mtime_{0};
+  /** The opened file (snapshot); kept between polls, extended as it grows */
+  std::unique_ptr<Sp3c> sp3_;
+  /** Identity (device and inode) of the opened file */
+  uint64_t dev_{0}, ino_{0};
+  /** Hash of the header of the opened file (see poll) */
+  uint64_t header_hash_{0};
+  /** inotify instance and watch (Linux only) */
+  int inotify_fd_{-1};
+  int watch_fd_{-1};
+
+public:
+  /** @brief Constructor; the file is not read until poll is called */
+  explicit Sp3Tail(const char *fn) : fn_(fn) {}
+
+  /** @brief Copy not allowed ! */
+  Sp3Tail(const Sp3Tail &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  Sp3Tail &operator=(const Sp3Tail &) = delete;
+
+  /** @brief Destructor; release inotify resources (if any) */
+  ~Sp3Tail() noexcept;
+
+  /** @brief Read any (complete) data blocks appended to the file since the
+   * last call.
+   *
+   * If the file has not changed (size and modification time), nothing is
+   * read at all.
+   * @param[out] epochs Cleared and filled with the new data blocks, in
+   *             chronological order
+   * @param[out] rewritten If not nullptr, set to true if the file was found
+   *             rewritten, in which case epochs hold all of the (new) file's
+   *             data blocks
+   * @return 0 on success (epochs may be empty), >0 on error (including
+   *         running out of memory); on error, epochs is left empty and the
+   *         state of the instance is not changed
+   */
+  int poll(std::vector<Sp3EpochBuffer> &epochs,
+           bool *rewritten = nullptr) noexcept;
+
+  /** @brief Wait until the file is (possibly) modified, or a timeout.
+   *
+   * On Linux, this uses inotify on the file's directory (so that files
+   * replaced via rename are also caught); elsewhere the file's size and
+   * modification time are checked periodically.
+   * @param[in] timeout_millisec Max time to wait (milliseconds)
+   * @return 0 if the file may have changed, -1 on timeout, >0 on error
+   */
+  int wait(int timeout_millisec) noexcept;
+
+  /** @brief Forget anything read; the next poll reads the whole file */
+  void reset() noexcept;
+
+  /** @brief The Sp3 file */
+  const std::string &filename() const noexcept { return fn_; }
+
+  /** @brief Byte offset past the last data block read */
+  int64_t offset() const noexcept { return offset_; }
+
+  /** @brief Epoch of the last data block read */
+  const dso::datetime<dso::nanoseconds> &last_epoch() const noexcept {
+    return last_epoch_;
+  }
+}; /* class Sp3Tail */
+
+} /* namespace dso */
+
+#endif
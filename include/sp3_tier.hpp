@@ -0,0 +1,120 @@
+/** @file
+ * Define a resolver over Sp3 products of different tiers (final, rapid,
+ * ultra-rapid), serving each query off from the best product available for
+ * the epoch and satellite. Lower tier products are only opened when needed.
+ */
+
+#ifndef __SP3C_TIER_HPP__
+#define __SP3C_TIER_HPP__
+
+#include "sp3.hpp"
+#include "sv_interpolate.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @enum Sp3Tier Product tiers, best first */
+enum class Sp3Tier : int { final = 0, rapid = 1, ultra_rapid = 2 };
+
+/** @brief Name of a tier, e.g. for reports */
+const char *to_string(Sp3Tier tier) noexcept;
+
+/** @class Sp3TierInfo Which product served a query */
+struct Sp3TierInfo {
+  /** Tier of the product */
+  Sp3Tier tier{Sp3Tier::final};
+  /** Index of the product, in the order sources were added */
+  int source{-1};
+  /** Set if any of the data points bracketing the epoch are flagged as
+   * predicted (orbit_prediction), e.g. the predicted half of an
+   * ultra-rapid product
+   */
+  bool predicted{false};
+}; /* struct Sp3TierInfo */
+
+/** @class Sp3TierResolver
+ * Interpolate off from the best available product, per epoch and SV.
+ *
+ * Sources are tried in order of tier (and, within a tier, in the order
+ * they were added); a source is used if it holds records for the SV around
+ * the epoch. Files are not opened until a query reaches them, and the
+ * interpolator for an SV is only built off from a source when first
+ * needed. Instances are not thread-safe.
+ */
+class Sp3TierResolver {
+  struct Source {
+    std::string fn;
+    Sp3Tier tier;
+    /** Index in the order sources were added */
+    int index;
+    /** The file, once opened */
+    std::unique_ptr<Sp3c> sp3;
+    /** Set if the file failed to open; it is not tried again */
+    bool failed{false};
+    /** Interpolators built so far */
+    std::vector<SvInterpolator> intrps;
+  }; /* struct Source */
+
+  /** Sources, sorted on tier */
+  std::vector<std::unique_ptr<Source>> sources_;
+  /** Max window of interpolation */
+  dso::milliseconds max_window_;
+  /** Accept records flagged as predicted */
+  bool accept_predicted_{true};
+
+  /** @brief Open a source (if not already open) and check if it spans t
+   * @return Nullptr if the source can not serve epoch t
+   */
+  Sp3c *open(Source &src, const dso::datetime<dso::nanoseconds> &t) noexcept;
+
+  /** @brief Interpolator for SV sv off from an (open) source; nullptr if
+   * the source holds no records for the SV
+   */
+  SvInterpolator *interpolator(Source &src, const sp3::SatelliteId &sv);
+
+public:
+  /** @brief Constructor; sources are added via add_source
+   * @param[in] max_window Max time distance of data points (from the
+   *            requested epoch) used in interpolation
+   */
+  explicit Sp3TierResolver(
+      dso::milliseconds max_window = three_min_in_millisec) noexcept
+      : max_window_(max_window) {}
+
+  /** @brief Register an Sp3 product of a given tier; the file is not
+   * touched until needed
+   */
+  void add_source(const char *fn, Sp3Tier tier);
+
+  /** @brief Choose whether records flagged as predicted may serve queries
+   * (default: yes); if not, such queries fall through to lower tiers.
+   */
+  void set_accept_predicted(bool accept) noexcept {
+    accept_predicted_ = accept;
+  }
+
+  /** @brief Interpolate the state of SV sv at epoch t, off from the best
+   * product available; same as SvInterpolator::interpolate_at.
+   * @param[out] info If not nullptr, set to the product that served the
+   *             query
+   * @return 0 on success; -1 if no product covers the SV at t, >0 on
+   *         error (the error of the last product tried)
+   */
+  int interpolate_at(const sp3::SatelliteId &sv,
+                     const dso::datetime<dso::nanoseconds> &t, double *pos,
+                     double *erpos, double *vel = nullptr,
+                     double *ervel = nullptr,
+                     Sp3TierInfo *info = nullptr) noexcept;
+
+  /** @brief Number of registered products */
+  int num_sources() const noexcept { return sources_.size(); }
+
+  /** @brief Number of products opened so far */
+  int num_opened() const noexcept;
+}; /* class Sp3TierResolver */
+
+} /* namespace dso */
+
+#endif
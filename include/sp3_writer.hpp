@@ -0,0 +1,105 @@
+/** @file
+ * Define a writer of Sp3 (c or d) files, so that products can be created
+ * (e.g. merged or combined off from other products) epoch by epoch, without
+ * holding them in memory.
+ */
+
+#ifndef __SP3C_WRITER_HPP__
+#define __SP3C_WRITER_HPP__
+
+#include "sp3.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @class Sp3Header
+ * The header fields of an Sp3 file to be written.
+ */
+struct Sp3Header {
+  /** Version, 'c' or 'd' ('d' is required for more than 85 satellites) */
+  char version{'c'};
+  /** Write velocity records ('V' flag) */
+  bool has_velocities{false};
+  /** Start epoch and (nominal) interval */
+  dso::datetime<dso::nanoseconds> start_epoch{
+      dso::datetime<dso::nanoseconds>::min()};
+  dso::nanoseconds interval{0};
+  /** Data used, coordinate system, orbit type, agency and time system */
+  std::string data_used{"ORBIT"};
+  std::string coordinate_system{"IGS20"};
+  std::string orbit_type{"FIT"};
+  std::string agency{"DSO"};
+  std::string time_system{"GPS"};
+  /** Floating point bases of std. deviations */
+  double fp_base_pos{1.25};
+  double fp_base_clk{1.025};
+  /** Satellites, and their accuracy exponents (0: unknown); accuracy may
+   * be left empty
+   */
+  std::vector<sp3::SatelliteId> satellites;
+  std::vector<int> accuracy;
+  /** Comment lines (without the leading comment marker) */
+  std::vector<std::string> comments;
+
+  /** @brief A header with the fields of an (opened) Sp3 file; accuracy
+   * exponents are not carried over (they are not parsed)
+   */
+  static Sp3Header from(const Sp3c &sp3);
+}; /* struct Sp3Header */
+
+/** @class Sp3Writer
+ * Write an Sp3 file, epoch by epoch.
+ *
+ * The number of epochs is not known until all epochs are written; the
+ * header is written with a place-holder, patched on close. Correlation
+ * records (EP/EV lines) are not written, since they are not held in
+ * Sp3DataBlock.
+ */
+class Sp3Writer {
+  std::string fn_;
+  std::FILE *fp_{nullptr};
+  Sp3Header hdr_;
+  /** Byte offset of the number of epochs, in the first header line */
+  long num_epochs_pos_{0};
+  int num_epochs_{0};
+
+  /** @brief Write a Position or Velocity record line */
+  int write_record(char type, const sp3::SatelliteId &sv,
+                   const Sp3DataBlock &block) noexcept;
+
+public:
+  /** @brief Constructor; create (or truncate) the file and write the header
+   * @throw std::runtime_error if the file can not be created/written to
+   */
+  Sp3Writer(const char *fn, const Sp3Header &hdr);
+
+  /** @brief Copy not allowed ! */
+  Sp3Writer(const Sp3Writer &) = delete;
+
+  /** @brief Assignment not allowed ! */
+  Sp3Writer &operator=(const Sp3Writer &) = delete;
+
+  /** @brief Destructor; closes the file (see close) if still open */
+  ~Sp3Writer() noexcept;
+
+  /** @brief Write an epoch (data block), i.e. the epoch line and a record
+   * per SV in the buffer; epochs must be written in chronological order.
+   * @return Anything other than 0 denotes an error
+   */
+  int write_epoch(const Sp3EpochBuffer &epoch) noexcept;
+
+  /** @brief Write the 'EOF' line, patch the number of epochs in the header
+   * and close the file.
+   * @return Anything other than 0 denotes an error
+   */
+  int close() noexcept;
+
+  /** @brief Number of epochs written so far */
+  int num_epochs() const noexcept { return num_epochs_; }
+}; /* class Sp3Writer */
+
+} /* namespace dso */
+
+#endif
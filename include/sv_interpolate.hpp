@@ -2,7 +2,10 @@
 #define __SV_SP3_INTERPOLATION_HPP__
 
 #include "sp3.hpp"
+#include <memory_resource>
 #include <stdexcept>
+#include <string>
+#include <vector>
 #ifdef DEBUG
 #include <chrono>
 #endif
@@ -28,14 +31,46 @@ constexpr int MIN_INTERPOLATION_PTS = 4;
 constexpr const dso::milliseconds three_min_in_millisec{
     (3 * 60 + 1) * dso::milliseconds::sec_factor<long>()};
 
+/** @class SvInterpolationState
+ * State of a caller interpolating off from a shared (const) SvInterpolator
+ * (see SvInterpolator::interpolate_at): the position of the interpolation
+ * window and the workspace. Any number of threads can interpolate off from
+ * the same instance concurrently, each using its own state.
+ */
+struct SvInterpolationState {
+  /** last index of data used in the interpolation */
+  int last_index{0};
+  /** time, x, y and z data arrays used in interpolation */
+  std::vector<double> txyz;
+  /** workspace arena used in interpolation */
+  std::vector<double> workspace;
+}; /* struct SvInterpolationState */
+
+/** @class SvInterpolator
+ * Interpolate the state of an SV, using the data records of an Sp3 file.
+ *
+ * All memory used by an instance (data records and interpolation
+ * workspace) is allocated via a std::pmr::memory_resource, given at
+ * construction (e.g. a std::pmr::monotonic_buffer_resource arena shared by
+ * all interpolators of a processing loop). Instances are movable and
+ * copyable, hence can be stored by value in containers. Re-feeding an
+ * instance off from a new Sp3 file (see reload) re-uses its buffers, so
+ * that once warmed-up, daily loops do not allocate.
+ */
 class SvInterpolator {
 private:
   /** SV to interpolate */
   sp3::SatelliteId svid;
   /** num of data points (blocks) available for SV; read from Sp3 */
   int num_dpts{0};
-  /** Sp3 instance providing data values */
-  Sp3c *sp3{nullptr};
+  /** Sp3 file the data points were fed off from (empty if none) */
+  std::string source_fn;
+  /** Fingerprint of the Sp3 file at the time the data points were read */
+  Sp3Fingerprint source_fp;
+  /** reference epoch (i.e. t=0) for interpolation; Sp3 start epoch */
+  dso::datetime<dso::nanoseconds> tref;
+  /** (nominal) data interval; Sp3 interval */
+  dso::nanoseconds interval{0};
   /** last index of data used in the interpolation */
   int last_index{0};
   /** interval to use in interpolation, aka use points up to max_millisec 
@@ -45,11 +80,11 @@ private:
   /** minimum number of points on each side to perform interpolation */
   int min_dpts_on_each_side{2};
   /** data points/blocks to be collected from the Sp3 */
-  Sp3DataBlock *data{nullptr};
+  std::pmr::vector<Sp3DataBlock> data;
   /** time, x, y and z data arrays used in interpolation */
-  double *txyz{nullptr};
+  std::pmr::vector<double> txyz;
   /** workspace arena (allocate once) used in interpolation */
-  double *workspace{nullptr};
+  std::pmr::vector<double> workspace;
 
   /** @brief Compute workspace arena size
    * 
@@ -62,36 +97,59 @@ private:
    * @return Maximum number of points around a central point, with time tags
    *         less than max_millisec apart
    */
-  int compute_workspace_size() noexcept;
+  int compute_workspace_size() const noexcept;
 
   /** Fill in the data array using an sp3 instance (aka collect SV blocks 
-   * from Sp3)
+   * from Sp3) and size the workspace arrays accordingly. Existing buffers
+   * are re-used, i.e. no allocation takes place if they are large enough.
+   * The filename and fingerprint of the Sp3 are recorded; no reference to
+   * the instance itself is kept.
    */
-  int feed_from_sp3() noexcept;
+  int feed_from_sp3(const Sp3c &sp3) noexcept;
+
+  /** Set num_dpts after data is filled in and size the workspace arrays */
+  void size_workspace() noexcept;
 
   /** Return the index of the data block in the data array, so that
-   *  bloc[i].t <= t < block[i+1].t
+   *  bloc[i].t <= t < block[i+1].t, starting off from (and updating) the
+   *  last index used, last
    */
-  int index_hunt(const dso::datetime<dso::nanoseconds> &t) noexcept {
+  int index_hunt(const dso::datetime<dso::nanoseconds> &t,
+                 int &last) const noexcept {
     // quick .....
-    if (last_index < num_dpts - 2) {
-      if (data[last_index].t <= t && data[last_index + 1].t > t) {
-        return last_index;
-      } else if (data[last_index + 1].t <= t && data[last_index + 2].t > t) {
-        return (++last_index);
+    if (last < num_dpts - 2) {
+      if (data[last].t <= t && data[last + 1].t > t) {
+        return last;
+      } else if (data[last + 1].t <= t && data[last + 2].t > t) {
+        return (++last);
       }
     }
 
-    int start_index = (data[last_index].t <= t) ? last_index : 0;
-    auto it = std::lower_bound(
-        data + start_index, data + num_dpts, t,
-        [](const Sp3DataBlock &block,
-           const dso::datetime<dso::nanoseconds> &tt) { return block.t < tt; });
-    return (last_index = static_cast<int>(it - data));
+    int start_index = (data[last].t <= t) ? last : 0;
+    auto it = std::upper_bound(
+        data.data() + start_index, data.data() + num_dpts, t,
+        [](const dso::datetime<dso::nanoseconds> &tt,
+           const Sp3DataBlock &block) { return tt < block.t; });
+    // last block with bloc.t <= t (or the first one, if t is before all)
+    return (last = std::max(0, static_cast<int>(it - data.data()) - 1));
   }
 
+  /** Interpolate at t, with the window at last and the workspace arrays
+   * txyz (of 4 * wsz doubles) and work (of 6 * wsz doubles); see
+   * interpolate_at
+   */
+  int interpolate(dso::datetime<dso::nanoseconds> t, double *pos,
+                  double *erpos, double *vel, double *ervel, int &last,
+                  double *txyz_arr, int wsz, double *work) const noexcept;
+
 public:
-  SvInterpolator(sp3::SatelliteId sid) noexcept : svid(sid){};
+  /** Constructor from a SatelliteId; no data are loaded (see reload)
+   * @param[in] mr Memory resource to allocate any memory from
+   */
+  SvInterpolator(sp3::SatelliteId sid,
+                 std::pmr::memory_resource *mr =
+                     std::pmr::get_default_resource()) noexcept
+      : svid(sid), data(mr), txyz(mr), workspace(mr){};
 
   /** Constructor from a SatelliteId and an Sp3c instance; this function
    *  will:
@@ -100,20 +158,99 @@ public:
    *  2. allocate enough workspace (a memory arena) for the t, x, y, and
    *     z arrays (for later calls to interpolate at) and also the
    *     c, d arrays that are needed for neville interpolation
+   *  All memory is allocated from the memory resource mr.
    */
   SvInterpolator(
-      sp3::SatelliteId sid, Sp3c &sp3obj,
-      dso::milliseconds max_allowed_millisec = three_min_in_millisec);
-
-  /** @brief Destructor (free memmory) */
-  ~SvInterpolator() noexcept {
-    if (data && num_dpts)
-      delete[] data;
-    if (txyz)
-      delete[] txyz;
-    if (workspace)
-      delete[] workspace;
-    num_dpts = 0;
+      sp3::SatelliteId sid, const Sp3c &sp3obj,
+      dso::milliseconds max_allowed_millisec = three_min_in_millisec,
+      std::pmr::memory_resource *mr = std::pmr::get_default_resource());
+
+  /** @brief Copy constructor; the copy uses the default memory resource */
+  SvInterpolator(const SvInterpolator &) = default;
+
+  /** @brief Move constructor; memory (and memory resource) is transfered */
+  SvInterpolator(SvInterpolator &&) noexcept = default;
+
+  /** @brief Copy assignment; buffers of the instance are re-used */
+  SvInterpolator &operator=(const SvInterpolator &) = default;
+
+  /** @brief Move assignment */
+  SvInterpolator &operator=(SvInterpolator &&) = default;
+
+  /** @brief Destructor (memory is released to the memory resource) */
+  ~SvInterpolator() noexcept = default;
+
+  /** @brief Re-fill the instance (for the same SV) off from a new Sp3
+   * instance, re-using allocated memory.
+   * @return Anything other than 0 denotes an error; in this case the
+   *         instance holds no data points.
+   */
+  int reload(const Sp3c &sp3obj) noexcept { return reload(svid, sp3obj); }
+
+  /** @brief Re-fill the instance, for SV sid, off from a new Sp3 instance,
+   * re-using allocated memory.
+   * @return Anything other than 0 denotes an error; in this case the
+   *         instance holds no data points.
+   */
+  int reload(sp3::SatelliteId sid, const Sp3c &sp3obj) noexcept;
+
+  /** @brief Re-fill the instance, for SV sid, off from an array of data
+   * blocks (e.g. decoded from an Sp3OrbitStore), re-using allocated memory.
+   *
+   * Blocks must be sorted in chronological order; records with bad/absent
+   * position and clock are skipped. The instance is not bound to any Sp3
+   * file.
+   * @param[in] blocks Array of data blocks for the SV
+   * @param[in] count  Number of blocks in the array
+   * @param[in] nominal_interval (Nominal) interval of the data blocks
+   * @return Anything other than 0 denotes an error; in this case the
+   *         instance holds no data points.
+   */
+  int reload(sp3::SatelliteId sid, const Sp3DataBlock *blocks, int count,
+             dso::nanoseconds nominal_interval) noexcept;
+
+  /** @brief Bind the instance to (another version of) the Sp3 file its
+   * data points were fed off from, without re-reading them; e.g. for a
+   * reissued product where the SV's records are unchanged. Subsequent
+   * checkpoints refer to this file.
+   * @return Anything other than 0 denotes an error; the instance then is
+   *         not bound to any file
+   */
+  int rebind(const Sp3c &sp3obj) noexcept;
+
+  /** @brief Append a data point, e.g. off from a newly parsed epoch of a
+   * growing Sp3 file (see Sp3Tail), without rebuilding the instance.
+   *
+   * The block must be later than the last data point held. Blocks with
+   * bad/absent position and clock are skipped. If the instance has no
+   * (nominal) interval yet, it is set to the spacing of the first two data
+   * points.
+   * @return 0 on success (or if skipped), 1 if the block is not later than
+   *         the last data point (in which case it is ignored)
+   */
+  int append(const Sp3DataBlock &block) noexcept;
+
+  /** @brief Append the data point of the instance's SV (if any) in a data
+   * block; see append(const Sp3DataBlock &).
+   */
+  int append(const Sp3EpochBuffer &epoch) noexcept {
+    const int k = epoch.find(svid);
+    return (k < 0) ? 0 : append(epoch.blocks[k]);
+  }
+
+  /** @brief Set the max time distance of data points (from the requested
+   * epoch) used in the interpolation. Takes effect on the next (re)load.
+   */
+  void set_max_window(dso::milliseconds max_allowed_millisec) noexcept {
+    max_millisec = max_allowed_millisec;
+  }
+
+  /** @brief The SV of the instance */
+  sp3::SatelliteId sv() const noexcept { return svid; }
+
+  /** @brief Memory resource used for any allocation */
+  std::pmr::memory_resource *resource() const noexcept {
+    return data.get_allocator().resource();
   }
 
   const dso::datetime<dso::nanoseconds> *last_block_date() const noexcept {
@@ -122,9 +259,39 @@ public:
 
   int num_data_points() const noexcept { return num_dpts; }
 
+  /** @brief The data points held, in chronological order */
+  const Sp3DataBlock *data_points() const noexcept { return data.data(); }
+
   int interpolate_at(dso::datetime<dso::nanoseconds> t, double *pos,
                      double *erpos, double *vel = nullptr,
-                     double *ervel = nullptr) noexcept;
+                     double *ervel = nullptr) noexcept {
+    return interpolate(t, pos, erpos, vel, ervel, last_index, txyz.data(),
+                       txyz.size() / 4, workspace.data());
+  }
+
+  /** @brief Interpolate off from a shared (const) instance, using the
+   * caller's own state; same as the non-const interpolate_at. The state's
+   * buffers are sized on first use.
+   */
+  int interpolate_at(dso::datetime<dso::nanoseconds> t, double *pos,
+                     double *erpos, double *vel, double *ervel,
+                     SvInterpolationState &state) const noexcept;
+
+  /** @brief Record the interpolation window state (the SV, the index and
+   * epoch of the last data point used), along with the filename and
+   * fingerprint of the Sp3 file the instance was fed off from (if any), as
+   * they were when the data points were read.
+   * @return Anything other than 0 denotes an error
+   */
+  int checkpoint(Sp3Checkpoint &cp) const noexcept;
+
+  /** @brief Restore a window state recorded via checkpoint, so that the
+   * next query picks up where the last one (before the checkpoint) left
+   * off. The instance must already hold the data points (e.g. via reload).
+   * @return 0 on success; -1 if the checkpoint does not match the instance
+   *         (different SV, data points or Sp3 file); >0 on error
+   */
+  int restore(const Sp3Checkpoint &cp) noexcept;
 }; /* class SvInterpolator */
 
 } /* namespace dso */
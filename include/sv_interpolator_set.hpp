@@ -0,0 +1,103 @@
+/** @file
+ * Define a set of SV interpolators, one per satellite of an Sp3 product,
+ * that can be reloaded off from a reissued product, rebuilding only the
+ * satellites whose records have actually changed.
+ */
+
+#ifndef __SV_SP3_INTERPOLATOR_SET_HPP__
+#define __SV_SP3_INTERPOLATOR_SET_HPP__
+
+#include "sp3_executor.hpp"
+#include "sv_interpolate.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dso {
+
+/** @class SvInterpolatorSet
+ * One SvInterpolator per satellite of an Sp3 product.
+ *
+ * Along with each interpolator, the set keeps the fingerprint of the
+ * satellite's records (see Sp3c::sv_fingerprints). When (re)loaded off from
+ * a new version of the product, only interpolators of satellites with a
+ * different fingerprint are rebuilt (in parallel); the rest are kept as
+ * they are. The satellites rebuilt are reported, so that callers can
+ * refresh any state derived from them.
+ *
+ * Interpolators are immutable and reference-counted, so copies of a set
+ * (e.g. successive versions of a product, see Sp3Publisher) share them
+ * rather than the data points they hold. A kept interpolator hence still
+ * refers to the file it was read off from (see SvInterpolator::checkpoint),
+ * its records being the same as the new version's.
+ */
+class SvInterpolatorSet {
+  /** Interpolators, in the order of the product's satellites */
+  std::vector<std::shared_ptr<const SvInterpolator>> intrps_;
+  /** Fingerprint of each satellite's records (0 if not loaded) */
+  std::vector<uint64_t> hashes_;
+  /** Interpolation state of each satellite (see interpolate_at) */
+  std::vector<SvInterpolationState> states_;
+  /** Max window of interpolation */
+  dso::milliseconds max_window_;
+  /** Memory resource for interpolators */
+  std::pmr::memory_resource *mr_;
+
+public:
+  /** @brief Constructor; no data are loaded (see load)
+   * @param[in] max_window Max time distance of data points (from the
+   *            requested epoch) used in interpolation
+   * @param[in] mr Memory resource to allocate interpolators' memory from
+   */
+  explicit SvInterpolatorSet(
+      dso::milliseconds max_window = three_min_in_millisec,
+      std::pmr::memory_resource *mr = std::pmr::get_default_resource()) noexcept
+      : max_window_(max_window), mr_(mr) {}
+
+  /** @brief (Re)load the set off from an Sp3 product.
+   *
+   * Interpolators for satellites whose records are unchanged w.r.t. the
+   * previous load are kept; the rest are (re)built. Satellites not in the
+   * product are dropped.
+   * @param[in]  sp3 The Sp3 product
+   * @param[out] rebuilt If not nullptr, filled with the satellites that were
+   *             (re)built, i.e. changed or new
+   * @param[in]  ex Executor to rebuild interpolators on; if nullptr, the
+   *             default_executor() is used
+   * @return Anything other than 0 denotes an error; interpolators that
+   *         failed to build hold no data and are rebuilt on the next load
+   */
+  int load(const Sp3c &sp3, std::vector<sp3::SatelliteId> *rebuilt = nullptr,
+           sp3::Executor *ex = nullptr);
+
+  /** @brief Number of interpolators (aka satellites) in the set */
+  int size() const noexcept { return intrps_.size(); }
+
+  /** @brief Interpolator for SV sv, or nullptr if not in the set */
+  const SvInterpolator *find(const sp3::SatelliteId &sv) const noexcept;
+
+  /** @brief Max window of interpolation */
+  dso::milliseconds max_window() const noexcept { return max_window_; }
+
+  /** @brief Interpolator at index i */
+  const SvInterpolator &operator[](int i) const noexcept {
+    return *intrps_[i];
+  }
+
+  /** @brief Fingerprint of the records of the satellite at index i */
+  uint64_t fingerprint(int i) const noexcept { return hashes_[i]; }
+
+  /** @brief Interpolate the state of SV sv at t, using the set's own
+   * interpolation state for sv; see SvInterpolator::interpolate_at
+   * @return -1 if sv is not in the set, else as
+   *         SvInterpolator::interpolate_at
+   */
+  int interpolate_at(const sp3::SatelliteId &sv,
+                     const dso::datetime<dso::nanoseconds> &t, double *pos,
+                     double *erpos, double *vel = nullptr,
+                     double *ervel = nullptr) noexcept;
+}; /* class SvInterpolatorSet */
+
+} /* namespace dso */
+
+#endif
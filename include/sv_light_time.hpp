@@ -0,0 +1,122 @@
+/** @file
+ * Define a batch solver of the light-time equation, i.e. the position (and
+ * clock) of satellites at signal transmission time, given the position of
+ * receivers and the reception times. Many observations (e.g. all satellites
+ * tracked by a network of receivers over an arc) are solved at once, off
+ * from a set of SV interpolators.
+ */
+
+#ifndef __SV_SP3_LIGHT_TIME_HPP__
+#define __SV_SP3_LIGHT_TIME_HPP__
+
+#include "sp3_executor.hpp"
+#include "sv_interpolator_set.hpp"
+#include <vector>
+
+namespace dso {
+
+/** @class SvLightTimeObs
+ * An observation to solve the light-time equation for.
+ */
+struct SvLightTimeObs {
+  /** The satellite observed */
+  sp3::SatelliteId sv;
+  /** Reception time, in the time system of the Sp3 product */
+  dso::datetime<dso::nanoseconds> t_rx{
+      dso::datetime<dso::nanoseconds>::min()};
+  /** Receiver position (ECEF) at reception [m] */
+  double rx[3];
+}; /* struct SvLightTimeObs */
+
+/** @class SvLightTimeSolution
+ * The solution of the light-time equation, for one observation.
+ */
+struct SvLightTimeSolution {
+  /** Satellite position and velocity at transmission time, in the ECEF
+   * frame at reception time (i.e. corrected for the Earth rotation during
+   * signal flight) [m] and [m/s]
+   */
+  double pos[3];
+  double vel[3];
+  /** Signal travel time [sec] and geometric range [m] */
+  double tau{0e0};
+  double range{0e0};
+  /** Satellite clock correction at transmission time [sec], if available
+   * (see has_clk)
+   */
+  double clk{0e0};
+  bool has_clk{false};
+  /** Periodic relativistic clock correction, -2 r.v / c^2 [sec] */
+  double rel{0e0};
+  /** 0 if solved, else one of the ERROR_ values of SvLightTimeSolver */
+  int status{0};
+}; /* struct SvLightTimeSolution */
+
+/** @class SvLightTimeSolver
+ * Solve the light-time equation for batches of observations.
+ *
+ * For each observation, the interpolation window of the satellite (the
+ * data points within the max window of the reception time, as in
+ * SvInterpolator::interpolate_at) is set up once; the (barycentric
+ * Lagrange) weights of the window are then re-used for all iterations, as
+ * well as for any other observation of the satellite that falls within the
+ * same window. Observations are grouped per satellite and solved in
+ * parallel (one task per satellite); within a group, iterations run over
+ * all observations at once.
+ *
+ * Positions are interpolated via the same polynomial as
+ * SvInterpolator::interpolate_at; velocities are the derivative of that
+ * polynomial; clocks are linearly interpolated between the neighbouring
+ * data points.
+ */
+class SvLightTimeSolver {
+  const SvInterpolatorSet *set_;
+  dso::milliseconds max_window_;
+  /** Min number of data points on each side of the reception time */
+  int min_dpts_on_each_side_{2};
+  /** Max number of iterations, and convergence threshold [sec] */
+  int max_iterations_{10};
+  double tolerance_{1e-12};
+
+public:
+  /** Status of a solution: satellite not in the set */
+  static constexpr int ERROR_NO_SV = 1;
+  /** Status of a solution: too few data points around reception time */
+  static constexpr int ERROR_NO_WINDOW = 2;
+  /** Status of a solution: iterations did not converge */
+  static constexpr int ERROR_NO_CONVERGENCE = 3;
+
+  /** @brief Constructor
+   * @param[in] set The interpolators of the satellites; must outlive the
+   *            instance. The max window of interpolation is that of the
+   *            set.
+   */
+  explicit SvLightTimeSolver(const SvInterpolatorSet &set) noexcept
+      : set_(&set), max_window_(set.max_window()) {}
+
+  /** @brief Set the max number of iterations and the convergence
+   * threshold (on the travel time) [sec]
+   */
+  void set_iterations(int max_iterations, double tolerance) noexcept {
+    max_iterations_ = max_iterations;
+    tolerance_ = tolerance;
+  }
+
+  /** @brief Solve the light-time equation for a batch of observations.
+   *
+   * @param[in]  obs Observations, in any order
+   * @param[out] sol Resized and filled with the solutions, one per
+   *             observation (in the order of obs)
+   * @param[in]  ex  Executor to run on; if nullptr, the default_executor()
+   *             is used
+   * @return 0 if all observations were solved, else 1 (see the status of
+   *         each solution)
+   */
+  int solve(const std::vector<SvLightTimeObs> &obs,
+            std::vector<SvLightTimeSolution> &sol,
+            sp3::Executor *ex = nullptr) const;
+}; /* class SvLightTimeSolver */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,150 @@
+/** @file
+ * Define the visibility of satellites from ground stations, i.e. the
+ * topocentric elevation, azimuth, range and range-rate of the satellites
+ * of an Sp3 product, and the passes (rise, culmination and set) of the
+ * satellites over any number of stations.
+ */
+
+#ifndef __SV_SP3_VISIBILITY_HPP__
+#define __SV_SP3_VISIBILITY_HPP__
+
+#include "sp3_executor.hpp"
+#include "sv_interpolator_set.hpp"
+#include <string>
+#include <vector>
+
+namespace dso {
+
+/** @class SvStation A ground station */
+struct SvStation {
+  std::string name;
+  /** Position (ECEF) [m] */
+  double xyz[3];
+}; /* struct SvStation */
+
+/** @class SvPass
+ * A pass of a satellite over a station, i.e. the time span the satellite
+ * is above the elevation mask.
+ */
+struct SvPass {
+  /** Index of the station (in the list of stations given) */
+  int station{0};
+  sp3::SatelliteId sv;
+  /** Rise, culmination and set epochs */
+  dso::datetime<dso::nanoseconds> rise, culmination, set;
+  /** Elevation at culmination [rad] */
+  double max_elevation{0e0};
+  /** False if the pass started before (has_rise) or ends after (has_set)
+   * the tabulated time span (or a gap in the data); rise/set then hold the
+   * first/last epoch the satellite was seen at
+   */
+  bool has_rise{true};
+  bool has_set{true};
+}; /* struct SvPass */
+
+/** @class SvVisibility
+ * Satellite states tabulated on a regular time grid, for computing look
+ * angles and passes over ground stations.
+ *
+ * Satellites are interpolated once, when tabulating (see tabulate); any
+ * number of stations is then served off from the table. States are stored
+ * epoch-major (all satellites of an epoch are contiguous), so that look
+ * angles are computed for all satellites of an epoch in one (vectorizable)
+ * loop. Between grid epochs, satellite positions are interpolated via cubic
+ * Hermite polynomials (off from the tabulated positions and velocities);
+ * rise and set epochs are the roots of the elevation (minus the mask) on
+ * that interpolant.
+ *
+ * Look angles are geometric, i.e. the light travel time and atmospheric
+ * refraction are not accounted for. Const member functions can be called
+ * concurrently.
+ */
+class SvVisibility {
+  std::vector<sp3::SatelliteId> svs_;
+  /** The time grid: first epoch, step and number of epochs */
+  dso::datetime<dso::nanoseconds> t0_;
+  dso::nanoseconds step_{0};
+  int nt_{0};
+  /** Positions [m] and velocities [m/s] (ECEF), index [epoch * nsv + sv] */
+  std::vector<double> x_, y_, z_, vx_, vy_, vz_;
+  /** Set if the state could be interpolated */
+  std::vector<char> ok_;
+
+  /** @brief A station, along with its local (East, North, Up) axes */
+  struct Topo;
+
+  /** @brief The local frame of station sta */
+  static Topo topo(const SvStation &sta) noexcept;
+
+  /** @brief Look angles (see the public overload), off from the frame of
+   * the station
+   */
+  void look_angles(const Topo &tp, int i, double *el, double *az,
+                   double *range, double *range_rate) const noexcept;
+
+public:
+  /** @brief Tabulate the states of all satellites of a set of
+   * interpolators, at epochs t0, t0 + step, ..., up to (and including) t1.
+   *
+   * Velocities are interpolated off the satellites' velocity records; for
+   * satellites without velocity records, they are computed by differencing
+   * interpolated positions. Any previous table is discarded. Satellites
+   * are interpolated in parallel (one task per satellite), off from the
+   * (shared) interpolators of the set.
+   * @param[in] ex Executor to run on; if nullptr, the default_executor() is
+   *            used
+   * @return 0 on success, >0 on error (e.g. an empty time span); states
+   *         that cannot be interpolated (e.g. close to the limits of the
+   *         data) are just marked as not available
+   */
+  int tabulate(const SvInterpolatorSet &set,
+               const dso::datetime<dso::nanoseconds> &t0,
+               const dso::datetime<dso::nanoseconds> &t1,
+               dso::nanoseconds step, sp3::Executor *ex = nullptr);
+
+  /** @brief Satellites in the table, in order */
+  const std::vector<sp3::SatelliteId> &satellites() const noexcept {
+    return svs_;
+  }
+
+  /** @brief Number of satellites in the table */
+  int num_satellites() const noexcept { return svs_.size(); }
+
+  /** @brief Number of epochs in the table */
+  int num_epochs() const noexcept { return nt_; }
+
+  /** @brief Epoch at index i of the table */
+  dso::datetime<dso::nanoseconds> epoch(int i) const noexcept;
+
+  /** @brief Look angles of all satellites from station sta, at the epoch
+   * with index i.
+   *
+   * Output arrays must hold (at least) num_satellites() values, in the
+   * order of satellites(); values of satellites not available at the epoch
+   * are set to NaN. Any of az, range and range_rate may be nullptr.
+   * @param[out] el Elevation [rad]
+   * @param[out] az Azimuth, clockwise from North [rad]
+   * @param[out] range Range [m]
+   * @param[out] range_rate Range-rate [m/s]
+   */
+  void look_angles(const SvStation &sta, int i, double *el, double *az,
+                   double *range, double *range_rate) const noexcept;
+
+  /** @brief Find all passes of all satellites over a list of stations.
+   *
+   * Stations are processed in parallel (one task per station).
+   * @param[in]  stations The stations
+   * @param[in]  min_elevation Elevation mask [rad]
+   * @param[out] out Cleared and filled with the passes, per station (in
+   *             the order given) and in chronological order of rise
+   * @param[in]  ex Executor to run on; if nullptr, the default_executor()
+   *             is used
+   * @return Anything other than 0 denotes an error (e.g. nothing tabulated)
+   */
+  int passes(const std::vector<SvStation> &stations, double min_elevation,
+             std::vector<SvPass> &out, sp3::Executor *ex = nullptr) const;
+}; /* class SvVisibility */
+
+} /* namespace dso */
+
+#endif
@@ -0,0 +1,257 @@
+/** @file
+ * sp3d: a daemon that loads Sp3 products once and serves (batched)
+ * interpolation requests to local processes, over a Unix domain socket (see
+ * core/sp3_wire.hpp for the protocol and Sp3Client for a client).
+ *
+ * Usage: sp3d [-s SOCKET] [-w WINDOW_SEC] SP3_FILE [SP3_FILE ...]
+ *
+ * Each connection is served by its own thread. On SIGHUP, all products are
+ * re-loaded (only satellites with changed records are rebuilt) and swapped
+ * in without pausing connections; SIGINT/SIGTERM stop the daemon.
+ */
+
+#include "core/sp3_time.hpp"
+#include "core/sp3_wire.hpp"
+#include "sp3_publication.hpp"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace dso;
+using namespace dso::sp3::wire;
+using dso::sp3::NS_PER_DAY;
+
+namespace {
+volatile std::sig_atomic_t stop_requested = 0;
+volatile std::sig_atomic_t reload_requested = 0;
+
+void on_signal(int sig) {
+  if (sig == SIGHUP)
+    reload_requested = 1;
+  else
+    stop_requested = 1;
+}
+
+/* A product served */
+struct Product {
+  std::string fn;
+  std::unique_ptr<Sp3Publisher> pub;
+}; /* struct Product */
+
+/* A client connection, served by its own thread */
+struct Connection {
+  int fd;
+  std::thread th;
+  std::atomic<bool> done{false};
+}; /* struct Connection */
+
+/* Answer interpolation queries, off from the products that cover them */
+void answer(std::vector<Sp3Reader> &readers, const InterpolationQuery *q,
+            int count, bool velocity, InterpolationResult *r) noexcept {
+  for (int i = 0; i < count; i++) {
+    std::memset(&r[i], 0, sizeof r[i]);
+    r[i].status = -1;
+    if (q[i].nsec < 0 || q[i].nsec >= NS_PER_DAY) {
+      r[i].status = 1;
+      continue;
+    }
+    char id[sizeof q[i].sv + 1] = {'\0'};
+    std::memcpy(id, q[i].sv, sizeof q[i].sv);
+    const sp3::SatelliteId sv(id);
+    const dso::datetime<dso::nanoseconds> t(dso::modified_julian_day(q[i].mjd),
+                                            dso::nanoseconds(q[i].nsec));
+    for (std::size_t p = 0; p < readers.size(); p++) {
+      if (readers[p].refresh() < 0)
+        continue;
+      const Sp3Dataset *ds = readers[p].dataset();
+      if (t < ds->t_start || t > ds->t_stop)
+        continue;
+      r[i].status = readers[p].interpolate_at(sv, t, r[i].pos, r[i].erpos,
+                                              velocity ? r[i].vel : nullptr,
+                                              velocity ? r[i].ervel : nullptr);
+      if (!r[i].status)
+        break;
+    }
+  }
+}
+
+/* Serve a connection, until the client hangs up (or on error) */
+void serve(const std::vector<Product> &products, Connection *conn) noexcept {
+  std::vector<Sp3Reader> readers;
+  for (const auto &p : products)
+    readers.emplace_back(*p.pub);
+  std::vector<InterpolationQuery> queries;
+  std::vector<InterpolationResult> results;
+
+  for (;;) {
+    RequestHeader hdr;
+    if (read_all(conn->fd, &hdr, sizeof hdr))
+      break;
+
+    ResponseHeader rhdr{RESPONSE_MAGIC, VERSION, STATUS_OK, 0, 0};
+    if (hdr.magic != REQUEST_MAGIC || hdr.version != VERSION ||
+        hdr.count > MAX_ITEMS ||
+        (hdr.op != OP_PING && hdr.op != OP_INTERPOLATE)) {
+      /* can not resync with the client; answer and hang up */
+      rhdr.status = STATUS_BAD_REQUEST;
+      write_all(conn->fd, &rhdr, sizeof rhdr);
+      break;
+    }
+
+    if (hdr.op == OP_INTERPOLATE) {
+      try {
+        queries.resize(hdr.count);
+        results.resize(hdr.count);
+      } catch (std::exception &) {
+        break;
+      }
+      if (hdr.count &&
+          read_all(conn->fd, queries.data(),
+                   hdr.count * sizeof(InterpolationQuery)))
+        break;
+      answer(readers, queries.data(), hdr.count, hdr.flags & FLAG_VELOCITY,
+             results.data());
+      rhdr.count = hdr.count;
+    }
+
+    if (write_all(conn->fd, &rhdr, sizeof rhdr) ||
+        (rhdr.count && write_all(conn->fd, results.data(),
+                                 rhdr.count * sizeof(InterpolationResult))))
+      break;
+  }
+
+  conn->done = true;
+}
+
+void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-s SOCKET] [-w WINDOW_SEC] SP3_FILE [SP3_FILE ...]\n"
+          "  -s SOCKET     Path of the Unix domain socket (default: %s)\n"
+          "  -w WINDOW_SEC Max time distance of data points used in\n"
+          "                interpolation, in seconds (default: 180)\n",
+          prog, DEFAULT_SOCKET);
+}
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+  const char *socket_path = DEFAULT_SOCKET;
+  long window_sec = 180;
+  int opt;
+  while ((opt = ::getopt(argc, argv, "s:w:h")) != -1) {
+    switch (opt) {
+    case 's':
+      socket_path = optarg;
+      break;
+    case 'w':
+      window_sec = std::atol(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc || window_sec <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  /* load products */
+  std::vector<Product> products(argc - optind);
+  for (int i = optind; i < argc; i++) {
+    Product &p = products[i - optind];
+    p.pub = std::make_unique<Sp3Publisher>(
+        dso::milliseconds(window_sec * 1000L));
+    p.fn = argv[i];
+    if (p.pub->publish(argv[i])) {
+      fprintf(stderr, "[ERROR] Failed loading product %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  /* listen on the socket */
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  if (std::strlen(socket_path) >= sizeof addr.sun_path) {
+    fprintf(stderr, "[ERROR] Socket path %s is too long\n", socket_path);
+    return 1;
+  }
+  std::strcpy(addr.sun_path, socket_path);
+  const int lfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ::unlink(socket_path);
+  if (lfd < 0 ||
+      ::bind(lfd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) ||
+      ::listen(lfd, 64)) {
+    fprintf(stderr, "[ERROR] Failed listening on %s: %s\n", socket_path,
+            std::strerror(errno));
+    return 1;
+  }
+
+  struct sigaction sa;
+  std::memset(&sa, 0, sizeof sa);
+  sa.sa_handler = on_signal;
+  ::sigaction(SIGINT, &sa, nullptr);
+  ::sigaction(SIGTERM, &sa, nullptr);
+  ::sigaction(SIGHUP, &sa, nullptr);
+
+  fprintf(stderr, "sp3d: serving %d product(s) on %s\n", (int)products.size(),
+          socket_path);
+
+  std::list<std::unique_ptr<Connection>> conns;
+  while (!stop_requested) {
+    /* re-load products */
+    if (reload_requested) {
+      reload_requested = 0;
+      for (auto &p : products)
+        if (p.pub->publish(p.fn.c_str()))
+          fprintf(stderr, "[WARNING] Failed re-loading product %s\n",
+                  p.fn.c_str());
+    }
+
+    /* reap finished connections */
+    for (auto it = conns.begin(); it != conns.end();) {
+      if ((*it)->done) {
+        (*it)->th.join();
+        ::close((*it)->fd);
+        it = conns.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    struct pollfd pfd {
+      lfd, POLLIN, 0
+    };
+    if (::poll(&pfd, 1, 500) <= 0)
+      continue;
+    const int fd = ::accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+    auto conn = std::make_unique<Connection>();
+    conn->fd = fd;
+    conn->th = std::thread(serve, std::cref(products), conn.get());
+    conns.push_back(std::move(conn));
+  }
+
+  /* hang up on clients and wait for their threads */
+  for (auto &c : conns) {
+    ::shutdown(c->fd, SHUT_RDWR);
+    c->th.join();
+    ::close(c->fd);
+  }
+  ::close(lfd);
+  ::unlink(socket_path);
+  return 0;
+}
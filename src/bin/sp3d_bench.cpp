@@ -0,0 +1,141 @@
+/** @file
+ * sp3d_bench: measure the per-request latency of the interpolation daemon
+ * (sp3d), against interpolating in-process off from the same Sp3 file.
+ *
+ * Usage: sp3d_bench [-s SOCKET] [-n REQUESTS] [-b BATCH] [-w WINDOW_SEC]
+ *                   SP3_FILE
+ *
+ * The daemon must be serving SP3_FILE (with the same window). Queries are
+ * spread over all satellites and epochs of the file.
+ */
+
+#include "core/sp3_wire.hpp"
+#include "sp3_client.hpp"
+#include "sv_interpolate.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
+
+using namespace dso;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+/* Print min/median/p99/max of latencies (in microseconds) */
+void report(const char *label, std::vector<double> &lat, int batch) {
+  std::sort(lat.begin(), lat.end());
+  const auto at = [&lat](double q) {
+    return lat[std::min<std::size_t>(lat.size() - 1, q * lat.size())];
+  };
+  double sum = 0e0;
+  for (auto l : lat)
+    sum += l;
+  printf("%-12s batch=%5d requests=%7zu  min=%9.2f  median=%9.2f  "
+         "p99=%9.2f  max=%9.2f  per-query=%8.3f [usec]\n",
+         label, batch, lat.size(), lat.front(), at(.5), at(.99), lat.back(),
+         sum / lat.size() / batch);
+}
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+  const char *socket_path = nullptr;
+  long num_requests = 10000, batch = 1, window_sec = 180;
+  int opt;
+  while ((opt = ::getopt(argc, argv, "s:n:b:w:")) != -1) {
+    switch (opt) {
+    case 's':
+      socket_path = optarg;
+      break;
+    case 'n':
+      num_requests = std::atol(optarg);
+      break;
+    case 'b':
+      batch = std::atol(optarg);
+      break;
+    case 'w':
+      window_sec = std::atol(optarg);
+      break;
+    default:
+      fprintf(stderr,
+              "Usage: %s [-s SOCKET] [-n REQUESTS] [-b BATCH] [-w WINDOW_SEC] "
+              "SP3_FILE\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc || num_requests <= 0 || batch <= 0 ||
+      batch > (long)sp3::wire::MAX_ITEMS) {
+    fprintf(stderr, "Usage: %s [-s SOCKET] [-n REQUESTS] [-b BATCH] "
+                    "[-w WINDOW_SEC] SP3_FILE\n",
+            argv[0]);
+    return 1;
+  }
+
+  /* queries, at the middle of intervals, away from the file's edges */
+  Sp3c sp3(argv[optind]);
+  const auto &svs = sp3.sattellite_vector();
+  const int64_t interval = sp3.interval().as_underlying_type();
+  const int64_t margin = (window_sec * 1000000000L) / interval + 1;
+  const int64_t num_slots = sp3.num_epochs() - 1 - 2 * margin;
+  if (svs.empty() || num_slots <= 0) {
+    fprintf(stderr, "Not enough epochs in file %s\n", argv[optind]);
+    return 1;
+  }
+  std::vector<Sp3ClientQuery> queries(num_requests * batch);
+  for (std::size_t i = 0; i < queries.size(); i++) {
+    queries[i].sv = svs[i % svs.size()];
+    const int64_t ns = (margin + (int64_t)(i / svs.size()) % num_slots) *
+                           interval +
+                       interval / 2;
+    queries[i].t = sp3.start_epoch() +
+                   datetime_interval<nanoseconds>(0, nanoseconds(ns));
+  }
+  std::vector<Sp3ClientResult> results(batch);
+  std::vector<double> lat;
+  lat.reserve(num_requests);
+
+  /* in-process, for reference */
+  std::vector<SvInterpolator> intrps;
+  for (const auto &sv : svs)
+    intrps.emplace_back(sv, sp3, dso::milliseconds(window_sec * 1000L));
+  for (long r = 0; r < num_requests; r++) {
+    const auto start = Clock::now();
+    for (long i = 0; i < batch; i++) {
+      const auto &q = queries[r * batch + i];
+      auto &res = results[i];
+      res.status = intrps[(r * batch + i) % svs.size()].interpolate_at(
+          q.t, res.pos, res.erpos);
+    }
+    lat.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count());
+  }
+  report("in-process", lat, batch);
+  const double check = results[0].pos[0];
+
+  /* via the daemon */
+  Sp3Client client(socket_path);
+  lat.clear();
+  for (long r = 0; r < num_requests; r++) {
+    const auto start = Clock::now();
+    if (client.interpolate(queries.data() + r * batch, batch,
+                           results.data())) {
+      fprintf(stderr, "Request %ld failed\n", r);
+      return 1;
+    }
+    lat.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count());
+  }
+  report("sp3d", lat, batch);
+
+  /* results should match */
+  if (results[0].status || std::abs(results[0].pos[0] - check) > 1e-9) {
+    fprintf(stderr, "Results of daemon do not match in-process ones!\n");
+    return 1;
+  }
+  return 0;
+}
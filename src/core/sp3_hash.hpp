@@ -0,0 +1,30 @@
+/** @file
+ * Define the (64-bit FNV-1a) hash used to fingerprint Sp3 contents.
+ */
+
+#ifndef __SP3C_HASH_HPP__
+#define __SP3C_HASH_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dso::sp3 {
+
+/** FNV-1a offset basis, i.e. the hash of no bytes */
+constexpr uint64_t FNV_OFFSET_BASIS{14695981039346656037ULL};
+
+/** FNV-1a prime */
+constexpr uint64_t FNV_PRIME{1099511628211ULL};
+
+/** @brief Update the FNV-1a hash h with count bytes off from buf */
+inline uint64_t fnv1a(uint64_t h, const char *buf, std::size_t count) noexcept {
+  for (std::size_t i = 0; i < count; i++) {
+    h ^= static_cast<unsigned char>(buf[i]);
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+} /* namespace dso::sp3 */
+
+#endif
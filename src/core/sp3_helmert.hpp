@@ -0,0 +1,124 @@
+/** @file
+ * Define the (linearized) 7-parameter Helmert transformation used when
+ * comparing/combining Sp3 products, i.e. x2 = x1 + T + D x1 + r x x1,
+ * estimated via least squares.
+ */
+
+#ifndef __SP3C_HELMERT_HPP__
+#define __SP3C_HELMERT_HPP__
+
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace dso::sp3 {
+
+/** Coordinates are divided by this [m] in the normal equations, so that
+ * all parameters are of similar magnitude
+ */
+constexpr double HELMERT_COORD_SCALE{6378137e0};
+
+/** Milliarcseconds per radian */
+constexpr double MAS_PER_RAD{206264806.247096e0};
+
+/** @class HelmertNormals
+ * Normal equations of the Helmert parameters; parameters are, in order,
+ * tx, ty, tz [m], scale, rx, ry, rz, the last four multiplied by
+ * HELMERT_COORD_SCALE (i.e. in [m]).
+ */
+struct HelmertNormals {
+  double N[7][7] = {};
+  double u[7] = {};
+  int count{0};
+
+  /** @brief Rows of the design matrix for position x [m] */
+  static void rows(const double *x, double A[3][7]) noexcept {
+    std::memset(A, 0, sizeof(double) * 21);
+    A[0][0] = A[1][1] = A[2][2] = 1e0;
+    for (int i = 0; i < 3; i++)
+      A[i][3] = x[i] / HELMERT_COORD_SCALE;
+    /* rotation: r cross x */
+    A[0][5] = x[2] / HELMERT_COORD_SCALE;
+    A[0][6] = -x[1] / HELMERT_COORD_SCALE;
+    A[1][4] = -x[2] / HELMERT_COORD_SCALE;
+    A[1][6] = x[0] / HELMERT_COORD_SCALE;
+    A[2][4] = x[1] / HELMERT_COORD_SCALE;
+    A[2][5] = -x[0] / HELMERT_COORD_SCALE;
+  }
+
+  /** @brief Add the difference d (x2 - x1) at position x1, both in [m],
+   * with weight w
+   */
+  void add(const double *x, const double *d, double w = 1e0) noexcept {
+    double A[3][7];
+    rows(x, A);
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 7; j++) {
+        u[j] += w * A[i][j] * d[i];
+        for (int k = 0; k < 7; k++)
+          N[j][k] += w * A[i][j] * A[i][k];
+      }
+    ++count;
+  }
+
+  /** @brief Add another set of normal equations */
+  void add(const HelmertNormals &other) noexcept {
+    for (int j = 0; j < 7; j++) {
+      u[j] += other.u[j];
+      for (int k = 0; k < 7; k++)
+        N[j][k] += other.N[j][k];
+    }
+    count += other.count;
+  }
+
+  /** @brief Solve for the parameters p, via Gaussian elimination with
+   * partial pivoting; the instance is not changed.
+   * @return Anything other than 0 denotes an error (singular system)
+   */
+  int solve(double *p) const noexcept {
+    double M[7][7];
+    std::memcpy(M, N, sizeof M);
+    std::memcpy(p, u, sizeof u);
+    for (int k = 0; k < 7; k++) {
+      int q = k;
+      for (int i = k + 1; i < 7; i++)
+        if (std::abs(M[i][k]) > std::abs(M[q][k]))
+          q = i;
+      if (std::abs(M[q][k]) < 1e-12)
+        return 1;
+      if (q != k) {
+        std::swap(M[q], M[k]);
+        std::swap(p[q], p[k]);
+      }
+      for (int i = k + 1; i < 7; i++) {
+        const double f = M[i][k] / M[k][k];
+        for (int j = k; j < 7; j++)
+          M[i][j] -= f * M[k][j];
+        p[i] -= f * p[k];
+      }
+    }
+    for (int k = 6; k >= 0; k--) {
+      for (int j = k + 1; j < 7; j++)
+        p[k] -= M[k][j] * p[j];
+      p[k] /= M[k][k];
+    }
+    return 0;
+  }
+
+  /** @brief The transformation (x2 - x1) at position x1 [m], given the
+   * parameters p
+   */
+  static void apply(const double *p, const double *x, double *d) noexcept {
+    double A[3][7];
+    rows(x, A);
+    for (int i = 0; i < 3; i++) {
+      d[i] = 0e0;
+      for (int j = 0; j < 7; j++)
+        d[i] += A[i][j] * p[j];
+    }
+  }
+}; /* struct HelmertNormals */
+
+} /* namespace dso::sp3 */
+
+#endif
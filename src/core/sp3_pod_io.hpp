@@ -0,0 +1,35 @@
+/** @file
+ * Helpers to read/write plain (binary) values and arrays off from/to file
+ * streams, used by the library's binary file formats (e.g. sidecar indexes
+ * and checkpoints). Values are written in native byte order.
+ */
+
+#ifndef __SP3C_POD_IO_HPP__
+#define __SP3C_POD_IO_HPP__
+
+#include <fstream>
+#include <vector>
+
+namespace dso::sp3 {
+
+template <typename T> void write_pod(std::ofstream &fout, const T &val) {
+  fout.write(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+template <typename T> void read_pod(std::ifstream &fin, T &val) {
+  fin.read(reinterpret_cast<char *>(&val), sizeof(T));
+}
+
+template <typename T>
+void write_vec(std::ofstream &fout, const std::vector<T> &vec) {
+  fout.write(reinterpret_cast<const char *>(vec.data()),
+             vec.size() * sizeof(T));
+}
+
+template <typename T> void read_vec(std::ifstream &fin, std::vector<T> &vec) {
+  fin.read(reinterpret_cast<char *>(vec.data()), vec.size() * sizeof(T));
+}
+
+} /* namespace dso::sp3 */
+
+#endif
@@ -0,0 +1,18 @@
+/** @file
+ * Define time constants shared by the library (and its programs), for
+ * arithmetic on epochs expressed in nanoseconds.
+ */
+
+#ifndef __SP3C_TIME_HPP__
+#define __SP3C_TIME_HPP__
+
+#include <cstdint>
+
+namespace dso::sp3 {
+
+/** Nanoseconds per day */
+constexpr int64_t NS_PER_DAY{86400LL * 1000000000LL};
+
+} /* namespace dso::sp3 */
+
+#endif
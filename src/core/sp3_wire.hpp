@@ -0,0 +1,103 @@
+/** @file
+ * Define the binary protocol spoken between the interpolation daemon (sp3d)
+ * and its clients (see Sp3Client), over a Unix domain socket.
+ *
+ * Both ends run on the same host, hence all fields are in native byte order
+ * and layout. A client sends a request (a RequestHeader followed by count
+ * items) and receives a response (a ResponseHeader followed by count items,
+ * in the order of the request), on the same connection.
+ */
+
+#ifndef __SP3C_WIRE_HPP__
+#define __SP3C_WIRE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dso::sp3::wire {
+
+/** Request/response magic numbers ('SP3Q' and 'SP3R') */
+constexpr uint32_t REQUEST_MAGIC{0x51335053U};
+constexpr uint32_t RESPONSE_MAGIC{0x52335053U};
+
+/** Protocol version */
+constexpr uint16_t VERSION{1};
+
+/** Max number of items in a request */
+constexpr uint32_t MAX_ITEMS{1U << 16};
+
+/** Default socket path of the daemon */
+constexpr const char *DEFAULT_SOCKET{"/tmp/sp3d.sock"};
+
+/** Request operations */
+enum Op : uint16_t {
+  /** No-op; answered with an empty response (e.g. to measure round trips) */
+  OP_PING = 0,
+  /** Interpolate state(s); items are InterpolationQuery */
+  OP_INTERPOLATE = 1
+}; /* enum Op */
+
+/** Request flags */
+enum Flags : uint16_t {
+  /** Also compute velocities (and their std. deviations) */
+  FLAG_VELOCITY = 1
+}; /* enum Flags */
+
+/** Response status (of the response as a whole) */
+enum Status : uint16_t {
+  STATUS_OK = 0,
+  /** Malformed or unsupported request */
+  STATUS_BAD_REQUEST = 1,
+  /** No product loaded */
+  STATUS_NO_DATA = 2
+}; /* enum Status */
+
+struct RequestHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t op;
+  uint16_t flags;
+  uint16_t reserved;
+  uint32_t count;
+}; /* struct RequestHeader */
+
+/** A query; the epoch is given as MJD and nanoseconds of day */
+struct InterpolationQuery {
+  char sv[4];
+  uint32_t reserved;
+  int64_t mjd;
+  int64_t nsec;
+}; /* struct InterpolationQuery */
+
+struct ResponseHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t status;
+  uint32_t count;
+  uint32_t reserved;
+}; /* struct ResponseHeader */
+
+/** Result of a query; status is as returned by
+ * SvInterpolator::interpolate_at (or -1 if the SV/epoch is not covered by
+ * any product loaded). Velocities are zero unless asked for.
+ */
+struct InterpolationResult {
+  int32_t status;
+  uint32_t reserved;
+  double pos[3], erpos[3];
+  double vel[3], ervel[3];
+}; /* struct InterpolationResult */
+
+/** @brief Read exactly count bytes off from fd
+ * @return 0 on success, -1 if the peer closed the connection, >0 on error
+ */
+int read_all(int fd, void *buf, std::size_t count) noexcept;
+
+/** @brief Write exactly count bytes to fd
+ * @return 0 on success, >0 on error
+ */
+int write_all(int fd, const void *buf, std::size_t count) noexcept;
+
+} /* namespace dso::sp3::wire */
+
+#endif
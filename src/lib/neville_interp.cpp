@@ -128,8 +128,8 @@ int dso::sp3::neville_interpolation3(
   double *dx = workspace + array_size;
   double *cy = workspace + 2 * array_size;
   double *dy = workspace + 3 * array_size;
-  double *cz = workspace + 3 * array_size;
-  double *dz = workspace + 4 * array_size;
+  double *cz = workspace + 4 * array_size;
+  double *dz = workspace + 5 * array_size;
 
   int nsx = 0, nsy = 0, nsz = 0;
   double dift;
@@ -197,9 +197,9 @@ int dso::sp3::neville_interpolation3(
     estimates[0] +=
         (destimates[0] = (2 * (nsx + 1) < (mm - m) ? cx[nsx + 1] : dx[nsx--]));
     estimates[1] +=
-        (destimates[1] = (2 * (nsy + 1) < (mm - m) ? cx[nsy + 1] : dx[nsy--]));
+        (destimates[1] = (2 * (nsy + 1) < (mm - m) ? cy[nsy + 1] : dy[nsy--]));
     estimates[2] +=
-        (destimates[2] = (2 * (nsz + 1) < (mm - m) ? cx[nsz + 1] : dx[nsz--]));
+        (destimates[2] = (2 * (nsz + 1) < (mm - m) ? cz[nsz + 1] : dz[nsz--]));
   }
 
   return 0;
@@ -1,4 +1,5 @@
 #include "sp3.hpp"
+#include "core/sp3_time.hpp"
 #include <cstdio>
 #include <charconv>
 #include <stdexcept>
@@ -7,6 +8,7 @@
 #include <iostream>
 #endif
 
+using dso::sp3::NS_PER_DAY;
 using dso::sp3::SatelliteId;
 
 namespace {
@@ -37,8 +39,7 @@ const char *skipws(const char *str) noexcept {
 }
 } /* anonymous namespace */
 
-/** @brief Resolve an Epoch Header Record line
- *  @param[in] line An Epoch Header Record to be resolved
+/** @brief Read and resolve an Epoch Header Record line off from the stream
  *  @param[out] t The epoch resolved from the input line
  *  @return Anything other than 0 denotes an error
  */
@@ -46,6 +47,17 @@ int dso::Sp3c::resolve_epoch_line(dso::datetime<dso::nanoseconds> &t) noexcept {
   char line[MAX_RECORD_CHARS];
 
   __istream.getline(line, MAX_RECORD_CHARS);
+  return resolve_epoch_line(line, t);
+}
+
+/** @brief Resolve an Epoch Header Record line, given as (null-terminated)
+ *  string
+ *  @param[in] line An Epoch Header Record to be resolved
+ *  @param[out] t The epoch resolved from the input line
+ *  @return Anything other than 0 denotes an error
+ */
+int dso::Sp3c::resolve_epoch_line(
+    const char *line, dso::datetime<dso::nanoseconds> &t) const noexcept {
   if (line[0] != '*' || line[1] != ' ') {
     fprintf(stderr, "ERROR. Failed resolving epoch line [%s] (%s)\n", line,
             __func__);
@@ -132,6 +144,21 @@ int dso::Sp3c::get_next_velocity(SatelliteId &sat, double &xv, double &yv,
     }
   }
 
+  return resolve_velocity_line(line, xv, yv, zv, cv, xstdv, ystdv, zstdv,
+                               cstdv, flag);
+}
+
+/** Resolve an Sp3c/d Velocity and ClockRate-of-Change Record line, given as
+ *  a (null-terminated) string. For a description of the parameters, see
+ *  get_next_velocity.
+ *  @return Anything other than 0 denotes an error (note tha error codes must
+ *          be >0 and <10)
+ */
+int dso::Sp3c::resolve_velocity_line(const char *line, double &xv, double &yv,
+                                     double &zv, double &cv, double &xstdv,
+                                     double &ystdv, double &zstdv,
+                                     double &cstdv,
+                                     Sp3Flag &flag) const noexcept {
   /* resolve the 4 floats (vel + clk_rate) */
   int error = 0;
   double dvec[4];
@@ -264,6 +291,21 @@ int dso::Sp3c::get_next_position(SatelliteId &sat, double &xkm, double &ykm,
     }
   }
 
+  return resolve_position_line(line, xkm, ykm, zkm, clk, xstdv, ystdv, zstdv,
+                               cstdv, flag);
+}
+
+/** Resolve an Sp3c/d Position and Clock Record line, given as a
+ *  (null-terminated) string. For a description of the parameters, see
+ *  get_next_position.
+ *  @return Anything other than 0 denotes an error (note tha error codes must
+ *          be >0 and <10)
+ */
+int dso::Sp3c::resolve_position_line(const char *line, double &xkm,
+                                     double &ykm, double &zkm, double &clk,
+                                     double &xstdv, double &ystdv,
+                                     double &zstdv, double &cstdv,
+                                     Sp3Flag &flag) const noexcept {
   /* resolve the 4 floats (pos + clk_bias) */
   int error = 0;
   double dvec[4];
@@ -348,13 +390,13 @@ int dso::Sp3c::get_next_position(SatelliteId &sat, double &xkm, double &ykm,
   if (has_clk_stddev == 1)
     flag.set(Sp3Event::has_clk_stddev);
 
-  if (line[74] == 'E')
+  if (sz > 74 && line[74] == 'E')
     flag.set(Sp3Event::clock_event);
-  if (line[75] == 'P')
+  if (sz > 75 && line[75] == 'P')
     flag.set(Sp3Event::clock_prediction);
-  if (line[78] == 'M')
+  if (sz > 78 && line[78] == 'M')
     flag.set(Sp3Event::maneuver);
-  if (line[79] == 'E')
+  if (sz > 79 && line[79] == 'P')
     flag.set(Sp3Event::orbit_prediction);
 
   return 0;
@@ -366,8 +408,10 @@ int dso::Sp3c::get_next_position(SatelliteId &sat, double &xkm, double &ykm,
  *           If the file is successefuly opened, the constructor will read
  *           the header and assign info.
  *  @param[in] filename  The filename of the Sp3 file
+ *  @param[in] mode      Map the file (shared), or read it into a private
+ *                       snapshot
  */
-dso::Sp3c::Sp3c(const char *filename)
+dso::Sp3c::Sp3c(const char *filename, sp3::MapMode mode)
     : __filename(filename), __istream(filename, std::ios_base::in),
       /*__satsys(SATELLITE_SYSTEM::mixed),*/ __end_of_head(0) {
   int j;
@@ -377,6 +421,28 @@ dso::Sp3c::Sp3c(const char *filename)
     throw std::runtime_error("[ERROR] Failed to read Sp3 header; Error Code: " +
                              std::to_string(j));
   }
+  if ((j = map__.map(filename, mode))) {
+    __istream.close();
+    throw std::runtime_error("[ERROR] Failed to map Sp3 file; Error Code: " +
+                             std::to_string(j));
+  }
+  compute_fingerprint();
+}
+
+dso::datetime<dso::nanoseconds> dso::Sp3c::stop_epoch() const noexcept {
+  const int64_t span = (num_epochs__ > 0 ? num_epochs__ - 1 : 0) *
+                       interval__.as_underlying_type();
+  auto t = start_epoch__;
+  t += dso::datetime_interval<dso::nanoseconds>(
+      span / NS_PER_DAY, dso::nanoseconds(span % NS_PER_DAY));
+  return t;
+}
+
+int dso::Sp3c::remap() noexcept {
+  if (const int error = map__.remap(__filename.c_str()); error)
+    return error;
+  compute_fingerprint();
+  return 0;
 }
 
 int dso::Sp3c::peak_next_data_block(
@@ -476,18 +542,25 @@ int dso::Sp3c::get_next_data_block(SatelliteId satid,
     if (c == '*') {
       keep_reading = false;
       break;
-    } else if (c == 'P') {
-      if ((status = get_next_position(
-               satid, block.state[0], block.state[1], block.state[2],
-               block.state[3], block.state_sdev[0], block.state_sdev[1],
-               block.state_sdev[2], block.state_sdev[3], block.flag, &satid)))
-        return status + 20;
-    } else if (c == 'V') {
-      if ((status = get_next_velocity(
-               satid, block.state[4], block.state[5], block.state[6],
-               block.state[7], block.state_sdev[4], block.state_sdev[5],
-               block.state_sdev[6], block.state_sdev[7], block.flag, &satid)))
-        return status + 30;
+    } else if (c == 'P' || c == 'V') {
+      // only resolve records for the requested SV; skip all others
+      __istream.getline(line, MAX_RECORD_CHARS);
+      csatid.set_id(line + 1);
+      if (csatid != satid)
+        continue;
+      if (c == 'P') {
+        if ((status = resolve_position_line(
+                 line, block.state[0], block.state[1], block.state[2],
+                 block.state[3], block.state_sdev[0], block.state_sdev[1],
+                 block.state_sdev[2], block.state_sdev[3], block.flag)))
+          return status + 20;
+      } else {
+        if ((status = resolve_velocity_line(
+                 line, block.state[4], block.state[5], block.state[6],
+                 block.state[7], block.state_sdev[4], block.state_sdev[5],
+                 block.state_sdev[6], block.state_sdev[7], block.flag)))
+          return status + 30;
+      }
     } else {
       __istream.getline(line, MAX_RECORD_CHARS);
       if (!std::strncmp(line, "EOF", 3)) {
@@ -0,0 +1,290 @@
+#include "sp3_c.h"
+#include "core/sp3_time.hpp"
+#include "sv_interpolate.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <vector>
+
+using dso::sp3::NS_PER_DAY;
+
+namespace {
+/* Columns of a satellite's records: time, state and std. deviations */
+constexpr int NUM_COLUMNS = 1 + 2 * SP3C_NUM_STATE;
+
+/* Seconds of t w.r.t. a reference epoch */
+double seconds_since(const dso::datetime<dso::nanoseconds> &t,
+                     const dso::datetime<dso::nanoseconds> &ref) noexcept {
+  return (t.imjd().as_underlying_type() - ref.imjd().as_underlying_type()) *
+             86400e0 +
+         (t.sec().as_underlying_type() - ref.sec().as_underlying_type()) *
+             1e-9;
+}
+
+/* The epoch sec seconds after a reference epoch */
+dso::datetime<dso::nanoseconds>
+epoch_at(const dso::datetime<dso::nanoseconds> &ref, double sec) noexcept {
+  const int64_t ns = ref.sec().as_underlying_type() + std::llround(sec * 1e9);
+  int64_t days = ns / NS_PER_DAY;
+  int64_t rem = ns % NS_PER_DAY;
+  if (rem < 0) {
+    rem += NS_PER_DAY;
+    --days;
+  }
+  return dso::datetime<dso::nanoseconds>(
+      dso::modified_julian_day(ref.imjd().as_underlying_type() + days),
+      dso::nanoseconds(rem));
+}
+
+/* A batch result, along with the storage of its arrays */
+struct BatchStorage : sp3c_batch {
+  std::vector<double> values;
+  std::vector<int32_t> statuses;
+}; /* struct BatchStorage */
+} /* anonymous namespace */
+
+struct sp3c_product {
+  std::unique_ptr<dso::Sp3c> sp3;
+  /* null-terminated satellite ids, in the order of the header */
+  std::vector<dso::sp3::SatelliteId> svs;
+  std::vector<std::string> ids;
+  /* per satellite: NUM_COLUMNS columns of num_records values, and flags */
+  std::vector<std::vector<double>> columns;
+  std::vector<std::vector<uint32_t>> flags;
+  /* one per satellite, built off from the collected records */
+  std::vector<dso::SvInterpolator> intrps;
+  bool loaded{false};
+
+  /* index of satellite sv (exactly 3 characters), or -1 */
+  int find(const char *sv) const noexcept {
+    if (!sv || strnlen(sv, 4) != 3)
+      return -1;
+    const dso::sp3::SatelliteId id(sv);
+    for (std::size_t i = 0; i < svs.size(); i++)
+      if (svs[i] == id)
+        return i;
+    return -1;
+  }
+}; /* struct sp3c_product */
+
+int sp3c_api_version(void) { return SP3C_API_VERSION; }
+
+int sp3c_probe(const char *fn, sp3c_info *info) {
+  int error;
+  sp3c_product *p = sp3c_open(fn, &error);
+  if (!p)
+    return error;
+  error = sp3c_product_info(p, info);
+  sp3c_close(p);
+  return error;
+}
+
+sp3c_product *sp3c_open(const char *fn, int *error) {
+  if (error)
+    *error = 0;
+  if (!fn) {
+    if (error)
+      *error = 1;
+    return nullptr;
+  }
+  try {
+    auto p = std::make_unique<sp3c_product>();
+    p->sp3 = std::make_unique<dso::Sp3c>(fn);
+    p->svs = p->sp3->sattellite_vector();
+    for (const auto &sv : p->svs)
+      p->ids.emplace_back(sv.id, strnlen(sv.id, 3));
+    return p.release();
+  } catch (std::exception &e) {
+    fprintf(stderr, "[ERROR] Failed opening Sp3 file %s (traceback: %s)\n",
+            fn, __func__);
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+  }
+  if (error)
+    *error = 2;
+  return nullptr;
+}
+
+int sp3c_load(sp3c_product *p, double max_window_sec) {
+  if (!p)
+    return 1;
+  p->loaded = false;
+  try {
+    /* collect records, per satellite */
+    std::vector<std::vector<dso::Sp3DataBlock>> records(p->svs.size());
+    dso::Sp3Cursor cursor(*p->sp3);
+    dso::Sp3EpochBuffer buf;
+    int error;
+    while (!(error = cursor.get_next_epoch(buf))) {
+      for (int i = 0; i < buf.size(); i++) {
+        const int k = p->find(buf.sats[i].id);
+        if (k >= 0)
+          records[k].push_back(buf.blocks[i]);
+      }
+    }
+    if (error > 0) {
+      fprintf(stderr,
+              "[ERROR] Failed reading data blocks of Sp3 file %s (traceback: "
+              "%s)\n",
+              p->sp3->filename().c_str(), __func__);
+      return 2;
+    }
+
+    /* lay out columns */
+    const auto ref = p->sp3->start_epoch();
+    p->columns.assign(p->svs.size(), {});
+    p->flags.assign(p->svs.size(), {});
+    for (std::size_t s = 0; s < p->svs.size(); s++) {
+      const auto &r = records[s];
+      const std::size_t n = r.size();
+      auto &col = p->columns[s];
+      col.resize(NUM_COLUMNS * n);
+      p->flags[s].resize(n);
+      for (std::size_t i = 0; i < n; i++) {
+        col[i] = seconds_since(r[i].t, ref);
+        for (int c = 0; c < SP3C_NUM_STATE; c++) {
+          col[(1 + c) * n + i] = r[i].state[c];
+          col[(1 + SP3C_NUM_STATE + c) * n + i] = r[i].state_sdev[c];
+        }
+        p->flags[s][i] = r[i].flag.bits_;
+      }
+    }
+
+    /* interpolators, off from the records collected (the file is not read
+     * again)
+     */
+    const dso::milliseconds window(std::llround(max_window_sec * 1e3));
+    p->intrps.clear();
+    p->intrps.reserve(p->svs.size());
+    for (std::size_t s = 0; s < p->svs.size(); s++) {
+      p->intrps.emplace_back(p->svs[s]);
+      p->intrps.back().set_max_window(window);
+      if (!records[s].empty() &&
+          p->intrps.back().reload(p->svs[s], records[s].data(),
+                                  records[s].size(), p->sp3->interval()))
+        return 3;
+    }
+  } catch (std::exception &e) {
+    fprintf(stderr, "[ERROR] Failed loading Sp3 file %s (traceback: %s)\n",
+            p->sp3->filename().c_str(), __func__);
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+    return 4;
+  }
+  p->loaded = true;
+  return 0;
+}
+
+void sp3c_close(sp3c_product *p) { delete p; }
+
+int sp3c_product_info(const sp3c_product *p, sp3c_info *info) {
+  if (!p || !info)
+    return 1;
+  const auto ref = p->sp3->start_epoch();
+  info->ref_mjd = ref.imjd().as_underlying_type();
+  info->ref_nsec = ref.sec().as_underlying_type();
+  info->interval_sec = p->sp3->interval().as_underlying_type() * 1e-9;
+  info->num_epochs = p->sp3->num_epochs();
+  info->num_sats = p->svs.size();
+  std::snprintf(info->time_sys, sizeof info->time_sys, "%s",
+                p->sp3->time_sys());
+  return 0;
+}
+
+int sp3c_num_satellites(const sp3c_product *p) {
+  return p ? (int)p->svs.size() : 0;
+}
+
+const char *sp3c_satellite(const sp3c_product *p, int i) {
+  if (!p || i < 0 || i >= (int)p->ids.size())
+    return nullptr;
+  return p->ids[i].c_str();
+}
+
+int sp3c_columns_of(const sp3c_product *p, const char *sv,
+                    sp3c_columns *cols) {
+  if (!p || !cols)
+    return 1;
+  if (!p->loaded) {
+    fprintf(stderr, "[ERROR] Sp3 product not loaded (traceback: %s)\n",
+            __func__);
+    return 2;
+  }
+  const int k = p->find(sv);
+  if (k < 0)
+    return -1;
+  const int64_t n = p->flags[k].size();
+  const double *col = p->columns[k].data();
+  cols->num_records = n;
+  cols->time = col;
+  for (int c = 0; c < SP3C_NUM_STATE; c++) {
+    cols->state[c] = col + (1 + c) * n;
+    cols->sdev[c] = col + (1 + SP3C_NUM_STATE + c) * n;
+  }
+  cols->flags = p->flags[k].data();
+  return 0;
+}
+
+int sp3c_interpolate(sp3c_product *p, const char *sv, const double *t,
+                     int64_t n, double *pos, double *erpos, double *vel,
+                     double *ervel, int32_t *status, int64_t *num_failed) {
+  if (num_failed)
+    *num_failed = 0;
+  if (!p || n < 0 || (n > 0 && (!t || !pos || !erpos)))
+    return 1;
+  if (!p->loaded) {
+    fprintf(stderr, "[ERROR] Sp3 product not loaded (traceback: %s)\n",
+            __func__);
+    return 2;
+  }
+  const int k = p->find(sv);
+  if (k < 0)
+    return -1;
+
+  dso::SvInterpolator &intrp = p->intrps[k];
+  const auto ref = p->sp3->start_epoch();
+  const bool velocity = vel && ervel;
+  int64_t failed = 0;
+  for (int64_t i = 0; i < n; i++) {
+    const int error = intrp.interpolate_at(
+        epoch_at(ref, t[i]), pos + 3 * i, erpos + 3 * i,
+        velocity ? vel + 3 * i : nullptr, velocity ? ervel + 3 * i : nullptr);
+    if (status)
+      status[i] = error;
+    if (error)
+      ++failed;
+  }
+  if (num_failed)
+    *num_failed = failed;
+  return 0;
+}
+
+sp3c_batch *sp3c_interpolate_batch(sp3c_product *p, const char *sv,
+                                   const double *t, int64_t n,
+                                   int with_velocity) {
+  if (!p || !p->loaded || p->find(sv) < 0 || n < 0)
+    return nullptr;
+  try {
+    auto b = std::make_unique<BatchStorage>();
+    const int64_t arrays = with_velocity ? 4 : 2;
+    b->values.assign(arrays * 3 * n, 0e0);
+    b->statuses.assign(n, 0);
+    double *v = b->values.data();
+    b->size = n;
+    b->pos = v;
+    b->erpos = v + 3 * n;
+    b->vel = with_velocity ? v + 6 * n : nullptr;
+    b->ervel = with_velocity ? v + 9 * n : nullptr;
+    b->status = b->statuses.data();
+    if (sp3c_interpolate(p, sv, t, n, b->pos, b->erpos, b->vel, b->ervel,
+                         b->status, nullptr))
+      return nullptr;
+    return b.release();
+  } catch (std::exception &) {
+    return nullptr;
+  }
+}
+
+void sp3c_batch_free(sp3c_batch *b) {
+  delete static_cast<BatchStorage *>(b);
+}
@@ -0,0 +1,227 @@
+#include "sp3_cache.hpp"
+#include "core/sp3_time.hpp"
+
+using dso::sp3::NS_PER_DAY;
+
+namespace {
+/* Epoch as nanoseconds since MJD 0 (fits in 64 bits up to MJD ~106000) */
+int64_t ns_of(const dso::datetime<dso::nanoseconds> &t) noexcept {
+  return t.imjd().as_underlying_type() * NS_PER_DAY +
+         t.sec().as_underlying_type();
+}
+} /* anonymous namespace */
+
+int dso::Sp3ProductCache::add_product(const char *fn) noexcept {
+  try {
+    Sp3c sp3(fn);
+    add_product(fn, sp3.start_epoch(), sp3.stop_epoch());
+  } catch (std::exception &e) {
+    fprintf(stderr,
+            "[ERROR] Failed registering product %s (traceback: %s)\n", fn,
+            __func__);
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
+
+void dso::Sp3ProductCache::add_product(
+    const char *fn, const dso::datetime<dso::nanoseconds> &t_start,
+    const dso::datetime<dso::nanoseconds> &t_stop) {
+  auto p = std::make_unique<Product>();
+  p->fn = fn;
+  p->t_start = t_start;
+  p->t_stop = t_stop;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  max_span_ = std::max(max_span_, ns_of(t_stop) - ns_of(t_start));
+  /* keep products sorted on their start epochs */
+  auto it = std::upper_bound(
+      products_.begin(), products_.end(), t_start,
+      [](const dso::datetime<dso::nanoseconds> &t,
+         const std::unique_ptr<Product> &q) { return t < q->t_start; });
+  products_.insert(it, std::move(p));
+}
+
+int dso::Sp3ProductCache::num_products() const noexcept {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return products_.size();
+}
+
+dso::Sp3ProductCache::StorePtr dso::Sp3ProductCache::acquire(Product *p) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  if (p->store) {
+    ++stats_.hits;
+    lru_.splice(lru_.begin(), lru_, p->lru_pos);
+    return p->store;
+  }
+  if (p->loading.valid()) {
+    /* being loaded by another thread; wait for it */
+    ++stats_.waits;
+    auto f = p->loading;
+    lock.unlock();
+    return f.get();
+  }
+  if (p->failed &&
+      std::chrono::steady_clock::now() - p->failed_at < retry_interval_) {
+    ++stats_.skipped;
+    return nullptr;
+  }
+
+  ++stats_.misses;
+  std::promise<StorePtr> promise;
+  p->loading = promise.get_future().share();
+  lock.unlock();
+
+  StorePtr store;
+  try {
+    Sp3c sp3(p->fn.c_str());
+    auto s = std::make_shared<Sp3OrbitStore>();
+    if (s->load(sp3) > 0) {
+      fprintf(stderr, "[ERROR] Failed loading product %s (traceback: %s)\n",
+              p->fn.c_str(), __func__);
+    } else {
+      store = std::move(s);
+    }
+  } catch (std::exception &e) {
+    fprintf(stderr, "[ERROR] Failed opening product %s (traceback: %s)\n",
+            p->fn.c_str(), __func__);
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+  }
+
+  lock.lock();
+  p->loading = std::shared_future<StorePtr>();
+  p->failed = !store;
+  if (!store) {
+    p->failed_at = std::chrono::steady_clock::now();
+    ++stats_.failures;
+  } else {
+    p->store = store;
+    lru_.push_front(p);
+    p->lru_pos = lru_.begin();
+    stats_.memory_bytes += store->memory_bytes();
+    ++stats_.num_loaded;
+    evict(p);
+  }
+  lock.unlock();
+
+  promise.set_value(store);
+  return store;
+}
+
+void dso::Sp3ProductCache::evict(const Product *keep) noexcept {
+  while (stats_.memory_bytes > budget_ && !lru_.empty() &&
+         lru_.back() != keep) {
+    Product *p = lru_.back();
+    lru_.pop_back();
+    stats_.memory_bytes -= p->store->memory_bytes();
+    p->store.reset();
+    --stats_.num_loaded;
+    ++stats_.evictions;
+  }
+}
+
+int dso::Sp3ProductCache::stores(const dso::datetime<dso::nanoseconds> &t0,
+                                 const dso::datetime<dso::nanoseconds> &t1,
+                                 std::vector<StorePtr> &out) {
+  out.clear();
+
+  /* products overlapping [t0, t1] */
+  std::vector<Product *> overlapping;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    const int64_t ns0 = ns_of(t0);
+    /* products starting before t0 - max_span cannot reach t0 */
+    auto it = std::lower_bound(
+        products_.begin(), products_.end(), ns0 - max_span_,
+        [](const std::unique_ptr<Product> &q, int64_t ns) {
+          return ns_of(q->t_start) < ns;
+        });
+    for (; it != products_.end() && (*it)->t_start <= t1; ++it)
+      if ((*it)->t_stop >= t0)
+        overlapping.push_back(it->get());
+  }
+
+  if (overlapping.empty())
+    return -1;
+
+  int error = 0;
+  for (Product *p : overlapping) {
+    if (StorePtr s = acquire(p); s)
+      out.push_back(std::move(s));
+    else
+      error = 1;
+  }
+
+  return error;
+}
+
+int dso::Sp3ProductCache::collect(const sp3::SatelliteId &sv,
+                                  const dso::datetime<dso::nanoseconds> &t0,
+                                  const dso::datetime<dso::nanoseconds> &t1,
+                                  std::vector<Sp3DataBlock> &out,
+                                  dso::nanoseconds &interval) {
+  out.clear();
+  std::vector<StorePtr> products;
+  if (const int error = stores(t0, t1, products); error)
+    return error;
+
+  interval = products.front()->interval();
+  std::vector<Sp3DataBlock> records, merged;
+  for (const auto &store : products) {
+    if (store->range(sv, t0, t1, records) || records.empty())
+      continue;
+    /* merge on epochs; records of previous products win */
+    merged.clear();
+    merged.reserve(out.size() + records.size());
+    auto a = out.cbegin(), b = records.cbegin();
+    while (a != out.cend() || b != records.cend()) {
+      if (b == records.cend() || (a != out.cend() && a->t <= b->t)) {
+        if (b != records.cend() && a->t == b->t)
+          ++b;
+        merged.push_back(*a++);
+      } else {
+        merged.push_back(*b++);
+      }
+    }
+    out.swap(merged);
+  }
+
+  return out.empty() ? -1 : 0;
+}
+
+int dso::Sp3ProductCache::range(const sp3::SatelliteId &sv,
+                                const dso::datetime<dso::nanoseconds> &t0,
+                                const dso::datetime<dso::nanoseconds> &t1,
+                                std::vector<Sp3DataBlock> &out) {
+  dso::nanoseconds interval(0);
+  return collect(sv, t0, t1, out, interval);
+}
+
+int dso::Sp3ProductCache::load_interpolator(
+    const sp3::SatelliteId &sv, const dso::datetime<dso::nanoseconds> &t0,
+    const dso::datetime<dso::nanoseconds> &t1, SvInterpolator &intrp,
+    std::vector<Sp3DataBlock> &scratch) {
+  dso::nanoseconds interval(0);
+  if (const int error = collect(sv, t0, t1, scratch, interval); error)
+    return error;
+  return intrp.reload(sv, scratch.data(), scratch.size(), interval);
+}
+
+void dso::Sp3ProductCache::set_retry_interval(
+    dso::milliseconds interval) noexcept {
+  std::lock_guard<std::mutex> lock(mtx_);
+  retry_interval_ = std::chrono::milliseconds(interval.as_underlying_type());
+}
+
+void dso::Sp3ProductCache::set_memory_budget(
+    std::size_t memory_budget) noexcept {
+  std::lock_guard<std::mutex> lock(mtx_);
+  budget_ = memory_budget;
+  evict(nullptr);
+}
+
+dso::Sp3CacheStats dso::Sp3ProductCache::stats() const noexcept {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return stats_;
+}
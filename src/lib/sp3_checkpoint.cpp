@@ -0,0 +1,128 @@
+#include "sp3_checkpoint.hpp"
+#include "core/sp3_pod_io.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+using dso::sp3::read_pod;
+using dso::sp3::write_pod;
+
+namespace {
+/* Checkpoint file identifier and format version; as of version 2, the
+ * fingerprint's mtime is in nsec since the Unix epoch
+ */
+constexpr char CHECKPOINT_MAGIC[4] = {'S', 'P', '3', 'K'};
+constexpr uint32_t CHECKPOINT_VERSION{2};
+
+/* Max length of filenames recorded */
+constexpr uint32_t MAX_FILENAME_CHARS{4096};
+} /* anonymous namespace */
+
+int dso::save_checkpoints(const char *fn,
+                          const std::vector<Sp3Checkpoint> &cps) noexcept {
+  std::string tmp;
+  try {
+    tmp = std::string(fn) + ".tmp" + std::to_string(getpid());
+  } catch (std::exception &) {
+    return 1;
+  }
+
+  std::ofstream fout(tmp, std::ios::binary | std::ios::trunc);
+  if (!fout.is_open()) {
+    fprintf(stderr,
+            "[ERROR] Failed to open checkpoint file %s for writing (traceback: "
+            "%s)\n",
+            tmp.c_str(), __func__);
+    return 2;
+  }
+
+  fout.write(CHECKPOINT_MAGIC, sizeof CHECKPOINT_MAGIC);
+  write_pod(fout, CHECKPOINT_VERSION);
+  write_pod(fout, static_cast<uint64_t>(cps.size()));
+  for (const auto &cp : cps) {
+    write_pod(fout, static_cast<uint32_t>(cp.fn.size()));
+    fout.write(cp.fn.data(), cp.fn.size());
+    write_pod(fout, cp.fingerprint.size);
+    write_pod(fout, cp.fingerprint.mtime);
+    write_pod(fout, cp.fingerprint.hash);
+    fout.write(cp.sv.id, sp3::SAT_ID_CHARS);
+    write_pod(fout, cp.offset);
+    write_pod(fout, static_cast<int64_t>(cp.epoch.imjd().as_underlying_type()));
+    write_pod(fout, static_cast<int64_t>(cp.epoch.sec().as_underlying_type()));
+    write_pod(fout, cp.last_index);
+  }
+  fout.close();
+
+  std::error_code ec;
+  if (!fout.good() || (std::filesystem::rename(tmp, fn, ec), ec)) {
+    fprintf(stderr,
+            "[ERROR] Failed to write checkpoint file %s (traceback: %s)\n", fn,
+            __func__);
+    std::filesystem::remove(tmp, ec);
+    return 3;
+  }
+  return 0;
+}
+
+int dso::load_checkpoints(const char *fn,
+                          std::vector<Sp3Checkpoint> &cps) noexcept {
+  cps.clear();
+  std::ifstream fin(fn, std::ios::binary);
+  if (!fin.is_open())
+    return -1;
+
+  char magic[sizeof CHECKPOINT_MAGIC];
+  uint32_t version = 0;
+  uint64_t count = 0;
+  fin.read(magic, sizeof magic);
+  read_pod(fin, version);
+  read_pod(fin, count);
+  if (!fin.good() || std::memcmp(magic, CHECKPOINT_MAGIC, sizeof magic) ||
+      version != CHECKPOINT_VERSION) {
+    fprintf(stderr,
+            "[ERROR] Invalid checkpoint file %s (traceback: %s)\n", fn,
+            __func__);
+    return 1;
+  }
+
+  try {
+    for (uint64_t i = 0; i < count && fin.good(); i++) {
+      Sp3Checkpoint cp;
+      uint32_t len = 0;
+      read_pod(fin, len);
+      if (len > MAX_FILENAME_CHARS)
+        break;
+      cp.fn.resize(len);
+      fin.read(cp.fn.data(), len);
+      read_pod(fin, cp.fingerprint.size);
+      read_pod(fin, cp.fingerprint.mtime);
+      read_pod(fin, cp.fingerprint.hash);
+      char id[sp3::SAT_ID_CHARS + 1] = {'\0'};
+      fin.read(id, sp3::SAT_ID_CHARS);
+      cp.sv = sp3::SatelliteId(id);
+      int64_t mjd = 0, nsec = 0;
+      read_pod(fin, cp.offset);
+      read_pod(fin, mjd);
+      read_pod(fin, nsec);
+      read_pod(fin, cp.last_index);
+      cp.epoch = dso::datetime<dso::nanoseconds>(dso::modified_julian_day(mjd),
+                                                 dso::nanoseconds(nsec));
+      cps.push_back(std::move(cp));
+    }
+  } catch (std::exception &) {
+    cps.clear();
+    return 1;
+  }
+
+  if (!fin.good() || cps.size() != count) {
+    fprintf(stderr,
+            "[ERROR] Failed reading (corrupt?) checkpoint file %s (traceback: "
+            "%s)\n",
+            fn, __func__);
+    cps.clear();
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,193 @@
+#include "sp3_client.hpp"
+#include "core/sp3_wire.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int dso::sp3::wire::read_all(int fd, void *buf, std::size_t count) noexcept {
+  char *p = static_cast<char *>(buf);
+  while (count) {
+    const ssize_t n = ::recv(fd, p, count, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return 1;
+    if (n == 0)
+      return -1;
+    p += n;
+    count -= n;
+  }
+  return 0;
+}
+
+int dso::sp3::wire::write_all(int fd, const void *buf,
+                              std::size_t count) noexcept {
+  const char *p = static_cast<const char *>(buf);
+  while (count) {
+    const ssize_t n = ::send(fd, p, count, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 1;
+    p += n;
+    count -= n;
+  }
+  return 0;
+}
+
+dso::Sp3Client::Sp3Client(const char *socket_path) {
+  if (!socket_path)
+    socket_path = sp3::wire::DEFAULT_SOCKET;
+
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  if (std::strlen(socket_path) >= sizeof addr.sun_path) {
+    fprintf(stderr, "[ERROR] Socket path %s is too long (traceback: %s)\n",
+            socket_path, __func__);
+    throw std::runtime_error("[ERROR] Invalid socket path\n");
+  }
+  std::strcpy(addr.sun_path, socket_path);
+
+  if ((fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+    fprintf(stderr, "[ERROR] Failed creating socket (traceback: %s)\n",
+            __func__);
+    throw std::runtime_error("[ERROR] Failed creating socket\n");
+  }
+  if (::connect(fd_, reinterpret_cast<struct sockaddr *>(&addr),
+                sizeof addr)) {
+    fprintf(stderr,
+            "[ERROR] Failed connecting to %s: %s (traceback: %s)\n",
+            socket_path, std::strerror(errno), __func__);
+    ::close(fd_);
+    fd_ = -1;
+    throw std::runtime_error("[ERROR] Failed connecting to daemon\n");
+  }
+}
+
+dso::Sp3Client::~Sp3Client() noexcept {
+  if (fd_ >= 0)
+    ::close(fd_);
+}
+
+int dso::Sp3Client::round_trip(int op, int flags, int count) noexcept {
+  using namespace sp3::wire;
+
+  RequestHeader *hdr = reinterpret_cast<RequestHeader *>(req_.data());
+  hdr->magic = REQUEST_MAGIC;
+  hdr->version = VERSION;
+  hdr->op = op;
+  hdr->flags = flags;
+  hdr->reserved = 0;
+  hdr->count = count;
+  const std::size_t item_size =
+      (op == OP_INTERPOLATE) ? sizeof(InterpolationQuery) : 0;
+  if (write_all(fd_, req_.data(), sizeof(RequestHeader) + count * item_size)) {
+    fprintf(stderr, "[ERROR] Failed sending request (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+
+  ResponseHeader rhdr;
+  if (read_all(fd_, &rhdr, sizeof rhdr)) {
+    fprintf(stderr, "[ERROR] Failed receiving response (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+  if (rhdr.magic != RESPONSE_MAGIC || rhdr.version != VERSION) {
+    fprintf(stderr, "[ERROR] Invalid response (traceback: %s)\n", __func__);
+    return 1;
+  }
+  if (rhdr.status != STATUS_OK)
+    return 2;
+  if (rhdr.count != (uint32_t)(item_size ? count : 0)) {
+    fprintf(stderr, "[ERROR] Invalid response count (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+
+  const std::size_t bytes =
+      item_size ? count * sizeof(InterpolationResult) : 0;
+  try {
+    resp_.resize(bytes);
+  } catch (std::exception &) {
+    return 1;
+  }
+  if (bytes && read_all(fd_, resp_.data(), bytes)) {
+    fprintf(stderr, "[ERROR] Failed receiving response (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+  return 0;
+}
+
+int dso::Sp3Client::interpolate(const Sp3ClientQuery *queries, int count,
+                                Sp3ClientResult *results,
+                                bool velocity) noexcept {
+  using namespace sp3::wire;
+
+  if (count < 0 || (uint32_t)count > MAX_ITEMS) {
+    fprintf(stderr,
+            "[ERROR] Invalid number of queries in request (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+
+  try {
+    req_.resize(sizeof(RequestHeader) + count * sizeof(InterpolationQuery));
+  } catch (std::exception &) {
+    return 1;
+  }
+  auto *q = reinterpret_cast<InterpolationQuery *>(req_.data() +
+                                                   sizeof(RequestHeader));
+  for (int i = 0; i < count; i++) {
+    std::memcpy(q[i].sv, queries[i].sv.id, sizeof q[i].sv);
+    q[i].reserved = 0;
+    q[i].mjd = queries[i].t.imjd().as_underlying_type();
+    q[i].nsec = queries[i].t.sec().as_underlying_type();
+  }
+
+  if (int error = round_trip(OP_INTERPOLATE, velocity ? FLAG_VELOCITY : 0,
+                             count))
+    return error;
+
+  const auto *r = reinterpret_cast<const InterpolationResult *>(resp_.data());
+  for (int i = 0; i < count; i++) {
+    results[i].status = r[i].status;
+    std::memcpy(results[i].pos, r[i].pos, sizeof r[i].pos);
+    std::memcpy(results[i].erpos, r[i].erpos, sizeof r[i].erpos);
+    std::memcpy(results[i].vel, r[i].vel, sizeof r[i].vel);
+    std::memcpy(results[i].ervel, r[i].ervel, sizeof r[i].ervel);
+  }
+  return 0;
+}
+
+int dso::Sp3Client::interpolate_at(const sp3::SatelliteId &sv,
+                                   const dso::datetime<dso::nanoseconds> &t,
+                                   double *pos, double *erpos, double *vel,
+                                   double *ervel) noexcept {
+  const Sp3ClientQuery q{sv, t};
+  Sp3ClientResult r;
+  if (int error = interpolate(&q, 1, &r, vel && ervel))
+    return error;
+  std::memcpy(pos, r.pos, sizeof r.pos);
+  std::memcpy(erpos, r.erpos, sizeof r.erpos);
+  if (vel)
+    std::memcpy(vel, r.vel, sizeof r.vel);
+  if (ervel)
+    std::memcpy(ervel, r.ervel, sizeof r.ervel);
+  return r.status;
+}
+
+int dso::Sp3Client::ping() noexcept {
+  using namespace sp3::wire;
+  try {
+    req_.resize(sizeof(RequestHeader));
+  } catch (std::exception &) {
+    return 1;
+  }
+  return round_trip(OP_PING, 0, 0);
+}
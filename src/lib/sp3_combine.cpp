@@ -0,0 +1,515 @@
+#include "sp3_combine.hpp"
+#include "core/sp3_helmert.hpp"
+#include "sp3_writer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+/* Lower bounds of centre RMS, so that weights stay finite [m] and [ns] */
+constexpr double MIN_RMS_POS{1e-4};
+constexpr double MIN_RMS_CLK{1e-3};
+/* Initial centre RMS, i.e. equal weights on the first iteration */
+constexpr double INITIAL_RMS_POS{1e0};
+constexpr double INITIAL_RMS_CLK{1e0};
+/* Max number of centres for a median (initial) combination */
+constexpr int MAX_CENTRES_MEDIAN = 64;
+/* Min number of records to estimate Helmert parameters */
+constexpr int HELMERT_MIN_RECORDS = 4;
+
+/* Bits of Obs/Comb */
+constexpr uint8_t HAS_POS = 1;
+constexpr uint8_t HAS_CLK = 2;
+constexpr uint8_t POS_OUTLIER = 4;
+constexpr uint8_t CLK_OUTLIER = 8;
+constexpr uint8_t MANEUVER = 16;
+
+/* A record of a centre (or the combination), in [m] and [ns]; s holds the
+ * std. deviations (0 if not given)
+ */
+struct Obs {
+  double x[4];
+  double s[4];
+  uint8_t bits{0};
+}; /* struct Obs */
+
+/* Per-centre sums, collected over (a chunk of) epochs */
+struct CentreSums {
+  dso::sp3::HelmertNormals ne;
+  double ss_pos{0e0}, ss_clk{0e0};
+  long n_pos{0}, n_clk{0}, n_out{0};
+}; /* struct CentreSums */
+
+/* Per-centre state of the iterations */
+struct Centre {
+  /* Helmert parameters (see HelmertNormals); set if ever estimated */
+  double p[7] = {};
+  bool has_p{false};
+  double rms_pos{INITIAL_RMS_POS};
+  double rms_clk{INITIAL_RMS_CLK};
+  CentreSums sums;
+}; /* struct Centre */
+
+int sv_key(const dso::sp3::SatelliteId &sv) noexcept {
+  return ((unsigned char)sv.id[0] << 16) | ((unsigned char)sv.id[1] << 8) |
+         (unsigned char)sv.id[2];
+}
+
+void fill(Obs &o, const dso::Sp3DataBlock &b) noexcept {
+  using dso::Sp3Event;
+  o.bits = 0;
+  if (!b.flag.is_set(Sp3Event::bad_abscent_position)) {
+    o.bits |= HAS_POS;
+    const bool sdev = b.flag.is_set(Sp3Event::has_pos_stddev);
+    for (int k = 0; k < 3; k++) {
+      o.x[k] = b.state[k] * 1e3;
+      o.s[k] = sdev ? b.state_sdev[k] * 1e-3 : 0e0;
+    }
+  }
+  if (!b.flag.is_set(Sp3Event::bad_abscent_clock)) {
+    o.bits |= HAS_CLK;
+    o.x[3] = b.state[3] * 1e3;
+    o.s[3] =
+        b.flag.is_set(Sp3Event::has_clk_stddev) ? b.state_sdev[3] * 1e-3 : 0e0;
+  }
+  if (b.flag.is_set(Sp3Event::maneuver))
+    o.bits |= MANEUVER;
+}
+
+/* Combine the clocks of an epoch, given the centres' clock offsets */
+void combine_clocks(const Obs *row, Obs *comb, const double *offset,
+                    const std::vector<Centre> &centres, int nsv,
+                    bool use_sdev) noexcept {
+  const int nc = centres.size();
+  for (int s = 0; s < nsv; s++) {
+    double wsum = 0e0, xsum = 0e0;
+    for (int c = 0; c < nc; c++) {
+      const Obs &o = row[c * nsv + s];
+      if ((o.bits & HAS_CLK) && !(o.bits & CLK_OUTLIER)) {
+        const double var = centres[c].rms_clk * centres[c].rms_clk +
+                           (use_sdev ? o.s[3] * o.s[3] : 0e0);
+        wsum += 1e0 / var;
+        xsum += (o.x[3] - offset[c]) / var;
+      }
+    }
+    if (wsum > 0e0) {
+      comb[s].bits |= HAS_CLK;
+      comb[s].x[3] = xsum / wsum;
+      comb[s].s[3] = std::sqrt(1e0 / wsum);
+    } else {
+      comb[s].bits &= ~HAS_CLK;
+    }
+  }
+}
+
+/* Combine the records of an epoch; the centres' clock offsets are
+ * (re-)estimated along the way
+ */
+void combine_epoch(const Obs *row, Obs *comb, double *offset,
+                   const std::vector<Centre> &centres, int nsv, bool first,
+                   bool use_sdev) noexcept {
+  const int nc = centres.size();
+
+  /* positions; the first time around, take the (per component) median of
+   * the centres, so that outliers do not spoil the initial residuals
+   */
+  double vals[3][MAX_CENTRES_MEDIAN];
+  for (int s = 0; s < nsv; s++) {
+    double wsum[3] = {}, xsum[3] = {}, dx[3];
+    comb[s].bits = 0;
+    if (first && nc <= MAX_CENTRES_MEDIAN) {
+      int n = 0;
+      for (int c = 0; c < nc; c++) {
+        const Obs &o = row[c * nsv + s];
+        if (o.bits & HAS_POS) {
+          for (int k = 0; k < 3; k++)
+            vals[k][n] = o.x[k];
+          comb[s].bits |= (HAS_POS | (o.bits & MANEUVER));
+          ++n;
+        }
+      }
+      for (int k = 0; n && k < 3; k++) {
+        std::sort(vals[k], vals[k] + n);
+        comb[s].x[k] = (n % 2) ? vals[k][n / 2]
+                               : (vals[k][n / 2 - 1] + vals[k][n / 2]) / 2e0;
+        comb[s].s[k] = 0e0;
+      }
+      continue;
+    }
+    for (int c = 0; c < nc; c++) {
+      const Obs &o = row[c * nsv + s];
+      if (!(o.bits & HAS_POS) || (o.bits & POS_OUTLIER))
+        continue;
+      dso::sp3::HelmertNormals::apply(centres[c].p, o.x, dx);
+      for (int k = 0; k < 3; k++) {
+        const double var = centres[c].rms_pos * centres[c].rms_pos +
+                           (use_sdev ? o.s[k] * o.s[k] : 0e0);
+        wsum[k] += 1e0 / var;
+        xsum[k] += (o.x[k] - dx[k]) / var;
+      }
+      comb[s].bits |= (HAS_POS | (o.bits & MANEUVER));
+    }
+    if (comb[s].bits & HAS_POS) {
+      for (int k = 0; k < 3; k++) {
+        comb[s].x[k] = xsum[k] / wsum[k];
+        comb[s].s[k] = std::sqrt(1e0 / wsum[k]);
+      }
+    }
+  }
+
+  /* clock datum: that of the first centre with clocks at this epoch */
+  int ref = -1;
+  for (int c = 0; c < nc && ref < 0; c++)
+    for (int s = 0; s < nsv; s++)
+      if (row[c * nsv + s].bits & HAS_CLK) {
+        ref = c;
+        break;
+      }
+  if (ref < 0)
+    return;
+
+  /* initial offsets, w.r.t. the reference centre */
+  if (first) {
+    for (int c = 0; c < nc; c++) {
+      double sum = 0e0;
+      int count = 0;
+      for (int s = 0; s < nsv; s++) {
+        const Obs &o = row[c * nsv + s];
+        const Obs &r = row[ref * nsv + s];
+        if ((o.bits & HAS_CLK) && (r.bits & HAS_CLK)) {
+          sum += o.x[3] - r.x[3];
+          ++count;
+        }
+      }
+      offset[c] = count ? sum / count : 0e0;
+    }
+  }
+
+  /* combine, re-estimate offsets w.r.t. the combination and combine again */
+  combine_clocks(row, comb, offset, centres, nsv, use_sdev);
+  for (int c = 0; c < nc; c++) {
+    double sum = 0e0;
+    int count = 0;
+    for (int s = 0; s < nsv; s++) {
+      const Obs &o = row[c * nsv + s];
+      if ((o.bits & HAS_CLK) && !(o.bits & CLK_OUTLIER) &&
+          (comb[s].bits & HAS_CLK)) {
+        sum += o.x[3] - comb[s].x[3];
+        ++count;
+      }
+    }
+    if (count)
+      offset[c] = sum / count;
+  }
+  const double datum = offset[ref];
+  for (int c = 0; c < nc; c++)
+    offset[c] -= datum;
+  combine_clocks(row, comb, offset, centres, nsv, use_sdev);
+}
+
+/* Residuals of an epoch's records w.r.t. the combination; outliers (i.e.
+ * residuals larger than factor times the record's sigma, as used for
+ * weighting) are flagged if reject is set, and sums are collected for the
+ * rest
+ */
+void residuals(Obs *row, const Obs *comb, const double *offset,
+               const std::vector<Centre> &centres, int nsv, bool reject,
+               double factor, bool use_sdev,
+               std::vector<CentreSums> &sums) noexcept {
+  const int nc = centres.size();
+  for (int c = 0; c < nc; c++) {
+    const Centre &ctr = centres[c];
+    for (int s = 0; s < nsv; s++) {
+      Obs &o = row[c * nsv + s];
+      if (!(comb[s].bits & HAS_POS))
+        o.bits &= ~POS_OUTLIER;
+      if (!(comb[s].bits & HAS_CLK))
+        o.bits &= ~CLK_OUTLIER;
+      if ((o.bits & HAS_POS) && (comb[s].bits & HAS_POS)) {
+        double d[3], dx[3], r[3];
+        dso::sp3::HelmertNormals::apply(ctr.p, comb[s].x, dx);
+        bool out = false;
+        for (int k = 0; k < 3; k++) {
+          d[k] = o.x[k] - comb[s].x[k];
+          r[k] = d[k] - dx[k];
+          const double var = ctr.rms_pos * ctr.rms_pos +
+                             (use_sdev ? o.s[k] * o.s[k] : 0e0);
+          out = out || r[k] * r[k] > factor * factor * var;
+        }
+        if (reject && out) {
+          o.bits |= POS_OUTLIER;
+          ++sums[c].n_out;
+        } else {
+          o.bits &= ~POS_OUTLIER;
+          sums[c].ne.add(comb[s].x, d);
+          sums[c].ss_pos += r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+          ++sums[c].n_pos;
+        }
+      }
+      if ((o.bits & HAS_CLK) && (comb[s].bits & HAS_CLK)) {
+        const double r = o.x[3] - offset[c] - comb[s].x[3];
+        const double var =
+            ctr.rms_clk * ctr.rms_clk + (use_sdev ? o.s[3] * o.s[3] : 0e0);
+        if (reject && r * r > factor * factor * var) {
+          o.bits |= CLK_OUTLIER;
+        } else {
+          o.bits &= ~CLK_OUTLIER;
+          sums[c].ss_clk += r * r;
+          ++sums[c].n_clk;
+        }
+      }
+    }
+  }
+}
+
+/* Transformations of the centres w.r.t. the combination are defined up to
+ * a common one (added to all centres and removed from the combination).
+ * Fix the datum by constraining their weighted (by position weights) sum
+ * to zero, i.e. no net translation, rotation or scale; the frame of the
+ * combination is then the weighted mean of the centres' frames. If any
+ * centre has no transformation (too few records), its frame fixes the
+ * datum and nothing is done.
+ */
+void helmert_datum(std::vector<Centre> &centres) noexcept {
+  double mean[7] = {}, wsum = 0e0;
+  for (const auto &ctr : centres) {
+    if (!ctr.has_p)
+      return;
+    const double w = 1e0 / (ctr.rms_pos * ctr.rms_pos);
+    for (int j = 0; j < 7; j++)
+      mean[j] += w * ctr.p[j];
+    wsum += w;
+  }
+  for (auto &ctr : centres)
+    for (int j = 0; j < 7; j++)
+      ctr.p[j] -= mean[j] / wsum;
+}
+} /* anonymous namespace */
+
+int dso::sp3::combine(const std::vector<const Sp3c *> &sources,
+                      const char *out, Sp3CombinationReport *report,
+                      const Sp3CombineOptions &opts, Executor *ex) {
+  const int nc = sources.size();
+  if (!nc)
+    return -1;
+
+  /* union of satellites */
+  std::vector<sp3::SatelliteId> svs;
+  std::unordered_map<int, int> sv_index;
+  for (const auto *sp3 : sources)
+    for (const auto &sv : sp3->sattellite_vector())
+      if (sv_index.emplace(sv_key(sv), (int)svs.size()).second)
+        svs.push_back(sv);
+  const int nsv = svs.size();
+
+  /* read all sources; records are stored per epoch, centre and satellite.
+   * Epochs are those of the first source.
+   */
+  std::vector<dso::datetime<dso::nanoseconds>> ts;
+  std::vector<Obs> obs;
+  for (int c = 0; c < nc; c++) {
+    Sp3Cursor cursor(*sources[c]);
+    Sp3EpochBuffer buf;
+    std::size_t e = 0;
+    int error;
+    while (!(error = cursor.get_next_epoch(buf))) {
+      if (!c) {
+        ts.push_back(buf.t);
+        obs.resize(ts.size() * nc * nsv);
+        e = ts.size() - 1;
+      } else {
+        while (e < ts.size() && ts[e] < buf.t)
+          ++e;
+        if (e == ts.size())
+          break;
+        if (ts[e] != buf.t)
+          continue;
+      }
+      Obs *row = obs.data() + (e * nc + c) * nsv;
+      for (int i = 0; i < buf.size(); i++) {
+        const auto it = sv_index.find(sv_key(buf.sats[i]));
+        if (it != sv_index.end())
+          fill(row[it->second], buf.blocks[i]);
+      }
+    }
+    if (error > 0) {
+      fprintf(stderr,
+              "[ERROR] Failed reading data block of Sp3 file %s (traceback: "
+              "%s)\n",
+              sources[c]->filename().c_str(), __func__);
+      return error;
+    }
+  }
+  const int nep = ts.size();
+  if (!nep)
+    return -1;
+
+  /* iterate: combine, compute residuals and update weights/parameters */
+  std::vector<Centre> centres(nc);
+  std::vector<Obs> comb((std::size_t)nep * nsv);
+  std::vector<double> offsets((std::size_t)nep * nc, 0e0);
+  std::mutex mtx;
+  int iter = 0;
+  while (iter < opts.max_iterations) {
+    const bool first = (iter == 0);
+    for (auto &ctr : centres)
+      ctr.sums = CentreSums();
+
+    sp3::parallel_for_chunks(
+        0, nep,
+        [&](int b, int e) {
+          std::vector<CentreSums> sums(nc);
+          for (int i = b; i < e; i++) {
+            Obs *row = obs.data() + (std::size_t)i * nc * nsv;
+            Obs *cr = comb.data() + (std::size_t)i * nsv;
+            double *off = offsets.data() + (std::size_t)i * nc;
+            combine_epoch(row, cr, off, centres, nsv, first, opts.use_sdev);
+            residuals(row, cr, off, centres, nsv, !first, opts.outlier_factor,
+                      opts.use_sdev, sums);
+          }
+          std::lock_guard<std::mutex> lock(mtx);
+          for (int c = 0; c < nc; c++) {
+            CentreSums &cs = centres[c].sums;
+            cs.ne.add(sums[c].ne);
+            cs.ss_pos += sums[c].ss_pos;
+            cs.ss_clk += sums[c].ss_clk;
+            cs.n_pos += sums[c].n_pos;
+            cs.n_clk += sums[c].n_clk;
+            cs.n_out += sums[c].n_out;
+          }
+        },
+        ex);
+    ++iter;
+
+    /* new weights and transformations */
+    double change = 0e0;
+    for (auto &ctr : centres) {
+      const CentreSums &cs = ctr.sums;
+      if (cs.n_pos) {
+        const double rms =
+            std::max(MIN_RMS_POS, std::sqrt(cs.ss_pos / (3 * cs.n_pos)));
+        change = std::max(change, std::abs(rms - ctr.rms_pos) / ctr.rms_pos);
+        ctr.rms_pos = rms;
+      }
+      if (cs.n_clk) {
+        const double rms =
+            std::max(MIN_RMS_CLK, std::sqrt(cs.ss_clk / cs.n_clk));
+        change = std::max(change, std::abs(rms - ctr.rms_clk) / ctr.rms_clk);
+        ctr.rms_clk = rms;
+      }
+      if (opts.helmert && cs.ne.count >= HELMERT_MIN_RECORDS) {
+        double p[7];
+        if (!cs.ne.solve(p)) {
+          std::memcpy(ctr.p, p, sizeof p);
+          ctr.has_p = true;
+        }
+      }
+    }
+    if (opts.helmert)
+      helmert_datum(centres);
+    if (!first && change < opts.tolerance)
+      break;
+  }
+
+  /* write the combined product */
+  Sp3Header hdr = Sp3Header::from(*sources[0]);
+  hdr.satellites = svs;
+  hdr.has_velocities = false;
+  hdr.start_epoch = ts[0];
+  hdr.agency = opts.agency;
+  hdr.comments = opts.comments;
+  const std::string tmp = std::string(out) + ".tmp";
+  int error = 0;
+  try {
+    Sp3Writer writer(tmp.c_str(), hdr);
+    Sp3EpochBuffer buf;
+    for (int e = 0; e < nep && !error; e++) {
+      buf.clear();
+      buf.t = ts[e];
+      for (int s = 0; s < nsv; s++) {
+        const Obs &o = comb[(std::size_t)e * nsv + s];
+        if (!(o.bits & (HAS_POS | HAS_CLK)))
+          continue;
+        Sp3DataBlock b;
+        b.t = ts[e];
+        std::memset(b.state, 0, sizeof b.state);
+        std::memset(b.state_sdev, 0, sizeof b.state_sdev);
+        if (o.bits & HAS_POS) {
+          for (int k = 0; k < 3; k++) {
+            b.state[k] = o.x[k] * 1e-3;
+            b.state_sdev[k] = o.s[k] * 1e3;
+          }
+          b.flag.set(Sp3Event::has_pos_stddev);
+        } else {
+          b.flag.set(Sp3Event::bad_abscent_position);
+        }
+        if (o.bits & HAS_CLK) {
+          b.state[3] = o.x[3] * 1e-3;
+          b.state_sdev[3] = o.s[3] * 1e3;
+          b.flag.set(Sp3Event::has_clk_stddev);
+        } else {
+          b.flag.set(Sp3Event::bad_abscent_clock);
+        }
+        if (o.bits & MANEUVER)
+          b.flag.set(Sp3Event::maneuver);
+        buf.sats.push_back(svs[s]);
+        buf.blocks.push_back(b);
+      }
+      error = writer.write_epoch(buf);
+    }
+    error = writer.close() || error;
+  } catch (std::exception &e) {
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+    error = 2;
+  }
+  if (!error && std::rename(tmp.c_str(), out)) {
+    fprintf(stderr, "[ERROR] Failed renaming %s to %s (traceback: %s)\n",
+            tmp.c_str(), out, __func__);
+    error = 3;
+  }
+  if (error) {
+    fprintf(stderr,
+            "[ERROR] Failed writing combined Sp3 product %s (traceback: %s)\n",
+            out, __func__);
+    std::remove(tmp.c_str());
+    return error;
+  }
+
+  if (report) {
+    *report = Sp3CombinationReport();
+    double wpos = 0e0, wclk = 0e0;
+    for (const auto &ctr : centres) {
+      wpos += 1e0 / (ctr.rms_pos * ctr.rms_pos);
+      wclk += 1e0 / (ctr.rms_clk * ctr.rms_clk);
+    }
+    for (int c = 0; c < nc; c++) {
+      const Centre &ctr = centres[c];
+      Sp3CentreSummary cs;
+      cs.fn = sources[c]->filename();
+      cs.weight_pos = 1e0 / (ctr.rms_pos * ctr.rms_pos) / wpos;
+      cs.weight_clk = 1e0 / (ctr.rms_clk * ctr.rms_clk) / wclk;
+      cs.rms_pos = ctr.rms_pos;
+      cs.rms_clk = ctr.rms_clk;
+      cs.num_used = ctr.sums.n_pos;
+      cs.num_rejected = ctr.sums.n_out;
+      Sp3HelmertParams &h = cs.helmert;
+      h.t = ts[0];
+      h.num_sats = ctr.sums.ne.count;
+      h.tx = ctr.p[0];
+      h.ty = ctr.p[1];
+      h.tz = ctr.p[2];
+      h.scale = ctr.p[3] / HELMERT_COORD_SCALE * 1e9;
+      h.rx = ctr.p[4] / HELMERT_COORD_SCALE * MAS_PER_RAD;
+      h.ry = ctr.p[5] / HELMERT_COORD_SCALE * MAS_PER_RAD;
+      h.rz = ctr.p[6] / HELMERT_COORD_SCALE * MAS_PER_RAD;
+      h.rms = ctr.rms_pos;
+      report->centres.push_back(cs);
+    }
+    report->num_iterations = iter;
+    report->num_epochs = nep;
+  }
+  return 0;
+}
@@ -0,0 +1,412 @@
+#include "sp3_compare.hpp"
+#include "core/sp3_helmert.hpp"
+#include "sv_interpolator_set.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+/* Min number of satellites to estimate Helmert parameters */
+constexpr int HELMERT_MIN_SATS = 4;
+
+/* Differences of a record (b - a), along with the position and velocity of
+ * a, all in [m], [m/s] and [ns]
+ */
+struct DiffCell {
+  double d[4];
+  double r[3];
+  double v[3];
+  bool pos_ok{false};
+  bool clk_ok{false};
+}; /* struct DiffCell */
+
+double dot(const double *a, const double *b) noexcept {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void cross(const double *a, const double *b, double *c) noexcept {
+  c[0] = a[1] * b[2] - a[2] * b[1];
+  c[1] = a[2] * b[0] - a[0] * b[2];
+  c[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+/* Estimate and remove a Helmert transformation off from the cells of one
+ * epoch; p.num_sats is left 0 if not estimated
+ */
+void remove_helmert(DiffCell *cells, int n,
+                    dso::Sp3HelmertParams &p) noexcept {
+  using dso::sp3::HELMERT_COORD_SCALE;
+  using dso::sp3::MAS_PER_RAD;
+  dso::sp3::HelmertNormals ne;
+  for (int s = 0; s < n; s++)
+    if (cells[s].pos_ok)
+      ne.add(cells[s].r, cells[s].d);
+  double u[7], dx[3];
+  if (ne.count < HELMERT_MIN_SATS || ne.solve(u))
+    return;
+
+  double sum = 0e0;
+  for (int s = 0; s < n; s++) {
+    if (!cells[s].pos_ok)
+      continue;
+    dso::sp3::HelmertNormals::apply(u, cells[s].r, dx);
+    for (int i = 0; i < 3; i++) {
+      cells[s].d[i] -= dx[i];
+      sum += cells[s].d[i] * cells[s].d[i];
+    }
+  }
+  p.num_sats = ne.count;
+  p.tx = u[0];
+  p.ty = u[1];
+  p.tz = u[2];
+  p.scale = u[3] / HELMERT_COORD_SCALE * 1e9;
+  p.rx = u[4] / HELMERT_COORD_SCALE * MAS_PER_RAD;
+  p.ry = u[5] / HELMERT_COORD_SCALE * MAS_PER_RAD;
+  p.rz = u[6] / HELMERT_COORD_SCALE * MAS_PER_RAD;
+  p.rms = std::sqrt(sum / (3 * ne.count - 7));
+}
+
+/* Statistics of a set of differences; v is reordered */
+dso::Sp3DiffStats reduce(std::vector<double> &v) noexcept {
+  dso::Sp3DiffStats st;
+  if (v.empty())
+    return st;
+  double sum = 0e0, sum2 = 0e0;
+  for (auto &x : v) {
+    sum += x;
+    sum2 += x * x;
+    x = std::abs(x);
+  }
+  std::sort(v.begin(), v.end());
+  const long n = v.size();
+  st.count = n;
+  st.mean = sum / n;
+  st.rms = std::sqrt(sum2 / n);
+  st.max_abs = v.back();
+  /* nearest-rank percentiles */
+  st.p50 = v[std::max(0L, (long)std::ceil(.50 * n) - 1)];
+  st.p95 = v[std::max(0L, (long)std::ceil(.95 * n) - 1)];
+  return st;
+}
+
+std::string json_stats(const char *name, const dso::Sp3DiffStats &st) {
+  char buf[256];
+  std::snprintf(buf, sizeof buf,
+                "\"%s\": {\"count\": %ld, \"mean\": %.6f, \"rms\": %.6f, "
+                "\"max_abs\": %.6f, \"p50\": %.6f, \"p95\": %.6f}",
+                name, st.count, st.mean, st.rms, st.max_abs, st.p50, st.p95);
+  return buf;
+}
+
+std::string json_sv(const dso::Sp3SvComparison &c) {
+  char buf[64];
+  std::snprintf(buf, sizeof buf, "{\"sv\": \"%.3s\", \"rms_3d\": %.6f,\n",
+                c.sv.id, c.rms_3d);
+  return buf + std::string("      ") + json_stats("radial", c.radial) +
+         ",\n      " + json_stats("along", c.along) + ",\n      " +
+         json_stats("cross", c.cross) + ",\n      " +
+         json_stats("clock", c.clock) + "}";
+}
+} /* anonymous namespace */
+
+int dso::sp3::compare(const Sp3c &a, const Sp3c &b,
+                      Sp3ComparisonReport &report,
+                      const Sp3CompareOptions &opts, Executor *ex) {
+  report = Sp3ComparisonReport();
+
+  /* records of a, epoch by epoch */
+  std::vector<Sp3EpochBuffer> epochs;
+  {
+    Sp3Cursor cursor(a);
+    Sp3EpochBuffer buf;
+    int error;
+    while (!(error = cursor.get_next_epoch(buf)))
+      epochs.push_back(buf);
+    if (error > 0) {
+      fprintf(stderr,
+              "[ERROR] Failed reading data block of Sp3 file %s (traceback: "
+              "%s)\n",
+              a.filename().c_str(), __func__);
+      return error;
+    }
+  }
+
+  /* interpolators for b */
+  SvInterpolatorSet set(opts.max_window);
+  if (set.load(b, nullptr, ex)) {
+    fprintf(stderr,
+            "[ERROR] Failed loading interpolators for Sp3 file %s (traceback: "
+            "%s)\n",
+            b.filename().c_str(), __func__);
+    return 1;
+  }
+
+  /* satellites of a, also recorded in b */
+  std::vector<sp3::SatelliteId> svs;
+  for (const auto &sv : a.sattellite_vector()) {
+    const SvInterpolator *intrp = set.find(sv);
+    if (intrp && intrp->num_data_points())
+      svs.push_back(sv);
+  }
+  const int nsv = svs.size();
+  const int nep = epochs.size();
+  if (!nsv || !nep)
+    return -1;
+
+  /* align records, one task per satellite */
+  const bool a_has_vel = a.has_velocities();
+  const double max_window_sec = opts.max_window.as_underlying_type() * 1e-3;
+  std::vector<DiffCell> cells((std::size_t)nep * nsv);
+  sp3::parallel_for(
+      0, nsv,
+      [&](int s) {
+        const sp3::SatelliteId &sv = svs[s];
+        const SvInterpolator *intrp = set.find(sv);
+        SvInterpolationState state;
+        const Sp3DataBlock *pts = intrp->data_points();
+        const int npts = intrp->num_data_points();
+        /* epoch index and record (in a) of a valid position, or nullptr */
+        auto a_position = [&](int e) -> const Sp3DataBlock * {
+          if (e < 0 || e >= nep)
+            return nullptr;
+          const int i = epochs[e].find(sv);
+          if (i < 0 ||
+              epochs[e].blocks[i].flag.is_set(Sp3Event::bad_abscent_position))
+            return nullptr;
+          return &epochs[e].blocks[i];
+        };
+
+        for (int e = 0; e < nep; e++) {
+          const int i = epochs[e].find(sv);
+          if (i < 0)
+            continue;
+          const auto &t = epochs[e].t;
+          const Sp3DataBlock &blk = epochs[e].blocks[i];
+          DiffCell &c = cells[(std::size_t)e * nsv + s];
+          const auto it = std::lower_bound(
+              pts, pts + npts, t,
+              [](const Sp3DataBlock &p, const dso::datetime<dso::nanoseconds>
+                                            &tt) { return p.t < tt; });
+          const bool exact = (it != pts + npts && it->t == t);
+          const bool inside = (it != pts && it != pts + npts);
+
+          /* positions */
+          double pos[3], err[3];
+          if (!blk.flag.is_set(Sp3Event::bad_abscent_position)) {
+            if (exact) {
+              if (!it->flag.is_set(Sp3Event::bad_abscent_position)) {
+                std::memcpy(pos, it->state, sizeof pos);
+                c.pos_ok = true;
+              }
+            } else if (inside) {
+              c.pos_ok = !intrp->interpolate_at(t, pos, err, nullptr, nullptr,
+                                                state);
+            }
+          }
+          if (c.pos_ok) {
+            for (int k = 0; k < 3; k++) {
+              c.d[k] = (pos[k] - blk.state[k]) * 1e3;
+              c.r[k] = blk.state[k] * 1e3;
+            }
+            /* velocity of a, given or off from neighbouring positions */
+            if (a_has_vel &&
+                !blk.flag.is_set(Sp3Event::bad_abscent_velocity)) {
+              for (int k = 0; k < 3; k++)
+                c.v[k] = blk.state[4 + k] * 1e-1;
+            } else {
+              const Sp3DataBlock *p0 = a_position(e - 1);
+              const Sp3DataBlock *p1 = a_position(e + 1);
+              if (!p0)
+                p0 = &blk;
+              if (!p1)
+                p1 = &blk;
+              const double dt =
+                  p1->t.diff<dso::DateTimeDifferenceType::FractionalSeconds>(
+                          p0->t)
+                      .seconds();
+              if (dt > 0e0) {
+                for (int k = 0; k < 3; k++)
+                  c.v[k] = (p1->state[k] - p0->state[k]) * 1e3 / dt;
+              } else {
+                c.pos_ok = false;
+              }
+            }
+          }
+
+          /* clocks; linearly interpolated if needed */
+          if (!blk.flag.is_set(Sp3Event::bad_abscent_clock)) {
+            if (exact) {
+              if (!it->flag.is_set(Sp3Event::bad_abscent_clock)) {
+                c.d[3] = (it->state[3] - blk.state[3]) * 1e3;
+                c.clk_ok = true;
+              }
+            } else if (inside) {
+              const Sp3DataBlock *p0 = it - 1;
+              const double dt =
+                  it->t.diff<dso::DateTimeDifferenceType::FractionalSeconds>(
+                           p0->t)
+                      .seconds();
+              if (!p0->flag.is_set(Sp3Event::bad_abscent_clock) &&
+                  !it->flag.is_set(Sp3Event::bad_abscent_clock) &&
+                  dt <= max_window_sec) {
+                const double f =
+                    t.diff<dso::DateTimeDifferenceType::FractionalSeconds>(
+                         p0->t)
+                        .seconds() /
+                    dt;
+                const double clk =
+                    p0->state[3] + f * (it->state[3] - p0->state[3]);
+                c.d[3] = (clk - blk.state[3]) * 1e3;
+                c.clk_ok = true;
+              }
+            }
+          }
+        }
+      },
+      ex, 1);
+
+  /* per-epoch reductions: clock datum and Helmert parameters */
+  std::vector<Sp3HelmertParams> helmert(opts.helmert ? nep : 0);
+  if (opts.helmert || opts.remove_clock_mean) {
+    sp3::parallel_for(
+        0, nep,
+        [&](int e) {
+          DiffCell *row = cells.data() + (std::size_t)e * nsv;
+          if (opts.remove_clock_mean) {
+            double sum = 0e0;
+            int count = 0;
+            for (int s = 0; s < nsv; s++)
+              if (row[s].clk_ok) {
+                sum += row[s].d[3];
+                ++count;
+              }
+            for (int s = 0; s < nsv; s++)
+              row[s].d[3] -= count ? sum / count : 0e0;
+          }
+          if (opts.helmert) {
+            helmert[e].t = epochs[e].t;
+            remove_helmert(row, nsv, helmert[e]);
+          }
+        },
+        ex);
+  }
+
+  /* radial/along/cross-track differences and statistics, per satellite */
+  std::vector<std::vector<double>> values((std::size_t)nsv * 4);
+  report.satellites.resize(nsv);
+  sp3::parallel_for(
+      0, nsv,
+      [&](int s) {
+        std::vector<double> *v = values.data() + (std::size_t)s * 4;
+        double sum3d = 0e0, er[3], ea[3], ec[3];
+        for (int e = 0; e < nep; e++) {
+          const DiffCell &c = cells[(std::size_t)e * nsv + s];
+          if (c.pos_ok) {
+            const double rr = std::sqrt(dot(c.r, c.r));
+            cross(c.r, c.v, ec);
+            const double hh = std::sqrt(dot(ec, ec));
+            if (rr > 0e0 && hh > 0e0) {
+              for (int k = 0; k < 3; k++) {
+                er[k] = c.r[k] / rr;
+                ec[k] /= hh;
+              }
+              cross(ec, er, ea);
+              v[0].push_back(dot(c.d, er));
+              v[1].push_back(dot(c.d, ea));
+              v[2].push_back(dot(c.d, ec));
+              sum3d += dot(c.d, c.d);
+            }
+          }
+          if (c.clk_ok)
+            v[3].push_back(c.d[3]);
+        }
+        Sp3SvComparison &r = report.satellites[s];
+        r.sv = svs[s];
+        r.rms_3d = v[0].empty() ? 0e0 : std::sqrt(sum3d / v[0].size());
+        r.radial = reduce(v[0]);
+        r.along = reduce(v[1]);
+        r.cross = reduce(v[2]);
+        r.clock = reduce(v[3]);
+      },
+      ex, 1);
+
+  /* totals (values are absolute values by now; mean and rms are combined
+   * off from the per-satellite statistics)
+   */
+  Sp3DiffStats Sp3SvComparison::*comps[] = {
+      &Sp3SvComparison::radial, &Sp3SvComparison::along,
+      &Sp3SvComparison::cross, &Sp3SvComparison::clock};
+  double sum3d = 0e0;
+  for (int k = 0; k < 4; k++) {
+    std::vector<double> all;
+    double sum = 0e0, sum2 = 0e0;
+    for (int s = 0; s < nsv; s++) {
+      const auto &v = values[(std::size_t)s * 4 + k];
+      all.insert(all.end(), v.begin(), v.end());
+      const Sp3DiffStats &st = report.satellites[s].*comps[k];
+      sum += st.mean * st.count;
+      sum2 += st.rms * st.rms * st.count;
+      if (!k)
+        sum3d += report.satellites[s].rms_3d * report.satellites[s].rms_3d *
+                 st.count;
+    }
+    Sp3DiffStats &tot = report.total.*comps[k];
+    tot = reduce(all);
+    if (tot.count) {
+      tot.mean = sum / tot.count;
+      tot.rms = std::sqrt(sum2 / tot.count);
+    }
+  }
+  std::memcpy(report.total.sv.id, "ALL", 3);
+  if (report.total.radial.count)
+    report.total.rms_3d = std::sqrt(sum3d / report.total.radial.count);
+
+  for (const auto &p : helmert)
+    if (p.num_sats)
+      report.helmert.push_back(p);
+  report.num_epochs = nep;
+  return (report.total.radial.count || report.total.clock.count) ? 0 : -1;
+}
+
+int dso::Sp3ComparisonReport::write_json(const char *fn) const {
+  std::string j("{\n");
+  j += "  \"num_epochs\": " + std::to_string(num_epochs) + ",\n";
+  j += "  \"units\": {\"position\": \"m\", \"clock\": \"ns\", \"rotation\": "
+       "\"mas\", \"scale\": \"ppb\"},\n";
+  j += "  \"total\": " + json_sv(total) + ",\n";
+  j += "  \"satellites\": [";
+  for (std::size_t i = 0; i < satellites.size(); i++)
+    j += (i ? ",\n    " : "\n    ") + json_sv(satellites[i]);
+  j += "\n  ],\n  \"helmert\": [";
+  char buf[320];
+  for (std::size_t i = 0; i < helmert.size(); i++) {
+    const Sp3HelmertParams &p = helmert[i];
+    std::snprintf(buf, sizeof buf,
+                  "%s{\"mjd\": %ld, \"nsec\": %ld, \"num_sats\": %d, "
+                  "\"tx\": %.6f, \"ty\": %.6f, \"tz\": %.6f, \"rx\": %.6f, "
+                  "\"ry\": %.6f, \"rz\": %.6f, \"scale\": %.6f, "
+                  "\"rms\": %.6f}",
+                  i ? ",\n    " : "\n    ",
+                  (long)p.t.imjd().as_underlying_type(),
+                  (long)p.t.sec().as_underlying_type(), p.num_sats, p.tx, p.ty,
+                  p.tz, p.rx, p.ry, p.rz, p.scale, p.rms);
+    j += buf;
+  }
+  j += "\n  ]\n}\n";
+
+  const std::string tmp = std::string(fn) + ".tmp";
+  std::FILE *fp = std::fopen(tmp.c_str(), "wb");
+  int error = !fp;
+  if (fp) {
+    error = std::fwrite(j.data(), 1, j.size(), fp) != j.size();
+    error = std::fclose(fp) || error;
+  }
+  if (error || std::rename(tmp.c_str(), fn)) {
+    fprintf(stderr, "[ERROR] Failed writing report %s (traceback: %s)\n", fn,
+            __func__);
+    std::remove(tmp.c_str());
+    return 1;
+  }
+  return 0;
+}
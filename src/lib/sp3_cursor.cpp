@@ -0,0 +1,309 @@
+#include "sp3.hpp"
+#include <cstdio>
+#include <cstring>
+
+using dso::sp3::SatelliteId;
+
+namespace {
+/* Max record characters (for a navigation data block) */
+constexpr int MAX_RECORD_CHARS{128};
+} /* anonymous namespace */
+
+dso::Sp3Cursor dso::Sp3c::cursor() const noexcept { return Sp3Cursor(*this); }
+
+dso::Sp3Cursor::Sp3Cursor(const Sp3c &sp3) noexcept
+    : sp3_(&sp3), pos_(static_cast<int64_t>(sp3.__end_of_head)) {}
+
+void dso::Sp3Cursor::rewind() noexcept {
+  pos_ = static_cast<int64_t>(sp3_->__end_of_head);
+}
+
+int dso::Sp3Cursor::seek(int64_t offset) noexcept {
+  if (offset < static_cast<int64_t>(sp3_->__end_of_head) ||
+      offset > static_cast<int64_t>(sp3_->map__.size()))
+    return 1;
+  pos_ = offset;
+  return 0;
+}
+
+int dso::Sp3Cursor::seek_epoch(int idx) noexcept {
+  const auto &index = sp3_->index();
+  if (idx < 0 || idx >= index.num_epochs())
+    return 1;
+  return seek(index.epoch_pos[idx]);
+}
+
+int dso::Sp3Cursor::next_line(char *line) noexcept {
+  const char *data = sp3_->map__.data();
+  const int64_t size = sp3_->map__.size();
+  if (pos_ >= size) {
+    *line = '\0';
+    return -1;
+  }
+
+  const char *start = data + pos_;
+  const char *nl =
+      static_cast<const char *>(std::memchr(start, '\n', size - pos_));
+  const char *stop = nl ? nl : data + size;
+  const int count =
+      std::min<int64_t>(stop - start, MAX_RECORD_CHARS - 1);
+  std::memcpy(line, start, count);
+  line[count] = '\0';
+  pos_ = (nl ? nl + 1 : stop) - data;
+  return count;
+}
+
+int dso::Sp3Cursor::peak_next_data_block(
+    dso::datetime<dso::nanoseconds> &t) const noexcept {
+  /* work on a copy, so that this instance is not moved */
+  Sp3Cursor cur(*this);
+  char line[MAX_RECORD_CHARS];
+
+  if (cur.next_line(line) < 0)
+    return 1;
+
+  if (*line == '*') {
+    if (int error = sp3_->resolve_epoch_line(line, t); error) {
+      fprintf(stderr,
+              "ERROR. Failed to resolve sp3 epoch line, error=%d (%s)\n", error,
+              __func__);
+      return error + 10;
+    }
+    return 0;
+  }
+
+  return std::strncmp(line, "EOF", 3) ? 100 : -1;
+}
+
+int dso::Sp3Cursor::get_sv_records(SatelliteId satid,
+                                   Sp3DataBlock &block) noexcept {
+  char line[MAX_RECORD_CHARS];
+  SatelliteId csatid;
+  int status;
+
+  if (next_line(line) < 4 || *line != 'P')
+    return 21;
+  csatid.set_id(line + 1);
+  if (csatid != satid)
+    return 29;
+  if ((status = sp3_->resolve_position_line(
+           line, block.state[0], block.state[1], block.state[2],
+           block.state[3], block.state_sdev[0], block.state_sdev[1],
+           block.state_sdev[2], block.state_sdev[3], block.flag)))
+    return status + 20;
+
+  /* velocity record (if any) follows, possibly after a correlation record */
+  if (peek() == 'E')
+    next_line(line);
+  if (peek() == 'V') {
+    next_line(line);
+    csatid.set_id(line + 1);
+    if (csatid != satid)
+      return 39;
+    if ((status = sp3_->resolve_velocity_line(
+             line, block.state[4], block.state[5], block.state[6],
+             block.state[7], block.state_sdev[4], block.state_sdev[5],
+             block.state_sdev[6], block.state_sdev[7], block.flag)))
+      return status + 30;
+  }
+
+  return 0;
+}
+
+/** Same as Sp3c::get_next_data_block, but reading off from the file mapping
+ *  at the cursor's position. Correlation records are (silently) skipped.
+ */
+int dso::Sp3Cursor::get_next_data_block(SatelliteId satid,
+                                        Sp3DataBlock &block) noexcept {
+  char line[MAX_RECORD_CHARS];
+  SatelliteId csatid;
+  int status;
+
+  // following line should be an epoch header or 'EOF'
+  if (next_line(line) < 0)
+    return -1;
+  if (*line == '*') {
+    if ((status = sp3_->resolve_epoch_line(line, block.t))) {
+      fprintf(stderr,
+              "ERROR. Failed to resolve sp3 epoch line, error=%d (%s)\n",
+              status, __func__);
+      return status + 10;
+    }
+  } else {
+    return std::strncmp(line, "EOF", 3) ? 100 : -1;
+  }
+
+  // default initialize the block flag
+  block.flag.set_defaults();
+
+  // keep on reading reacords, till the next epoch header .....
+  char c;
+  while ((c = peek()) != '*') {
+    if (next_line(line) < 0)
+      return -1;
+    if (c == 'P' || c == 'V') {
+      // only resolve records for the requested SV; skip all others
+      csatid.set_id(line + 1);
+      if (csatid != satid)
+        continue;
+      if (c == 'P') {
+        if ((status = sp3_->resolve_position_line(
+                 line, block.state[0], block.state[1], block.state[2],
+                 block.state[3], block.state_sdev[0], block.state_sdev[1],
+                 block.state_sdev[2], block.state_sdev[3], block.flag)))
+          return status + 20;
+      } else {
+        if ((status = sp3_->resolve_velocity_line(
+                 line, block.state[4], block.state[5], block.state[6],
+                 block.state[7], block.state_sdev[4], block.state_sdev[5],
+                 block.state_sdev[6], block.state_sdev[7], block.flag)))
+          return status + 30;
+      }
+    } else if (!std::strncmp(line, "EOF", 3)) {
+      return -1;
+    } else if (std::strncmp(line, "EP", 2) && std::strncmp(line, "EV", 2)) {
+      return 150;
+    }
+  }
+
+  return 0;
+}
+
+int dso::Sp3Cursor::get_next_epoch(Sp3EpochBuffer &buf) noexcept {
+  static const Sp3SvSelection all;
+  return get_next_epoch(buf, all);
+}
+
+int dso::Sp3Cursor::skip_epoch(dso::datetime<dso::nanoseconds> *t) noexcept {
+  char line[MAX_RECORD_CHARS];
+
+  // following line should be an epoch header or 'EOF'
+  if (next_line(line) < 0)
+    return -1;
+  if (*line != '*') {
+    if (std::strncmp(line, "EOF", 3))
+      return 100;
+    pos_ = sp3_->map__.size();
+    return -1;
+  }
+  if (t) {
+    if (int status = sp3_->resolve_epoch_line(line, *t); status) {
+      fprintf(stderr,
+              "ERROR. Failed to resolve sp3 epoch line, error=%d (%s)\n",
+              status, __func__);
+      return status + 10;
+    }
+  }
+
+  // skip records, till the next epoch header (or EOF)
+  while (peek() != '*' && next_line(line) >= 0) {
+    if (!std::strncmp(line, "EOF", 3)) {
+      // nothing follows; next call will report EOF
+      pos_ = sp3_->map__.size();
+      break;
+    }
+  }
+  return 0;
+}
+
+int dso::Sp3Cursor::get_next_epoch(Sp3EpochBuffer &buf,
+                                   const Sp3SvSelection &sel) noexcept {
+  char line[MAX_RECORD_CHARS];
+  int status;
+  buf.clear();
+
+  // following line should be an epoch header or 'EOF'
+  if (next_line(line) < 0)
+    return -1;
+  if (*line != '*') {
+    if (std::strncmp(line, "EOF", 3))
+      return 100;
+    pos_ = sp3_->map__.size();
+    return -1;
+  }
+  if ((status = sp3_->resolve_epoch_line(line, buf.t))) {
+    fprintf(stderr, "ERROR. Failed to resolve sp3 epoch line, error=%d (%s)\n",
+            status, __func__);
+    return status + 10;
+  }
+
+  // collect records, till the next epoch header (or EOF)
+  char c;
+  while ((c = peek()) != '*' && next_line(line) >= 0) {
+    if (c == 'P' || c == 'V') {
+      const SatelliteId sv(line + 1);
+      if (!sel.accepts(sv))
+        continue;
+      // a velocity record normally follows the position record of the SV
+      int k = (c == 'V' && buf.size() && buf.sats.back() == sv)
+                  ? buf.size() - 1
+                  : ((c == 'V') ? buf.find(sv) : -1);
+      if (k < 0) {
+        buf.sats.push_back(sv);
+        buf.blocks.emplace_back();
+        buf.blocks.back().t = buf.t;
+        buf.blocks.back().flag.set_defaults();
+        k = buf.size() - 1;
+      }
+      Sp3DataBlock &b = buf.blocks[k];
+      if (c == 'P') {
+        if ((status = sp3_->resolve_position_line(
+                 line, b.state[0], b.state[1], b.state[2], b.state[3],
+                 b.state_sdev[0], b.state_sdev[1], b.state_sdev[2],
+                 b.state_sdev[3], b.flag)))
+          return status + 20;
+      } else {
+        if ((status = sp3_->resolve_velocity_line(
+                 line, b.state[4], b.state[5], b.state[6], b.state[7],
+                 b.state_sdev[4], b.state_sdev[5], b.state_sdev[6],
+                 b.state_sdev[7], b.flag)))
+          return status + 30;
+      }
+    } else if (!std::strncmp(line, "EOF", 3)) {
+      // nothing follows; next call will report EOF
+      pos_ = sp3_->map__.size();
+      break;
+    } else if (std::strncmp(line, "EP", 2) && std::strncmp(line, "EV", 2)) {
+      return 150;
+    }
+  }
+
+  return 0;
+}
+
+int dso::Sp3Cursor::checkpoint(Sp3Checkpoint &cp) const noexcept {
+  cp = Sp3Checkpoint();
+  try {
+    cp.fn = sp3_->filename();
+  } catch (std::exception &) {
+    return 1;
+  }
+  cp.fingerprint = sp3_->fingerprint();
+  cp.offset = pos_;
+  /* epoch of the next data block, if any */
+  dso::datetime<dso::nanoseconds> t;
+  if (int error = peak_next_data_block(t); error > 1)
+    return error;
+  else if (!error)
+    cp.epoch = t;
+  return 0;
+}
+
+int dso::Sp3Cursor::restore(const Sp3Checkpoint &cp) noexcept {
+  if (sp3_->fingerprint() != cp.fingerprint)
+    return -1;
+
+  const int64_t pos = pos_;
+  if (seek(cp.offset))
+    return -1;
+
+  /* the data block at offset should be the one recorded */
+  if (cp.epoch != dso::datetime<dso::nanoseconds>::min()) {
+    dso::datetime<dso::nanoseconds> t;
+    if (peak_next_data_block(t) || t != cp.epoch) {
+      pos_ = pos;
+      return -1;
+    }
+  }
+  return 0;
+}
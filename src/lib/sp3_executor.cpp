@@ -0,0 +1,202 @@
+#include "sp3_executor.hpp"
+#include <exception>
+
+namespace {
+/* The pool (if any) the calling thread is a worker of, and its index */
+thread_local const dso::sp3::WorkStealingPool *tl_pool{nullptr};
+thread_local int tl_worker{-1};
+
+/* External executor set by the user (if any) */
+std::atomic<dso::sp3::Executor *> user_executor{nullptr};
+
+/* State of a parallel_for_chunks call, shared by all tasks taking part. Any
+ * task started after all chunks are claimed, returns without touching the
+ * (caller-owned) function. The task completing the last chunk signals cv.
+ */
+struct ForState {
+  int begin, end, grain, num_chunks;
+  const std::function<void(int, int)> *f;
+  std::atomic<int> next{0};
+  std::atomic<int> done{0};
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::exception_ptr error;
+
+  bool finished() const noexcept {
+    return done.load(std::memory_order_acquire) == num_chunks;
+  }
+
+  void run() noexcept {
+    int chunk;
+    while ((chunk = next.fetch_add(1, std::memory_order_relaxed)) <
+           num_chunks) {
+      const int b = begin + chunk * grain;
+      const int e = std::min(end, b + grain);
+      try {
+        (*f)(b, e);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!error)
+          error = std::current_exception();
+      }
+      if (done.fetch_add(1, std::memory_order_acq_rel) == num_chunks - 1) {
+        /* lock, so that the waiting thread does not miss the signal */
+        std::lock_guard<std::mutex> lock(mtx);
+        cv.notify_all();
+      }
+    }
+  }
+}; /* struct ForState */
+} /* anonymous namespace */
+
+dso::sp3::WorkStealingPool::WorkStealingPool(int num_threads) {
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < num_threads; i++)
+    queues_.emplace_back(std::make_unique<TaskQueue>());
+  threads_.reserve(num_threads);
+  for (int i = 0; i < num_threads; i++)
+    threads_.emplace_back([this, i]() { work(i); });
+}
+
+dso::sp3::WorkStealingPool::~WorkStealingPool() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &t : threads_)
+    t.join();
+}
+
+void dso::sp3::WorkStealingPool::submit(std::function<void()> task) {
+  const int n = queues_.size();
+  const int q = (tl_pool == this)
+                    ? tl_worker
+                    : next_queue_.fetch_add(1, std::memory_order_relaxed) % n;
+  {
+    std::lock_guard<std::mutex> lock(queues_[q]->mtx);
+    queues_[q]->tasks.push_back(std::move(task));
+  }
+  {
+    /* lock, so that no worker misses the wake-up call */
+    std::lock_guard<std::mutex> lock(mtx_);
+    pending_.fetch_add(1, std::memory_order_release);
+  }
+  cv_.notify_one();
+}
+
+bool dso::sp3::WorkStealingPool::pop(int self,
+                                     std::function<void()> &task) noexcept {
+  const int n = queues_.size();
+  /* own queue first, newest task */
+  if (self >= 0) {
+    std::lock_guard<std::mutex> lock(queues_[self]->mtx);
+    if (!queues_[self]->tasks.empty()) {
+      task = std::move(queues_[self]->tasks.back());
+      queues_[self]->tasks.pop_back();
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  /* steal the oldest task of some other queue */
+  const int start = (self >= 0) ? self + 1 : 0;
+  for (int i = 0; i < n; i++) {
+    auto &q = *queues_[(start + i) % n];
+    std::lock_guard<std::mutex> lock(q.mtx);
+    if (!q.tasks.empty()) {
+      task = std::move(q.tasks.front());
+      q.tasks.pop_front();
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void dso::sp3::WorkStealingPool::work(int self) noexcept {
+  tl_pool = this;
+  tl_worker = self;
+  std::function<void()> task;
+  for (;;) {
+    if (pop(self, task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [this]() {
+      return stop_ || pending_.load(std::memory_order_acquire) > 0;
+    });
+    if (stop_ && !pending_.load(std::memory_order_acquire))
+      return;
+  }
+}
+
+bool dso::sp3::WorkStealingPool::try_run_one() {
+  std::function<void()> task;
+  if (pop((tl_pool == this) ? tl_worker : -1, task)) {
+    task();
+    return true;
+  }
+  return false;
+}
+
+dso::sp3::Executor &dso::sp3::default_executor() {
+  if (Executor *ex = user_executor.load(std::memory_order_acquire); ex)
+    return *ex;
+  static WorkStealingPool pool;
+  return pool;
+}
+
+void dso::sp3::set_default_executor(Executor *ex) noexcept {
+  user_executor.store(ex, std::memory_order_release);
+}
+
+void dso::sp3::parallel_for_chunks(int begin, int end,
+                                   const std::function<void(int, int)> &f,
+                                   Executor *ex, int grain) {
+  if (end <= begin)
+    return;
+  if (!ex)
+    ex = &default_executor();
+
+  const int n = end - begin;
+  const int workers = std::max(1, ex->concurrency());
+  /* by default, aim at a few chunks per worker for load balancing */
+  if (grain <= 0)
+    grain = std::max(1, n / (4 * workers));
+  const int num_chunks = (n + grain - 1) / grain;
+
+  /* nothing to gain here; run on the calling thread */
+  if (num_chunks == 1 || workers == 1) {
+    f(begin, end);
+    return;
+  }
+
+  auto state = std::make_shared<ForState>();
+  state->begin = begin;
+  state->end = end;
+  state->grain = grain;
+  state->num_chunks = num_chunks;
+  state->f = &f;
+
+  const int helpers = std::min(num_chunks, workers) - 1;
+  for (int i = 0; i < helpers; i++)
+    ex->submit([state]() { state->run(); });
+
+  /* take part, and keep on working (on anything) while waiting; once there
+   * is nothing left to run, the remaining chunks are all being worked on by
+   * other threads, so block until the last one is done
+   */
+  state->run();
+  while (!state->finished()) {
+    if (!ex->try_run_one()) {
+      std::unique_lock<std::mutex> lock(state->mtx);
+      state->cv.wait(lock, [&state]() { return state->finished(); });
+    }
+  }
+
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
@@ -0,0 +1,444 @@
+#include "sp3_export.hpp"
+#include "core/sp3_time.hpp"
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <sys/stat.h>
+
+using dso::sp3::NS_PER_DAY;
+
+namespace {
+/* Size of NPY headers (bytes); fixed, so that the shape can be re-written
+ * once the number of records is known
+ */
+constexpr int NPY_HEADER_SIZE = 128;
+
+/* Number of state/std. deviation columns */
+constexpr int NUM_VALUES = 16;
+
+/* Max number of column files open at any time; well below the usual limit
+ * on open files per process
+ */
+constexpr int MAX_OPEN_FILES = 256;
+
+struct ColumnDef {
+  const char *name;
+  const char *dtype;
+  const char *unit;
+}; /* struct ColumnDef */
+
+/* Exported columns, in order; see Sp3DataBlock for units */
+constexpr ColumnDef T_COLUMN{"t", "<i8", "ns"};
+constexpr ColumnDef SV_COLUMN{"sv", "|S3", ""};
+constexpr ColumnDef VALUE_COLUMNS[NUM_VALUES] = {
+    {"x", "<f8", "km"},
+    {"y", "<f8", "km"},
+    {"z", "<f8", "km"},
+    {"clk", "<f8", "microsec"},
+    {"vx", "<f8", "dm/sec"},
+    {"vy", "<f8", "dm/sec"},
+    {"vz", "<f8", "dm/sec"},
+    {"vclk", "<f8", "1e-4 microsec/sec"},
+    {"sdev_x", "<f8", "mm"},
+    {"sdev_y", "<f8", "mm"},
+    {"sdev_z", "<f8", "mm"},
+    {"sdev_clk", "<f8", "psec"},
+    {"sdev_vx", "<f8", "1e-4 mm/sec"},
+    {"sdev_vy", "<f8", "1e-4 mm/sec"},
+    {"sdev_vz", "<f8", "1e-4 mm/sec"},
+    {"sdev_vclk", "<f8", "1e-4 psec/sec"}};
+constexpr ColumnDef FLAG_COLUMN{"flag", "<u4", ""};
+
+/* NPY (version 1.0) header for a 1-d array of n elements */
+std::string npy_header(const char *dtype, int64_t n) {
+  char dict[NPY_HEADER_SIZE];
+  std::snprintf(dict, sizeof dict,
+                "{'descr': '%s', 'fortran_order': False, 'shape': (%" PRId64
+                ",), }",
+                dtype, n);
+  std::string h("\x93NUMPY\x01\x00", 8);
+  const uint16_t hlen = NPY_HEADER_SIZE - 10;
+  h.push_back(static_cast<char>(hlen & 0xff));
+  h.push_back(static_cast<char>(hlen >> 8));
+  h += dict;
+  h.append(NPY_HEADER_SIZE - 1 - h.size(), ' ');
+  h.push_back('\n');
+  return h;
+}
+
+/* Write an array, little-endian */
+template <typename T>
+int write_le(std::FILE *fp, const T *data, std::size_t n) noexcept {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  char buf[sizeof(T)];
+  for (std::size_t i = 0; i < n; i++) {
+    const char *p = reinterpret_cast<const char *>(data + i);
+    for (std::size_t b = 0; b < sizeof(T); b++)
+      buf[b] = p[sizeof(T) - 1 - b];
+    if (std::fwrite(buf, sizeof(T), 1, fp) != 1)
+      return 1;
+  }
+  return 0;
+#else
+  return std::fwrite(data, sizeof(T), n, fp) != n;
+#endif
+}
+
+/* Escape a string for JSON */
+std::string json_string(const std::string &s) {
+  std::string r("\"");
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      r.push_back('\\');
+      r.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char esc[8];
+      std::snprintf(esc, sizeof esc, "\\u%04x", c);
+      r += esc;
+    } else {
+      r.push_back(c);
+    }
+  }
+  r.push_back('"');
+  return r;
+}
+
+/* Columns of a table, in the order written */
+std::vector<ColumnDef> table_columns(bool with_sv) {
+  std::vector<ColumnDef> cols{T_COLUMN};
+  if (with_sv)
+    cols.push_back(SV_COLUMN);
+  cols.insert(cols.end(), VALUE_COLUMNS, VALUE_COLUMNS + NUM_VALUES);
+  cols.push_back(FLAG_COLUMN);
+  return cols;
+}
+
+int make_dir(const std::string &dir) noexcept {
+  if (::mkdir(dir.c_str(), 0755) && errno != EEXIST) {
+    fprintf(stderr,
+            "[ERROR] Failed creating directory %s: %s (traceback: %s)\n",
+            dir.c_str(), std::strerror(errno), __func__);
+    return 1;
+  }
+  return 0;
+}
+} /* anonymous namespace */
+
+dso::Sp3ColumnExporter::Sp3ColumnExporter(const char *dir,
+                                          Sp3ExportOptions opts)
+    : dir_(dir), opts_(opts) {
+  if (opts_.chunk_records < 1)
+    opts_.chunk_records = 1;
+  if (make_dir(dir_))
+    throw std::runtime_error("[ERROR] Failed creating export directory\n");
+}
+
+dso::Sp3ColumnExporter::~Sp3ColumnExporter() noexcept {
+  for (auto &tbl : tables_)
+    close_files(tbl);
+}
+
+std::string dso::Sp3ColumnExporter::column_path(const Table &tbl,
+                                                const char *column) const {
+  return tbl.dir + "/" + column +
+         ((opts_.format == Sp3ExportFormat::npy) ? ".npy" : ".bin");
+}
+
+int dso::Sp3ColumnExporter::sv_index(const sp3::SatelliteId &sv) {
+  uint32_t key = 0;
+  std::memcpy(&key, sv.id, 3);
+  const auto it = sv_map_.find(key);
+  if (it != sv_map_.end())
+    return it->second;
+  svs_.push_back(sv);
+  last_t_.push_back(std::numeric_limits<int64_t>::min());
+  sv_map_.emplace(key, (int)svs_.size() - 1);
+  return svs_.size() - 1;
+}
+
+dso::Sp3ColumnExporter::Table &dso::Sp3ColumnExporter::table_of(int k) {
+  const int idx = (opts_.layout == Sp3ExportLayout::whole_file) ? 0 : k;
+  while ((int)tables_.size() <= idx) {
+    Table tbl;
+    if (opts_.layout == Sp3ExportLayout::whole_file) {
+      tbl.name = "all";
+      tbl.dir = dir_;
+    } else {
+      const auto &sv = svs_[tables_.size()];
+      tbl.name = std::string(sv.id, strnlen(sv.id, 3));
+      tbl.dir = dir_ + "/" + tbl.name;
+    }
+    tables_.push_back(std::move(tbl));
+  }
+  return tables_[idx];
+}
+
+int dso::Sp3ColumnExporter::open_files(Table &tbl) {
+  if (!tbl.fps.empty())
+    return 0;
+  const bool npy = (opts_.format == Sp3ExportFormat::npy);
+  const bool is_new = !tbl.num_records;
+  const auto cols =
+      table_columns(opts_.layout == Sp3ExportLayout::whole_file);
+  if (is_new && opts_.layout == Sp3ExportLayout::per_satellite &&
+      make_dir(tbl.dir))
+    return 1;
+
+  /* make room, closing the least recently written tables */
+  while (num_open_ + (int)cols.size() > MAX_OPEN_FILES) {
+    Table *lru = nullptr;
+    for (auto &t : tables_)
+      if (!t.fps.empty() && (!lru || t.last_flush < lru->last_flush))
+        lru = &t;
+    if (!lru || close_files(*lru))
+      return 1;
+  }
+
+  for (const auto &col : cols) {
+    const std::string fn = column_path(tbl, col.name);
+    std::FILE *fp = std::fopen(fn.c_str(), is_new ? "wb" : "ab");
+    int error = !fp;
+    if (fp) {
+      tbl.fps.push_back(fp);
+      ++num_open_;
+      if (is_new && npy) {
+        const std::string h = npy_header(col.dtype, 0);
+        error = std::fwrite(h.data(), 1, h.size(), fp) != h.size();
+      }
+    }
+    if (error) {
+      fprintf(stderr, "[ERROR] Failed opening file %s: %s (traceback: %s)\n",
+              fn.c_str(), std::strerror(errno), __func__);
+      close_files(tbl);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int dso::Sp3ColumnExporter::close_files(Table &tbl) noexcept {
+  int error = 0;
+  for (auto fp : tbl.fps)
+    error = std::fclose(fp) || error;
+  num_open_ -= tbl.fps.size();
+  tbl.fps.clear();
+  if (error)
+    fprintf(stderr,
+            "[ERROR] Failed closing column files of table %s (traceback: "
+            "%s)\n",
+            tbl.name.c_str(), __func__);
+  return error;
+}
+
+int dso::Sp3ColumnExporter::flush(Table &tbl) {
+  const std::size_t n = tbl.t.size();
+  if (!n)
+    return 0;
+  if (open_files(tbl))
+    return 1;
+
+  /* append the chunk to the column files, in order */
+  std::FILE *const *fp = tbl.fps.data();
+  int error = write_le(*fp++, tbl.t.data(), n);
+  if (opts_.layout == Sp3ExportLayout::whole_file)
+    error = error || std::fwrite(tbl.sv.data(), 1, 3 * n, *fp++) != 3 * n;
+  for (int c = 0; c < NUM_VALUES; c++)
+    error = error || write_le(*fp++, tbl.values[c].data(), n);
+  error = error || write_le(*fp++, tbl.flags.data(), n);
+  if (error) {
+    fprintf(stderr,
+            "[ERROR] Failed writing column files of table %s (traceback: "
+            "%s)\n",
+            tbl.name.c_str(), __func__);
+    return 1;
+  }
+
+  tbl.num_records += n;
+  tbl.last_flush = ++num_flushes_;
+  buffered_ -= n;
+  tbl.t.clear();
+  tbl.sv.clear();
+  for (auto &v : tbl.values)
+    v.clear();
+  tbl.flags.clear();
+  return 0;
+}
+
+int dso::Sp3ColumnExporter::flush_all() {
+  for (auto &tbl : tables_)
+    if (flush(tbl))
+      return 1;
+  return 0;
+}
+
+int dso::Sp3ColumnExporter::add(const Sp3c &sp3) {
+  if (finished_) {
+    fprintf(stderr,
+            "[ERROR] Cannot add file %s to a finished export (traceback: %s)\n",
+            sp3.filename().c_str(), __func__);
+    return 1;
+  }
+  if (!has_ref_) {
+    ref_ = sp3.start_epoch();
+    time_sys_ = sp3.time_sys();
+    has_ref_ = true;
+  } else if (time_sys_ != sp3.time_sys()) {
+    fprintf(stderr,
+            "[WARNING] Time system of file %s (%s) differs from the one of "
+            "the export (%s)\n",
+            sp3.filename().c_str(), sp3.time_sys(), time_sys_.c_str());
+  }
+  const int64_t ref_mjd = ref_.imjd().as_underlying_type();
+  const int64_t ref_nsec = ref_.sec().as_underlying_type();
+
+  Sp3Cursor cursor(sp3);
+  Sp3EpochBuffer buf;
+  int error;
+  while (!(error = cursor.get_next_epoch(buf))) {
+    const int64_t t = (buf.t.imjd().as_underlying_type() - ref_mjd) *
+                          NS_PER_DAY +
+                      (buf.t.sec().as_underlying_type() - ref_nsec);
+    for (int i = 0; i < buf.size(); i++) {
+      const int k = sv_index(buf.sats[i]);
+      if (t <= last_t_[k])
+        continue;
+      last_t_[k] = t;
+      Table &tbl = table_of(k);
+      const Sp3DataBlock &b = buf.blocks[i];
+      tbl.t.push_back(t);
+      if (opts_.layout == Sp3ExportLayout::whole_file) {
+        char id[3] = {0, 0, 0};
+        std::memcpy(id, buf.sats[i].id, strnlen(buf.sats[i].id, 3));
+        tbl.sv.insert(tbl.sv.end(), id, id + 3);
+      }
+      for (int c = 0; c < 8; c++) {
+        tbl.values[c].push_back(b.state[c]);
+        tbl.values[8 + c].push_back(b.state_sdev[c]);
+      }
+      tbl.flags.push_back(b.flag.bits_);
+      ++buffered_;
+    }
+    if (buffered_ >= opts_.chunk_records && flush_all())
+      return 2;
+  }
+  if (error > 0) {
+    fprintf(stderr,
+            "[ERROR] Failed reading data blocks of Sp3 file %s (traceback: "
+            "%s)\n",
+            sp3.filename().c_str(), __func__);
+    return 3;
+  }
+  sources_.push_back(sp3.filename());
+  return 0;
+}
+
+int dso::Sp3ColumnExporter::finish() {
+  if (finished_)
+    return 0;
+  if (flush_all())
+    return 1;
+  for (auto &tbl : tables_)
+    if (close_files(tbl))
+      return 1;
+
+  /* NPY headers hold the final shape */
+  if (opts_.format == Sp3ExportFormat::npy) {
+    const auto cols =
+        table_columns(opts_.layout == Sp3ExportLayout::whole_file);
+    for (const auto &tbl : tables_) {
+      for (const auto &col : cols) {
+        const std::string fn = column_path(tbl, col.name);
+        const std::string h = npy_header(col.dtype, tbl.num_records);
+        std::FILE *fp = std::fopen(fn.c_str(), "r+b");
+        int error = !fp;
+        if (fp) {
+          error = std::fwrite(h.data(), 1, h.size(), fp) != h.size();
+          error = std::fclose(fp) || error;
+        }
+        if (error) {
+          fprintf(stderr,
+                  "[ERROR] Failed finalizing file %s (traceback: %s)\n",
+                  fn.c_str(), __func__);
+          return 2;
+        }
+      }
+    }
+  }
+
+  if (write_manifest())
+    return 3;
+  finished_ = true;
+  return 0;
+}
+
+int dso::Sp3ColumnExporter::write_manifest() const {
+  const bool npy = (opts_.format == Sp3ExportFormat::npy);
+  const bool whole = (opts_.layout == Sp3ExportLayout::whole_file);
+  std::string j("{\n");
+  j += "  \"format\": \"" + std::string(npy ? "npy" : "raw") + "\",\n";
+  j += "  \"layout\": \"" +
+       std::string(whole ? "whole_file" : "per_satellite") + "\",\n";
+  j += "  \"byte_order\": \"little\",\n";
+  j += "  \"time_reference\": {\"mjd\": " +
+       std::to_string(has_ref_ ? ref_.imjd().as_underlying_type() : 0) +
+       ", \"nsec\": " +
+       std::to_string(has_ref_ ? ref_.sec().as_underlying_type() : 0) +
+       ", \"time_system\": " + json_string(time_sys_) + "},\n";
+  j += "  \"num_records\": " + std::to_string(num_records()) + ",\n";
+  j += "  \"sources\": [";
+  for (std::size_t i = 0; i < sources_.size(); i++)
+    j += (i ? ", " : "") + json_string(sources_[i]);
+  j += "],\n  \"satellites\": [";
+  for (std::size_t i = 0; i < svs_.size(); i++)
+    j += (i ? ", " : "") +
+         json_string(std::string(svs_[i].id, strnlen(svs_[i].id, 3)));
+  j += "],\n  \"tables\": [";
+
+  for (std::size_t i = 0; i < tables_.size(); i++) {
+    const Table &tbl = tables_[i];
+    const std::string prefix = whole ? "" : tbl.name + "/";
+    const char *ext = npy ? ".npy" : ".bin";
+    auto column = [&](const ColumnDef &col) {
+      return "\n        {\"name\": \"" + std::string(col.name) +
+             "\", \"file\": " + json_string(prefix + col.name + ext) +
+             ", \"dtype\": \"" + col.dtype + "\", \"unit\": \"" + col.unit +
+             "\"}";
+    };
+    j += (i ? ",\n" : "\n");
+    j += "    {\"name\": " + json_string(tbl.name) +
+         ", \"num_records\": " + std::to_string(tbl.num_records) +
+         ",\n     \"columns\": [" + column(T_COLUMN);
+    if (whole)
+      j += "," + column(SV_COLUMN);
+    for (int c = 0; c < NUM_VALUES; c++)
+      j += "," + column(VALUE_COLUMNS[c]);
+    j += "," + column(FLAG_COLUMN) + "]}";
+  }
+  j += "\n  ]\n}\n";
+
+  const std::string fn = dir_ + "/manifest.json";
+  const std::string tmp = fn + ".tmp";
+  std::FILE *fp = std::fopen(tmp.c_str(), "wb");
+  int error = !fp;
+  if (fp) {
+    error = std::fwrite(j.data(), 1, j.size(), fp) != j.size();
+    error = std::fclose(fp) || error;
+  }
+  if (error || std::rename(tmp.c_str(), fn.c_str())) {
+    fprintf(stderr, "[ERROR] Failed writing manifest %s (traceback: %s)\n",
+            fn.c_str(), __func__);
+    std::remove(tmp.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int64_t dso::Sp3ColumnExporter::num_records() const noexcept {
+  int64_t n = 0;
+  for (const auto &tbl : tables_)
+    n += tbl.num_records + tbl.t.size();
+  return n;
+}
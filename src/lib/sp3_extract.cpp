@@ -0,0 +1,278 @@
+#include "sp3_extract.hpp"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+/* Satellites per '+'/'++' header line, and min number of such lines */
+constexpr int SATS_PER_LINE = 17;
+constexpr int MIN_SAT_LINES = 5;
+
+/* Size of stdio buffers of output files */
+constexpr std::size_t OUT_BUFFER_SIZE = 1 << 16;
+
+/* Start of the line following the one starting at pos */
+int64_t next_line(const char *data, int64_t size, int64_t pos) noexcept {
+  const void *nl = std::memchr(data + pos, '\n', size - pos);
+  return nl ? static_cast<const char *>(nl) - data + 1 : size;
+}
+
+/* End of the record (Position line and any Velocity/correlation lines)
+ * starting at pos
+ */
+int64_t record_end(const char *data, int64_t size, int64_t pos) noexcept {
+  pos = next_line(data, size, pos);
+  while (pos < size &&
+         (data[pos] == 'V' || (data[pos] == 'E' && pos + 1 < size &&
+                               (data[pos + 1] == 'P' || data[pos + 1] == 'V'))))
+    pos = next_line(data, size, pos);
+  return pos;
+}
+
+/* Epochs and satellites (indexes) selected off from a file */
+struct Selection {
+  std::vector<int> epochs;
+  std::vector<int> sats;
+  int every{1};
+}; /* struct Selection */
+
+int select(dso::Sp3c &sp3, const dso::Sp3Filter &f, Selection &sel) noexcept {
+  if (f.require_bits || f.reject_bits) {
+    fprintf(stderr,
+            "[ERROR] Cannot select records on flags without decoding them "
+            "(traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+  if (!sp3.has_index() && sp3.build_index()) {
+    fprintf(stderr, "[ERROR] Failed indexing Sp3 file %s (traceback: %s)\n",
+            sp3.filename().c_str(), __func__);
+    return 2;
+  }
+  if (!sp3.raw_data())
+    return 3;
+
+  const auto &idx = sp3.index();
+  try {
+    long count = 0;
+    for (int i = idx.lower_bound(f.t_start);
+         i < idx.num_epochs() && idx.epochs[i] <= f.t_stop; i++)
+      if (!(count++ % f.every))
+        sel.epochs.push_back(i);
+    const auto &svs = sp3.sattellite_vector();
+    for (int j = 0; j < (int)svs.size(); j++)
+      if (f.svs.accepts(svs[j]))
+        sel.sats.push_back(j);
+  } catch (std::exception &) {
+    return 4;
+  }
+  sel.every = f.every;
+  return (sel.epochs.empty() || sel.sats.empty()) ? -1 : 0;
+}
+
+/* Write the header of a file holding the epochs and satellites selected;
+ * lines are copied off from the original header, except for the ones
+ * holding the start epoch, the number of epochs and the satellites.
+ */
+int write_header(const dso::Sp3c &sp3, const Selection &sel,
+                 const std::vector<int> &sats, std::FILE *fp) noexcept {
+  const char *data = sp3.raw_data();
+  const int64_t size = sp3.raw_size();
+  const int64_t eoh = sp3.header_size();
+  const auto &idx = sp3.index();
+
+  /* the epoch line of the first epoch; its date fields are laid out as in
+   * the first header line
+   */
+  const int64_t ep = idx.epoch_pos[sel.epochs.front()];
+  const int64_t ep_end = next_line(data, size, ep);
+  if (ep_end - ep < 31)
+    return 1;
+
+  /* accuracy codes of the satellites, off from the '++' lines */
+  std::vector<const char *> accuracy;
+  std::vector<int64_t> lines;
+  for (int64_t pos = 0; pos < eoh; pos = next_line(data, size, pos)) {
+    lines.push_back(pos);
+    if (!std::strncmp(data + pos, "++", 2))
+      for (int k = 0; k < SATS_PER_LINE; k++)
+        accuracy.push_back(data + pos + 9 + 3 * k);
+  }
+
+  char buf[128];
+  bool sat_lines_done = false;
+  int error = 0;
+  for (std::size_t l = 0; l < lines.size() && !error; l++) {
+    const int64_t pos = lines[l];
+    const int64_t end = (l + 1 < lines.size()) ? lines[l + 1] : eoh;
+    const char *line = data + pos;
+    if (l == 0) {
+      /* start epoch and number of epochs */
+      if (end - pos < 40)
+        return 1;
+      std::string s(line, end - pos);
+      std::memcpy(&s[3], data + ep + 3, 28);
+      std::snprintf(buf, sizeof buf, "%7d", (int)sel.epochs.size());
+      std::memcpy(&s[32], buf, 7);
+      error = std::fwrite(s.data(), 1, s.size(), fp) != s.size();
+    } else if (l == 1) {
+      /* GPS week and seconds, interval, MJD and fraction of day */
+      const auto &t = idx.epochs[sel.epochs.front()];
+      dso::nanoseconds sow;
+      const long week = t.gps_wsow(sow).as_underlying_type();
+      const double interval =
+          sp3.interval().as_underlying_type() * 1e-9 * sel.every;
+      std::snprintf(buf, sizeof buf, "## %4ld %15.8f %14.8f %5ld %15.13f\n",
+                    week, sow.as_underlying_type() * 1e-9, interval,
+                    (long)t.imjd().as_underlying_type(),
+                    t.sec().as_underlying_type() * 1e-9 / 86400e0);
+      error = std::fputs(buf, fp) < 0;
+    } else if (line[0] == '+') {
+      /* satellite id and accuracy lines; written once, in full */
+      if (sat_lines_done)
+        continue;
+      sat_lines_done = true;
+      const int n = sats.size();
+      const int num_lines =
+          std::max(MIN_SAT_LINES, (n + SATS_PER_LINE - 1) / SATS_PER_LINE);
+      const auto &svs = sp3.sattellite_vector();
+      for (int pass = 0; pass < 2 && !error; pass++) {
+        for (int k = 0; k < num_lines && !error; k++) {
+          std::string s;
+          if (pass == 0) {
+            std::snprintf(buf, sizeof buf, "+  %3d   ", k ? 0 : n);
+            s = k ? std::string("+        ") : std::string(buf);
+          } else {
+            s = "++       ";
+          }
+          for (int m = k * SATS_PER_LINE; m < (k + 1) * SATS_PER_LINE; m++) {
+            if (m >= n)
+              s += "  0";
+            else if (pass == 0)
+              s.append(svs[sats[m]].id, 3);
+            else if (sats[m] < (int)accuracy.size())
+              s.append(accuracy[sats[m]], 3);
+            else
+              s += "  0";
+          }
+          s.push_back('\n');
+          error = std::fwrite(s.data(), 1, s.size(), fp) != s.size();
+        }
+      }
+    } else {
+      error = std::fwrite(line, 1, end - pos, fp) != (std::size_t)(end - pos);
+    }
+  }
+  return error;
+}
+
+/* An output file, written to a temporary and renamed once complete */
+struct OutFile {
+  std::string fn, tmp;
+  std::FILE *fp{nullptr};
+  std::unique_ptr<char[]> buf;
+
+  int open(const std::string &name) noexcept {
+    fn = name;
+    tmp = name + ".tmp";
+    if (!(fp = std::fopen(tmp.c_str(), "wb"))) {
+      fprintf(stderr, "[ERROR] Failed opening file %s (traceback: %s)\n",
+              tmp.c_str(), __func__);
+      return 1;
+    }
+    buf.reset(new (std::nothrow) char[OUT_BUFFER_SIZE]);
+    if (buf)
+      std::setvbuf(fp, buf.get(), _IOFBF, OUT_BUFFER_SIZE);
+    return 0;
+  }
+
+  /* close; renamed into place if ok, else removed */
+  int close(bool ok) noexcept {
+    if (!fp)
+      return 1;
+    ok = !std::fclose(fp) && ok;
+    fp = nullptr;
+    if (ok && !std::rename(tmp.c_str(), fn.c_str()))
+      return 0;
+    fprintf(stderr, "[ERROR] Failed writing file %s (traceback: %s)\n",
+            fn.c_str(), __func__);
+    std::remove(tmp.c_str());
+    return 1;
+  }
+
+  ~OutFile() noexcept {
+    if (fp)
+      close(false);
+  }
+}; /* struct OutFile */
+
+/* Write the data blocks of epoch (index) i, for satellites sats */
+int write_epoch(const dso::Sp3c &sp3, int i, const int *sats, int num_sats,
+                std::FILE *fp) noexcept {
+  const char *data = sp3.raw_data();
+  const int64_t size = sp3.raw_size();
+  const auto &idx = sp3.index();
+  const int64_t ep = idx.epoch_pos[i];
+  const int64_t ep_end = next_line(data, size, ep);
+  if (std::fwrite(data + ep, 1, ep_end - ep, fp) != (std::size_t)(ep_end - ep))
+    return 1;
+  for (int k = 0; k < num_sats; k++) {
+    const int32_t off = idx.sv_offset(i, sats[k]);
+    if (off < 0)
+      continue;
+    const int64_t end = record_end(data, size, ep + off);
+    if (std::fwrite(data + ep + off, 1, end - ep - off, fp) !=
+        (std::size_t)(end - ep - off))
+      return 1;
+  }
+  return 0;
+}
+} /* anonymous namespace */
+
+int dso::sp3::extract(Sp3c &sp3, const char *out, const Sp3Filter &f) {
+  Selection sel;
+  if (int error = select(sp3, f, sel); error)
+    return error;
+
+  OutFile of;
+  if (of.open(out))
+    return 10;
+  int error = write_header(sp3, sel, sel.sats, of.fp);
+  for (std::size_t e = 0; e < sel.epochs.size() && !error; e++)
+    error = write_epoch(sp3, sel.epochs[e], sel.sats.data(), sel.sats.size(),
+                        of.fp);
+  error = error || std::fputs("EOF\n", of.fp) < 0;
+  return of.close(!error) ? 11 : 0;
+}
+
+int dso::sp3::split_satellites(Sp3c &sp3, const std::string &prefix,
+                               const Sp3Filter &f) {
+  Selection sel;
+  if (int error = select(sp3, f, sel); error)
+    return error;
+
+  const auto &svs = sp3.sattellite_vector();
+  std::vector<OutFile> files(sel.sats.size());
+  int error = 0;
+  for (std::size_t k = 0; k < sel.sats.size() && !error; k++) {
+    const auto &sv = svs[sel.sats[k]];
+    const std::string fn =
+        prefix + std::string(sv.id, strnlen(sv.id, 3)) + ".sp3";
+    error = files[k].open(fn) ||
+            write_header(sp3, sel, {sel.sats[k]}, files[k].fp);
+  }
+
+  /* one pass over the epochs, distributing records to files */
+  for (std::size_t e = 0; e < sel.epochs.size() && !error; e++)
+    for (std::size_t k = 0; k < sel.sats.size() && !error; k++)
+      error = write_epoch(sp3, sel.epochs[e], &sel.sats[k], 1, files[k].fp);
+
+  int failed = 0;
+  for (auto &of : files) {
+    const bool ok = !error && of.fp && std::fputs("EOF\n", of.fp) >= 0;
+    if (of.fp)
+      failed += of.close(ok);
+  }
+  return (error || failed) ? 11 : 0;
+}
@@ -0,0 +1,179 @@
+#include "sp3_fanout.hpp"
+#include <cstdio>
+#include <exception>
+
+namespace {
+/* Call a subscriber's on_epoch; exceptions unsubscribe it */
+int deliver(dso::Sp3Subscriber *sub, const dso::Sp3EpochBuffer &epoch) {
+  try {
+    return sub->on_epoch(epoch);
+  } catch (std::exception &e) {
+    fprintf(stderr,
+            "[ERROR] Subscriber threw while consuming an epoch; it is "
+            "unsubscribed (traceback: %s)\n",
+            __func__);
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+    return 1;
+  }
+}
+
+/* Call a subscriber's on_end; exceptions are reported */
+void finish(dso::Sp3Subscriber *sub, int status) noexcept {
+  try {
+    sub->on_end(status);
+  } catch (std::exception &e) {
+    fprintf(stderr,
+            "[ERROR] Subscriber threw at the end of publishing (traceback: "
+            "%s)\n",
+            __func__);
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+  }
+}
+} /* anonymous namespace */
+
+int dso::Sp3FanOut::subscribe(Sp3Subscriber *sub, bool threaded) {
+  auto ch = std::make_unique<Channel>();
+  ch->sub = sub;
+  ch->threaded = threaded;
+  channels_.push_back(std::move(ch));
+  return channels_.size() - 1;
+}
+
+std::shared_ptr<dso::Sp3EpochBuffer> dso::Sp3FanOut::acquire_buffer() {
+  std::lock_guard<std::mutex> lock(pool_mtx_);
+  if (free_.empty()) {
+    buffers_.push_back(std::make_unique<Sp3EpochBuffer>());
+    free_.push_back(buffers_.back().get());
+  }
+  Sp3EpochBuffer *buf = free_.back();
+  free_.pop_back();
+  return std::shared_ptr<Sp3EpochBuffer>(buf, [this](Sp3EpochBuffer *p) {
+    std::lock_guard<std::mutex> l(pool_mtx_);
+    free_.push_back(p);
+  });
+}
+
+void dso::Sp3FanOut::push(Channel &ch, int capacity, const EpochPtr &epoch) {
+  std::unique_lock<std::mutex> lock(ch.mtx);
+  if ((int)ch.queue.size() >= capacity && !ch.done) {
+    ++ch.stats.stalls;
+    ch.cv.wait(lock,
+               [&] { return (int)ch.queue.size() < capacity || ch.done; });
+  }
+  if (ch.done)
+    return;
+  ch.queue.push_back(epoch);
+  if ((int)ch.queue.size() > ch.stats.max_queued)
+    ch.stats.max_queued = ch.queue.size();
+  ch.cv.notify_all();
+}
+
+void dso::Sp3FanOut::consume(Channel &ch) noexcept {
+  for (;;) {
+    EpochPtr epoch;
+    {
+      std::unique_lock<std::mutex> lock(ch.mtx);
+      ch.cv.wait(lock, [&] { return !ch.queue.empty() || ch.closed; });
+      if (ch.queue.empty())
+        break;
+      epoch = std::move(ch.queue.front());
+      ch.queue.pop_front();
+      /* room in queue; wake the parser, if waiting */
+      ch.cv.notify_all();
+    }
+    ++ch.stats.delivered;
+    if (int status = deliver(ch.sub, *epoch); status) {
+      std::lock_guard<std::mutex> lock(ch.mtx);
+      ch.status = status;
+      ch.done = true;
+      ch.queue.clear();
+      ch.cv.notify_all();
+      break;
+    }
+  }
+
+  int end_status;
+  {
+    /* wait for the parser to finish, if we unsubscribed early */
+    std::unique_lock<std::mutex> lock(ch.mtx);
+    ch.cv.wait(lock, [&] { return ch.closed; });
+    end_status = ch.end_status;
+  }
+  finish(ch.sub, end_status);
+}
+
+int dso::Sp3FanOut::run(const Sp3c &sp3, const Sp3Filter &f) {
+  for (auto &ch : channels_) {
+    ch->queue.clear();
+    ch->closed = ch->done = false;
+    ch->status = ch->end_status = 0;
+    ch->stats = Sp3FanOutStats();
+  }
+  Sp3Cursor cursor(sp3);
+  long count = 0;
+  int error = 0;
+  try {
+    for (auto &ch : channels_)
+      if (ch->threaded)
+        ch->thread = std::thread(consume, std::ref(*ch));
+
+    for (;;) {
+      /* anyone still listening ? */
+      bool active = false;
+      for (auto &ch : channels_) {
+        std::lock_guard<std::mutex> lock(ch->mtx);
+        active = active || !ch->done;
+      }
+      if (!active)
+        break;
+
+      auto buf = acquire_buffer();
+      if ((error = f.next_epoch(cursor, *buf, count))) {
+        if (error > 0)
+          fprintf(stderr,
+                  "[ERROR] Failed reading data block of Sp3 file %s; "
+                  "publishing stops (traceback: %s)\n",
+                  sp3.filename().c_str(), __func__);
+        break;
+      }
+      const EpochPtr epoch(std::move(buf));
+
+      for (auto &ch : channels_) {
+        if (ch->threaded) {
+          push(*ch, capacity_, epoch);
+        } else if (!ch->done) {
+          ++ch->stats.delivered;
+          if ((ch->status = deliver(ch->sub, *epoch)))
+            ch->done = true;
+        }
+      }
+    }
+  } catch (std::exception &e) {
+    fprintf(stderr,
+            "[ERROR] Failed publishing epochs of Sp3 file %s; publishing "
+            "stops (traceback: %s)\n",
+            sp3.filename().c_str(), __func__);
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+    error = 1;
+  }
+  if (error < 0)
+    error = 0;
+
+  /* close all channels, joining any subscriber thread started (also when
+   * failing half-way); subscribers without a thread end here
+   */
+  for (auto &ch : channels_) {
+    if (ch->thread.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(ch->mtx);
+        ch->closed = true;
+        ch->end_status = error;
+        ch->cv.notify_all();
+      }
+      ch->thread.join();
+    } else {
+      finish(ch->sub, error);
+    }
+  }
+  return error;
+}
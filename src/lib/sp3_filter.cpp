@@ -0,0 +1,134 @@
+#include "sp3_filter.hpp"
+
+dso::Sp3Filter dso::Sp3Filter::operator|(const Sp3Filter &f) const {
+  Sp3Filter r(*this);
+
+  /* intersect SV selections */
+  if (r.svs.systems.empty()) {
+    r.svs.systems = f.svs.systems;
+  } else if (!f.svs.systems.empty()) {
+    std::string common;
+    for (char c : r.svs.systems)
+      if (f.svs.systems.find(c) != std::string::npos)
+        common.push_back(c);
+    /* nothing in common: a system id no SV has */
+    r.svs.systems = common.empty() ? std::string(1, '\0') : common;
+  }
+  if (r.svs.svs.empty()) {
+    r.svs.svs = f.svs.svs;
+  } else if (!f.svs.svs.empty()) {
+    std::vector<sp3::SatelliteId> common;
+    for (const auto &sv : r.svs.svs)
+      if (std::find(f.svs.svs.cbegin(), f.svs.svs.cend(), sv) !=
+          f.svs.svs.cend())
+        common.push_back(sv);
+    if (common.empty())
+      r.svs.systems = std::string(1, '\0');
+    r.svs.svs = std::move(common);
+  }
+
+  /* intersect time windows */
+  if (f.t_start > r.t_start)
+    r.t_start = f.t_start;
+  if (f.t_stop < r.t_stop)
+    r.t_stop = f.t_stop;
+
+  r.every *= f.every;
+  r.require_bits |= f.require_bits;
+  r.reject_bits |= f.reject_bits;
+  return r;
+}
+
+int dso::Sp3Filter::next_epoch(Sp3Cursor &cursor, Sp3EpochBuffer &buf,
+                               long &count) const noexcept {
+  /* jump to the start of the time window, if the file is indexed */
+  const Sp3c &sp3 = cursor.sp3();
+  if (!count && sp3.has_index() &&
+      t_start != dso::datetime<dso::nanoseconds>::min()) {
+    const int idx = sp3.index().lower_bound(t_start);
+    const int64_t pos = (idx < sp3.index().num_epochs())
+                            ? sp3.index().epoch_pos[idx]
+                            : -1;
+    if (pos < 0)
+      return -1;
+    if (pos > cursor.tell() && cursor.seek(pos))
+      return 1;
+  }
+
+  for (;;) {
+    /* epoch-level stages, before parsing any records */
+    dso::datetime<dso::nanoseconds> t;
+    if (int error = cursor.peak_next_data_block(t); error < 0 || error == 1)
+      return -1;
+    else if (error)
+      return error;
+    if (t > t_stop)
+      return -1;
+    if (t < t_start || (count++ % every)) {
+      if (int error = cursor.skip_epoch(); error)
+        return error;
+      continue;
+    }
+
+    /* SV selection, while parsing */
+    if (int error = cursor.get_next_epoch(buf, svs); error)
+      return error;
+
+    /* flag stages; compact in place */
+    if (require_bits || reject_bits) {
+      int k = 0;
+      for (int i = 0; i < buf.size(); i++) {
+        if (accepts(buf.blocks[i])) {
+          if (k != i) {
+            buf.sats[k] = buf.sats[i];
+            buf.blocks[k] = buf.blocks[i];
+          }
+          ++k;
+        }
+      }
+      buf.sats.resize(k);
+      buf.blocks.resize(k);
+    }
+    if (buf.size())
+      return 0;
+  }
+}
+
+dso::Sp3Filter dso::sp3::systems(const char *ids) {
+  Sp3Filter f;
+  f.svs.systems = ids;
+  return f;
+}
+
+dso::Sp3Filter dso::sp3::satellites(std::initializer_list<SatelliteId> svs) {
+  Sp3Filter f;
+  f.svs.svs.assign(svs.begin(), svs.end());
+  return f;
+}
+
+dso::Sp3Filter dso::sp3::with_event(Sp3Event e) noexcept {
+  Sp3Filter f;
+  f.require_bits = (1 << static_cast<sp3::uitype>(e));
+  return f;
+}
+
+dso::Sp3Filter dso::sp3::without_event(Sp3Event e) noexcept {
+  Sp3Filter f;
+  f.reject_bits = (1 << static_cast<sp3::uitype>(e));
+  return f;
+}
+
+dso::Sp3Filter
+dso::sp3::time_window(const dso::datetime<dso::nanoseconds> &t0,
+                      const dso::datetime<dso::nanoseconds> &t1) noexcept {
+  Sp3Filter f;
+  f.t_start = t0;
+  f.t_stop = t1;
+  return f;
+}
+
+dso::Sp3Filter dso::sp3::decimate(int n) noexcept {
+  Sp3Filter f;
+  f.every = (n > 0) ? n : 1;
+  return f;
+}
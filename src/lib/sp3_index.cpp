@@ -0,0 +1,389 @@
+#include "core/sp3_hash.hpp"
+#include "core/sp3_pod_io.hpp"
+#include "sp3.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <unistd.h>
+
+using dso::sp3::FNV_OFFSET_BASIS;
+using dso::sp3::SatelliteId;
+using dso::sp3::fnv1a;
+using dso::sp3::read_pod;
+using dso::sp3::read_vec;
+using dso::sp3::write_pod;
+using dso::sp3::write_vec;
+
+namespace {
+/* Max record characters (for a navigation data block) */
+constexpr int MAX_RECORD_CHARS{128};
+
+/* Size of chunks to read in when scanning an Sp3 file */
+constexpr std::size_t SCAN_CHUNK_SIZE{1 << 20};
+
+/* Number of trailing bytes of the file considered in the fingerprint hash */
+constexpr std::size_t FINGERPRINT_TAIL_BYTES{4096};
+
+/* Sidecar index file identifier and format version; as of version 2, the
+ * fingerprint's mtime is in nsec since the Unix epoch
+ */
+constexpr char SIDECAR_MAGIC[4] = {'S', 'P', '3', 'I'};
+constexpr uint32_t SIDECAR_VERSION{2};
+} /* anonymous namespace */
+
+int dso::Sp3EpochIndex::lower_bound(
+    const dso::datetime<dso::nanoseconds> &t) const noexcept {
+  return std::lower_bound(epochs.cbegin(), epochs.cend(), t) - epochs.cbegin();
+}
+
+std::string dso::Sp3c::sidecar_filename() const noexcept {
+  const auto sz = __filename.size();
+  if (sz > 4 && (!__filename.compare(sz - 4, 4, ".sp3") ||
+                 !__filename.compare(sz - 4, 4, ".SP3")))
+    return __filename + "i";
+  return __filename + ".sp3i";
+}
+
+/** The fingerprint is made up of the file size, the last modification time
+ *  and a hash of the header and the last FINGERPRINT_TAIL_BYTES bytes of the
+ *  file. The latter should capture files re-written in place, where the
+ *  size and time resolution of the filesystem would not suffice. All of it
+ *  describes the file as mapped (i.e. the bytes cursors read), and is
+ *  computed only when the file is (re-)mapped.
+ */
+void dso::Sp3c::compute_fingerprint() noexcept {
+  fingerprint__ = Sp3Fingerprint();
+  const char *data = map__.data();
+  if (!data)
+    return;
+
+  const int64_t size = map__.size();
+  const int64_t eoh = std::min<int64_t>(__end_of_head, size);
+  const int64_t tail =
+      std::max<int64_t>(eoh, size - (int64_t)FINGERPRINT_TAIL_BYTES);
+  fingerprint__.size = size;
+  fingerprint__.mtime = map__.mtime();
+  fingerprint__.hash = fnv1a(fnv1a(FNV_OFFSET_BASIS, data, eoh), data + tail,
+                             size - tail);
+}
+
+int dso::Sp3c::sv_fingerprints(std::vector<uint64_t> &hashes) const noexcept {
+  const int nsats = sat_vec__.size();
+  hashes.assign(nsats, FNV_OFFSET_BASIS);
+  if (!map__.data())
+    return 1;
+
+  /* last epoch line, and the satellites that have hashed it in */
+  const char *epoch_line = nullptr;
+  std::size_t epoch_len = 0;
+  std::vector<int> epoch_seen(nsats, -1);
+  int epoch_count = -1;
+  int sat = -1;
+
+  const char *p = map__.data() + __end_of_head;
+  const char *const end = map__.data() + map__.size();
+  while (p < end) {
+    const char *eol =
+        static_cast<const char *>(std::memchr(p, '\n', end - p));
+    if (!eol)
+      eol = end;
+    std::size_t len = eol - p;
+    while (len && (p[len - 1] == ' ' || p[len - 1] == '\r'))
+      --len;
+
+    if (*p == '*') {
+      epoch_line = p;
+      epoch_len = len;
+      ++epoch_count;
+      sat = -1;
+    } else if ((*p == 'P' || *p == 'V') && len > sp3::SAT_ID_CHARS) {
+      const SatelliteId sv(p + 1);
+      if (sat < 0 || sat_vec__[sat] != sv) {
+        auto it = std::find(sat_vec__.cbegin(), sat_vec__.cend(), sv);
+        sat = (it == sat_vec__.cend()) ? -1 : (int)(it - sat_vec__.cbegin());
+      }
+      if (sat >= 0 && epoch_seen[sat] != epoch_count) {
+        hashes[sat] = fnv1a(hashes[sat], epoch_line, epoch_len);
+        epoch_seen[sat] = epoch_count;
+      }
+      if (sat >= 0)
+        hashes[sat] = fnv1a(hashes[sat], p, len);
+    } else if (*p == 'E' && len > 1 && (p[1] == 'P' || p[1] == 'V')) {
+      /* correlation records follow the record of the satellite */
+      if (sat >= 0)
+        hashes[sat] = fnv1a(hashes[sat], p, len);
+    } else if (len >= 3 && !std::strncmp(p, "EOF", 3)) {
+      break;
+    }
+    p = eol + 1;
+  }
+
+  return 0;
+}
+
+/** Scan the whole file (past the header) once, in big chunks, recording
+ *  the offsets of Epoch Header and Position Records. Note that we are using
+ *  an independent stream, so that the instance's stream is left untouched.
+ */
+int dso::Sp3c::build_index() noexcept {
+  index__.clear();
+  Sp3EpochIndex idx;
+  idx.num_sats = sat_vec__.size();
+  idx.fingerprint = fingerprint__;
+
+  std::ifstream fin(__filename, std::ios::binary);
+  if (!fin.is_open())
+    return 1;
+  fin.seekg(__end_of_head, std::ios::beg);
+
+  std::vector<char> buf(2 * SCAN_CHUNK_SIZE);
+  /* file offset of buf[0] and number of (valid) bytes in buffer */
+  int64_t offset = static_cast<int64_t>(__end_of_head);
+  std::size_t have = 0;
+  /* index (hint) of the last satellite matched */
+  int sv_hint = -1;
+  char line[MAX_RECORD_CHARS];
+
+  /* resolve one line, of size count, starting at file offset pos; return
+   * -1 on 'EOF' line, 0 if ok, and >0 on error
+   */
+  auto resolve_line = [&](const char *str, std::size_t count,
+                          int64_t pos) -> int {
+    if (*str == '*') {
+      count = std::min<std::size_t>(count, MAX_RECORD_CHARS - 1);
+      std::memcpy(line, str, count);
+      line[count] = '\0';
+      dso::datetime<dso::nanoseconds> t;
+      if (resolve_epoch_line(line, t))
+        return 1;
+      idx.epoch_pos.push_back(pos);
+      idx.epochs.push_back(t);
+      idx.sv_pos.insert(idx.sv_pos.end(), idx.num_sats, -1);
+      sv_hint = -1;
+    } else if (*str == 'P') {
+      if (idx.epochs.empty() || count < 4)
+        return 2;
+      const SatelliteId sv(str + 1);
+      /* records are (normally) in the order of the header */
+      int k = sv_hint + 1;
+      if (k >= idx.num_sats || sat_vec__[k] != sv) {
+        k = std::find(sat_vec__.cbegin(), sat_vec__.cend(), sv) -
+            sat_vec__.cbegin();
+        if (k == idx.num_sats) {
+          fprintf(stderr,
+                  "[ERROR] Satellite %.3s not listed in Sp3 header "
+                  "(traceback: %s)\n",
+                  sv.id, __func__);
+          return 3;
+        }
+      }
+      sv_hint = k;
+      idx.sv_pos[(idx.num_epochs() - 1) * idx.num_sats + k] =
+          static_cast<int32_t>(pos - idx.epoch_pos.back());
+    } else if (count >= 3 && !std::strncmp(str, "EOF", 3)) {
+      return -1;
+    }
+    return 0;
+  };
+
+  int status = 0;
+  bool done = false;
+  while (!done) {
+    fin.read(buf.data() + have, SCAN_CHUNK_SIZE);
+    const std::size_t nread = fin.gcount();
+    have += nread;
+    std::size_t start = 0;
+    for (;;) {
+      const char *nl = static_cast<const char *>(
+          std::memchr(buf.data() + start, '\n', have - start));
+      if (!nl) {
+        /* last line of file may not end with a newline character */
+        if (!nread) {
+          if (have > start)
+            status = resolve_line(buf.data() + start, have - start,
+                                  offset + start);
+          done = true;
+        }
+        break;
+      }
+      const std::size_t end = nl - buf.data();
+      if ((status = resolve_line(buf.data() + start, end - start,
+                                 offset + start))) {
+        done = true;
+        break;
+      }
+      start = end + 1;
+    }
+    /* move any incomplete line to the start of the buffer */
+    std::memmove(buf.data(), buf.data() + start, have - start);
+    offset += start;
+    have -= start;
+    if (have >= SCAN_CHUNK_SIZE) {
+      /* no newline character found in a whole chunk */
+      status = 10;
+      done = true;
+    }
+  }
+
+  if (status > 0) {
+    fprintf(stderr,
+            "[ERROR] Failed building epoch index for Sp3 file %s, error=%d "
+            "(traceback: %s)\n",
+            __filename.c_str(), status, __func__);
+    return status;
+  }
+
+  index__ = std::move(idx);
+  return 0;
+}
+
+int dso::Sp3c::write_index(const char *fn) const noexcept {
+  if (index__.empty())
+    return 1;
+
+  const std::string ifn = fn ? std::string(fn) : sidecar_filename();
+  const std::string tmp = ifn + ".tmp" + std::to_string(getpid());
+
+  std::ofstream fout(tmp, std::ios::binary | std::ios::trunc);
+  if (!fout.is_open()) {
+    fprintf(stderr,
+            "[ERROR] Failed to open index file %s for writing (traceback: "
+            "%s)\n",
+            tmp.c_str(), __func__);
+    return 2;
+  }
+
+  fout.write(SIDECAR_MAGIC, sizeof SIDECAR_MAGIC);
+  write_pod(fout, SIDECAR_VERSION);
+  write_pod(fout, index__.fingerprint.size);
+  write_pod(fout, index__.fingerprint.mtime);
+  write_pod(fout, index__.fingerprint.hash);
+  write_pod(fout, static_cast<uint32_t>(index__.num_sats));
+  write_pod(fout, static_cast<uint64_t>(index__.num_epochs()));
+  for (const auto &sv : sat_vec__)
+    fout.write(sv.id, sp3::SAT_ID_CHARS);
+  write_vec(fout, index__.epoch_pos);
+  for (const auto &t : index__.epochs) {
+    write_pod(fout, static_cast<int64_t>(t.imjd().as_underlying_type()));
+    write_pod(fout, static_cast<int64_t>(t.sec().as_underlying_type()));
+  }
+  write_vec(fout, index__.sv_pos);
+  fout.close();
+
+  std::error_code ec;
+  if (!fout.good() || (std::filesystem::rename(tmp, ifn, ec), ec)) {
+    fprintf(stderr, "[ERROR] Failed to write index file %s (traceback: %s)\n",
+            ifn.c_str(), __func__);
+    std::filesystem::remove(tmp, ec);
+    return 3;
+  }
+
+  return 0;
+}
+
+int dso::Sp3c::load_index(const char *fn) noexcept {
+  index__.clear();
+
+  const std::string ifn = fn ? std::string(fn) : sidecar_filename();
+  std::ifstream fin(ifn, std::ios::binary);
+  if (!fin.is_open())
+    return -1;
+
+  char magic[sizeof SIDECAR_MAGIC];
+  uint32_t version = 0, nsats = 0;
+  uint64_t nepochs = 0;
+  Sp3EpochIndex idx;
+  fin.read(magic, sizeof magic);
+  read_pod(fin, version);
+  read_pod(fin, idx.fingerprint.size);
+  read_pod(fin, idx.fingerprint.mtime);
+  read_pod(fin, idx.fingerprint.hash);
+  read_pod(fin, nsats);
+  read_pod(fin, nepochs);
+  if (!fin.good() || std::memcmp(magic, SIDECAR_MAGIC, sizeof magic) ||
+      version != SIDECAR_VERSION)
+    return -2;
+
+  /* the index must describe the file as it is now */
+  if (fingerprint__ != idx.fingerprint || nsats != sat_vec__.size() ||
+      nepochs > fingerprint__.size)
+    return -2;
+
+  /* same satellites, in the same order */
+  char id[sp3::SAT_ID_CHARS];
+  for (const auto &sv : sat_vec__) {
+    fin.read(id, sp3::SAT_ID_CHARS);
+    if (std::strncmp(id, sv.id, sp3::SAT_ID_CHARS))
+      return -2;
+  }
+
+  idx.num_sats = nsats;
+  idx.epoch_pos.resize(nepochs);
+  idx.sv_pos.resize(nepochs * nsats);
+  idx.epochs.reserve(nepochs);
+  read_vec(fin, idx.epoch_pos);
+  for (uint64_t i = 0; i < nepochs; i++) {
+    int64_t mjd, nsec;
+    read_pod(fin, mjd);
+    read_pod(fin, nsec);
+    idx.epochs.emplace_back(dso::modified_julian_day(mjd),
+                            dso::nanoseconds(nsec));
+  }
+  read_vec(fin, idx.sv_pos);
+  if (!fin.good()) {
+    fprintf(stderr,
+            "[ERROR] Failed reading (corrupt?) index file %s (traceback: "
+            "%s)\n",
+            ifn.c_str(), __func__);
+    return 2;
+  }
+
+  index__ = std::move(idx);
+  return 0;
+}
+
+int dso::Sp3c::use_sidecar_index(bool persist) noexcept {
+  if (!load_index())
+    return 0;
+
+  if (int error = build_index(); error)
+    return error;
+
+  /* failing to persist the index is not fatal */
+  if (persist && write_index()) {
+    fprintf(stderr,
+            "[WARNING] Failed to persist sidecar index for Sp3 file %s "
+            "(traceback: %s)\n",
+            __filename.c_str(), __func__);
+  }
+  return 0;
+}
+
+int dso::Sp3c::seek_epoch(int idx) noexcept {
+  if (idx < 0 || idx >= index__.num_epochs())
+    return 1;
+  __istream.clear();
+  __istream.seekg(index__.epoch_pos[idx], std::ios::beg);
+  return !__istream.good();
+}
+
+int dso::Sp3c::get_data_block(int idx, SatelliteId satid,
+                              Sp3DataBlock &block) const noexcept {
+  if (idx < 0 || idx >= index__.num_epochs())
+    return 1;
+  const int k = std::find(sat_vec__.cbegin(), sat_vec__.cend(), satid) -
+                sat_vec__.cbegin();
+  if (k == (int)sat_vec__.size())
+    return 2;
+
+  block.t = index__.epochs[idx];
+  block.flag.set_defaults();
+  const int32_t offset = index__.sv_offset(idx, k);
+  if (offset < 0)
+    return -1;
+
+  Sp3Cursor cursor(*this);
+  if (cursor.seek(index__.epoch_pos[idx] + offset))
+    return 3;
+  return cursor.get_sv_records(satid, block);
+}
@@ -0,0 +1,177 @@
+#include "sp3_mapped_file.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+/* Read (up to) count bytes of file fd, starting at pos */
+int64_t read_at(int fd, int64_t pos, char *buf, int64_t count) noexcept {
+  int64_t done = 0;
+  while (done < count) {
+    const ssize_t n = ::pread(fd, buf + done, count - done, pos + done);
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  return done;
+}
+
+/* Modification time of a file [nsec since the Unix epoch] */
+int64_t mtime_of(const struct stat &st) noexcept {
+#ifdef __APPLE__
+  return (int64_t)st.st_mtimespec.tv_sec * 1'000'000'000L +
+         st.st_mtimespec.tv_nsec;
+#else
+  return (int64_t)st.st_mtim.tv_sec * 1'000'000'000L + st.st_mtim.tv_nsec;
+#endif
+}
+
+/* Anonymous (private) memory, to hold a snapshot of size bytes */
+void *map_anonymous(std::size_t size) noexcept {
+  return ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+} /* anonymous namespace */
+
+int dso::sp3::MappedFile::map(const char *fn, MapMode mode) noexcept {
+  unmap();
+
+  const int fd = ::open(fn, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "[ERROR] Failed opening file %s (traceback: %s)\n", fn,
+            __func__);
+    return 1;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) || st.st_size <= 0) {
+    ::close(fd);
+    return 2;
+  }
+
+  void *ptr;
+  if (mode == MapMode::snapshot) {
+    ptr = map_anonymous(st.st_size);
+    if (ptr != MAP_FAILED &&
+        read_at(fd, 0, static_cast<char *>(ptr), st.st_size) != st.st_size) {
+      /* the file shrunk while being read */
+      ::munmap(ptr, st.st_size);
+      ::close(fd);
+      fprintf(stderr, "[ERROR] Failed reading file %s (traceback: %s)\n", fn,
+              __func__);
+      return 4;
+    }
+  } else {
+    ptr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  /* the mapping stays valid after the descriptor is closed */
+  ::close(fd);
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr, "[ERROR] Failed mapping file %s (traceback: %s)\n", fn,
+            __func__);
+    return 3;
+  }
+
+  data_ = static_cast<const char *>(ptr);
+  size_ = st.st_size;
+  mode_ = mode;
+  mtime_ = mtime_of(st);
+  return 0;
+}
+
+int dso::sp3::MappedFile::remap(const char *fn) noexcept {
+  if (!data_)
+    return map(fn, mode_);
+
+  const int fd = ::open(fn, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "[ERROR] Failed opening file %s (traceback: %s)\n", fn,
+            __func__);
+    return 1;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) || st.st_size <= 0) {
+    ::close(fd);
+    return 2;
+  }
+  const std::size_t size = st.st_size;
+  if (size == size_) {
+    /* a shared mapping shows any changes made in place */
+    if (mode_ == MapMode::shared)
+      mtime_ = mtime_of(st);
+    ::close(fd);
+    return 0;
+  }
+  if (mode_ == MapMode::snapshot && size < size_) {
+    ::close(fd);
+    return 4;
+  }
+
+  void *ptr;
+  if (mode_ == MapMode::snapshot) {
+#ifdef __linux__
+    ptr = ::mremap(const_cast<char *>(data_), size_, size, MREMAP_MAYMOVE);
+#else
+    ptr = map_anonymous(size);
+    if (ptr != MAP_FAILED)
+      std::memcpy(ptr, data_, size_);
+#endif
+    /* read in the bytes appended */
+    if (ptr != MAP_FAILED &&
+        read_at(fd, size_, static_cast<char *>(ptr) + size_, size - size_) !=
+            (int64_t)(size - size_)) {
+#ifdef __linux__
+      /* shrinking (in place) does not fail */
+      data_ = static_cast<const char *>(
+          ::mremap(ptr, size, size_, MREMAP_MAYMOVE));
+#else
+      ::munmap(ptr, size);
+#endif
+      ::close(fd);
+      fprintf(stderr, "[ERROR] Failed reading file %s (traceback: %s)\n", fn,
+              __func__);
+      return 4;
+    }
+#ifndef __linux__
+    if (ptr != MAP_FAILED)
+      ::munmap(const_cast<char *>(data_), size_);
+#endif
+  } else {
+#ifdef __linux__
+    ptr = ::mremap(const_cast<char *>(data_), size_, size, MREMAP_MAYMOVE);
+#else
+    ptr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr != MAP_FAILED)
+      ::munmap(const_cast<char *>(data_), size_);
+#endif
+  }
+  ::close(fd);
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr, "[ERROR] Failed re-mapping file %s (traceback: %s)\n",
+            fn, __func__);
+    return 3;
+  }
+
+  data_ = static_cast<const char *>(ptr);
+  size_ = size;
+  mtime_ = mtime_of(st);
+  return 0;
+}
+
+void dso::sp3::MappedFile::unmap() noexcept {
+  if (data_)
+    ::munmap(const_cast<char *>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+  mtime_ = 0;
+}
+
+void dso::sp3::MappedFile::will_need() const noexcept {
+  if (data_ && mode_ == MapMode::shared)
+    ::madvise(const_cast<char *>(data_), size_, MADV_WILLNEED);
+}
@@ -0,0 +1,133 @@
+#include "sp3_merge.hpp"
+#include "sp3_writer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace {
+/* A source of the merge, holding its next (unmerged) epoch */
+struct MergeSource {
+  dso::Sp3Cursor cursor;
+  dso::Sp3EpochBuffer head;
+  /* -1 once exhausted, >0 on error */
+  int status{0};
+
+  explicit MergeSource(const dso::Sp3c &sp3) noexcept : cursor(sp3) {}
+
+  void advance() noexcept {
+    if (!status)
+      status = cursor.get_next_epoch(head);
+  }
+}; /* struct MergeSource */
+
+bool bad_position(const dso::Sp3DataBlock &b) noexcept {
+  return b.flag.is_set(dso::Sp3Event::bad_abscent_position);
+}
+} /* anonymous namespace */
+
+int dso::sp3::merge(const std::vector<const Sp3c *> &sources, const char *out,
+                    const Sp3MergeOptions &options) {
+  if (sources.empty())
+    return -1;
+
+  /* header: that of the first source, with the union of satellites */
+  Sp3Header hdr = Sp3Header::from(*sources[0]);
+  hdr.satellites.clear();
+  for (const auto *sp3 : sources) {
+    if (std::strcmp(sp3->time_sys(), sources[0]->time_sys()))
+      fprintf(stderr,
+              "[WARNING] Merging Sp3 products of different time systems, %s "
+              "and %s (traceback: %s)\n",
+              sources[0]->time_sys(), sp3->time_sys(), __func__);
+    for (const auto &sv : sp3->sattellite_vector())
+      if (std::find(hdr.satellites.cbegin(), hdr.satellites.cend(), sv) ==
+          hdr.satellites.cend())
+        hdr.satellites.push_back(sv);
+    hdr.has_velocities = hdr.has_velocities || sp3->has_velocities();
+    if (sp3->interval() < hdr.interval)
+      hdr.interval = sp3->interval();
+  }
+  if (!options.agency.empty())
+    hdr.agency = options.agency;
+  hdr.comments = options.comments;
+
+  /* read the first epoch of every source */
+  std::vector<std::unique_ptr<MergeSource>> srcs;
+  for (const auto *sp3 : sources) {
+    srcs.emplace_back(new MergeSource(*sp3));
+    srcs.back()->advance();
+  }
+
+  /* k-way merge; k is small, hence a linear scan for the earliest head
+   * beats a heap
+   */
+  auto next_epoch = [&](dso::datetime<dso::nanoseconds> &t) -> int {
+    int found = -1;
+    for (const auto &s : srcs) {
+      if (s->status > 0)
+        return s->status;
+      if (!s->status && (found < 0 || s->head.t < t)) {
+        t = s->head.t;
+        found = 0;
+      }
+    }
+    return found;
+  };
+
+  dso::datetime<dso::nanoseconds> t;
+  int error = next_epoch(t);
+  if (error) {
+    if (error > 0)
+      fprintf(stderr,
+              "[ERROR] Failed reading data block of Sp3 source (traceback: "
+              "%s)\n",
+              __func__);
+    return error;
+  }
+  hdr.start_epoch = t;
+
+  const std::string tmp = std::string(out) + ".tmp";
+  try {
+    Sp3Writer writer(tmp.c_str(), hdr);
+    Sp3EpochBuffer merged;
+    while (!error) {
+      merged.clear();
+      merged.t = t;
+      for (auto &s : srcs) {
+        if (s->status || s->head.t != t)
+          continue;
+        for (int i = 0; i < s->head.size(); i++) {
+          const int j = merged.find(s->head.sats[i]);
+          if (j < 0) {
+            merged.sats.push_back(s->head.sats[i]);
+            merged.blocks.push_back(s->head.blocks[i]);
+          } else if (options.prefer_valid && bad_position(merged.blocks[j]) &&
+                     !bad_position(s->head.blocks[i])) {
+            merged.blocks[j] = s->head.blocks[i];
+          }
+        }
+        s->advance();
+      }
+      error = writer.write_epoch(merged) ? 1 : next_epoch(t);
+    }
+    if (error > 0)
+      fprintf(stderr,
+              "[ERROR] Failed merging Sp3 products, epoch %d (traceback: %s)\n",
+              writer.num_epochs(), __func__);
+    error = std::max(error, 0);
+    error = writer.close() || error;
+  } catch (std::exception &e) {
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+    error = 2;
+  }
+
+  if (!error && std::rename(tmp.c_str(), out)) {
+    fprintf(stderr, "[ERROR] Failed renaming %s to %s (traceback: %s)\n",
+            tmp.c_str(), out, __func__);
+    error = 3;
+  }
+  if (error)
+    std::remove(tmp.c_str());
+  return error;
+}
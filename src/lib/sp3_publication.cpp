@@ -0,0 +1,105 @@
+#include "sp3_publication.hpp"
+
+int dso::Sp3Publisher::publish(const char *fn,
+                               std::vector<sp3::SatelliteId> *rebuilt,
+                               sp3::Executor *ex) noexcept {
+  std::lock_guard<std::mutex> lock(write_mtx_);
+
+  try {
+    /* start off from (a copy of) the current version, sharing its
+     * interpolators, so that unchanged satellites need not be re-read
+     */
+    const auto current = pub_.acquire();
+    auto next = current ? std::make_shared<Sp3Dataset>(*current)
+                        : std::make_shared<Sp3Dataset>(max_window_);
+    next->source = fn;
+    next->version = pub_.version() + 1;
+
+    /* interpolators only record the file's name and fingerprint; nothing
+     * refers to sp3 once loaded */
+    Sp3c sp3(fn);
+    if (int error = next->interpolators.load(sp3, rebuilt, ex)) {
+      fprintf(stderr,
+              "[ERROR] Failed loading interpolators off from %s (traceback: "
+              "%s)\n",
+              fn, __func__);
+      return error;
+    }
+    next->t_start = sp3.start_epoch();
+    next->t_stop = sp3.stop_epoch();
+
+    pub_.publish(std::move(next));
+  } catch (std::exception &e) {
+    fprintf(stderr, "[ERROR] Failed publishing Sp3 file %s (traceback: %s)\n",
+            fn, __func__);
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
+
+int dso::Sp3Reader::refresh() noexcept {
+  const uint64_t v = pub_->version();
+  if (snap_ && v == seen_)
+    return 0;
+  auto snap = pub_->snapshot();
+  if (!snap)
+    return -1;
+  seen_ = v;
+  if (snap == snap_)
+    return 0;
+  /* (the previous version is held until done, so that addresses of its
+   * interpolators are not re-used meanwhile) */
+  const auto prev = std::move(snap_);
+  snap_ = std::move(snap);
+  /* point to the new version's interpolators; buffers are kept, as is the
+   * window position for interpolators shared with the previous version */
+  for (auto &l : local_) {
+    const SvInterpolator *intrp = snap_->interpolators.find(l.sv);
+    if (intrp != l.intrp) {
+      l.intrp = intrp;
+      l.state.last_index = 0;
+    }
+  }
+  return 1;
+}
+
+void dso::Sp3Reader::release() noexcept {
+  snap_.reset();
+  local_.clear();
+  seen_ = 0;
+}
+
+int dso::Sp3Reader::interpolate_at(const sp3::SatelliteId &sv,
+                                   const dso::datetime<dso::nanoseconds> &t,
+                                   double *pos, double *erpos, double *vel,
+                                   double *ervel) noexcept {
+  if (refresh() < 0)
+    return -1;
+
+  /* the reader's state for sv */
+  LocalState *local = nullptr;
+  for (auto &l : local_)
+    if (l.sv == sv) {
+      local = &l;
+      break;
+    }
+  if (!local) {
+    try {
+      local_.push_back(LocalState{sv, snap_->interpolators.find(sv),
+                                  SvInterpolationState()});
+    } catch (std::exception &) {
+      fprintf(stderr,
+              "[ERROR] Failed allocating state for %s (traceback: %s)\n",
+              sv.to_string().c_str(), __func__);
+      return 1;
+    }
+    local = &local_.back();
+  }
+  if (!local->intrp)
+    return -1;
+
+  return local->intrp->interpolate_at(t, pos, erpos, vel, ervel,
+                                      local->state);
+}
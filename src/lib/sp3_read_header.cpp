@@ -31,6 +31,7 @@ int dso::Sp3c::read_header() noexcept {
   version__ = *(line + 1);
   if (version__ != 'c' && version__ != 'd')
     return 10;
+  pv_flag__ = *(line + 2);
   int year = std::strtol(line + 3, &str_end, 10); // read year
   if (!year || errno == ERANGE) {
     errno = 0;
@@ -63,6 +64,7 @@ int dso::Sp3c::read_header() noexcept {
     errno = 0;
     return 16;
   }
+  std::memcpy(data_used__, line + 40, 5);
   std::memcpy(crd_sys__, line + 46, 5);
   std::memcpy(orb_type__, line + 52, 3);
   std::memcpy(agency__, line + 56, 4);
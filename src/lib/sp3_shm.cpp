@@ -0,0 +1,475 @@
+#include "sp3_shm.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+/* Segment magic number ('SP3SHM\0\1') and layout version */
+constexpr uint64_t SHM_MAGIC{0x0100'4d48'5333'5053ULL};
+constexpr uint32_t SHM_VERSION{2};
+/* Pointer segment magic number ('SP3PTR\0\1') */
+constexpr uint64_t SHM_POINTER_MAGIC{0x0100'5254'5033'5053ULL};
+/* Max attempts to open the current generation, while being re-published */
+constexpr int MAX_OPEN_ATTEMPTS = 8;
+
+/* The segment under the published name; points to the current generation
+ * of the data segment (0 if none)
+ */
+struct SegmentPointer {
+  uint64_t magic;
+  std::atomic<uint64_t> generation;
+}; /* struct SegmentPointer */
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Generation of shared memory segments must be lock-free");
+
+/* Segment header; followed by num_sats SatelliteEntry's and the columns */
+struct SegmentHeader {
+  /* written last, once the segment is complete */
+  uint64_t magic;
+  uint32_t version;
+  uint32_t num_sats;
+  /* reference epoch of time columns */
+  int64_t ref_mjd;
+  int64_t ref_nsec;
+  int64_t interval_nsec;
+  /* total size of segment (bytes) */
+  uint64_t size;
+}; /* struct SegmentHeader */
+
+struct SatelliteEntry {
+  char sv[4];
+  uint32_t count;
+  /* offset of each column (w.r.t. the start of the segment) */
+  uint64_t offsets[dso::Sp3ShmSegment::NUM_COLUMNS];
+}; /* struct SatelliteEntry */
+
+const SegmentHeader *header(const char *data) noexcept {
+  return reinterpret_cast<const SegmentHeader *>(data);
+}
+
+const SatelliteEntry *entries(const char *data) noexcept {
+  return reinterpret_cast<const SatelliteEntry *>(data +
+                                                  sizeof(SegmentHeader));
+}
+
+/* Name of the data segment of a given generation */
+std::string data_name(const char *name, uint64_t generation) {
+  return std::string(name) + "." + std::to_string(generation);
+}
+
+/* Current generation of the data segment of name; 0 if none (or on error) */
+uint64_t current_generation(const char *name) noexcept {
+  const int fd = ::shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return 0;
+  struct stat st;
+  void *ptr = MAP_FAILED;
+  if (!::fstat(fd, &st) && st.st_size == (off_t)sizeof(SegmentPointer))
+    ptr = ::mmap(nullptr, sizeof(SegmentPointer), PROT_READ, MAP_SHARED, fd,
+                 0);
+  ::close(fd);
+  if (ptr == MAP_FAILED)
+    return 0;
+  const auto *p = static_cast<const SegmentPointer *>(ptr);
+  uint64_t generation = 0;
+  if (p->magic == SHM_POINTER_MAGIC)
+    generation = p->generation.load(std::memory_order_acquire);
+  ::munmap(ptr, sizeof(SegmentPointer));
+  return generation;
+}
+
+/* Map the pointer segment of name, read-write, creating it if needed */
+SegmentPointer *map_pointer(const char *name) noexcept {
+  int fd = ::shm_open(name, O_CREAT | O_RDWR, 0644);
+  struct stat st;
+  if (fd >= 0 && !::fstat(fd, &st) && st.st_size &&
+      st.st_size != (off_t)sizeof(SegmentPointer)) {
+    /* not a pointer segment (e.g. of an older layout); replace it */
+    ::close(fd);
+    ::shm_unlink(name);
+    fd = ::shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  }
+  if (fd < 0)
+    return nullptr;
+  void *ptr = MAP_FAILED;
+  if (!::ftruncate(fd, sizeof(SegmentPointer)))
+    ptr = ::mmap(nullptr, sizeof(SegmentPointer), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+  ::close(fd);
+  return (ptr == MAP_FAILED) ? nullptr : static_cast<SegmentPointer *>(ptr);
+}
+
+/* Seconds of t w.r.t. a reference epoch */
+double seconds_since(const dso::datetime<dso::nanoseconds> &t, int64_t mjd,
+                     int64_t nsec) noexcept {
+  return (t.imjd().as_underlying_type() - mjd) * 86400e0 +
+         (t.sec().as_underlying_type() - nsec) * 1e-9;
+}
+} /* anonymous namespace */
+
+int dso::Sp3ShmSegment::publish(const char *name, const Sp3c &sp3) noexcept {
+  /* collect records, per satellite */
+  std::vector<sp3::SatelliteId> svs;
+  std::vector<std::vector<Sp3DataBlock>> records;
+  try {
+    svs = sp3.sattellite_vector();
+    records.resize(svs.size());
+    Sp3Cursor cursor(sp3);
+    Sp3EpochBuffer buf;
+    int error;
+    while (!(error = cursor.get_next_epoch(buf))) {
+      for (int i = 0; i < buf.size(); i++) {
+        const auto &b = buf.blocks[i];
+        if (b.flag.is_set(Sp3Event::bad_abscent_position) &&
+            b.flag.is_set(Sp3Event::bad_abscent_clock))
+          continue;
+        const auto it = std::find(svs.begin(), svs.end(), buf.sats[i]);
+        if (it != svs.end())
+          records[it - svs.begin()].push_back(b);
+      }
+    }
+    if (error > 0) {
+      fprintf(stderr,
+              "[ERROR] Failed reading data blocks off from Sp3 (traceback: "
+              "%s)\n",
+              __func__);
+      return 1;
+    }
+  } catch (std::exception &e) {
+    fprintf(stderr, "[ERROR] %s (traceback: %s)\n", e.what(), __func__);
+    return 1;
+  }
+
+  /* layout */
+  std::size_t size =
+      sizeof(SegmentHeader) + svs.size() * sizeof(SatelliteEntry);
+  for (const auto &r : records)
+    size += NUM_COLUMNS * r.size() * sizeof(double);
+
+  /* create the next generation; readers keep on finding the current one
+   * (via the pointer segment) until it is complete
+   */
+  SegmentPointer *pointer = map_pointer(name);
+  if (!pointer) {
+    fprintf(stderr,
+            "[ERROR] Failed creating shared memory segment %s: %s (traceback: "
+            "%s)\n",
+            name, std::strerror(errno), __func__);
+    return 2;
+  }
+  const uint64_t previous =
+      (pointer->magic == SHM_POINTER_MAGIC)
+          ? pointer->generation.load(std::memory_order_acquire)
+          : 0;
+  std::string dname, previous_dname;
+  try {
+    dname = data_name(name, previous + 1);
+    previous_dname = data_name(name, previous);
+  } catch (std::exception &) {
+    ::munmap(pointer, sizeof(SegmentPointer));
+    return 2;
+  }
+  /* left over by a failed publisher, if any */
+  ::shm_unlink(dname.c_str());
+  const int fd = ::shm_open(dname.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  void *ptr = MAP_FAILED;
+  if (fd >= 0) {
+    if (!::ftruncate(fd, size))
+      ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+  }
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr,
+            "[ERROR] Failed creating shared memory segment %s: %s (traceback: "
+            "%s)\n",
+            dname.c_str(), std::strerror(errno), __func__);
+    ::shm_unlink(dname.c_str());
+    ::munmap(pointer, sizeof(SegmentPointer));
+    return 2;
+  }
+
+  char *data = static_cast<char *>(ptr);
+  auto *hdr = reinterpret_cast<SegmentHeader *>(data);
+  const auto ref = sp3.start_epoch();
+  hdr->version = SHM_VERSION;
+  hdr->num_sats = svs.size();
+  hdr->ref_mjd = ref.imjd().as_underlying_type();
+  hdr->ref_nsec = ref.sec().as_underlying_type();
+  hdr->interval_nsec = sp3.interval().as_underlying_type();
+  hdr->size = size;
+
+  auto *ent = reinterpret_cast<SatelliteEntry *>(data + sizeof(SegmentHeader));
+  uint64_t offset =
+      sizeof(SegmentHeader) + svs.size() * sizeof(SatelliteEntry);
+  for (std::size_t s = 0; s < svs.size(); s++) {
+    const auto &r = records[s];
+    std::memcpy(ent[s].sv, svs[s].id, sizeof ent[s].sv);
+    ent[s].count = r.size();
+    for (int c = 0; c < NUM_COLUMNS; c++) {
+      ent[s].offsets[c] = offset;
+      double *col = reinterpret_cast<double *>(data + offset);
+      for (std::size_t i = 0; i < r.size(); i++) {
+        if (c == TIME)
+          col[i] = seconds_since(r[i].t, hdr->ref_mjd, hdr->ref_nsec);
+        else if (c < SDEV)
+          col[i] = r[i].state[c - STATE];
+        else if (c < FLAGS)
+          col[i] = r[i].state_sdev[c - SDEV];
+        else
+          col[i] = r[i].flag.bits_;
+      }
+      offset += r.size() * sizeof(double);
+    }
+  }
+
+  /* mark the segment complete */
+  std::atomic_thread_fence(std::memory_order_release);
+  hdr->magic = SHM_MAGIC;
+  ::munmap(ptr, size);
+
+  /* switch readers over to it; the previous generation lives on while
+   * mapped
+   */
+  pointer->magic = SHM_POINTER_MAGIC;
+  pointer->generation.store(previous + 1, std::memory_order_release);
+  ::munmap(pointer, sizeof(SegmentPointer));
+  if (previous)
+    ::shm_unlink(previous_dname.c_str());
+  return 0;
+}
+
+int dso::Sp3ShmSegment::remove(const char *name) noexcept {
+  const uint64_t generation = current_generation(name);
+  int error = ::shm_unlink(name) ? 1 : 0;
+  try {
+    if (generation && ::shm_unlink(data_name(name, generation).c_str()))
+      error = 1;
+  } catch (std::exception &) {
+    error = 1;
+  }
+  return error;
+}
+
+dso::Sp3ShmSegment::Sp3ShmSegment(const char *name) {
+  /* open the current generation; if re-published meanwhile (and the
+   * generation found is already removed), look it up again
+   */
+  int fd = -1;
+  for (int i = 0; fd < 0 && i < MAX_OPEN_ATTEMPTS; i++) {
+    const uint64_t generation = current_generation(name);
+    if (!generation) {
+      errno = ENOENT;
+      break;
+    }
+    fd = ::shm_open(data_name(name, generation).c_str(), O_RDONLY, 0);
+    if (fd < 0 && errno != ENOENT)
+      break;
+  }
+  if (fd < 0) {
+    fprintf(stderr,
+            "[ERROR] Failed opening shared memory segment %s: %s (traceback: "
+            "%s)\n",
+            name, std::strerror(errno), __func__);
+    throw std::runtime_error("[ERROR] Failed opening shared memory segment\n");
+  }
+  struct stat st;
+  void *ptr = MAP_FAILED;
+  if (!::fstat(fd, &st) && st.st_size >= (off_t)sizeof(SegmentHeader))
+    ptr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr,
+            "[ERROR] Failed mapping shared memory segment %s (traceback: "
+            "%s)\n",
+            name, __func__);
+    throw std::runtime_error("[ERROR] Failed mapping shared memory segment\n");
+  }
+  data_ = static_cast<const char *>(ptr);
+  size_ = st.st_size;
+
+  /* validate the segment (it may still be written to) */
+  const SegmentHeader *hdr = header(data_);
+  bool valid = hdr->magic == SHM_MAGIC;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  valid = valid && hdr->version == SHM_VERSION && hdr->size == size_ &&
+          sizeof(SegmentHeader) + hdr->num_sats * sizeof(SatelliteEntry) <=
+              size_;
+  for (uint32_t s = 0; valid && s < hdr->num_sats; s++) {
+    const auto &e = entries(data_)[s];
+    for (int c = 0; c < NUM_COLUMNS; c++)
+      if (e.offsets[c] % alignof(double) ||
+          e.offsets[c] + e.count * sizeof(double) > size_)
+        valid = false;
+  }
+  if (!valid) {
+    fprintf(stderr,
+            "[ERROR] Invalid (or incomplete) shared memory segment %s "
+            "(traceback: %s)\n",
+            name, __func__);
+    ::munmap(ptr, size_);
+    data_ = nullptr;
+    throw std::runtime_error("[ERROR] Invalid shared memory segment\n");
+  }
+}
+
+dso::Sp3ShmSegment::~Sp3ShmSegment() noexcept {
+  if (data_)
+    ::munmap(const_cast<char *>(data_), size_);
+}
+
+int dso::Sp3ShmSegment::find(const sp3::SatelliteId &sv) const noexcept {
+  const SegmentHeader *hdr = header(data_);
+  for (uint32_t s = 0; s < hdr->num_sats; s++)
+    if (!std::strncmp(entries(data_)[s].sv, sv.id, 4))
+      return s;
+  return -1;
+}
+
+dso::datetime<dso::nanoseconds> dso::Sp3ShmSegment::ref_epoch() const noexcept {
+  const SegmentHeader *hdr = header(data_);
+  return dso::datetime<dso::nanoseconds>(dso::modified_julian_day(hdr->ref_mjd),
+                                         dso::nanoseconds(hdr->ref_nsec));
+}
+
+dso::nanoseconds dso::Sp3ShmSegment::interval() const noexcept {
+  return dso::nanoseconds(header(data_)->interval_nsec);
+}
+
+std::vector<dso::sp3::SatelliteId> dso::Sp3ShmSegment::satellites() const {
+  std::vector<sp3::SatelliteId> svs;
+  const SegmentHeader *hdr = header(data_);
+  for (uint32_t s = 0; s < hdr->num_sats; s++) {
+    char id[5] = {'\0'};
+    std::memcpy(id, entries(data_)[s].sv, 4);
+    svs.emplace_back(id);
+  }
+  return svs;
+}
+
+int dso::Sp3ShmSegment::num_records(
+    const sp3::SatelliteId &sv) const noexcept {
+  const int s = find(sv);
+  return (s < 0) ? 0 : entries(data_)[s].count;
+}
+
+const double *dso::Sp3ShmSegment::column(const sp3::SatelliteId &sv,
+                                         Column c) const noexcept {
+  const int s = find(sv);
+  return (s < 0) ? nullptr
+                 : reinterpret_cast<const double *>(
+                       data_ + entries(data_)[s].offsets[c]);
+}
+
+dso::SvShmInterpolator::SvShmInterpolator(const Sp3ShmSegment &seg,
+                                          sp3::SatelliteId sid,
+                                          dso::milliseconds max_window)
+    : svid(sid) {
+  const int s = seg.find(sid);
+  if (s < 0) {
+    fprintf(stderr,
+            "[ERROR] No data records for SV %s in shared memory segment "
+            "(traceback: %s)\n",
+            sid.id, __func__);
+    throw std::runtime_error(
+        "[ERROR] Failed creating SvShmInterpolator instance\n");
+  }
+  const SatelliteEntry &e = entries(seg.data_)[s];
+  for (int c = 0; c < Sp3ShmSegment::NUM_COLUMNS; c++)
+    cols[c] = reinterpret_cast<const double *>(seg.data_ + e.offsets[c]);
+  num_dpts = e.count;
+  ref_mjd = header(seg.data_)->ref_mjd;
+  ref_nsec = header(seg.data_)->ref_nsec;
+  max_sec = max_window.as_underlying_type() * 1e-3;
+
+  /* workspace for the max number of points within the window */
+  const int64_t interval = header(seg.data_)->interval_nsec;
+  const int one_side_pts =
+      (interval > 0) ? (max_sec * 1e9) / interval + 1 : num_dpts;
+  workspace.resize(6 * (2 * one_side_pts + 1));
+}
+
+int dso::SvShmInterpolator::index_hunt(double tsec) noexcept {
+  const double *t = cols[Sp3ShmSegment::TIME];
+  if (last_index < num_dpts - 2) {
+    if (t[last_index] <= tsec && t[last_index + 1] > tsec)
+      return last_index;
+    else if (t[last_index + 1] <= tsec && t[last_index + 2] > tsec)
+      return ++last_index;
+  }
+  const int start_index = (t[last_index] <= tsec) ? last_index : 0;
+  const double *it = std::upper_bound(t + start_index, t + num_dpts, tsec);
+  return (last_index = std::max(0, static_cast<int>(it - t) - 1));
+}
+
+int dso::SvShmInterpolator::interpolate_at(
+    const dso::datetime<dso::nanoseconds> &t, double *pos, double *erpos,
+    double *vel, double *ervel) noexcept {
+  if (!num_dpts) {
+    fprintf(stderr, "[ERROR] No data points to interpolate (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+
+  const double tsec = seconds_since(t, ref_mjd, ref_nsec);
+  const double *tt = cols[Sp3ShmSegment::TIME];
+  const int index = index_hunt(tsec);
+
+  /* data points within the window (see SvInterpolator::interpolate_at) */
+  int start = index;
+  while (start > 0 && tsec - tt[start] < max_sec)
+    --start;
+  if (index - start < 2) {
+    fprintf(
+        stderr,
+        "[ERROR] Cannot interpolate due to too few data points (on the left) "
+        "(traceback: %s)\n",
+        __func__);
+    return 1;
+  }
+  int stop = index;
+  while (stop < num_dpts - 1 && tt[stop] - tsec < max_sec)
+    ++stop;
+  if (stop - index < 2) {
+    fprintf(
+        stderr,
+        "[ERROR] Cannot interpolate due to too few data points (on the right) "
+        "(traceback: %s)\n",
+        __func__);
+    return 1;
+  }
+  const int size = stop - start + 1;
+  if (6 * size > (int)workspace.size()) {
+    fprintf(stderr,
+            "[ERROR] Too many data points for interpolation workspace "
+            "(traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+
+  /* interpolate directly off from the (mapped) columns */
+  const double *const *s = cols + Sp3ShmSegment::STATE;
+  if (sp3::neville_interpolation3(tsec, pos, erpos, tt + start, s[0] + start,
+                                  s[1] + start, s[2] + start, size, size, 0,
+                                  workspace.data())) {
+    fprintf(stderr, "[ERROR] Neville algorithm failed (traceback: %s)\n",
+            __func__);
+    return 5;
+  }
+  if (vel && ervel) {
+    if (sp3::neville_interpolation3(tsec, vel, ervel, tt + start,
+                                    s[4] + start, s[5] + start, s[6] + start,
+                                    size, size, 0, workspace.data())) {
+      fprintf(stderr, "[ERROR] Neville algorithm failed (traceback: %s)\n",
+              __func__);
+      return 6;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,557 @@
+#include "sp3_store.hpp"
+#include "core/sp3_time.hpp"
+#include <cmath>
+#include <limits>
+
+using dso::sp3::NS_PER_DAY;
+
+namespace {
+/* Channels (aka fields) encoded per record: time, state[8], state_sdev[8]
+ * and the flag
+ */
+constexpr int NUM_CHANNELS = 18;
+/* Quantization of state values; Sp3 values are given with 6 decimal places,
+ * i.e. 1e-6 km = 1 mm, 1e-6 microsec = 1 ps, etc.
+ */
+constexpr double STATE_SCALE = 1e6;
+/* Quantization of std. deviations (mm, ps, ...) */
+constexpr double SDEV_SCALE = 1e3;
+
+/* Quantize a value; non-finite (or out-of-range) values are mapped to 0 */
+int64_t quantize(double v, double scale) noexcept {
+  const double q = v * scale;
+  if (!std::isfinite(q) || std::abs(q) > 4e18)
+    return 0;
+  return std::llround(q);
+}
+
+uint64_t zigzag(uint64_t v) noexcept {
+  return (v << 1) ^ (0 - (v >> 63));
+}
+
+uint64_t unzigzag(uint64_t u) noexcept { return (u >> 1) ^ (0 - (u & 1)); }
+
+int varint_size(uint64_t u) noexcept {
+  int n = 1;
+  while (u >= 0x80) {
+    u >>= 7;
+    ++n;
+  }
+  return n;
+}
+
+void put_varint(std::vector<uint8_t> &buf, uint64_t u) {
+  while (u >= 0x80) {
+    buf.push_back(static_cast<uint8_t>(u | 0x80));
+    u >>= 7;
+  }
+  buf.push_back(static_cast<uint8_t>(u));
+}
+
+const uint8_t *get_varint(const uint8_t *p, uint64_t &u) noexcept {
+  u = 0;
+  int shift = 0;
+  while (*p & 0x80) {
+    u |= static_cast<uint64_t>(*p++ & 0x7f) << shift;
+    shift += 7;
+  }
+  u |= static_cast<uint64_t>(*p++) << shift;
+  return p;
+}
+
+/* Apply one more level of differencing, i.e. go from order (level-1) to
+ * order level. Values are unsigned, so that wrap-around is well defined.
+ */
+void difference(uint64_t *a, int n, int level) noexcept {
+  for (int i = n - 1; i >= level; i--)
+    a[i] -= a[i - 1];
+}
+
+/* Inverse of differencing of order k */
+void integrate(uint64_t *a, int n, int k) noexcept {
+  for (int level = k; level >= 1; level--)
+    for (int i = level; i < n; i++)
+      a[i] += a[i - 1];
+}
+
+/* Layouts of the (differenced, zig-zagged) values of a channel; stored in
+ * the upper bits of the channel's leading byte, the lower ones holding the
+ * order of differencing
+ */
+enum ChannelLayout : uint8_t {
+  /* one varint per value */
+  DENSE = 0,
+  /* bitmap of non-zero values, followed by a varint per non-zero value */
+  SPARSE = 1,
+  /* number of leading values m, followed by m varints; the rest are zero
+   * (e.g. constant or absent channels, regular time tags)
+   */
+  TRUNCATED = 2
+}; /* enum ChannelLayout */
+constexpr int ORDER_BITS = 4;
+constexpr uint8_t ORDER_MASK = (1 << ORDER_BITS) - 1;
+static_assert(dso::Sp3OrbitStore::MAX_DIFF_ORDER <= ORDER_MASK);
+
+/* Bytes needed to encode the values a[0, n) of a channel, in each layout */
+void layout_costs(const uint64_t *a, int n, int cost[3]) noexcept {
+  int dense = 0, nonzero = 0, leading = 0;
+  for (int i = 0; i < n; i++) {
+    const uint64_t u = zigzag(a[i]);
+    const int sz = varint_size(u);
+    dense += sz;
+    if (u) {
+      nonzero += sz;
+      leading = dense;
+    }
+  }
+  int m = n;
+  while (m > 0 && !a[m - 1])
+    --m;
+  cost[DENSE] = dense;
+  cost[SPARSE] = (n + 7) / 8 + nonzero;
+  cost[TRUNCATED] = varint_size(m) + leading;
+}
+
+/* Encode the n values of a channel, using the order of differencing and
+ * layout that results in the fewest bytes
+ */
+void encode_channel(const uint64_t *values, int n, std::vector<uint8_t> &buf) {
+  uint64_t a[dso::Sp3OrbitStore::BLOCK_SIZE];
+  std::copy(values, values + n, a);
+
+  int best_order = 0, best_layout = DENSE;
+  int best_cost = std::numeric_limits<int>::max();
+  for (int k = 0; k <= dso::Sp3OrbitStore::MAX_DIFF_ORDER && k < n; k++) {
+    if (k)
+      difference(a, n, k);
+    int cost[3];
+    layout_costs(a, n, cost);
+    for (int l = DENSE; l <= TRUNCATED; l++) {
+      if (cost[l] < best_cost) {
+        best_cost = cost[l];
+        best_order = k;
+        best_layout = l;
+      }
+    }
+  }
+
+  std::copy(values, values + n, a);
+  for (int k = 1; k <= best_order; k++)
+    difference(a, n, k);
+  buf.push_back(static_cast<uint8_t>((best_layout << ORDER_BITS) | best_order));
+  switch (best_layout) {
+  case SPARSE: {
+    const std::size_t at = buf.size();
+    buf.resize(at + (n + 7) / 8, 0);
+    for (int i = 0; i < n; i++)
+      if (a[i])
+        buf[at + i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+    for (int i = 0; i < n; i++)
+      if (a[i])
+        put_varint(buf, zigzag(a[i]));
+    break;
+  }
+  case TRUNCATED: {
+    int m = n;
+    while (m > 0 && !a[m - 1])
+      --m;
+    put_varint(buf, m);
+    for (int i = 0; i < m; i++)
+      put_varint(buf, zigzag(a[i]));
+    break;
+  }
+  default:
+    for (int i = 0; i < n; i++)
+      put_varint(buf, zigzag(a[i]));
+  }
+}
+
+/* Decode the n values of a channel (see encode_channel); returns a pointer
+ * past the channel's bytes
+ */
+const uint8_t *decode_channel(const uint8_t *p, int n,
+                              uint64_t *values) noexcept {
+  const int order = *p & ORDER_MASK;
+  const int layout = *p++ >> ORDER_BITS;
+  uint64_t u;
+  switch (layout) {
+  case SPARSE: {
+    const uint8_t *bitmap = p;
+    p += (n + 7) / 8;
+    for (int i = 0; i < n; i++) {
+      values[i] = 0;
+      if (bitmap[i / 8] & (1 << (i % 8))) {
+        p = get_varint(p, u);
+        values[i] = unzigzag(u);
+      }
+    }
+    break;
+  }
+  case TRUNCATED: {
+    p = get_varint(p, u);
+    const int m = u;
+    for (int i = 0; i < n; i++) {
+      values[i] = 0;
+      if (i < m) {
+        p = get_varint(p, u);
+        values[i] = unzigzag(u);
+      }
+    }
+    break;
+  }
+  default:
+    for (int i = 0; i < n; i++) {
+      p = get_varint(p, u);
+      values[i] = unzigzag(u);
+    }
+  }
+  integrate(values, n, order);
+  return p;
+}
+} /* anonymous namespace */
+
+int64_t dso::Sp3OrbitStore::to_ns(
+    const dso::datetime<dso::nanoseconds> &t) const noexcept {
+  return (t.imjd().as_underlying_type() - ref_mjd_) * NS_PER_DAY +
+         t.sec().as_underlying_type();
+}
+
+dso::datetime<dso::nanoseconds>
+dso::Sp3OrbitStore::from_ns(int64_t ns) const noexcept {
+  int64_t days = ns / NS_PER_DAY;
+  int64_t rem = ns % NS_PER_DAY;
+  if (rem < 0) {
+    rem += NS_PER_DAY;
+    --days;
+  }
+  return dso::datetime<dso::nanoseconds>(
+      dso::modified_julian_day(ref_mjd_ + days), dso::nanoseconds(rem));
+}
+
+const dso::Sp3OrbitStore::SvColumn *
+dso::Sp3OrbitStore::column(const sp3::SatelliteId &sv) const noexcept {
+  for (const auto &col : cols_)
+    if (col.sv == sv)
+      return &col;
+  return nullptr;
+}
+
+void dso::Sp3OrbitStore::encode_pending(SvColumn &col) {
+  const int n = col.pending.size();
+  if (!n)
+    return;
+
+  /* channel-major copy of the (quantized) records */
+  uint64_t values[NUM_CHANNELS][BLOCK_SIZE];
+  for (int i = 0; i < n; i++) {
+    const Sp3DataBlock &b = col.pending[i];
+    values[0][i] = to_ns(b.t);
+    for (int j = 0; j < 8; j++) {
+      values[1 + j][i] = quantize(b.state[j], STATE_SCALE);
+      values[9 + j][i] = quantize(b.state_sdev[j], SDEV_SCALE);
+    }
+    values[17][i] = b.flag.bits_;
+  }
+
+  BlockHeader hdr;
+  hdr.t_first = values[0][0];
+  hdr.t_last = values[0][n - 1];
+  hdr.offset = col.bytes.size();
+  hdr.count = n;
+  for (int c = 0; c < NUM_CHANNELS; c++)
+    encode_channel(values[c], n, col.bytes);
+
+  col.blocks.push_back(hdr);
+  col.pending.clear();
+}
+
+void dso::Sp3OrbitStore::decode_block(const SvColumn &col, int block,
+                                      std::vector<Sp3DataBlock> &out) const {
+  const BlockHeader &hdr = col.blocks[block];
+  const int n = hdr.count;
+  const uint8_t *p = col.bytes.data() + hdr.offset;
+
+  uint64_t values[NUM_CHANNELS][BLOCK_SIZE];
+  for (int c = 0; c < NUM_CHANNELS; c++)
+    p = decode_channel(p, n, values[c]);
+
+  for (int i = 0; i < n; i++) {
+    out.emplace_back();
+    Sp3DataBlock &b = out.back();
+    b.t = from_ns(static_cast<int64_t>(values[0][i]));
+    for (int j = 0; j < 8; j++) {
+      b.state[j] = static_cast<int64_t>(values[1 + j][i]) / STATE_SCALE;
+      b.state_sdev[j] = static_cast<int64_t>(values[9 + j][i]) / SDEV_SCALE;
+    }
+    b.flag.bits_ = static_cast<sp3::uitype>(values[17][i]);
+  }
+}
+
+int dso::Sp3OrbitStore::append(const sp3::SatelliteId &sv,
+                               const Sp3DataBlock &block) {
+  if (!has_ref_) {
+    ref_mjd_ = block.t.imjd().as_underlying_type();
+    has_ref_ = true;
+  }
+
+  SvColumn *col = nullptr;
+  for (auto &c : cols_)
+    if (c.sv == sv) {
+      col = &c;
+      break;
+    }
+  if (!col) {
+    cols_.emplace_back();
+    col = &cols_.back();
+    col->sv = sv;
+  }
+
+  return append_to(*col, block);
+}
+
+int dso::Sp3OrbitStore::append_to(SvColumn &col, const Sp3DataBlock &block) {
+  const int64_t ns = to_ns(block.t);
+  if (col.num_records && ns <= col.t_last)
+    return 1;
+
+  if (col.pending.capacity() < (std::size_t)BLOCK_SIZE)
+    col.pending.reserve(BLOCK_SIZE);
+  col.pending.push_back(block);
+  col.t_last = ns;
+  ++col.num_records;
+  if ((int)col.pending.size() == BLOCK_SIZE)
+    encode_pending(col);
+
+  return 0;
+}
+
+int dso::Sp3OrbitStore::load(const Sp3c &sp3) {
+  if (!interval_.as_underlying_type())
+    interval_ = sp3.interval();
+
+  Sp3Cursor cursor(sp3);
+  Sp3EpochBuffer buf;
+  int num_epochs = 0;
+  int error;
+  while (!(error = cursor.get_next_epoch(buf))) {
+    for (int i = 0; i < buf.size(); i++)
+      append(buf.sats[i], buf.blocks[i]);
+    ++num_epochs;
+  }
+
+  seal();
+
+  if (error > 0) {
+    fprintf(stderr,
+            "[ERROR] Failed reading data blocks off from Sp3 file, "
+            "error=%d (traceback: %s)\n",
+            error, __func__);
+    return error;
+  }
+  return num_epochs ? 0 : -1;
+}
+
+int dso::Sp3OrbitStore::load(const std::vector<std::string> &files,
+                             Sp3OverlapPolicy policy, sp3::Executor *ex) {
+  clear();
+  const int n = files.size();
+
+  /* parse files to (independent) stores, one task per file */
+  std::vector<Sp3OrbitStore> parts(n);
+  std::vector<int> status(n, 0);
+  sp3::parallel_for(
+      0, n,
+      [&](int i) {
+        try {
+          Sp3c sp3(files[i].c_str());
+          status[i] = parts[i].load(sp3);
+        } catch (std::exception &e) {
+          fprintf(stderr,
+                  "[ERROR] Failed opening Sp3 file %s (traceback: %s)\n",
+                  files[i].c_str(), __func__);
+          fprintf(stderr, "[ERROR] %s\n", e.what());
+          status[i] = 1;
+        }
+      },
+      ex, 1);
+
+  /* reference epoch, interval and satellites, in order of files given */
+  int error = 0;
+  for (int i = 0; i < n; i++) {
+    if (status[i] > 0) {
+      error = status[i];
+      continue;
+    }
+    if (parts[i].cols_.empty())
+      continue;
+    if (!has_ref_ || parts[i].ref_mjd_ < ref_mjd_) {
+      ref_mjd_ = parts[i].ref_mjd_;
+      has_ref_ = true;
+    }
+    if (!interval_.as_underlying_type())
+      interval_ = parts[i].interval_;
+    for (const auto &pc : parts[i].cols_) {
+      if (!column(pc.sv)) {
+        cols_.emplace_back();
+        cols_.back().sv = pc.sv;
+      }
+    }
+  }
+  if (!has_ref_)
+    return error ? error : -1;
+
+  /* merge records, one task per satellite */
+  struct Ranked {
+    int rank;
+    Sp3DataBlock block;
+  };
+  sp3::parallel_for(
+      0, (int)cols_.size(),
+      [&](int c) {
+        SvColumn &col = cols_[c];
+        std::vector<Ranked> records;
+        std::vector<Sp3DataBlock> decoded;
+        for (int i = 0; i < n; i++) {
+          const SvColumn *pc = parts[i].column(col.sv);
+          if (status[i] > 0 || !pc)
+            continue;
+          decoded.clear();
+          for (int k = 0; k < (int)pc->blocks.size(); k++)
+            parts[i].decode_block(*pc, k, decoded);
+          decoded.insert(decoded.end(), pc->pending.cbegin(),
+                         pc->pending.cend());
+          /* lower rank wins */
+          const int rank =
+              (policy == Sp3OverlapPolicy::first_wins) ? i : n - i;
+          for (const auto &b : decoded)
+            records.push_back({rank, b});
+        }
+        std::stable_sort(records.begin(), records.end(),
+                         [](const Ranked &a, const Ranked &b) {
+                           return (a.block.t < b.block.t) ||
+                                  (a.block.t == b.block.t && a.rank < b.rank);
+                         });
+        /* duplicate epochs (ranked lower) are rejected by append_to */
+        for (const auto &r : records)
+          append_to(col, r.block);
+        encode_pending(col);
+        col.pending.shrink_to_fit();
+        col.bytes.shrink_to_fit();
+        col.blocks.shrink_to_fit();
+      },
+      ex, 1);
+
+  return error;
+}
+
+void dso::Sp3OrbitStore::seal() {
+  for (auto &col : cols_) {
+    encode_pending(col);
+    col.pending.shrink_to_fit();
+    col.bytes.shrink_to_fit();
+    col.blocks.shrink_to_fit();
+  }
+}
+
+void dso::Sp3OrbitStore::clear() noexcept {
+  cols_.clear();
+  cols_.shrink_to_fit();
+  has_ref_ = false;
+  ref_mjd_ = 0;
+  interval_ = dso::nanoseconds(0);
+}
+
+std::vector<dso::sp3::SatelliteId> dso::Sp3OrbitStore::satellites() const {
+  std::vector<sp3::SatelliteId> svs;
+  svs.reserve(cols_.size());
+  for (const auto &col : cols_)
+    svs.push_back(col.sv);
+  return svs;
+}
+
+int64_t
+dso::Sp3OrbitStore::num_records(const sp3::SatelliteId &sv) const noexcept {
+  const SvColumn *col = column(sv);
+  return col ? col->num_records : 0;
+}
+
+int dso::Sp3OrbitStore::span(
+    const sp3::SatelliteId &sv, dso::datetime<dso::nanoseconds> &first,
+    dso::datetime<dso::nanoseconds> &last) const noexcept {
+  const SvColumn *col = column(sv);
+  if (!col || !col->num_records)
+    return -1;
+  first = col->blocks.empty() ? col->pending.front().t
+                              : from_ns(col->blocks.front().t_first);
+  last = from_ns(col->t_last);
+  return 0;
+}
+
+int dso::Sp3OrbitStore::range(const sp3::SatelliteId &sv,
+                              const dso::datetime<dso::nanoseconds> &t0,
+                              const dso::datetime<dso::nanoseconds> &t1,
+                              std::vector<Sp3DataBlock> &out) const {
+  out.clear();
+  const SvColumn *col = column(sv);
+  if (!col)
+    return -1;
+
+  const int64_t ns0 = to_ns(t0);
+  const int64_t ns1 = to_ns(t1);
+
+  /* first block that ends at/after t0 */
+  auto it = std::lower_bound(
+      col->blocks.cbegin(), col->blocks.cend(), ns0,
+      [](const BlockHeader &h, int64_t ns) { return h.t_last < ns; });
+  for (; it != col->blocks.cend() && it->t_first <= ns1; ++it) {
+    const std::size_t sz = out.size();
+    decode_block(*col, it - col->blocks.cbegin(), out);
+    /* trim records out of range (only in first/last block) */
+    if (it->t_first < ns0 || it->t_last > ns1) {
+      auto last = std::remove_if(
+          out.begin() + sz, out.end(), [&](const Sp3DataBlock &b) {
+            return b.t < t0 || b.t > t1;
+          });
+      out.erase(last, out.end());
+    }
+  }
+
+  for (const auto &b : col->pending)
+    if (b.t >= t0 && b.t <= t1)
+      out.push_back(b);
+
+  return 0;
+}
+
+int dso::Sp3OrbitStore::window(const sp3::SatelliteId &sv,
+                               const dso::datetime<dso::nanoseconds> &t,
+                               dso::nanoseconds margin,
+                               std::vector<Sp3DataBlock> &out) const {
+  const int64_t ns = to_ns(t);
+  return range(sv, from_ns(ns - margin.as_underlying_type()),
+               from_ns(ns + margin.as_underlying_type()), out);
+}
+
+int dso::Sp3OrbitStore::load_interpolator(
+    const sp3::SatelliteId &sv, const dso::datetime<dso::nanoseconds> &t0,
+    const dso::datetime<dso::nanoseconds> &t1, SvInterpolator &intrp,
+    std::vector<Sp3DataBlock> &scratch) const {
+  if (range(sv, t0, t1, scratch))
+    return -1;
+
+  dso::nanoseconds interval = interval_;
+  if (!interval.as_underlying_type() && scratch.size() > 1)
+    interval = dso::nanoseconds(to_ns(scratch[1].t) - to_ns(scratch[0].t));
+
+  return intrp.reload(sv, scratch.data(), scratch.size(), interval);
+}
+
+std::size_t dso::Sp3OrbitStore::memory_bytes() const noexcept {
+  std::size_t bytes = cols_.capacity() * sizeof(SvColumn);
+  for (const auto &col : cols_) {
+    bytes += col.bytes.capacity();
+    bytes += col.blocks.capacity() * sizeof(BlockHeader);
+    bytes += col.pending.capacity() * sizeof(Sp3DataBlock);
+  }
+  return bytes;
+}
@@ -0,0 +1,222 @@
+#include "sp3_stream.hpp"
+#include <chrono>
+
+namespace {
+/* Wait for a future, executing pending tasks of the executor meanwhile (the
+ * task we are waiting for may be queued behind them)
+ */
+template <typename T>
+void help_while_waiting(const std::future<T> &f, dso::sp3::Executor &ex) {
+  while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    /* nothing we can help with; block until the task is done */
+    if (!ex.try_run_one()) {
+      f.wait();
+      return;
+    }
+  }
+}
+} /* anonymous namespace */
+
+dso::Sp3Stream::Sp3Stream(std::vector<std::string> files,
+                          dso::milliseconds max_window, sp3::Executor *ex)
+    : files_(std::move(files)), max_window_(max_window), ex_(ex) {
+  /* open the first file right away, in the background */
+  start_prefetch();
+}
+
+dso::Sp3Stream::~Sp3Stream() noexcept {
+  if (prefetch_.valid())
+    help_while_waiting(prefetch_, ex_ ? *ex_ : sp3::default_executor());
+}
+
+void dso::Sp3Stream::add_file(const std::string &fn) {
+  files_.push_back(fn);
+  exhausted_ = false;
+}
+
+void dso::Sp3Stream::start_prefetch() {
+  if (prefetch_.valid() || next_file_ >= (int)files_.size())
+    return;
+
+  auto promise = std::make_shared<std::promise<FilePtr>>();
+  prefetch_ = promise->get_future();
+  const std::string fn = files_[next_file_++];
+  sp3::Executor &ex = ex_ ? *ex_ : sp3::default_executor();
+  ex.submit([promise, fn]() {
+    try {
+      auto sp3 = std::make_unique<Sp3c>(fn.c_str());
+      /* get the file's pages read-in, while the current one is processed */
+      sp3->prefetch();
+      promise->set_value(std::move(sp3));
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  });
+}
+
+int dso::Sp3Stream::next_file() noexcept {
+  cursor_.reset();
+  current_.reset();
+
+  if (!prefetch_.valid())
+    start_prefetch();
+  if (!prefetch_.valid())
+    return -1;
+
+  help_while_waiting(prefetch_, ex_ ? *ex_ : sp3::default_executor());
+  try {
+    current_ = prefetch_.get();
+  } catch (std::exception &e) {
+    fprintf(stderr, "[ERROR] Failed opening Sp3 file %s (traceback: %s)\n",
+            files_[next_file_ - 1].c_str(), __func__);
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+    start_prefetch();
+    return 1;
+  }
+
+  cursor_.emplace(*current_);
+  interval_ = current_->interval();
+
+  /* open the one after, while this one is read */
+  start_prefetch();
+  return 0;
+}
+
+int dso::Sp3Stream::read_epoch() noexcept {
+  if (exhausted_)
+    return -1;
+
+  Sp3EpochBuffer buf;
+  if (!spare_.empty()) {
+    buf = std::move(spare_.back());
+    spare_.pop_back();
+  }
+
+  int error = 0;
+  for (;;) {
+    if (!cursor_ && (error = next_file())) {
+      if (error < 0)
+        exhausted_ = true;
+      break;
+    }
+
+    if ((error = cursor_->get_next_epoch(buf)) > 0) {
+      fprintf(stderr,
+              "[ERROR] Failed reading data block off from Sp3 file "
+              "(traceback: %s)\n",
+              __func__);
+      break;
+    } else if (error < 0) {
+      /* done with this file */
+      cursor_.reset();
+      current_.reset();
+      continue;
+    }
+
+    /* skip epochs already read off from the previous file */
+    if (buf.t <= last_read_)
+      continue;
+
+    last_read_ = buf.t;
+    window_.push_back(std::move(buf));
+    ++generation_;
+    return 0;
+  }
+
+  spare_.push_back(std::move(buf));
+  return error;
+}
+
+int dso::Sp3Stream::slide(const dso::datetime<dso::nanoseconds> &t) noexcept {
+  if (t < last_query_)
+    return 1;
+  last_query_ = t;
+
+  const dso::datetime_interval<dso::nanoseconds> w{
+      0, dso::cast_to<dso::milliseconds, dso::nanoseconds>(max_window_)};
+
+  for (;;) {
+    /* evict epochs no later query can need, i.e. prior to t - w; note that
+     * the interpolator may use one more data point, just outside the window
+     */
+    while (window_.size() > 1 && window_[1].t < t &&
+           w < (t - window_[1].t)) {
+      spare_.push_back(std::move(window_.front()));
+      window_.pop_front();
+      ++generation_;
+    }
+
+    /* read epochs up to (and including) the first one after t + w */
+    if (!window_.empty() && window_.back().t > t &&
+        w < (window_.back().t - t))
+      break;
+    const int error = read_epoch();
+    if (error < 0)
+      break;
+    else if (error > 0)
+      return 2;
+  }
+
+  return 0;
+}
+
+int dso::Sp3Stream::window(const sp3::SatelliteId &sv,
+                           const dso::datetime<dso::nanoseconds> &t,
+                           std::vector<Sp3DataBlock> &out) noexcept {
+  out.clear();
+  if (const int error = slide(t); error)
+    return error;
+
+  const dso::datetime_interval<dso::nanoseconds> w{
+      0, dso::cast_to<dso::milliseconds, dso::nanoseconds>(max_window_)};
+  for (const auto &epoch : window_) {
+    /* out of range ? */
+    if ((epoch.t < t && w < (t - epoch.t)) ||
+        (epoch.t > t && w < (epoch.t - t)))
+      continue;
+    if (const int k = epoch.find(sv); k >= 0)
+      out.push_back(epoch.blocks[k]);
+  }
+
+  return 0;
+}
+
+dso::Sp3Stream::SvSlot &dso::Sp3Stream::slot(const sp3::SatelliteId &sv) {
+  for (auto &sl : slots_)
+    if (sl.intrp.sv() == sv)
+      return sl;
+  slots_.push_back(SvSlot{SvInterpolator(sv), 0, false});
+  slots_.back().intrp.set_max_window(max_window_);
+  return slots_.back();
+}
+
+int dso::Sp3Stream::interpolate_at(const sp3::SatelliteId &sv,
+                                   const dso::datetime<dso::nanoseconds> &t,
+                                   double *pos, double *erpos, double *vel,
+                                   double *ervel) noexcept {
+  if (const int error = slide(t); error)
+    return error;
+
+  SvSlot *sl = &slot(sv);
+
+  /* re-feed the interpolator only if the window has changed */
+  if (!sl->fed || sl->generation != generation_) {
+    sl->fed = false;
+    records_.clear();
+    for (const auto &epoch : window_)
+      if (const int k = epoch.find(sv); k >= 0)
+        records_.push_back(epoch.blocks[k]);
+    if (sl->intrp.reload(sv, records_.data(), records_.size(), interval_)) {
+      fprintf(stderr,
+              "[ERROR] No data records for SV %.3s in stream window "
+              "(traceback: %s)\n",
+              sv.id, __func__);
+      return 3;
+    }
+    sl->fed = true;
+    sl->generation = generation_;
+  }
+
+  const int error = sl->intrp.interpolate_at(t, pos, erpos, vel, ervel);
+  return error ? 10 + error : 0;
+}
@@ -0,0 +1,321 @@
+#include "sp3_tail.hpp"
+#include "core/sp3_hash.hpp"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+namespace {
+/* Columns of the epoch count in the first header line; excluded from the
+ * header hash, since writers may update it as they append data blocks
+ */
+constexpr int64_t NUM_EPOCHS_COL{32};
+constexpr int64_t NUM_EPOCHS_LEN{7};
+#ifndef __linux__
+/* Period of checking for changes of the file, when inotify is missing */
+constexpr int WAIT_POLL_MILLISEC{100};
+#endif
+
+/* Hash the range [pos, pos + count) of the file snapshot at data */
+uint64_t hash_range(const char *data, int64_t pos, int64_t count,
+                    uint64_t h = dso::sp3::FNV_OFFSET_BASIS) noexcept {
+  return dso::sp3::fnv1a(h, data + pos, count);
+}
+
+/* Hash the header (of size size) of the file snapshot at data */
+uint64_t hash_header(const char *data, int64_t size) noexcept {
+  if (size <= NUM_EPOCHS_COL + NUM_EPOCHS_LEN)
+    return hash_range(data, 0, size);
+  const uint64_t h = hash_range(data, 0, NUM_EPOCHS_COL);
+  return hash_range(data, NUM_EPOCHS_COL + NUM_EPOCHS_LEN,
+                    size - NUM_EPOCHS_COL - NUM_EPOCHS_LEN, h);
+}
+
+/* Hash the range [pos, pos + count) of file fd, read via pread; same as
+ * hash_range on a snapshot of the file
+ */
+int hash_file_range(int fd, int64_t pos, int64_t count,
+                    uint64_t &h) noexcept {
+  char buf[4096];
+  while (count > 0) {
+    const ssize_t n =
+        ::pread(fd, buf, std::min<int64_t>(count, sizeof buf), pos);
+    if (n <= 0)
+      return 1;
+    h = dso::sp3::fnv1a(h, buf, n);
+    pos += n;
+    count -= n;
+  }
+  return 0;
+}
+
+/* Hash the header (of size size) of file fd; same as hash_header on a
+ * snapshot of the file
+ */
+int hash_file_header(int fd, int64_t size, uint64_t &h) noexcept {
+  h = dso::sp3::FNV_OFFSET_BASIS;
+  if (size <= NUM_EPOCHS_COL + NUM_EPOCHS_LEN)
+    return hash_file_range(fd, 0, size, h);
+  return hash_file_range(fd, 0, NUM_EPOCHS_COL, h) ||
+         hash_file_range(fd, NUM_EPOCHS_COL + NUM_EPOCHS_LEN,
+                         size - NUM_EPOCHS_COL - NUM_EPOCHS_LEN, h);
+}
+
+/* Find the end of the complete data blocks of the file snapshot at data (of
+ * size size), searching no earlier than from; that is the start of the
+ * 'EOF' line if the file ends with one, else the start of the last data
+ * block (which may still be written to).
+ */
+int64_t complete_end(const char *data, int64_t size, int64_t from) noexcept {
+  /* does the file end with an 'EOF' line ? */
+  int64_t n = size;
+  while (n > from && (data[n - 1] == '\n' || data[n - 1] == '\r' ||
+                      data[n - 1] == ' '))
+    --n;
+  if (n - from >= 3 && !std::strncmp(data + n - 3, "EOF", 3) &&
+      (n == 3 || data[n - 4] == '\n'))
+    return n - 3;
+
+  /* search backwards for the last epoch header line */
+  for (int64_t i = size - 1; i > from; i--)
+    if (data[i] == '*' && data[i - 1] == '\n')
+      return i;
+  return from;
+}
+} /* anonymous namespace */
+
+dso::Sp3Tail::~Sp3Tail() noexcept {
+#ifdef __linux__
+  if (inotify_fd_ >= 0)
+    ::close(inotify_fd_);
+#endif
+}
+
+void dso::Sp3Tail::reset() noexcept {
+  offset_ = last_pos_ = 0;
+  last_hash_ = 0;
+  last_epoch_ = dso::datetime<dso::nanoseconds>::min();
+  size_ = -1;
+  mtime_ = 0;
+  sp3_.reset();
+  dev_ = ino_ = header_hash_ = 0;
+}
+
+int dso::Sp3Tail::poll(std::vector<Sp3EpochBuffer> &epochs,
+                       bool *rewritten) noexcept {
+  epochs.clear();
+  if (rewritten)
+    *rewritten = false;
+
+  /* checks run on the file (via pread), never on a mapping of it, so
+   * that files truncated or rewritten meanwhile cannot fault (SIGBUS)
+   */
+  const int fd = ::open(fn_.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || ::fstat(fd, &st)) {
+    fprintf(stderr, "[ERROR] Failed to stat file %s (traceback: %s)\n",
+            fn_.c_str(), __func__);
+    if (fd >= 0)
+      ::close(fd);
+    return 1;
+  }
+  if (sp3_ && st.st_size == size_ && st.st_mtime == mtime_ &&
+      (uint64_t)st.st_dev == dev_ && (uint64_t)st.st_ino == ino_) {
+    ::close(fd);
+    return 0;
+  }
+
+  /* is this the file opened, with the header and the last data block read
+   * still there, as they were ?
+   */
+  bool is_rewritten = !sp3_ || (uint64_t)st.st_dev != dev_ ||
+                      (uint64_t)st.st_ino != ino_ || st.st_size < offset_;
+  if (!is_rewritten) {
+    uint64_t h = sp3::FNV_OFFSET_BASIS;
+    is_rewritten = hash_file_header(fd, sp3_->header_size(), h) ||
+                   h != header_hash_;
+    h = sp3::FNV_OFFSET_BASIS;
+    is_rewritten =
+        is_rewritten ||
+        (offset_ > 0 &&
+         (hash_file_range(fd, last_pos_, offset_ - last_pos_, h) ||
+          h != last_hash_));
+  }
+  ::close(fd);
+
+  /* if so, just read in the bytes appended to the snapshot; failing that
+   * (e.g. the file shrunk meanwhile), read the file again
+   */
+  if (!is_rewritten && sp3_->remap())
+    is_rewritten = true;
+  /* nothing read yet is not a rewrite */
+  is_rewritten = is_rewritten && sp3_;
+
+  /* (re-)open the file; the instance is only replaced on success */
+  std::unique_ptr<Sp3c> fresh;
+  if (!sp3_ || is_rewritten) {
+    try {
+      fresh = std::make_unique<Sp3c>(fn_.c_str(), sp3::MapMode::snapshot);
+    } catch (std::exception &e) {
+      fprintf(stderr, "[ERROR] Failed opening Sp3 file %s (traceback: %s)\n",
+              fn_.c_str(), __func__);
+      fprintf(stderr, "[ERROR] %s\n", e.what());
+      return 2;
+    }
+  }
+  const Sp3c &sp3 = fresh ? *fresh : *sp3_;
+  const char *data = sp3.raw_data();
+  const int64_t size = sp3.raw_size();
+
+  int64_t offset = fresh ? 0 : offset_;
+  int64_t last_pos = fresh ? 0 : last_pos_;
+  auto last_epoch =
+      fresh ? dso::datetime<dso::nanoseconds>::min() : last_epoch_;
+  const int64_t end = complete_end(
+      data, size, std::max<int64_t>(offset, sp3.header_size()));
+  int error = 0;
+
+  /* the epochs collected may not fit in memory (std::bad_alloc) */
+  try {
+    Sp3Cursor cursor(sp3);
+    if (offset && cursor.seek(offset)) {
+      error = 3;
+    } else {
+      Sp3EpochBuffer buf;
+      while (!error && cursor.tell() < end) {
+        const int64_t pos = cursor.tell();
+        if ((error = cursor.get_next_epoch(buf)) < 0) {
+          error = 0;
+          break;
+        } else if (error) {
+          fprintf(stderr,
+                  "[ERROR] Failed reading data block at offset %ld of file %s "
+                  "(traceback: %s)\n",
+                  (long)pos, fn_.c_str(), __func__);
+          error += 10;
+          break;
+        }
+        offset = std::min(cursor.tell(), end);
+        last_pos = pos;
+        /* skip epochs out of order (e.g. repeated) */
+        if (buf.t > last_epoch) {
+          last_epoch = buf.t;
+          epochs.push_back(buf);
+        }
+      }
+    }
+  } catch (std::exception &e) {
+    fprintf(stderr,
+            "[ERROR] Failed collecting data blocks of file %s (traceback: "
+            "%s)\n",
+            fn_.c_str(), __func__);
+    fprintf(stderr, "[ERROR] %s\n", e.what());
+    error = 4;
+  }
+
+  if (error) {
+    epochs.clear();
+    return error;
+  }
+
+  if (fresh) {
+    sp3_ = std::move(fresh);
+    dev_ = st.st_dev;
+    ino_ = st.st_ino;
+    header_hash_ = hash_header(sp3_->raw_data(), sp3_->header_size());
+  }
+  offset_ = offset;
+  last_pos_ = last_pos;
+  last_hash_ = (offset > 0) ? hash_range(data, last_pos, offset - last_pos)
+                            : 0;
+  last_epoch_ = last_epoch;
+  size_ = size;
+  mtime_ = st.st_mtime;
+  if (rewritten)
+    *rewritten = is_rewritten;
+  return 0;
+}
+
+int dso::Sp3Tail::wait(int timeout_millisec) noexcept {
+#ifdef __linux__
+  /* watch the directory, so that files replaced via rename are caught */
+  const auto slash = fn_.find_last_of('/');
+  const std::string dir =
+      (slash == std::string::npos) ? std::string(".") : fn_.substr(0, slash);
+  const std::string name =
+      (slash == std::string::npos) ? fn_ : fn_.substr(slash + 1);
+
+  if (inotify_fd_ < 0) {
+    if ((inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+      fprintf(stderr, "[ERROR] Failed to initialize inotify (traceback: %s)\n",
+              __func__);
+      return 1;
+    }
+    watch_fd_ = ::inotify_add_watch(inotify_fd_, dir.c_str(),
+                                    IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO |
+                                        IN_CREATE);
+    if (watch_fd_ < 0) {
+      fprintf(stderr, "[ERROR] Failed to watch directory %s (traceback: %s)\n",
+              dir.c_str(), __func__);
+      ::close(inotify_fd_);
+      inotify_fd_ = -1;
+      return 1;
+    }
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(timeout_millisec);
+  alignas(struct inotify_event) char buf[4096];
+  for (;;) {
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          deadline - std::chrono::steady_clock::now())
+                          .count();
+    if (left <= 0)
+      return -1;
+    struct pollfd pfd {
+      inotify_fd_, POLLIN, 0
+    };
+    const int r = ::poll(&pfd, 1, (int)left);
+    if (r < 0)
+      return 1;
+    else if (!r)
+      return -1;
+
+    /* any events on our file ? */
+    bool changed = false;
+    ssize_t n;
+    while ((n = ::read(inotify_fd_, buf, sizeof buf)) > 0) {
+      for (char *p = buf; p < buf + n;) {
+        const auto *ev = reinterpret_cast<const struct inotify_event *>(p);
+        if (ev->len && name == ev->name)
+          changed = true;
+        p += sizeof(struct inotify_event) + ev->len;
+      }
+    }
+    if (changed)
+      return 0;
+  }
+#else
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(timeout_millisec);
+  for (;;) {
+    struct stat st;
+    if (!::stat(fn_.c_str(), &st) &&
+        (st.st_size != size_ || st.st_mtime != mtime_))
+      return 0;
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          deadline - std::chrono::steady_clock::now())
+                          .count();
+    if (left <= 0)
+      return -1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(
+        std::min<long>(left, WAIT_POLL_MILLISEC)));
+  }
+#endif
+}
@@ -0,0 +1,124 @@
+#include "sp3_tier.hpp"
+
+const char *dso::to_string(Sp3Tier tier) noexcept {
+  switch (tier) {
+  case Sp3Tier::final:
+    return "final";
+  case Sp3Tier::rapid:
+    return "rapid";
+  case Sp3Tier::ultra_rapid:
+    return "ultra-rapid";
+  }
+  return "unknown";
+}
+
+void dso::Sp3TierResolver::add_source(const char *fn, Sp3Tier tier) {
+  auto src = std::make_unique<Source>();
+  src->fn = fn;
+  src->tier = tier;
+  src->index = sources_.size();
+  /* keep sorted on tier; same tier in order of registration */
+  auto it = std::upper_bound(
+      sources_.begin(), sources_.end(), tier,
+      [](Sp3Tier t, const std::unique_ptr<Source> &s) { return t < s->tier; });
+  sources_.insert(it, std::move(src));
+}
+
+int dso::Sp3TierResolver::num_opened() const noexcept {
+  int n = 0;
+  for (const auto &s : sources_)
+    n += (s->sp3 != nullptr);
+  return n;
+}
+
+dso::Sp3c *
+dso::Sp3TierResolver::open(Source &src,
+                           const dso::datetime<dso::nanoseconds> &t) noexcept {
+  if (src.failed)
+    return nullptr;
+  if (!src.sp3) {
+    try {
+      src.sp3 = std::make_unique<Sp3c>(src.fn.c_str());
+    } catch (std::exception &e) {
+      fprintf(stderr,
+              "[WARNING] Failed opening Sp3 file %s; skipping (traceback: "
+              "%s)\n",
+              src.fn.c_str(), __func__);
+      fprintf(stderr, "[WARNING] %s\n", e.what());
+      src.failed = true;
+      return nullptr;
+    }
+  }
+
+  /* nominal span of the file, off from its header */
+  const Sp3c &sp3 = *src.sp3;
+  return (t < sp3.start_epoch() || t > sp3.stop_epoch()) ? nullptr
+                                                          : src.sp3.get();
+}
+
+dso::SvInterpolator *
+dso::Sp3TierResolver::interpolator(Source &src, const sp3::SatelliteId &sv) {
+  for (auto &intrp : src.intrps)
+    if (intrp.sv() == sv)
+      return intrp.num_data_points() ? &intrp : nullptr;
+  if (!src.sp3->has_sv(sv))
+    return nullptr;
+
+  /* build it; on failure, keep an empty one so that it is not re-tried */
+  src.intrps.emplace_back(sv);
+  SvInterpolator &intrp = src.intrps.back();
+  intrp.set_max_window(max_window_);
+  if (intrp.reload(sv, *src.sp3)) {
+    fprintf(stderr,
+            "[WARNING] Failed reading records for %s off from %s; skipping "
+            "(traceback: %s)\n",
+            sv.to_string().c_str(), src.fn.c_str(), __func__);
+    return nullptr;
+  }
+  return &intrp;
+}
+
+int dso::Sp3TierResolver::interpolate_at(
+    const sp3::SatelliteId &sv, const dso::datetime<dso::nanoseconds> &t,
+    double *pos, double *erpos, double *vel, double *ervel,
+    Sp3TierInfo *info) noexcept {
+  int error = -1;
+  for (auto &src : sources_) {
+    if (!open(*src, t))
+      continue;
+    SvInterpolator *intrp;
+    try {
+      intrp = interpolator(*src, sv);
+    } catch (std::exception &) {
+      intrp = nullptr;
+    }
+    if (!intrp)
+      continue;
+
+    /* records of the SV must bracket t */
+    const Sp3DataBlock *data = intrp->data_points();
+    const int n = intrp->num_data_points();
+    if (t < data[0].t || t > data[n - 1].t)
+      continue;
+    const auto it = std::upper_bound(
+        data, data + n, t,
+        [](const dso::datetime<dso::nanoseconds> &tt,
+           const Sp3DataBlock &b) { return tt < b.t; });
+    const int k = std::max(1, static_cast<int>(it - data)) - 1;
+    const bool predicted =
+        data[k].flag.is_set(Sp3Event::orbit_prediction) ||
+        (k + 1 < n && data[k + 1].flag.is_set(Sp3Event::orbit_prediction));
+    if (predicted && !accept_predicted_)
+      continue;
+
+    if ((error = intrp->interpolate_at(t, pos, erpos, vel, ervel)))
+      continue;
+    if (info) {
+      info->tier = src->tier;
+      info->source = src->index;
+      info->predicted = predicted;
+    }
+    return 0;
+  }
+  return error;
+}
@@ -0,0 +1,259 @@
+#include "sp3_writer.hpp"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+/* Satellites per '+'/'++' header line, and min number of such lines */
+constexpr int SATS_PER_LINE = 17;
+constexpr int MIN_SAT_LINES = 5;
+/* Min number of comment lines */
+constexpr int MIN_COMMENT_LINES = 4;
+/* Max number of satellites in an Sp3c file */
+constexpr int MAX_SATS_SP3C = 85;
+
+/* Value written for bad/absent clock values */
+constexpr double SP3_MISSING_CLK_VALUE{999999.999999e0};
+
+constexpr int64_t NS_PER_HOUR = 3600LL * 1000000000LL;
+constexpr int64_t NS_PER_MIN = 60LL * 1000000000LL;
+
+/* Calendar date and time of an epoch */
+struct CalendarDate {
+  int year, month, day, hour, minute;
+  double sec;
+}; /* struct CalendarDate */
+
+CalendarDate calendar(const dso::datetime<dso::nanoseconds> &t) noexcept {
+  /* civil date off from days since 1970-01-01 (MJD 40587) */
+  const long z = t.imjd().as_underlying_type() - 40587L + 719468L;
+  const long era = (z >= 0 ? z : z - 146096) / 146097;
+  const long doe = z - era * 146097;
+  const long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const long mp = (5 * doy + 2) / 153;
+  CalendarDate d;
+  d.day = doy - (153 * mp + 2) / 5 + 1;
+  d.month = mp < 10 ? mp + 3 : mp - 9;
+  d.year = yoe + era * 400 + (d.month <= 2);
+  const int64_t ns = t.sec().as_underlying_type();
+  d.hour = ns / NS_PER_HOUR;
+  d.minute = (ns % NS_PER_HOUR) / NS_PER_MIN;
+  d.sec = (ns % NS_PER_MIN) * 1e-9;
+  return d;
+}
+
+/* Exponent n so that base^n approximates a std. deviation, within [1, max] */
+int sdev_exponent(double sdev, double base, int max) noexcept {
+  const int n = (int)std::lround(std::log(sdev) / std::log(base));
+  return std::min(std::max(n, 1), max);
+}
+
+std::string trimmed(const char *s) {
+  std::string r(s);
+  while (!r.empty() && r.back() == ' ')
+    r.pop_back();
+  return r;
+}
+} /* anonymous namespace */
+
+dso::Sp3Header dso::Sp3Header::from(const Sp3c &sp3) {
+  Sp3Header h;
+  h.version = sp3.version();
+  h.has_velocities = sp3.has_velocities();
+  h.start_epoch = sp3.start_epoch();
+  h.interval = sp3.interval();
+  h.data_used = trimmed(sp3.data_used());
+  h.coordinate_system = trimmed(sp3.coordinate_system());
+  h.orbit_type = trimmed(sp3.orbit_type());
+  h.agency = trimmed(sp3.agency());
+  h.time_system = trimmed(sp3.time_sys());
+  h.fp_base_pos = sp3.fp_base_pos();
+  h.fp_base_clk = sp3.fp_base_clk();
+  h.satellites = sp3.sattellite_vector();
+  return h;
+}
+
+dso::Sp3Writer::Sp3Writer(const char *fn, const Sp3Header &hdr)
+    : fn_(fn), hdr_(hdr) {
+  if ((int)hdr_.satellites.size() > MAX_SATS_SP3C)
+    hdr_.version = 'd';
+  if (!(fp_ = std::fopen(fn, "wb"))) {
+    fprintf(stderr, "[ERROR] Failed creating Sp3 file %s (traceback: %s)\n",
+            fn, __func__);
+    throw std::runtime_error("[ERROR] Failed creating Sp3 file\n");
+  }
+
+  char line[128];
+  std::string h;
+  const CalendarDate d = calendar(hdr_.start_epoch);
+  std::snprintf(line, sizeof line,
+                "#%c%c%4d %2d %2d %2d %2d %11.8f %7d %-5.5s %-5.5s %-3.3s "
+                "%4.4s\n",
+                hdr_.version, hdr_.has_velocities ? 'V' : 'P', d.year, d.month,
+                d.day, d.hour, d.minute, d.sec, 0, hdr_.data_used.c_str(),
+                hdr_.coordinate_system.c_str(), hdr_.orbit_type.c_str(),
+                hdr_.agency.c_str());
+  h += line;
+  num_epochs_pos_ = 32;
+
+  dso::nanoseconds sow;
+  const long week = hdr_.start_epoch.gps_wsow(sow).as_underlying_type();
+  std::snprintf(line, sizeof line, "## %4ld %15.8f %14.8f %5ld %15.13f\n",
+                week, sow.as_underlying_type() * 1e-9,
+                hdr_.interval.as_underlying_type() * 1e-9,
+                (long)hdr_.start_epoch.imjd().as_underlying_type(),
+                hdr_.start_epoch.sec().as_underlying_type() * 1e-9 / 86400e0);
+  h += line;
+
+  /* satellite ids and accuracy exponents */
+  const int n = hdr_.satellites.size();
+  const int num_lines =
+      std::max(MIN_SAT_LINES, (n + SATS_PER_LINE - 1) / SATS_PER_LINE);
+  for (int pass = 0; pass < 2; pass++) {
+    for (int k = 0; k < num_lines; k++) {
+      if (pass)
+        h += "++       ";
+      else if (k)
+        h += "+        ";
+      else {
+        std::snprintf(line, sizeof line, "+  %3d   ", n);
+        h += line;
+      }
+      for (int m = k * SATS_PER_LINE; m < (k + 1) * SATS_PER_LINE; m++) {
+        if (m >= n) {
+          h += "  0";
+        } else if (!pass) {
+          h.append(hdr_.satellites[m].id, 3);
+        } else {
+          const int a = (m < (int)hdr_.accuracy.size()) ? hdr_.accuracy[m] : 0;
+          std::snprintf(line, sizeof line, "%3d", a);
+          h += line;
+        }
+      }
+      h += '\n';
+    }
+  }
+
+  /* file type: a single system, or mixed */
+  char type = n ? hdr_.satellites[0].id[0] : 'G';
+  for (const auto &sv : hdr_.satellites)
+    if (sv.id[0] != type)
+      type = 'M';
+  std::snprintf(line, sizeof line,
+                "%%c %c  cc %-3.3s ccc cccc cccc cccc cccc ccccc ccccc ccccc "
+                "ccccc\n",
+                type, hdr_.time_system.c_str());
+  h += line;
+  h += "%c cc cc ccc ccc cccc cccc cccc cccc ccccc ccccc ccccc ccccc\n";
+  std::snprintf(line, sizeof line, "%%f %10.7f %12.9f %14.11f %18.15f\n",
+                hdr_.fp_base_pos, hdr_.fp_base_clk, 0e0, 0e0);
+  h += line;
+  h += "%f  0.0000000  0.000000000  0.00000000000  0.000000000000000\n";
+  h += "%i    0    0    0    0      0      0      0      0         0\n";
+  h += "%i    0    0    0    0      0      0      0      0         0\n";
+  for (int k = 0; k < std::max<int>(MIN_COMMENT_LINES, hdr_.comments.size());
+       k++) {
+    h += "/* ";
+    if (k < (int)hdr_.comments.size())
+      h += hdr_.comments[k].substr(0, 77);
+    h += '\n';
+  }
+
+  if (std::fwrite(h.data(), 1, h.size(), fp_) != h.size()) {
+    fprintf(stderr, "[ERROR] Failed writing Sp3 header to %s (traceback: %s)\n",
+            fn, __func__);
+    std::fclose(fp_);
+    fp_ = nullptr;
+    throw std::runtime_error("[ERROR] Failed writing Sp3 header\n");
+  }
+}
+
+dso::Sp3Writer::~Sp3Writer() noexcept {
+  if (fp_)
+    close();
+}
+
+int dso::Sp3Writer::write_record(char type, const sp3::SatelliteId &sv,
+                                 const Sp3DataBlock &b) noexcept {
+  const bool pos = (type == 'P');
+  const int o = pos ? 0 : 4;
+  const Sp3Flag &f = b.flag;
+  const bool bad_xyz = f.is_set(pos ? Sp3Event::bad_abscent_position
+                                    : Sp3Event::bad_abscent_velocity);
+  const bool bad_clk = f.is_set(pos ? Sp3Event::bad_abscent_clock
+                                    : Sp3Event::bad_abscent_clock_rate);
+
+  char line[128];
+  int c = std::snprintf(line, sizeof line, "%c%-3.3s%14.6f%14.6f%14.6f%14.6f",
+                        type, sv.id, bad_xyz ? 0e0 : b.state[o],
+                        bad_xyz ? 0e0 : b.state[o + 1],
+                        bad_xyz ? 0e0 : b.state[o + 2],
+                        bad_clk ? SP3_MISSING_CLK_VALUE : b.state[o + 3]);
+  std::memset(line + c, ' ', 80 - c);
+  line[80] = '\n';
+
+  /* std. deviations, as exponents of the floating point bases */
+  char field[8];
+  if (!bad_xyz && f.is_set(pos ? Sp3Event::has_pos_stddev
+                               : Sp3Event::has_vel_stddev)) {
+    for (int i = 0; i < 3; i++) {
+      std::snprintf(field, sizeof field, "%2d",
+                    sdev_exponent(b.state_sdev[o + i], hdr_.fp_base_pos, 99));
+      std::memcpy(line + 61 + 3 * i, field, 2);
+    }
+  }
+  if (!bad_clk && f.is_set(pos ? Sp3Event::has_clk_stddev
+                               : Sp3Event::has_clk_rate_stdev)) {
+    std::snprintf(field, sizeof field, "%3d",
+                  sdev_exponent(b.state_sdev[o + 3], hdr_.fp_base_clk, 999));
+    std::memcpy(line + 70, field, 3);
+  }
+  if (pos) {
+    if (f.is_set(Sp3Event::clock_event))
+      line[74] = 'E';
+    if (f.is_set(Sp3Event::clock_prediction))
+      line[75] = 'P';
+    if (f.is_set(Sp3Event::maneuver))
+      line[78] = 'M';
+    if (f.is_set(Sp3Event::orbit_prediction))
+      line[79] = 'P';
+  }
+  return std::fwrite(line, 1, 81, fp_) != 81;
+}
+
+int dso::Sp3Writer::write_epoch(const Sp3EpochBuffer &epoch) noexcept {
+  if (!fp_)
+    return 1;
+  char line[64];
+  const CalendarDate d = calendar(epoch.t);
+  std::snprintf(line, sizeof line, "*  %4d %2d %2d %2d %2d %11.8f\n", d.year,
+                d.month, d.day, d.hour, d.minute, d.sec);
+  if (std::fputs(line, fp_) < 0)
+    return 2;
+  for (int i = 0; i < epoch.size(); i++) {
+    if (write_record('P', epoch.sats[i], epoch.blocks[i]))
+      return 2;
+    if (hdr_.has_velocities &&
+        write_record('V', epoch.sats[i], epoch.blocks[i]))
+      return 2;
+  }
+  ++num_epochs_;
+  return 0;
+}
+
+int dso::Sp3Writer::close() noexcept {
+  if (!fp_)
+    return 1;
+  int error = std::fputs("EOF\n", fp_) < 0;
+  char field[16];
+  std::snprintf(field, sizeof field, "%7d", num_epochs_);
+  error = error || std::fseek(fp_, num_epochs_pos_, SEEK_SET) ||
+          std::fwrite(field, 1, 7, fp_) != 7;
+  error = std::fclose(fp_) || error;
+  fp_ = nullptr;
+  if (error)
+    fprintf(stderr, "[ERROR] Failed writing Sp3 file %s (traceback: %s)\n",
+            fn_.c_str(), __func__);
+  return error;
+}
@@ -1,20 +1,23 @@
 #include "sv_interpolate.hpp"
 #include "datetime/calendar.hpp"
 
-int dso::SvInterpolator::compute_workspace_size() noexcept {
+int dso::SvInterpolator::compute_workspace_size() const noexcept {
   dso::nanoseconds lr_intrvl =
       dso::cast_to<dso::milliseconds, dso::nanoseconds>(max_millisec);
   int one_side_pts =
-      lr_intrvl.as_underlying_type() / sp3->interval().as_underlying_type();
+      lr_intrvl.as_underlying_type() / interval.as_underlying_type();
   ++one_side_pts;
   return one_side_pts * 2 + 1;
 }
 
-int dso::SvInterpolator::feed_from_sp3() noexcept {
-  if (!sp3)
-    return 1;
+int dso::SvInterpolator::feed_from_sp3(const Sp3c &sp3) noexcept {
+  num_dpts = 0;
+  last_index = 0;
+  data.clear();
+  source_fn.clear();
+  source_fp = Sp3Fingerprint();
 
-  if (!sp3->num_epochs()) {
+  if (!sp3.num_epochs()) {
     fprintf(stderr,
             "[ERROR] Sp3 instance has no epochs stored! Did you forget to "
             "read it's header? (traceback: %s)\n",
@@ -22,7 +25,7 @@ int dso::SvInterpolator::feed_from_sp3() noexcept {
     return 1;
   }
 
-  if (!sp3->has_sv(svid)) {
+  if (!sp3.has_sv(svid)) {
     fprintf(stderr,
             "[ERROR] Sp3 instance has no data records for the requested SV "
             "(traceback: %s)\n",
@@ -30,23 +33,30 @@ int dso::SvInterpolator::feed_from_sp3() noexcept {
     return 2;
   }
 
-  // allocate enough space; to be safe, use the number of epochs in the sp3
-  // file, even though some records may be missing
-  if (data)
-    delete[] data;
-  num_dpts = 0;
-  data = new Sp3DataBlock[sp3->num_epochs()];
+  tref = sp3.start_epoch();
+  interval = sp3.interval();
 
-  // read the sp3 file through and grap data for the sv
+  // reserve enough space; to be safe, use the number of epochs in the sp3
+  // file, even though some records may be missing. If the buffer is already
+  // large enough (e.g. on reload), this will not allocate
+  data.reserve(sp3.has_index() ? sp3.index().num_epochs()
+                                : sp3.num_epochs());
+
+  // read the sp3 file through and grap data for the sv; use an independent
+  // cursor, so that interpolators for different SVs can be fed concurrently
   Sp3DataBlock block;
-  sp3->rewind();
-  int error, idx = 0;
-  while (!(error = sp3->get_next_data_block(svid, block))) {
-    // do not include data point if position and clock are missing
-    if (!(block.flag.is_set(Sp3Event::bad_abscent_position) &&
+  Sp3Cursor cursor(sp3);
+  int error;
+  do {
+    block.t = dso::datetime<dso::nanoseconds>::min();
+    error = cursor.get_next_data_block(svid, block);
+    // note that the last data block may come along with EOF (i.e. -1); do
+    // not include data point if position and clock are missing
+    if (error <= 0 && block.t != dso::datetime<dso::nanoseconds>::min() &&
+        !(block.flag.is_set(Sp3Event::bad_abscent_position) &&
           block.flag.is_set(Sp3Event::bad_abscent_clock)))
-      data[idx++] = block;
-  }
+      data.push_back(block);
+  } while (!error);
 
   // check for error while parsing
   if (error > 0) {
@@ -54,29 +64,123 @@ int dso::SvInterpolator::feed_from_sp3() noexcept {
             "[ERROR] Failed parsing sp3 file for the requested SV data "
             "(traceback: %s)\n",
             __func__);
-    delete[] data;
-    data = nullptr;
+    data.clear();
+    return 1;
   }
 
-  // set num_dpts to 0 in case of error; else num_dpts is the actual number of
-  // data blocks read in from the Sp3 instance, excluding the ones with bad
-  // flags
-  num_dpts = (error > 0) ? 0 : idx;
+  // record where the data points came from (see checkpoint/restore)
+  try {
+    source_fn = sp3.filename();
+  } catch (std::exception &) {
+    data.clear();
+    return 1;
+  }
+  source_fp = sp3.fingerprint();
 
-  return error > 0;
+  size_workspace();
+  return 0;
 }
 
-dso::SvInterpolator::SvInterpolator(sp3::SatelliteId sid, Sp3c &sp3obj,
-                                    dso::milliseconds max_allowed_millisec)
-    : svid(sid), sp3(&sp3obj), max_millisec(max_allowed_millisec) {
-  if (int error = feed_from_sp3(); error) {
+void dso::SvInterpolator::size_workspace() noexcept {
+  // num_dpts is the actual number of data blocks collected, excluding the
+  // ones with bad flags
+  num_dpts = data.size();
+
+  // size the workspace arena
+  const int workspace_size = compute_workspace_size();
+  txyz.resize(workspace_size * 4);
+  workspace.resize(workspace_size * 6);
+}
+
+dso::SvInterpolator::SvInterpolator(sp3::SatelliteId sid,
+                                    const Sp3c &sp3obj,
+                                    dso::milliseconds max_allowed_millisec,
+                                    std::pmr::memory_resource *mr)
+    : svid(sid), max_millisec(max_allowed_millisec), data(mr), txyz(mr),
+      workspace(mr) {
+  if (int error = feed_from_sp3(sp3obj); error) {
     throw std::runtime_error("[ERROR] Failed creating SvInterpolator "
                              "instance from Sp3 Error Code: " +
                              std::to_string(error));
   }
-  int workspace_size = compute_workspace_size();
-  txyz = new double[workspace_size * 4];
-  workspace = new double[workspace_size * 6];
+}
+
+int dso::SvInterpolator::reload(sp3::SatelliteId sid,
+                                const Sp3c &sp3obj) noexcept {
+  svid = sid;
+  return feed_from_sp3(sp3obj);
+}
+
+int dso::SvInterpolator::reload(sp3::SatelliteId sid,
+                                const Sp3DataBlock *blocks, int count,
+                                dso::nanoseconds nominal_interval) noexcept {
+  svid = sid;
+  source_fn.clear();
+  source_fp = Sp3Fingerprint();
+  num_dpts = 0;
+  last_index = 0;
+  data.clear();
+
+  if (count <= 0 || nominal_interval.as_underlying_type() <= 0) {
+    fprintf(stderr,
+            "[ERROR] No data blocks (or invalid interval) to feed "
+            "interpolator with (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+
+  tref = blocks[0].t;
+  interval = nominal_interval;
+  data.reserve(count);
+  for (int i = 0; i < count; i++) {
+    if (!(blocks[i].flag.is_set(Sp3Event::bad_abscent_position) &&
+          blocks[i].flag.is_set(Sp3Event::bad_abscent_clock)))
+      data.push_back(blocks[i]);
+  }
+
+  size_workspace();
+  return 0;
+}
+
+int dso::SvInterpolator::rebind(const Sp3c &sp3obj) noexcept {
+  try {
+    source_fn = sp3obj.filename();
+  } catch (std::exception &) {
+    source_fn.clear();
+    source_fp = Sp3Fingerprint();
+    return 1;
+  }
+  source_fp = sp3obj.fingerprint();
+  return 0;
+}
+
+int dso::SvInterpolator::append(const Sp3DataBlock &block) noexcept {
+  if (block.flag.is_set(Sp3Event::bad_abscent_position) &&
+      block.flag.is_set(Sp3Event::bad_abscent_clock))
+    return 0;
+  if (num_dpts && block.t <= data[num_dpts - 1].t)
+    return 1;
+
+  if (!num_dpts) {
+    tref = block.t;
+    last_index = 0;
+  } else if (!interval.as_underlying_type()) {
+    const auto &last = data[num_dpts - 1].t;
+    interval = dso::nanoseconds(
+        (block.t.imjd().as_underlying_type() -
+         last.imjd().as_underlying_type()) *
+            86400L * dso::nanoseconds::sec_factor<long>() +
+        block.t.sec().as_underlying_type() - last.sec().as_underlying_type());
+  }
+
+  data.push_back(block);
+  /* the workspace can only be sized once the interval is known */
+  if (interval.as_underlying_type())
+    size_workspace();
+  else
+    num_dpts = data.size();
+
+  return 0;
 }
 
 /*
@@ -172,10 +276,49 @@ int dso::SvInterpolator::interpolate_at(dso::datetime<dso::nanoseconds> t,
 
 int dso::SvInterpolator::interpolate_at(dso::datetime<dso::nanoseconds> t,
                                         double *pos, double *erpos,
-                                        double *vel, double *ervel) noexcept {
+                                        double *vel, double *ervel,
+                                        SvInterpolationState &state) const
+    noexcept {
+  if (!num_dpts) {
+    fprintf(stderr, "[ERROR] No data points to interpolate (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
 
-  int index = index_hunt(t);
-  last_index = index;
+  const int wsz = compute_workspace_size();
+  if ((int)state.txyz.size() < wsz * 4) {
+    try {
+      state.txyz.resize(wsz * 4);
+      state.workspace.resize(wsz * 6);
+    } catch (std::exception &) {
+      fprintf(stderr,
+              "[ERROR] Failed allocating interpolation workspace (traceback: "
+              "%s)\n",
+              __func__);
+      return 1;
+    }
+  }
+  if (state.last_index >= num_dpts)
+    state.last_index = 0;
+
+  return interpolate(t, pos, erpos, vel, ervel, state.last_index,
+                     state.txyz.data(), wsz, state.workspace.data());
+}
+
+int dso::SvInterpolator::interpolate(dso::datetime<dso::nanoseconds> t,
+                                     double *pos, double *erpos, double *vel,
+                                     double *ervel, int &last,
+                                     double *txyz_arr, int wsz,
+                                     double *work) const noexcept {
+
+  if (!num_dpts) {
+    fprintf(stderr, "[ERROR] No data points to interpolate (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+
+  int index = index_hunt(t, last);
+  last = index;
 #ifdef DEBUG
   if (index < 0 || index > num_dpts - 1) {
     fprintf(stderr, "[DEBUG] Invalid index! hunt returned index=%d\n", index);
@@ -229,14 +372,20 @@ int dso::SvInterpolator::interpolate_at(dso::datetime<dso::nanoseconds> t,
   int size = stop - start + 1;
 
   // seperate the workspace arena to arrays of x, y, z and time
-  int wsz = compute_workspace_size();
-  double *__restrict__ td = txyz + 0 * wsz;
-  double *__restrict__ xd = txyz + 1 * wsz;
-  double *__restrict__ yd = txyz + 2 * wsz;
-  double *__restrict__ zd = txyz + 3 * wsz;
+  if (size > wsz) {
+    fprintf(stderr,
+            "[ERROR] Too many data points for interpolation workspace "
+            "(traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+  double *__restrict__ td = txyz_arr + 0 * wsz;
+  double *__restrict__ xd = txyz_arr + 1 * wsz;
+  double *__restrict__ yd = txyz_arr + 2 * wsz;
+  double *__restrict__ zd = txyz_arr + 3 * wsz;
 
   // fill in arays for each component
-  auto start_t = sp3->start_epoch();
+  const auto start_t = tref;
   for (int i = 0; i < size; i++) {
     // td[i] = data[start + i].t.delta_date(start_t).as_mjd();
     td[i] =
@@ -253,7 +402,7 @@ int dso::SvInterpolator::interpolate_at(dso::datetime<dso::nanoseconds> t,
 
   // perform the interpolation for all components
   if (sp3::neville_interpolation3(tx, pos, erpos, td, xd, yd, zd, size, size,
-                                  0, workspace)) {
+                                  0, work)) {
     fprintf(stderr, "[ERROR] Neville algorithm failed (traceback: %s)\n",
             __func__);
     return 5;
@@ -273,7 +422,7 @@ int dso::SvInterpolator::interpolate_at(dso::datetime<dso::nanoseconds> t,
 
     // perform the interpolation for all components
     if (sp3::neville_interpolation3(tx, vel, ervel, td, xd, yd, zd, size, size,
-                                    0, workspace)) {
+                                    0, work)) {
       fprintf(stderr, "[ERROR] Neville algorithm failed (traceback: %s)\n",
               __func__);
       return 6;
@@ -282,3 +431,31 @@ int dso::SvInterpolator::interpolate_at(dso::datetime<dso::nanoseconds> t,
 
   return 0;
 }
+
+int dso::SvInterpolator::checkpoint(Sp3Checkpoint &cp) const noexcept {
+  cp = Sp3Checkpoint();
+  if (!source_fn.empty()) {
+    try {
+      cp.fn = source_fn;
+    } catch (std::exception &) {
+      return 1;
+    }
+    cp.fingerprint = source_fp;
+  }
+  cp.sv = svid;
+  cp.last_index = last_index;
+  if (num_dpts)
+    cp.epoch = data[last_index].t;
+  return 0;
+}
+
+int dso::SvInterpolator::restore(const Sp3Checkpoint &cp) noexcept {
+  if (!(cp.sv == svid) || cp.last_index < 0 || cp.last_index >= num_dpts ||
+      data[cp.last_index].t != cp.epoch)
+    return -1;
+  /* the data points held must come off from the same version of the file */
+  if (!source_fn.empty() && source_fp != cp.fingerprint)
+    return -1;
+  last_index = cp.last_index;
+  return 0;
+}
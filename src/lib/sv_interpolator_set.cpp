@@ -0,0 +1,85 @@
+#include "sv_interpolator_set.hpp"
+
+const dso::SvInterpolator *
+dso::SvInterpolatorSet::find(const sp3::SatelliteId &sv) const noexcept {
+  for (const auto &intrp : intrps_)
+    if (intrp->sv() == sv)
+      return intrp.get();
+  return nullptr;
+}
+
+int dso::SvInterpolatorSet::interpolate_at(
+    const sp3::SatelliteId &sv, const dso::datetime<dso::nanoseconds> &t,
+    double *pos, double *erpos, double *vel, double *ervel) noexcept {
+  for (std::size_t i = 0; i < intrps_.size(); i++)
+    if (intrps_[i]->sv() == sv)
+      return intrps_[i]->interpolate_at(t, pos, erpos, vel, ervel,
+                                        states_[i]);
+  return -1;
+}
+
+int dso::SvInterpolatorSet::load(const Sp3c &sp3,
+                                 std::vector<sp3::SatelliteId> *rebuilt,
+                                 sp3::Executor *ex) {
+  if (rebuilt)
+    rebuilt->clear();
+
+  std::vector<uint64_t> hashes;
+  if (sp3.sv_fingerprints(hashes)) {
+    fprintf(stderr,
+            "[ERROR] Failed computing satellite fingerprints (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+
+  /* keep (share) unchanged interpolators, along with their interpolation
+   * state; changed/new ones are built anew, since the previous ones may
+   * be shared with other sets
+   */
+  const auto &svs = sp3.sattellite_vector();
+  const int n = svs.size();
+  std::vector<std::shared_ptr<const SvInterpolator>> intrps(n);
+  std::vector<SvInterpolationState> states(n);
+  std::vector<int> to_build;
+  std::vector<std::shared_ptr<SvInterpolator>> built;
+  for (int i = 0; i < n; i++) {
+    int j = 0;
+    while (j < (int)intrps_.size() && intrps_[j]->sv() != svs[i])
+      ++j;
+    if (j < (int)intrps_.size() && hashes_[j] == hashes[i]) {
+      intrps[i] = intrps_[j];
+      states[i] = std::move(states_[j]);
+    } else {
+      /* the instance (and its data) are allocated off from mr_ */
+      built.push_back(std::allocate_shared<SvInterpolator>(
+          std::pmr::polymorphic_allocator<SvInterpolator>(mr_), svs[i], mr_));
+      built.back()->set_max_window(max_window_);
+      to_build.push_back(i);
+    }
+  }
+
+  /* build changed/new ones, in parallel */
+  std::vector<int> status(to_build.size(), 0);
+  sp3::parallel_for(
+      0, (int)to_build.size(),
+      [&](int k) { status[k] = built[k]->reload(svs[to_build[k]], sp3); }, ex,
+      1);
+
+  int error = 0;
+  for (int k = 0; k < (int)to_build.size(); k++) {
+    const int i = to_build[k];
+    intrps[i] = std::move(built[k]);
+    if (status[k]) {
+      /* make sure it is rebuilt next time */
+      hashes[i] = 0;
+      error = status[k];
+    }
+    if (rebuilt)
+      rebuilt->push_back(svs[i]);
+  }
+
+  intrps_ = std::move(intrps);
+  hashes_ = std::move(hashes);
+  states_ = std::move(states);
+  return error;
+}
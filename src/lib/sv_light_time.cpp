@@ -0,0 +1,277 @@
+#include "sv_light_time.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+/* Speed of light [m/sec] */
+constexpr double C_LIGHT{299792458e0};
+/* Earth rotation rate [rad/sec] */
+constexpr double OMEGA_EARTH{7.2921151467e-5};
+
+/* An interpolation window, i.e. data points [start, stop] of a satellite,
+ * with times relative to that of the first data point
+ */
+struct Window {
+  int start{-1}, stop{-1};
+  dso::datetime<dso::nanoseconds> tref;
+  /* times [sec], positions [m], clocks [sec] and barycentric weights */
+  std::vector<double> t, x, y, z, clk, w;
+  std::vector<char> clk_ok;
+
+  int size() const noexcept { return t.size(); }
+}; /* struct Window */
+
+/* Set up the window of data points [start, stop]; returns false if any of
+ * the data points has a bad/absent position
+ */
+bool setup(Window &win, const dso::Sp3DataBlock *pts, int start,
+           int stop) noexcept {
+  win.start = start;
+  win.stop = stop;
+  win.tref = pts[start].t;
+  const int n = stop - start + 1;
+  win.t.resize(n);
+  win.x.resize(n);
+  win.y.resize(n);
+  win.z.resize(n);
+  win.clk.resize(n);
+  win.w.resize(n);
+  win.clk_ok.resize(n);
+  bool ok = true;
+  for (int j = 0; j < n; j++) {
+    const dso::Sp3DataBlock &b = pts[start + j];
+    ok = ok && !b.flag.is_set(dso::Sp3Event::bad_abscent_position);
+    win.t[j] = b.t.diff<dso::DateTimeDifferenceType::FractionalSeconds>(
+                        win.tref)
+                   .seconds();
+    win.x[j] = b.state[0] * 1e3;
+    win.y[j] = b.state[1] * 1e3;
+    win.z[j] = b.state[2] * 1e3;
+    win.clk[j] = b.state[3] * 1e-6;
+    win.clk_ok[j] = !b.flag.is_set(dso::Sp3Event::bad_abscent_clock);
+  }
+  /* barycentric weights, w_j = 1 / prod_{k != j} (t_j - t_k); times are
+   * scaled by the half-width of the window (a factor common to all weights,
+   * that cancels out), so that products do not overflow for large windows
+   */
+  const double scale = (n > 1) ? 2e0 / (win.t[n - 1] - win.t[0]) : 1e0;
+  for (int j = 0; j < n; j++) {
+    double p = 1e0;
+    for (int k = 0; k < n; k++)
+      if (k != j)
+        p *= (win.t[j] - win.t[k]) * scale;
+    win.w[j] = 1e0 / p;
+  }
+  return ok;
+}
+
+/* Evaluate the interpolating polynomial of a window, and its derivative,
+ * at time t [sec] (relative to the window's reference time)
+ */
+void evaluate(const Window &win, double t, double *pos, double *vel) noexcept {
+  const int n = win.size();
+  const double *ys[3] = {win.x.data(), win.y.data(), win.z.data()};
+
+  /* at a data point, the barycentric formulae do not apply */
+  for (int j = 0; j < n; j++) {
+    if (t == win.t[j]) {
+      for (int i = 0; i < 3; i++) {
+        pos[i] = ys[i][j];
+        vel[i] = 0e0;
+        for (int k = 0; k < n; k++)
+          if (k != j)
+            vel[i] += (win.w[k] / win.w[j]) * (ys[i][k] - ys[i][j]) /
+                      (win.t[j] - win.t[k]);
+      }
+      return;
+    }
+  }
+
+  double den = 0e0, num[3] = {0e0, 0e0, 0e0};
+  for (int j = 0; j < n; j++) {
+    const double a = win.w[j] / (t - win.t[j]);
+    den += a;
+    num[0] += a * win.x[j];
+    num[1] += a * win.y[j];
+    num[2] += a * win.z[j];
+  }
+  for (int i = 0; i < 3; i++)
+    pos[i] = num[i] / den;
+  double dnum[3] = {0e0, 0e0, 0e0};
+  for (int j = 0; j < n; j++) {
+    const double dt = t - win.t[j];
+    const double a = win.w[j] / dt / dt;
+    dnum[0] += a * (pos[0] - win.x[j]);
+    dnum[1] += a * (pos[1] - win.y[j]);
+    dnum[2] += a * (pos[2] - win.z[j]);
+  }
+  for (int i = 0; i < 3; i++)
+    vel[i] = dnum[i] / den;
+}
+
+/* Linearly interpolate the clock of a window at t [sec]; returns false if
+ * the neighbouring clock values are not available
+ */
+bool clock_at(const Window &win, double t, double &clk) noexcept {
+  const int n = win.size();
+  const auto it = std::upper_bound(win.t.begin(), win.t.end(), t);
+  const int j = std::max(0, (int)(it - win.t.begin()) - 1);
+  if (t == win.t[j] && win.clk_ok[j]) {
+    clk = win.clk[j];
+    return true;
+  }
+  if (j + 1 >= n || !win.clk_ok[j] || !win.clk_ok[j + 1])
+    return false;
+  const double f = (t - win.t[j]) / (win.t[j + 1] - win.t[j]);
+  clk = win.clk[j] + f * (win.clk[j + 1] - win.clk[j]);
+  return true;
+}
+
+int sv_key(const dso::sp3::SatelliteId &sv) noexcept {
+  return ((unsigned char)sv.id[0] << 16) | ((unsigned char)sv.id[1] << 8) |
+         (unsigned char)sv.id[2];
+}
+} /* anonymous namespace */
+
+int dso::SvLightTimeSolver::solve(const std::vector<SvLightTimeObs> &obs,
+                                  std::vector<SvLightTimeSolution> &sol,
+                                  sp3::Executor *ex) const {
+  const int nobs = obs.size();
+  sol.assign(nobs, SvLightTimeSolution());
+
+  /* group observations per satellite, in chronological order */
+  std::vector<int> order(nobs);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    const int ka = sv_key(obs[a].sv), kb = sv_key(obs[b].sv);
+    return (ka != kb) ? ka < kb : obs[a].t_rx < obs[b].t_rx;
+  });
+  std::vector<int> groups;
+  for (int i = 0; i < nobs; i++)
+    if (!i || sv_key(obs[order[i]].sv) != sv_key(obs[order[i - 1]].sv))
+      groups.push_back(i);
+  groups.push_back(nobs);
+
+  const dso::datetime_interval<dso::nanoseconds> max_t{
+      0, dso::cast_to<dso::milliseconds, dso::nanoseconds>(max_window_)};
+
+  sp3::parallel_for(
+      0, (int)groups.size() - 1,
+      [&](int g) {
+        const int first = groups[g], last = groups[g + 1];
+        const int n = last - first;
+        const SvInterpolator *intrp = set_->find(obs[order[first]].sv);
+        const Sp3DataBlock *pts = intrp ? intrp->data_points() : nullptr;
+        const int npts = intrp ? intrp->num_data_points() : 0;
+
+        /* set up windows; consecutive observations share windows */
+        std::vector<Window> windows;
+        std::vector<int> win_of(n, -1);
+        std::vector<double> t_rx(n), tau(n, 0e0);
+        for (int i = 0; i < n; i++) {
+          const SvLightTimeObs &o = obs[order[first + i]];
+          SvLightTimeSolution &s = sol[order[first + i]];
+          if (!npts) {
+            s.status = ERROR_NO_SV;
+            continue;
+          }
+          /* data points as in SvInterpolator::interpolate_at */
+          const auto it = std::upper_bound(
+              pts, pts + npts, o.t_rx,
+              [](const dso::datetime<dso::nanoseconds> &tt,
+                 const Sp3DataBlock &b) { return tt < b.t; });
+          const int index = std::max(0, (int)(it - pts) - 1);
+          int start = index, stop = index;
+          while (start > 0 && o.t_rx - pts[start].t < max_t)
+            --start;
+          while (stop < npts - 1 && pts[stop].t - o.t_rx < max_t)
+            ++stop;
+          if (index - start < min_dpts_on_each_side_ ||
+              stop - index < min_dpts_on_each_side_) {
+            s.status = ERROR_NO_WINDOW;
+            continue;
+          }
+          if (windows.empty() || windows.back().start != start ||
+              windows.back().stop != stop) {
+            windows.emplace_back();
+            if (!setup(windows.back(), pts, start, stop)) {
+              windows.back().start = -1;
+              s.status = ERROR_NO_WINDOW;
+              continue;
+            }
+          } else if (windows.back().start < 0) {
+            s.status = ERROR_NO_WINDOW;
+            continue;
+          }
+          win_of[i] = windows.size() - 1;
+          t_rx[i] = o.t_rx
+                        .diff<dso::DateTimeDifferenceType::FractionalSeconds>(
+                            windows.back().tref)
+                        .seconds();
+        }
+
+        /* iterate, over all observations of the group at once */
+        std::vector<char> done(n, 0);
+        for (int i = 0; i < n; i++)
+          done[i] = (win_of[i] < 0);
+        double p[3], v[3];
+        for (int iter = 0; iter < max_iterations_; iter++) {
+          int pending = 0;
+          for (int i = 0; i < n; i++) {
+            if (done[i])
+              continue;
+            const double *rx = obs[order[first + i]].rx;
+            evaluate(windows[win_of[i]], t_rx[i] - tau[i], p, v);
+            /* Earth rotation during signal flight */
+            const double th = OMEGA_EARTH * tau[i];
+            const double c = std::cos(th), s = std::sin(th);
+            const double dx = c * p[0] + s * p[1] - rx[0];
+            const double dy = -s * p[0] + c * p[1] - rx[1];
+            const double dz = p[2] - rx[2];
+            const double tau_new =
+                std::sqrt(dx * dx + dy * dy + dz * dz) / C_LIGHT;
+            done[i] = std::abs(tau_new - tau[i]) < tolerance_;
+            tau[i] = tau_new;
+            pending += !done[i];
+          }
+          if (!pending)
+            break;
+        }
+
+        /* final states, at the converged travel times */
+        for (int i = 0; i < n; i++) {
+          SvLightTimeSolution &s = sol[order[first + i]];
+          if (win_of[i] < 0)
+            continue;
+          if (!done[i]) {
+            s.status = ERROR_NO_CONVERGENCE;
+            continue;
+          }
+          const Window &win = windows[win_of[i]];
+          const double t = t_rx[i] - tau[i];
+          evaluate(win, t, p, v);
+          const double th = OMEGA_EARTH * tau[i];
+          const double c = std::cos(th), sn = std::sin(th);
+          s.pos[0] = c * p[0] + sn * p[1];
+          s.pos[1] = -sn * p[0] + c * p[1];
+          s.pos[2] = p[2];
+          s.vel[0] = c * v[0] + sn * v[1];
+          s.vel[1] = -sn * v[0] + c * v[1];
+          s.vel[2] = v[2];
+          s.tau = tau[i];
+          s.range = tau[i] * C_LIGHT;
+          s.has_clk = clock_at(win, t, s.clk);
+          s.rel = -2e0 *
+                  (s.pos[0] * s.vel[0] + s.pos[1] * s.vel[1] +
+                   s.pos[2] * s.vel[2]) /
+                  (C_LIGHT * C_LIGHT);
+        }
+      },
+      ex, 1);
+
+  for (const auto &s : sol)
+    if (s.status)
+      return 1;
+  return 0;
+}
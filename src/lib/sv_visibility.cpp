@@ -0,0 +1,371 @@
+#include "sv_visibility.hpp"
+#include "core/sp3_time.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using dso::sp3::NS_PER_DAY;
+
+namespace {
+/* WGS84 semi-major axis [m] and flattening */
+constexpr double WGS84_A{6378137e0};
+constexpr double WGS84_F{1e0 / 298.257223563e0};
+constexpr double TWO_PI{2e0 * 3.14159265358979323846e0};
+/* Velocity records [dm/sec] to [m/sec] */
+constexpr double DM_TO_M{1e-1};
+/* Half the time step of velocities computed by differencing [nsec] */
+constexpr int64_t VEL_HALF_STEP_NS{500000000LL};
+/* Convergence threshold of rise/set epochs [sec] */
+constexpr double ROOT_TOLERANCE{1e-3};
+constexpr int ROOT_MAX_ITERATIONS = 60;
+
+dso::datetime<dso::nanoseconds>
+add_ns(dso::datetime<dso::nanoseconds> t, int64_t ns) noexcept {
+  t += dso::datetime_interval<dso::nanoseconds>(
+      ns / NS_PER_DAY, dso::nanoseconds(ns % NS_PER_DAY));
+  return t;
+}
+} /* anonymous namespace */
+
+struct dso::SvVisibility::Topo {
+  double r[3];
+  double e[3], n[3], u[3];
+}; /* struct Topo */
+
+dso::SvVisibility::Topo
+dso::SvVisibility::topo(const SvStation &sta) noexcept {
+  Topo t;
+  const double *r = sta.xyz;
+  for (int k = 0; k < 3; k++)
+    t.r[k] = r[k];
+  /* geodetic latitude (iteratively) and longitude */
+  const double e2 = WGS84_F * (2e0 - WGS84_F);
+  const double p = std::sqrt(r[0] * r[0] + r[1] * r[1]);
+  const double lon = std::atan2(r[1], r[0]);
+  double lat = std::atan2(r[2], p * (1e0 - e2));
+  for (int i = 0; i < 5; i++) {
+    const double s = std::sin(lat);
+    const double N = WGS84_A / std::sqrt(1e0 - e2 * s * s);
+    lat = std::atan2(r[2] + e2 * N * s, p);
+  }
+  const double sf = std::sin(lat), cf = std::cos(lat);
+  const double sl = std::sin(lon), cl = std::cos(lon);
+  t.e[0] = -sl;
+  t.e[1] = cl;
+  t.e[2] = 0e0;
+  t.n[0] = -sf * cl;
+  t.n[1] = -sf * sl;
+  t.n[2] = cf;
+  t.u[0] = cf * cl;
+  t.u[1] = cf * sl;
+  t.u[2] = sf;
+  return t;
+}
+
+dso::datetime<dso::nanoseconds> dso::SvVisibility::epoch(int i) const noexcept {
+  return add_ns(t0_, i * step_.as_underlying_type());
+}
+
+int dso::SvVisibility::tabulate(const SvInterpolatorSet &set,
+                                const dso::datetime<dso::nanoseconds> &t0,
+                                const dso::datetime<dso::nanoseconds> &t1,
+                                dso::nanoseconds step, sp3::Executor *ex) {
+  svs_.clear();
+  nt_ = 0;
+  const int64_t step_ns = step.as_underlying_type();
+  const double span =
+      t1.diff<dso::DateTimeDifferenceType::FractionalSeconds>(t0).seconds();
+  if (step_ns <= 0 || span < 0e0 || !set.size()) {
+    fprintf(stderr,
+            "[ERROR] Invalid time span/step or no satellites to tabulate "
+            "(traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+
+  t0_ = t0;
+  step_ = step;
+  nt_ = (int)std::floor((span * 1e9 + 1e0) / step_ns) + 1;
+  const int nsv = set.size();
+  for (int k = 0; k < nsv; k++)
+    svs_.push_back(set[k].sv());
+  const std::size_t size = (std::size_t)nt_ * nsv;
+  for (auto *v : {&x_, &y_, &z_, &vx_, &vy_, &vz_})
+    v->assign(size, 0e0);
+  ok_.assign(size, 0);
+
+  sp3::parallel_for(
+      0, nsv,
+      [&](int k) {
+        const SvInterpolator &intrp = set[k];
+        SvInterpolationState state;
+        /* velocity records, unless missing off any data point */
+        bool has_vel = true;
+        for (int i = 0; i < intrp.num_data_points() && has_vel; i++)
+          has_vel = !intrp.data_points()[i].flag.is_set(
+              Sp3Event::bad_abscent_velocity);
+        double p[3], p0[3], p1[3], err[3], v[3], erv[3];
+        for (int i = 0; i < nt_; i++) {
+          const auto t = epoch(i);
+          const std::size_t j = (std::size_t)i * nsv + k;
+          if (has_vel) {
+            if (intrp.interpolate_at(t, p, err, v, erv, state))
+              continue;
+            for (int c = 0; c < 3; c++)
+              v[c] *= DM_TO_M;
+          } else {
+            if (intrp.interpolate_at(t, p, err, nullptr, nullptr, state))
+              continue;
+            /* velocity, via central differences where possible */
+            const bool ok0 = !intrp.interpolate_at(
+                add_ns(t, -VEL_HALF_STEP_NS), p0, err, nullptr, nullptr,
+                state);
+            const bool ok1 = !intrp.interpolate_at(
+                add_ns(t, VEL_HALF_STEP_NS), p1, err, nullptr, nullptr,
+                state);
+            if (!ok0 && !ok1)
+              continue;
+            /* time span of differences [sec], scaled for km to m */
+            const double dt = (ok0 + ok1) * (VEL_HALF_STEP_NS * 1e-9) * 1e-3;
+            for (int c = 0; c < 3; c++)
+              v[c] = ((ok1 ? p1[c] : p[c]) - (ok0 ? p0[c] : p[c])) / dt;
+          }
+          x_[j] = p[0] * 1e3;
+          y_[j] = p[1] * 1e3;
+          z_[j] = p[2] * 1e3;
+          vx_[j] = v[0];
+          vy_[j] = v[1];
+          vz_[j] = v[2];
+          ok_[j] = 1;
+        }
+      },
+      ex, 1);
+  return 0;
+}
+
+void dso::SvVisibility::look_angles(const SvStation &sta, int i, double *el,
+                                    double *az, double *range,
+                                    double *range_rate) const noexcept {
+  look_angles(topo(sta), i, el, az, range, range_rate);
+}
+
+void dso::SvVisibility::look_angles(const Topo &tp, int i, double *el,
+                                    double *az, double *range,
+                                    double *range_rate) const noexcept {
+  const int nsv = svs_.size();
+  const std::size_t off = (std::size_t)i * nsv;
+  const double *__restrict__ x = x_.data() + off;
+  const double *__restrict__ y = y_.data() + off;
+  const double *__restrict__ z = z_.data() + off;
+  const double *__restrict__ vx = vx_.data() + off;
+  const double *__restrict__ vy = vy_.data() + off;
+  const double *__restrict__ vz = vz_.data() + off;
+  const char *__restrict__ ok = ok_.data() + off;
+  constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+  for (int s = 0; s < nsv; s++) {
+    const double dx = x[s] - tp.r[0];
+    const double dy = y[s] - tp.r[1];
+    const double dz = z[s] - tp.r[2];
+    const double rho = std::sqrt(dx * dx + dy * dy + dz * dz);
+    const double u = tp.u[0] * dx + tp.u[1] * dy + tp.u[2] * dz;
+    el[s] = ok[s] ? std::asin(u / rho) : nan;
+  }
+  if (az) {
+    for (int s = 0; s < nsv; s++) {
+      const double dx = x[s] - tp.r[0];
+      const double dy = y[s] - tp.r[1];
+      const double dz = z[s] - tp.r[2];
+      const double e = tp.e[0] * dx + tp.e[1] * dy;
+      const double n = tp.n[0] * dx + tp.n[1] * dy + tp.n[2] * dz;
+      const double a = std::atan2(e, n);
+      az[s] = ok[s] ? (a < 0e0 ? a + TWO_PI : a) : nan;
+    }
+  }
+  if (range || range_rate) {
+    for (int s = 0; s < nsv; s++) {
+      const double dx = x[s] - tp.r[0];
+      const double dy = y[s] - tp.r[1];
+      const double dz = z[s] - tp.r[2];
+      const double rho = std::sqrt(dx * dx + dy * dy + dz * dz);
+      if (range)
+        range[s] = ok[s] ? rho : nan;
+      if (range_rate)
+        range_rate[s] =
+            ok[s] ? (dx * vx[s] + dy * vy[s] + dz * vz[s]) / rho : nan;
+    }
+  }
+}
+
+int dso::SvVisibility::passes(const std::vector<SvStation> &stations,
+                              double min_elevation, std::vector<SvPass> &out,
+                              sp3::Executor *ex) const {
+  out.clear();
+  if (!nt_ || svs_.empty()) {
+    fprintf(stderr, "[ERROR] No satellite states tabulated (traceback: %s)\n",
+            __func__);
+    return 1;
+  }
+  const int nsv = svs_.size();
+  const int nst = stations.size();
+  const double h = step_.as_underlying_type() * 1e-9;
+  const double sin_min = std::sin(min_elevation);
+
+  /* sin(elevation) of satellite s at t [sec] past t0, off from the cubic
+   * Hermite interpolant of the table (both bracketing states must exist)
+   */
+  auto sin_el = [&](const Topo &tp, int s, double t) -> double {
+    int i = std::min(std::max(0, (int)std::floor(t / h)), nt_ - 2);
+    if (nt_ < 2)
+      i = 0;
+    const std::size_t j0 = (std::size_t)i * nsv + s;
+    const std::size_t j1 = (nt_ < 2) ? j0 : j0 + nsv;
+    const double u = (nt_ < 2) ? 0e0 : t / h - i;
+    const double h00 = (1e0 + 2e0 * u) * (1e0 - u) * (1e0 - u);
+    const double h10 = u * (1e0 - u) * (1e0 - u);
+    const double h01 = u * u * (3e0 - 2e0 * u);
+    const double h11 = u * u * (u - 1e0);
+    const double d[3] = {
+        h00 * x_[j0] + h10 * h * vx_[j0] + h01 * x_[j1] + h11 * h * vx_[j1] -
+            tp.r[0],
+        h00 * y_[j0] + h10 * h * vy_[j0] + h01 * y_[j1] + h11 * h * vy_[j1] -
+            tp.r[1],
+        h00 * z_[j0] + h10 * h * vz_[j0] + h01 * z_[j1] + h11 * h * vz_[j1] -
+            tp.r[2]};
+    const double rho = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    return (tp.u[0] * d[0] + tp.u[1] * d[1] + tp.u[2] * d[2]) / rho;
+  };
+
+  /* root of sin_el - sin_min in [a, b] (Illinois variant of regula falsi) */
+  auto root = [&](const Topo &tp, int s, double a, double b) -> double {
+    double fa = sin_el(tp, s, a) - sin_min, fb = sin_el(tp, s, b) - sin_min;
+    int side = 0;
+    for (int it = 0; it < ROOT_MAX_ITERATIONS && b - a > ROOT_TOLERANCE;
+         it++) {
+      const double c = (a * fb - b * fa) / (fb - fa);
+      const double fc = sin_el(tp, s, c) - sin_min;
+      if ((fc > 0e0) == (fb > 0e0)) {
+        b = c;
+        fb = fc;
+        if (side == -1)
+          fa /= 2e0;
+        side = -1;
+      } else {
+        a = c;
+        fa = fc;
+        if (side == 1)
+          fb /= 2e0;
+        side = 1;
+      }
+    }
+    return (std::abs(fa) < std::abs(fb)) ? a : b;
+  };
+
+  /* max of sin_el in [a, b] (golden section search) */
+  auto culmination = [&](const Topo &tp, int s, double a, double b,
+                         double &tmax) -> double {
+    const double g = (std::sqrt(5e0) - 1e0) / 2e0;
+    double c = b - g * (b - a), d = a + g * (b - a);
+    double fc = sin_el(tp, s, c), fd = sin_el(tp, s, d);
+    while (b - a > ROOT_TOLERANCE) {
+      if (fc > fd) {
+        b = d;
+        d = c;
+        fd = fc;
+        c = b - g * (b - a);
+        fc = sin_el(tp, s, c);
+      } else {
+        a = c;
+        c = d;
+        fc = fd;
+        d = a + g * (b - a);
+        fd = sin_el(tp, s, d);
+      }
+    }
+    tmax = (a + b) / 2e0;
+    return sin_el(tp, s, tmax);
+  };
+
+  auto to_epoch = [&](double t) {
+    return add_ns(t0_, std::llround(t * 1e9));
+  };
+
+  std::vector<std::vector<SvPass>> per_station(nst);
+  sp3::parallel_for(
+      0, nst,
+      [&](int k) {
+        const Topo tp = topo(stations[k]);
+        std::vector<double> el(nsv), prev(nsv);
+        /* per satellite: in pass, has rise, rise time [sec] past t0 and
+         * (index of) the max tabulated elevation
+         */
+        std::vector<char> in_pass(nsv, 0), has_rise(nsv, 0);
+        std::vector<double> rise(nsv, 0e0);
+        std::vector<int> imax(nsv, 0);
+        std::vector<double> elmax(nsv, 0e0);
+        std::vector<SvPass> &passes = per_station[k];
+
+        auto close = [&](int s, double t_set, bool has_set, int ilast) {
+          SvPass p;
+          p.station = k;
+          p.sv = svs_[s];
+          p.rise = to_epoch(rise[s]);
+          p.set = to_epoch(t_set);
+          p.has_rise = has_rise[s];
+          p.has_set = has_set;
+          /* refine the culmination around the max tabulated elevation */
+          const double a = std::max(rise[s], (imax[s] - 1) * h);
+          const double b = std::min(t_set, (imax[s] + 1) * h);
+          double tmax = imax[s] * h;
+          double smax = sin_el(tp, s, tmax);
+          if (imax[s] > 0 && imax[s] < ilast && b > a) {
+            double tc;
+            const double sc = culmination(tp, s, a, b, tc);
+            if (sc > smax) {
+              smax = sc;
+              tmax = tc;
+            }
+          }
+          p.culmination = to_epoch(tmax);
+          p.max_elevation = std::asin(std::min(1e0, smax));
+          passes.push_back(p);
+          in_pass[s] = 0;
+        };
+
+        for (int i = 0; i < nt_; i++) {
+          look_angles(tp, i, el.data(), nullptr, nullptr, nullptr);
+          const double t = i * h;
+          for (int s = 0; s < nsv; s++) {
+            const bool ok = !std::isnan(el[s]);
+            const bool vis = ok && std::sin(el[s]) >= sin_min;
+            const bool prev_ok = i > 0 && !std::isnan(prev[s]);
+            if (vis && !in_pass[s]) {
+              in_pass[s] = 1;
+              has_rise[s] = prev_ok;
+              rise[s] = prev_ok ? root(tp, s, t - h, t) : t;
+              imax[s] = i;
+              elmax[s] = el[s];
+            } else if (!vis && in_pass[s]) {
+              close(s, ok ? root(tp, s, t - h, t) : t - h, ok, i - 1);
+            }
+            if (vis && el[s] > elmax[s]) {
+              elmax[s] = el[s];
+              imax[s] = i;
+            }
+          }
+          prev.swap(el);
+        }
+        for (int s = 0; s < nsv; s++)
+          if (in_pass[s])
+            close(s, (nt_ - 1) * h, false, nt_ - 1);
+        std::sort(passes.begin(), passes.end(),
+                  [](const SvPass &a, const SvPass &b) {
+                    return a.rise < b.rise;
+                  });
+      },
+      ex, 1);
+
+  for (auto &v : per_station)
+    out.insert(out.end(), v.begin(), v.end());
+  return 0;
+}
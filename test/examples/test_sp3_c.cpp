@@ -0,0 +1,114 @@
+#include "sp3.hpp"
+#include "sp3_c.h"
+#include "sv_interpolate.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace dso;
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <SP3c FILE>\n", argv[0]);
+    return 1;
+  }
+
+  assert(sp3c_api_version() == SP3C_API_VERSION);
+
+  // open; header info
+  int error;
+  assert(!sp3c_open(nullptr, &error) && error > 0);
+  sp3c_product *p = sp3c_open(argv[1], &error);
+  assert(p && !error);
+  sp3c_info info;
+  assert(!sp3c_product_info(p, &info));
+  Sp3c sp3(argv[1]);
+  assert(info.num_epochs == sp3.num_epochs());
+  assert(info.num_sats == (int)sp3.sattellite_vector().size());
+  assert(std::strlen(info.time_sys) < sizeof info.time_sys &&
+         !std::strncmp(info.time_sys, sp3.time_sys(), 3));
+  assert(sp3c_num_satellites(p) == info.num_sats);
+  const char *sv = sp3c_satellite(p, 0);
+  assert(sv && std::strlen(sv) == 3 && !sp3c_satellite(p, info.num_sats));
+
+  // nothing is served before loading
+  sp3c_columns cols;
+  assert(sp3c_columns_of(p, sv, &cols) > 0);
+
+  const double window_sec = 4 * info.interval_sec;
+  assert(!sp3c_load(p, window_sec));
+
+  // columns hold the records of the satellite
+  assert(!sp3c_columns_of(p, sv, &cols));
+  SvInterpolator ref(sp3::SatelliteId(sv), sp3,
+                     milliseconds((long)(window_sec * 1000)));
+  assert(cols.num_records >= ref.num_data_points());
+  assert(cols.time[0] == 0e0);
+  for (int64_t i = 1; i < cols.num_records; i++)
+    assert(cols.time[i] > cols.time[i - 1]);
+  assert(cols.state[0][0] == ref.data_points()[0].state[0]);
+  assert(cols.flags[0] == ref.data_points()[0].flag.bits_);
+
+  // bad satellite ids: unknown, too short (not read past), too long
+  assert(sp3c_columns_of(p, "X99", &cols) == -1);
+  assert(sp3c_columns_of(p, "G", &cols) == -1);
+  assert(sp3c_columns_of(p, "", &cols) == -1);
+  assert(sp3c_columns_of(p, "G011", &cols) == -1);
+  double t[4], pos[12], erpos[12], vel[12], ervel[12];
+  int32_t status[4];
+  int64_t failed = -1;
+  assert(sp3c_interpolate(p, "X99", t, 4, pos, erpos, nullptr, nullptr,
+                          status, &failed) == -1);
+  assert(sp3c_interpolate(p, "G", t, 4, pos, erpos, nullptr, nullptr,
+                          status, &failed) == -1);
+  assert(!sp3c_interpolate_batch(p, "X99", t, 4, 0));
+
+  // argument errors are not confused with failed epochs
+  assert(sp3c_interpolate(nullptr, sv, t, 4, pos, erpos, nullptr, nullptr,
+                          status, &failed) > 0);
+  assert(sp3c_interpolate(p, sv, nullptr, 4, pos, erpos, nullptr, nullptr,
+                          status, &failed) > 0);
+
+  // interpolate: two epochs within the records, two outside
+  const double mid = cols.time[cols.num_records / 2];
+  t[0] = mid + info.interval_sec / 3;
+  t[1] = mid + info.interval_sec / 2;
+  t[2] = cols.time[cols.num_records - 1] + 10 * info.interval_sec;
+  t[3] = -10 * info.interval_sec;
+  assert(!sp3c_interpolate(p, sv, t, 4, pos, erpos, vel, ervel, status,
+                           &failed));
+  assert(failed == 2 && !status[0] && !status[1] && status[2] && status[3]);
+  for (int i = 0; i < 2; i++) {
+    double rpos[3], rerpos[3], rvel[3], rervel[3];
+    auto ti = sp3.start_epoch() +
+              datetime_interval<nanoseconds>(
+                  0, nanoseconds(std::llround(t[i] * 1e9)));
+    assert(!ref.interpolate_at(ti, rpos, rerpos, rvel, rervel));
+    for (int k = 0; k < 3; k++) {
+      assert(std::abs(pos[3 * i + k] - rpos[k]) < 1e-6);
+      assert(std::abs(vel[3 * i + k] - rvel[k]) < 1e-6);
+    }
+  }
+
+  // batch results
+  sp3c_batch *b = sp3c_interpolate_batch(p, sv, t, 4, 1);
+  assert(b && b->size == 4 && b->vel && b->ervel);
+  for (int i = 0; i < 4; i++)
+    assert(b->status[i] == status[i]);
+  for (int i = 0; i < 6; i++)
+    assert(b->pos[i] == pos[i] && b->vel[i] == vel[i]);
+  sp3c_batch_free(b);
+
+  sp3c_close(p);
+
+  // probe reads the header only
+  sp3c_info probed;
+  assert(!sp3c_probe(argv[1], &probed));
+  assert(probed.ref_mjd == info.ref_mjd && probed.ref_nsec == info.ref_nsec &&
+         probed.num_epochs == info.num_epochs);
+
+  printf("All ok!\n");
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include "sp3_cache.hpp"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dso;
+using dso::sp3::SatelliteId;
+
+/* Copy an Sp3 file, leaving out every other data block */
+void write_gappy(const char *fn, const std::string &out) {
+  std::ifstream fin(fn);
+  std::ofstream fout(out);
+  std::string line;
+  int block = 0;
+  while (std::getline(fin, line)) {
+    if (line[0] == '*')
+      ++block;
+    if (!block || (block % 2) || !line.compare(0, 3, "EOF"))
+      fout << line << '\n';
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> <OUTPUT DIR>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+  const SatelliteId sv = sp3.sattellite_vector().front();
+  const auto t0 = sp3.start_epoch();
+  auto t1 = t0;
+  t1 += dso::datetime_interval<nanoseconds>(
+      0, nanoseconds(3600L * nanoseconds::sec_factor<long>()));
+
+  // misses, then hits
+  {
+    Sp3ProductCache cache(1L << 30);
+    assert(!cache.add_product(argv[1]));
+    std::vector<Sp3DataBlock> out;
+    assert(!cache.range(sv, t0, t1, out) && !out.empty());
+    assert(!cache.range(sv, t0, t1, out) && !out.empty());
+    const auto st = cache.stats();
+    assert(st.misses == 1 && st.hits == 1 && st.num_loaded == 1);
+    assert(st.memory_bytes > 0);
+
+    // shrinking the budget evicts, and the next query loads again
+    cache.set_memory_budget(0);
+    assert(cache.stats().evictions == 1 && !cache.stats().num_loaded);
+    assert(!cache.range(sv, t0, t1, out) && !out.empty());
+    assert(cache.stats().misses == 2);
+  }
+
+  // concurrent queries of a product load it once
+  {
+    Sp3ProductCache cache(1L << 30);
+    assert(!cache.add_product(argv[1]));
+    std::vector<std::thread> threads;
+    std::vector<int> errors(8, -2);
+    for (int i = 0; i < 8; i++)
+      threads.emplace_back([&, i]() {
+        std::vector<Sp3DataBlock> out;
+        errors[i] = cache.range(sv, t0, t1, out);
+      });
+    for (auto &t : threads)
+      t.join();
+    for (int e : errors)
+      assert(!e);
+    const auto st = cache.stats();
+    assert(st.misses == 1 && st.hits + st.waits == 7);
+  }
+
+  // failed loads are remembered until the retry interval elapses
+  {
+    Sp3ProductCache cache(1L << 30);
+    const std::string missing = std::string(argv[2]) + "/no_such_file.sp3";
+    cache.add_product(missing.c_str(), t0, t1);
+    std::vector<Sp3DataBlock> out;
+    assert(cache.range(sv, t0, t1, out) > 0);
+    assert(cache.range(sv, t0, t1, out) > 0);
+    assert(cache.stats().failures == 1 && cache.stats().skipped == 1);
+    cache.set_retry_interval(dso::milliseconds(0));
+    assert(cache.range(sv, t0, t1, out) > 0);
+    assert(cache.stats().failures == 2);
+  }
+
+  // a product with gaps, registered first, gets filled in by the next one
+  {
+    const std::string gappy = std::string(argv[2]) + "/gappy.sp3";
+    write_gappy(argv[1], gappy);
+    Sp3ProductCache cache(1L << 30);
+    assert(!cache.add_product(gappy.c_str()));
+    assert(!cache.add_product(argv[1]));
+    std::vector<Sp3DataBlock> out, ref;
+    assert(!cache.range(sv, t0, t1, out));
+
+    Sp3ProductCache full(1L << 30);
+    assert(!full.add_product(argv[1]));
+    assert(!full.range(sv, t0, t1, ref));
+    assert(out.size() == ref.size());
+    for (std::size_t i = 0; i < out.size(); i++) {
+      assert(out[i].t == ref[i].t);
+      for (int k = 0; k < 4; k++)
+        assert(out[i].state[k] == ref[i].state[k]);
+    }
+    std::remove(gappy.c_str());
+  }
+
+  printf("All ok!\n");
+  return 0;
+}
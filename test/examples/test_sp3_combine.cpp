@@ -0,0 +1,164 @@
+#include "sp3_combine.hpp"
+#include "sp3_writer.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace dso;
+
+constexpr double MAS_PER_RAD = 206264806.247096e0;
+
+/* A (linearized) Helmert transformation: translation [m], scale [ppb] and
+ * rotation [mas], along with a clock offset [microsec]
+ */
+struct Offset {
+  double t[3];
+  double scale;
+  double r[3];
+  double clk;
+}; /* struct Offset */
+
+/* The transformation at position x [km], in [km] */
+void transform(const Offset &o, const double *x, double *d) {
+  double r[3];
+  for (int k = 0; k < 3; k++)
+    r[k] = o.r[k] / MAS_PER_RAD;
+  const double rx[3] = {r[1] * x[2] - r[2] * x[1], r[2] * x[0] - r[0] * x[2],
+                        r[0] * x[1] - r[1] * x[0]};
+  for (int k = 0; k < 3; k++)
+    d[k] = o.t[k] * 1e-3 + o.scale * 1e-9 * x[k] + rx[k];
+}
+
+/* Write a copy of an Sp3 file, transformed by o */
+void write_copy(const Sp3c &sp3, const std::string &fn, const Offset &o) {
+  Sp3Writer writer(fn.c_str(), Sp3Header::from(sp3));
+  Sp3Cursor cursor(sp3);
+  Sp3EpochBuffer buf;
+  while (!cursor.get_next_epoch(buf)) {
+    for (auto &b : buf.blocks) {
+      double d[3];
+      transform(o, b.state, d);
+      for (int k = 0; k < 3; k++)
+        b.state[k] += d[k];
+      b.state[3] += o.clk;
+    }
+    assert(!writer.write_epoch(buf));
+  }
+  assert(!writer.close());
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> <OUTPUT DIR>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+  const std::string dir(argv[2]);
+
+  // three centres, each off the input by a known transformation
+  const std::vector<Offset> offsets = {
+      {{0.5e0, 0e0, 0e0}, 0e0, {0e0, 0e0, 0e0}, 0e0},
+      {{0e0, -0.3e0, 0e0}, 0e0, {0e0, 0e0, 20e0}, 5e-3},
+      {{0e0, 0e0, 0.2e0}, 10e0, {-8e0, 0e0, 0e0}, -2e-3}};
+  const int nc = offsets.size();
+  std::vector<std::string> fns;
+  std::vector<Sp3c *> centres;
+  for (int c = 0; c < nc; c++) {
+    fns.push_back(dir + "/centre" + std::to_string(c) + ".sp3");
+    write_copy(sp3, fns[c], offsets[c]);
+    centres.push_back(new Sp3c(fns[c].c_str()));
+  }
+
+  const std::string out = dir + "/combined.sp3";
+  Sp3CombinationReport rep;
+  assert(!sp3::combine({centres[0], centres[1], centres[2]}, out.c_str(),
+                       &rep));
+  assert((int)rep.centres.size() == nc);
+  assert(rep.num_epochs == sp3.num_epochs());
+
+  // datum: the weighted sum of the transformations is zero
+  Offset mean = {};
+  double wsum = 0e0;
+  for (const auto &cs : rep.centres) {
+    const auto &h = cs.helmert;
+    assert(cs.rms_pos < 5e-3 && !cs.num_rejected);
+    const double w = cs.weight_pos;
+    wsum += w;
+    mean.t[0] += w * h.tx;
+    mean.t[1] += w * h.ty;
+    mean.t[2] += w * h.tz;
+    mean.scale += w * h.scale;
+    mean.r[0] += w * h.rx;
+    mean.r[1] += w * h.ry;
+    mean.r[2] += w * h.rz;
+  }
+  assert(std::abs(wsum - 1e0) < 1e-12);
+  for (int k = 0; k < 3; k++) {
+    assert(std::abs(mean.t[k]) < 1e-9);
+    assert(std::abs(mean.r[k]) < 1e-9);
+  }
+  assert(std::abs(mean.scale) < 1e-9);
+
+  // the known transformations are recovered, up to the datum, i.e. their
+  // weighted mean
+  Offset ref = {};
+  for (int c = 0; c < nc; c++) {
+    const double w = rep.centres[c].weight_pos;
+    for (int k = 0; k < 3; k++) {
+      ref.t[k] += w * offsets[c].t[k];
+      ref.r[k] += w * offsets[c].r[k];
+    }
+    ref.scale += w * offsets[c].scale;
+  }
+  for (int c = 0; c < nc; c++) {
+    const auto &h = rep.centres[c].helmert;
+    const Offset &o = offsets[c];
+    assert(std::abs(h.tx - (o.t[0] - ref.t[0])) < 1e-2);
+    assert(std::abs(h.ty - (o.t[1] - ref.t[1])) < 1e-2);
+    assert(std::abs(h.tz - (o.t[2] - ref.t[2])) < 1e-2);
+    assert(std::abs(h.scale - (o.scale - ref.scale)) < 1e-1);
+    assert(std::abs(h.rx - (o.r[0] - ref.r[0])) < 1e-1);
+    assert(std::abs(h.ry - (o.r[1] - ref.r[1])) < 1e-1);
+    assert(std::abs(h.rz - (o.r[2] - ref.r[2])) < 1e-1);
+  }
+
+  // the combination is the input, in the mean frame; clocks refer to the
+  // first centre's
+  {
+    Sp3c comb(out.c_str());
+    Sp3Cursor ci(sp3), cc(comb);
+    Sp3EpochBuffer bi, bc;
+    long n = 0;
+    while (!ci.get_next_epoch(bi)) {
+      assert(!cc.get_next_epoch(bc) && bc.t == bi.t);
+      for (int i = 0; i < bi.size(); i++) {
+        int j = 0;
+        while (j < bc.size() && !(bc.sats[j] == bi.sats[i]))
+          ++j;
+        assert(j < bc.size());
+        const Sp3DataBlock &a = bi.blocks[i], &b = bc.blocks[j];
+        if (a.flag.is_set(Sp3Event::bad_abscent_position))
+          continue;
+        double d[3];
+        transform(ref, a.state, d);
+        for (int k = 0; k < 3; k++)
+          assert(std::abs(b.state[k] - a.state[k] - d[k]) < 5e-6);
+        if (!a.flag.is_set(Sp3Event::bad_abscent_clock))
+          assert(std::abs(b.state[3] - a.state[3]) < 5e-6);
+        ++n;
+      }
+    }
+    assert(n > 0);
+  }
+
+  for (int c = 0; c < nc; c++) {
+    delete centres[c];
+    std::remove(fns[c].c_str());
+  }
+  std::remove(out.c_str());
+  printf("All ok!\n");
+  return 0;
+}
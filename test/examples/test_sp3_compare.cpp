@@ -0,0 +1,96 @@
+#include "sp3_compare.hpp"
+#include "sp3_extract.hpp"
+#include "sp3_filter.hpp"
+#include "sp3_writer.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+using namespace dso;
+
+/* Translation [km] and rotation (about Z) [mas] applied to the copy */
+constexpr double TX = 1e-3;
+constexpr double RZ = 2e0;
+/* Clock offset [microsec] applied to the copy */
+constexpr double DCLK = 5e-3;
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> <OUTPUT DIR>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+
+  // a product against itself
+  Sp3ComparisonReport rep;
+  assert(!sp3::compare(sp3, sp3, rep));
+  assert(rep.num_epochs == sp3.num_epochs());
+  assert((int)rep.satellites.size() == sp3.num_sats());
+  for (const auto &s : rep.satellites) {
+    assert(s.radial.count > 0 && s.clock.count > 0);
+    assert(s.rms_3d == 0e0 && s.clock.max_abs == 0e0);
+  }
+
+  // a transformed copy, with shifted clocks
+  const std::string copy = std::string(argv[2]) + "/transformed.sp3";
+  {
+    const double rz = RZ / 206264806.247096e0;
+    Sp3Writer writer(copy.c_str(), Sp3Header::from(sp3));
+    Sp3Cursor cursor(sp3);
+    Sp3EpochBuffer buf;
+    while (!cursor.get_next_epoch(buf)) {
+      for (auto &b : buf.blocks) {
+        const double x = b.state[0], y = b.state[1];
+        b.state[0] = x - rz * y + TX;
+        b.state[1] = y + rz * x;
+        b.state[3] += DCLK;
+      }
+      assert(!writer.write_epoch(buf));
+    }
+    assert(!writer.close());
+  }
+  Sp3c sp3b(copy.c_str());
+
+  // without removing the clock datum, clocks differ by DCLK
+  Sp3CompareOptions opts;
+  opts.remove_clock_mean = false;
+  assert(!sp3::compare(sp3, sp3b, rep, opts));
+  assert(std::abs(rep.total.clock.mean - DCLK * 1e3) < 1e-6);
+  assert(rep.total.rms_3d > 0.1);
+
+  // the Helmert transformation absorbs the position differences
+  opts.remove_clock_mean = true;
+  opts.helmert = true;
+  assert(!sp3::compare(sp3, sp3b, rep, opts));
+  assert(rep.total.clock.max_abs < 1e-6);
+  assert((int)rep.helmert.size() == sp3.num_epochs());
+  for (const auto &p : rep.helmert) {
+    assert(std::abs(p.tx - TX * 1e3) < 1e-2);
+    assert(std::abs(p.ty) < 1e-2 && std::abs(p.tz) < 1e-2);
+    assert(std::abs(p.rz - RZ) < 1e-1);
+    assert(p.rms < 1e-3);
+  }
+  assert(rep.total.rms_3d < 1e-3);
+  const std::string json = std::string(argv[2]) + "/compare.json";
+  assert(!rep.write_json(json.c_str()));
+
+  // a product on a coarser grid: positions are interpolated
+  const std::string coarse = std::string(argv[2]) + "/coarse.sp3";
+  assert(!sp3::extract(sp3, coarse.c_str(), sp3::decimate(2)));
+  Sp3c sp3c(coarse.c_str());
+  opts = Sp3CompareOptions();
+  opts.max_window = dso::milliseconds(3 * 3600 * 1000L);
+  assert(!sp3::compare(sp3, sp3c, rep, opts));
+  assert(rep.total.radial.count > 0);
+  // (LEO orbits are not sampled densely enough for this)
+  for (const auto &s : rep.satellites)
+    if (s.sv.id[0] != 'L')
+      assert(s.rms_3d < 1e0);
+
+  std::remove(copy.c_str());
+  std::remove(coarse.c_str());
+  std::remove(json.c_str());
+  return 0;
+}
@@ -0,0 +1,152 @@
+#include "sp3.hpp"
+#include "sv_interpolate.hpp"
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace dso;
+using dso::sp3::SatelliteId;
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <SP3c FILE>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+  const auto svs = sp3.sattellite_vector();
+  const SatelliteId sv1 = svs.front();
+  const SatelliteId sv2 = svs.back();
+
+  // two iterators (for two SVs) over the same Sp3c, advanced in turns
+  Sp3Iterator it1(sp3, sv1);
+  Sp3Iterator it2(sp3, sv2);
+
+  // reference values, read off from the Sp3c's own stream
+  Sp3DataBlock ref1, ref2;
+  Sp3Cursor cursor = sp3.cursor();
+  int epochs = 0, j1 = 0, j2 = 0;
+  do {
+    sp3.rewind();
+    for (int i = 0; i <= epochs; i++)
+      sp3.get_next_data_block(sv1, ref1);
+    Sp3Cursor c2(cursor);
+    for (int i = 0; i <= epochs; i++)
+      c2.get_next_data_block(sv2, ref2);
+
+    assert(it1.data_block().t == ref1.t);
+    assert(it2.data_block().t == ref2.t);
+    for (int i = 0; i < 4; i++) {
+      assert(it1.data_block().state[i] == ref1.state[i]);
+      assert(it2.data_block().state[i] == ref2.state[i]);
+    }
+
+    j1 = it1.advance();
+    j2 = it2.advance();
+    ++epochs;
+  } while (!j1 && !j2 && epochs < 10);
+
+  if (j1 > 0 || j2 > 0) {
+    fprintf(stderr, "Failed advancing iterators\n");
+    return 1;
+  }
+
+  // checkpoint the iterator, and resume off from the checkpoint file (as a
+  // restarted job would)
+  std::vector<Sp3Checkpoint> cps(2);
+  assert(!it1.checkpoint(cps[0]));
+  assert(!cursor.checkpoint(cps[1]));
+  const std::string ckfn = std::string(argv[1]) + ".ckpt";
+  assert(!save_checkpoints(ckfn.c_str(), cps));
+  std::vector<Sp3Checkpoint> loaded;
+  assert(!load_checkpoints(ckfn.c_str(), loaded) && loaded.size() == 2);
+  std::remove(ckfn.c_str());
+  {
+    Sp3c resumed_sp3(loaded[0].fn.c_str());
+    Sp3Iterator resumed(resumed_sp3, sv1);
+    assert(!resumed.restore(loaded[0]));
+    assert(resumed.data_block().t == it1.data_block().t);
+    for (int i = 0; i < 3 && !it1.advance(); i++) {
+      assert(!resumed.advance());
+      assert(resumed.data_block().t == it1.data_block().t);
+      assert(resumed.data_block().state[0] == it1.data_block().state[0]);
+    }
+    // checkpoints of another SV (or file position) are refused
+    Sp3Iterator other(resumed_sp3, sv2);
+    assert(sv1 == sv2 || other.restore(loaded[0]) < 0);
+    Sp3Checkpoint bad(loaded[0]);
+    bad.offset += 1;
+    const auto t_before = resumed.data_block().t;
+    const auto pos_before = resumed.cursor().tell();
+    assert(resumed.restore(bad));
+    // ... and leave the iterator as it was
+    assert(resumed.data_block().t == t_before &&
+           resumed.cursor().tell() == pos_before);
+    bad = loaded[0];
+    bad.epoch = t_before;
+    assert(resumed.restore(bad) == -1);
+    assert(resumed.data_block().t == t_before &&
+           resumed.cursor().tell() == pos_before);
+    Sp3Cursor c3(resumed_sp3);
+    assert(!c3.restore(loaded[1]) && c3.tell() == cursor.tell());
+  }
+
+  // interpolators: resume the window off from a checkpoint, on a new
+  // instance fed off from the same file
+  {
+    const milliseconds window(4 * sp3.interval().as_underlying_type() /
+                              1'000'000L);
+    SvInterpolator intrp(sv1, sp3, window);
+    const int n = intrp.num_data_points();
+    const auto t = intrp.data_points()[n / 2].t +
+                   datetime_interval<nanoseconds>(0, nanoseconds(1000L));
+    double pos[3], erpos[3], rpos[3], rerpos[3];
+    assert(!intrp.interpolate_at(t, pos, erpos));
+    std::vector<Sp3Checkpoint> icps(1);
+    assert(!intrp.checkpoint(icps[0]));
+    assert(icps[0].fn == sp3.filename() && icps[0].sv == sv1);
+    assert(!save_checkpoints(ckfn.c_str(), icps));
+    assert(!load_checkpoints(ckfn.c_str(), loaded) && loaded.size() == 1);
+    std::remove(ckfn.c_str());
+
+    Sp3c resumed_sp3(loaded[0].fn.c_str());
+    SvInterpolator resumed(sv1, resumed_sp3, window);
+    assert(!resumed.restore(loaded[0]));
+    Sp3Checkpoint cp;
+    assert(!resumed.checkpoint(cp) && cp.last_index == icps[0].last_index &&
+           cp.epoch == icps[0].epoch);
+    assert(!resumed.interpolate_at(t, rpos, rerpos));
+    for (int k = 0; k < 3; k++)
+      assert(pos[k] == rpos[k]);
+
+    // checkpoints of another SV, window or file version are refused
+    SvInterpolator other(sv2, sp3, window);
+    assert(sv1 == sv2 || other.restore(loaded[0]) == -1);
+    Sp3Checkpoint bad(loaded[0]);
+    bad.last_index += 1;
+    assert(resumed.restore(bad) == -1);
+    bad = loaded[0];
+    bad.fingerprint.hash += 1;
+    assert(resumed.restore(bad) == -1);
+    // interpolators not fed off from a file accept any (matching) window
+    SvInterpolator blocks(sv1);
+    assert(!blocks.reload(sv1, intrp.data_points(), n, sp3.interval()));
+    assert(!blocks.restore(bad));
+  }
+
+  // the (nominal) last epoch is the last one read, for complete files
+  {
+    Sp3Cursor c = sp3.cursor();
+    Sp3EpochBuffer buf;
+    auto last = sp3.start_epoch();
+    int n = 0;
+    for (; !c.get_next_epoch(buf); ++n)
+      last = buf.t;
+    assert(n != sp3.num_epochs() || last == sp3.stop_epoch());
+  }
+
+  printf("Iterated %d epochs for %s and %s\n", epochs, sv1.id, sv2.id);
+  printf("All ok!\n");
+  return 0;
+}
@@ -0,0 +1,48 @@
+#include "sp3_executor.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+using namespace dso::sp3;
+
+int main() {
+  // nested parallel loops, on the default (internal) pool
+  constexpr int N = 64, M = 1000;
+  std::vector<long> sums(N, 0);
+  parallel_for(0, N, [&sums](int i) {
+    std::atomic<long> sum{0};
+    parallel_for(0, M, [&sum, i](int j) { sum += i * M + j; });
+    sums[i] = sum;
+  });
+  long total = 0;
+  for (auto s : sums)
+    total += s;
+  const long n = (long)N * M;
+  assert(total == n * (n - 1) / 2);
+
+  // a user-provided executor
+  WorkStealingPool pool(3);
+  set_default_executor(&pool);
+  assert(default_executor().concurrency() == 3);
+  std::atomic<int> count{0};
+  parallel_for(0, 10000, [&count](int) { ++count; });
+  assert(count == 10000);
+
+  // exceptions are propagated to the caller
+  bool thrown = false;
+  try {
+    parallel_for(0, 100, [](int i) {
+      if (i == 42)
+        throw std::runtime_error("42");
+    });
+  } catch (std::exception &) {
+    thrown = true;
+  }
+  assert(thrown);
+  set_default_executor(nullptr);
+
+  printf("All ok!\n");
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include "sp3_export.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace dso;
+
+/* Read the array of an NPY file of doubles (NPY_HEADER_SIZE is 128) */
+std::vector<double> read_npy(const std::string &fn, long &shape) {
+  std::FILE *fp = std::fopen(fn.c_str(), "rb");
+  assert(fp);
+  char hdr[128];
+  assert(std::fread(hdr, 1, 128, fp) == 128);
+  assert(!std::memcmp(hdr, "\x93NUMPY", 6));
+  assert(hdr[127] == '\n');
+  const std::string dict(hdr + 10, 118);
+  const auto pos = dict.find("'shape': (");
+  assert(pos != std::string::npos);
+  shape = std::strtol(dict.c_str() + pos + 10, nullptr, 10);
+  std::vector<double> v(shape);
+  assert(std::fread(v.data(), sizeof(double), shape, fp) == (size_t)shape);
+  assert(std::fgetc(fp) == EOF);
+  std::fclose(fp);
+  return v;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> <EXPORT DIR>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+
+  // reference: all records, in file order
+  std::vector<double> x, sdev_clk;
+  long count = 0;
+  {
+    Sp3Cursor cursor(sp3);
+    Sp3EpochBuffer buf;
+    while (!cursor.get_next_epoch(buf)) {
+      for (int i = 0; i < buf.size(); i++) {
+        x.push_back(buf.blocks[i].state[0]);
+        sdev_clk.push_back(buf.blocks[i].state_sdev[3]);
+      }
+    }
+    count = x.size();
+  }
+
+  // whole file, NPY; small chunks, so that columns are appended to
+  const std::string dir = std::string(argv[2]) + "/whole";
+  {
+    Sp3ExportOptions opts;
+    opts.chunk_records = 50;
+    Sp3ColumnExporter ex(dir.c_str(), opts);
+    assert(!ex.add(sp3));
+    // adding the same file again exports nothing (records not later)
+    assert(!ex.add(sp3));
+    assert(ex.num_records() == count);
+    assert(!ex.finish());
+  }
+  long shape;
+  const auto xs = read_npy(dir + "/x.npy", shape);
+  assert(shape == count);
+  for (long i = 0; i < count; i++)
+    assert(xs[i] == x[i]);
+  const auto ss = read_npy(dir + "/sdev_clk.npy", shape);
+  for (long i = 0; i < count; i++)
+    assert(ss[i] == sdev_clk[i]);
+  std::FILE *fp = std::fopen((dir + "/manifest.json").c_str(), "r");
+  assert(fp);
+  std::fclose(fp);
+
+  // per satellite, raw
+  const std::string dir2 = std::string(argv[2]) + "/per_sv";
+  Sp3ExportOptions opts;
+  opts.format = Sp3ExportFormat::raw;
+  opts.layout = Sp3ExportLayout::per_satellite;
+  Sp3ColumnExporter ex(dir2.c_str(), opts);
+  assert(!ex.add(sp3));
+  assert(!ex.finish());
+  long total = 0;
+  for (const auto &sv : sp3.sattellite_vector()) {
+    const std::string fn =
+        dir2 + "/" + std::string(sv.id, strnlen(sv.id, 3)) + "/t.bin";
+    fp = std::fopen(fn.c_str(), "rb");
+    if (!fp)
+      continue;
+    std::fseek(fp, 0, SEEK_END);
+    total += std::ftell(fp) / sizeof(int64_t);
+    std::fclose(fp);
+  }
+  assert(total == count);
+
+  printf("All checks passed\n");
+  return 0;
+}
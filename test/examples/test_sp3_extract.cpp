@@ -0,0 +1,174 @@
+#include "sp3_extract.hpp"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace dso;
+using namespace dso::sp3;
+
+/* Records (of all SVs, or of SV sv only) of an Sp3 file, epoch by epoch */
+std::vector<Sp3EpochBuffer> records(const char *fn,
+                                    const SatelliteId *sv = nullptr) {
+  Sp3c sp3(fn);
+  std::vector<Sp3EpochBuffer> out;
+  Sp3Cursor cursor(sp3);
+  Sp3EpochBuffer buf;
+  while (!cursor.get_next_epoch(buf)) {
+    Sp3EpochBuffer kept;
+    kept.t = buf.t;
+    for (int i = 0; i < buf.size(); i++) {
+      if (!sv || buf.sats[i] == *sv) {
+        kept.sats.push_back(buf.sats[i]);
+        kept.blocks.push_back(buf.blocks[i]);
+      }
+    }
+    out.push_back(kept);
+  }
+  return out;
+}
+
+/* Records are copied verbatim, hence decode to the very same values */
+void check_same(const Sp3EpochBuffer &a, const Sp3EpochBuffer &b) {
+  assert(a.t == b.t);
+  assert(a.size() == b.size());
+  for (int i = 0; i < a.size(); i++) {
+    assert(a.sats[i] == b.sats[i]);
+    for (int j = 0; j < 8; j++) {
+      assert(a.blocks[i].state[j] == b.blocks[i].state[j]);
+      assert(a.blocks[i].state_sdev[j] == b.blocks[i].state_sdev[j]);
+    }
+    assert(a.blocks[i].flag.bits_ == b.blocks[i].flag.bits_);
+  }
+}
+
+std::string contents(const std::string &fn) {
+  std::ifstream fin(fn);
+  std::stringstream ss;
+  ss << fin.rdbuf();
+  return ss.str();
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> <OUTPUT DIR>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+  const auto svs = sp3.sattellite_vector();
+  assert(svs.size() > 2);
+  const auto all = records(argv[1]);
+  const int n = all.size();
+  assert(n > 10 && n == sp3.num_epochs());
+  const std::string dir(argv[2]);
+
+  // the whole file: same header info and records
+  {
+    const std::string fn = dir + "/extract_all.sp3";
+    assert(!extract(sp3, fn.c_str()));
+    Sp3c copy(fn.c_str());
+    assert(copy.num_epochs() == n);
+    assert(copy.start_epoch() == sp3.start_epoch());
+    assert(copy.interval() == sp3.interval());
+    assert(copy.sattellite_vector() == svs);
+    const auto got = records(fn.c_str());
+    assert((int)got.size() == n);
+    for (int i = 0; i < n; i++)
+      check_same(got[i], all[i]);
+    std::remove(fn.c_str());
+  }
+
+  // a time window, decimated, of two SVs
+  const SatelliteId sv0 = svs[0], sv1 = svs[svs.size() - 1];
+  const Sp3Filter f =
+      satellites({sv0, sv1}) | time_window(all[2].t, all[n - 3].t) |
+      decimate(2);
+  {
+    const std::string fn = dir + "/extract_subset.sp3";
+    assert(!extract(sp3, fn.c_str(), f));
+    Sp3c sub(fn.c_str());
+    const int m = (n - 4 + 1) / 2;
+    assert(sub.num_epochs() == m);
+    assert(sub.start_epoch() == all[2].t);
+    assert(sub.interval().as_underlying_type() ==
+           2 * sp3.interval().as_underlying_type());
+    assert((sub.sattellite_vector() == std::vector<SatelliteId>{sv0, sv1}));
+    const auto got = records(fn.c_str());
+    assert((int)got.size() == m);
+    for (int i = 0; i < m; i++) {
+      Sp3EpochBuffer ref;
+      ref.t = all[2 + 2 * i].t;
+      for (int k = 0; k < all[2 + 2 * i].size(); k++) {
+        const auto &s = all[2 + 2 * i].sats[k];
+        if (s == sv0 || s == sv1) {
+          ref.sats.push_back(s);
+          ref.blocks.push_back(all[2 + 2 * i].blocks[k]);
+        }
+      }
+      check_same(got[i], ref);
+    }
+
+    // extracting off from the extracted file changes nothing
+    const std::string fn2 = dir + "/extract_subset2.sp3";
+    assert(!extract(sub, fn2.c_str()));
+    assert(contents(fn2) == contents(fn));
+
+    // splitting the subset, or the original, gives the very same files
+    const std::string pa = dir + "/split_a_", pb = dir + "/split_b_";
+    assert(!split_satellites(sub, pa));
+    assert(!split_satellites(sp3, pb, f));
+    for (const auto &sv : {sv0, sv1}) {
+      const std::string id(sv.id, 3);
+      const std::string a = pa + id + ".sp3", b = pb + id + ".sp3";
+      assert(contents(a) == contents(b));
+      Sp3c one(a.c_str());
+      assert(one.num_epochs() == m);
+      assert(one.sattellite_vector() == std::vector<SatelliteId>{sv});
+      const auto got_sv = records(a.c_str());
+      const auto ref_sv = records(fn.c_str(), &sv);
+      assert(got_sv.size() == ref_sv.size());
+      for (std::size_t i = 0; i < got_sv.size(); i++)
+        check_same(got_sv[i], ref_sv[i]);
+      std::remove(a.c_str());
+      std::remove(b.c_str());
+    }
+    std::remove(fn.c_str());
+    std::remove(fn2.c_str());
+  }
+
+  // all SVs split in one pass; each file holds the SV's records only
+  {
+    const std::string prefix = dir + "/split_";
+    assert(!split_satellites(sp3, prefix));
+    for (const auto &sv : svs) {
+      const std::string fn = prefix + std::string(sv.id, 3) + ".sp3";
+      const auto got = records(fn.c_str());
+      const auto ref = records(argv[1], &sv);
+      assert(got.size() == ref.size());
+      for (std::size_t i = 0; i < got.size(); i++)
+        check_same(got[i], ref[i]);
+      std::remove(fn.c_str());
+    }
+  }
+
+  // nothing selected: no file written; flag stages are refused
+  {
+    const std::string fn = dir + "/extract_none.sp3";
+    assert(extract(sp3, fn.c_str(), satellites({SatelliteId("X99")})) == -1);
+    assert(extract(sp3, fn.c_str(),
+                   time_window(all[n - 1].t + datetime_interval<nanoseconds>(
+                                                  1, nanoseconds(0)),
+                               all[n - 1].t +
+                                   datetime_interval<nanoseconds>(
+                                       2, nanoseconds(0)))) == -1);
+    assert(extract(sp3, fn.c_str(),
+                   without_event(Sp3Event::orbit_prediction)) > 0);
+    assert(!std::ifstream(fn).good());
+  }
+
+  printf("All ok!\n");
+  return 0;
+}
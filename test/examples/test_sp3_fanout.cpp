@@ -0,0 +1,95 @@
+#include "sp3_fanout.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace dso;
+
+/* Record the epochs delivered; optionally slow, or unsubscribing after a
+ * number of epochs, or throwing at the end
+ */
+struct Collector : public Sp3Subscriber {
+  std::vector<dso::datetime<nanoseconds>> epochs;
+  int delay_usec{0};
+  int quit_after{-1};
+  bool throw_at_end{false};
+  int num_ends{0};
+  int end_status{-1};
+
+  int on_epoch(const Sp3EpochBuffer &epoch) override {
+    if (delay_usec)
+      std::this_thread::sleep_for(std::chrono::microseconds(delay_usec));
+    epochs.push_back(epoch.t);
+    return ((int)epochs.size() == quit_after) ? 7 : 0;
+  }
+
+  void on_end(int status) override {
+    ++num_ends;
+    end_status = status;
+    if (throw_at_end)
+      throw std::runtime_error("on_end failed");
+  }
+}; /* struct Collector */
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <SP3c FILE>\n", argv[0]);
+    return 1;
+  }
+
+  // reference epochs
+  Sp3c sp3(argv[1]);
+  std::vector<dso::datetime<nanoseconds>> ref;
+  {
+    Sp3Cursor cursor(sp3);
+    Sp3EpochBuffer buf;
+    while (!cursor.get_next_epoch(buf))
+      ref.push_back(buf.t);
+  }
+  assert(ref.size() > 4);
+
+  // a small queue, so that the slow subscriber stalls the parser
+  constexpr int CAPACITY = 2;
+  Sp3FanOut fanout(CAPACITY);
+  Collector fast, slow, quitter, thrower, inlined;
+  slow.delay_usec = 500;
+  quitter.quit_after = 3;
+  thrower.throw_at_end = true;
+  const int ifast = fanout.subscribe(&fast);
+  const int islow = fanout.subscribe(&slow);
+  const int iquit = fanout.subscribe(&quitter);
+  fanout.subscribe(&thrower);
+  const int iinl = fanout.subscribe(&inlined, false);
+  assert(fanout.num_subscribers() == 5);
+
+  // run twice; instances are re-usable
+  for (int run = 0; run < 2; run++) {
+    for (auto *c : {&fast, &slow, &quitter, &thrower, &inlined}) {
+      c->epochs.clear();
+      c->num_ends = 0;
+    }
+    assert(!fanout.run(sp3));
+
+    // all epochs, in order, to all subscribers (whatever their speed)
+    for (const auto *c : {&fast, &slow, &thrower, &inlined}) {
+      assert(c->epochs == ref);
+      assert(c->num_ends == 1 && !c->end_status);
+    }
+    for (int i : {ifast, islow, iinl}) {
+      assert(!fanout.status(i));
+      assert(fanout.stats(i).delivered == ref.size());
+      assert(fanout.stats(i).max_queued <= CAPACITY);
+    }
+    assert(fanout.stats(islow).stalls > 0);
+
+    // unsubscribing stops deliveries, but on_end is still called
+    assert(fanout.status(iquit) == 7 && quitter.epochs.size() == 3);
+    assert(quitter.num_ends == 1 && !quitter.end_status);
+  }
+
+  printf("All ok!\n");
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include "sp3_filter.hpp"
+#include "sp3_generator.hpp"
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+using namespace dso;
+using namespace dso::sp3;
+
+/* Filter all epochs of a file by hand */
+std::vector<Sp3EpochBuffer> reference(const Sp3c &sp3, const char *systems,
+                                      Sp3Event rejected, int every) {
+  std::vector<Sp3EpochBuffer> out;
+  Sp3Cursor cursor(sp3);
+  Sp3EpochBuffer buf;
+  for (long count = 0; !cursor.get_next_epoch(buf); ++count) {
+    if (count % every)
+      continue;
+    Sp3EpochBuffer kept;
+    kept.t = buf.t;
+    for (int i = 0; i < buf.size(); i++) {
+      if (std::string(systems).find(buf.sats[i].id[0]) != std::string::npos &&
+          !buf.blocks[i].flag.is_set(rejected)) {
+        kept.sats.push_back(buf.sats[i]);
+        kept.blocks.push_back(buf.blocks[i]);
+      }
+    }
+    if (kept.size())
+      out.push_back(kept);
+  }
+  return out;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <SP3c FILE>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+  const char *sys = "GL";
+  const auto ref = reference(sp3, sys, Sp3Event::orbit_prediction, 4);
+
+  const Sp3Filter f = systems("GLE") | systems(sys) |
+                      without_event(Sp3Event::orbit_prediction) | decimate(2) |
+                      decimate(2);
+  Sp3Cursor cursor(sp3);
+  Sp3EpochBuffer buf;
+  long count = 0;
+  std::size_t n = 0;
+  while (!f.next_epoch(cursor, buf, count)) {
+    assert(n < ref.size());
+    assert(buf.t == ref[n].t);
+    assert(buf.size() == ref[n].size());
+    for (int i = 0; i < buf.size(); i++) {
+      assert(buf.sats[i] == ref[n].sats[i]);
+      for (int j = 0; j < 8; j++)
+        assert(buf.blocks[i].state[j] == ref[n].blocks[i].state[j]);
+    }
+    ++n;
+  }
+  assert(n == ref.size());
+
+  // time window: all epochs in [t0, t1] and nothing else
+  std::vector<Sp3EpochBuffer> all;
+  {
+    Sp3Cursor c(sp3);
+    while (!c.get_next_epoch(buf))
+      all.push_back(buf);
+  }
+  assert(all.size() > 4);
+  const auto t0 = all[1].t;
+  const auto t1 = all[all.size() - 2].t;
+  count = 0;
+  n = 1;
+  Sp3Cursor c2(sp3);
+  while (!time_window(t0, t1).next_epoch(c2, buf, count)) {
+    assert(buf.t == all[n].t);
+    assert(buf.size() == all[n].size());
+    ++n;
+  }
+  assert(n == all.size() - 1);
+
+  // an empty intersection selects nothing
+  count = 0;
+  Sp3Cursor c3(sp3);
+  assert((systems("G") | systems("E")).next_epoch(c3, buf, count) == -1);
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+  // the generators yield the same records
+  n = 0;
+  for (const auto &epoch : epochs(sp3, f)) {
+    assert(n < ref.size());
+    assert(epoch.t == ref[n].t && epoch.size() == ref[n].size());
+    ++n;
+  }
+  assert(n == ref.size());
+
+  std::size_t num_records = 0, k = 0;
+  for (const auto &e : ref)
+    num_records += e.size();
+  n = 0;
+  for (const auto &rec : records(sp3, f)) {
+    while (k >= (std::size_t)ref[n].size()) {
+      k = 0;
+      ++n;
+    }
+    assert(rec.sv == ref[n].sats[k]);
+    assert(rec.block.t == ref[n].t);
+    ++k;
+    --num_records;
+  }
+  assert(!num_records);
+  printf("Generators checked\n");
+#endif
+
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include "sp3.hpp"
+#include <cassert>
+#include <cstdio>
+
+using namespace dso;
+using dso::sp3::SatelliteId;
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <SP3c FILE>\n", argv[0]);
+    return 1;
+  }
+
+  // first time: index is (re-)built and persisted to the sidecar file
+  {
+    Sp3c sp3(argv[1]);
+    if (sp3.use_sidecar_index()) {
+      fprintf(stderr, "Failed to build/load sidecar index\n");
+      return 1;
+    }
+    printf("Index of %s holds %d epochs (sidecar: %s)\n", argv[1],
+           sp3.index().num_epochs(), sp3.sidecar_filename().c_str());
+  }
+
+  // re-open; the index should now be loaded off from the sidecar
+  Sp3c sp3(argv[1]);
+  if (sp3.load_index()) {
+    fprintf(stderr, "Failed to load sidecar index\n");
+    return 1;
+  }
+
+  // compare random access against a sequential read of the file
+  for (const auto &sv : sp3.sattellite_vector()) {
+    Sp3DataBlock seq, rnd;
+    sp3.rewind();
+    int idx = 0, j;
+    do {
+      j = sp3.get_next_data_block(sv, seq);
+      if (j > 0)
+        return 1;
+      int k = sp3.get_data_block(idx, sv, rnd);
+      if (k > 0)
+        return 1;
+      assert(seq.t == rnd.t);
+      if (!k) {
+        for (int i = 0; i < 8; i++)
+          assert(seq.state[i] == rnd.state[i]);
+        assert(seq.flag.bits_ == rnd.flag.bits_);
+      }
+      ++idx;
+    } while (!j);
+    assert(idx == sp3.index().num_epochs());
+  }
+
+  // jump to the middle of the file and keep on reading from there
+  Sp3DataBlock block;
+  const int mid = sp3.index().num_epochs() / 2;
+  if (sp3.seek_epoch(mid) ||
+      sp3.get_next_data_block(sp3.sattellite_vector()[0], block) > 0) {
+    fprintf(stderr, "Failed reading data block after seek\n");
+    return 1;
+  }
+  assert(block.t == sp3.index().epochs[mid]);
+  assert(sp3.index().lower_bound(block.t) == mid);
+
+  printf("All ok!\n");
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include "sp3_publication.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace dso;
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> <SP3c FILE>\n", argv[0]);
+    return 1;
+  }
+
+  // use a window wide enough for any sampling interval
+  Sp3Publisher pub(milliseconds(2L * 3600 * 1000));
+  if (pub.publish(argv[1])) {
+    fprintf(stderr, "Failed publishing file %s\n", argv[1]);
+    return 1;
+  }
+  const auto first = pub.snapshot();
+  assert(first && first->version == 1 && first->interpolators.size() > 0);
+  const auto sv = Sp3c(argv[1]).sattellite_vector()[0];
+
+  // an epoch within each of the two files
+  datetime<nanoseconds> epochs[2];
+  for (int i = 0; i < 2; i++)
+    epochs[i] =
+        Sp3c(argv[i + 1]).start_epoch() +
+        datetime_interval<nanoseconds>(0, nanoseconds(3600L * 1'000'000'000L));
+
+  // reader threads query continuously, while versions are swapped
+  constexpr int NUM_READERS = 4;
+  std::atomic<bool> stop{false};
+  std::atomic<long> queries{0}, failures{0};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < NUM_READERS; i++) {
+    readers.emplace_back([&]() {
+      Sp3Reader reader(pub);
+      double pos[3], erpos[3];
+      uint64_t last_version = 0;
+      while (!stop) {
+        reader.refresh();
+        const Sp3Dataset *ds = reader.dataset();
+        // versions seen by a reader never go back
+        assert(ds && ds->version >= last_version);
+        last_version = ds->version;
+        const auto &t = epochs[ds->source == argv[1] ? 0 : 1];
+        // a query may fail only if a newer version was picked up meanwhile
+        if (reader.interpolate_at(sv, t, pos, erpos) &&
+            reader.dataset()->version == last_version)
+          ++failures;
+        ++queries;
+      }
+    });
+  }
+
+  // swap versions back and forth
+  constexpr int NUM_SWAPS = 20;
+  for (int i = 0; i < NUM_SWAPS; i++) {
+    if (pub.publish(argv[2 - (i % 2)])) {
+      fprintf(stderr, "Failed publishing version %d\n", i + 2);
+      stop = true;
+      break;
+    }
+  }
+  stop = true;
+  for (auto &t : readers)
+    t.join();
+
+  assert(pub.version() == NUM_SWAPS + 1);
+  assert(pub.snapshot()->version == NUM_SWAPS + 1);
+  assert(!failures);
+
+  // old versions are reclaimed once no longer referenced
+  std::weak_ptr<const Sp3Dataset> old = pub.snapshot();
+  pub.publish(argv[1]);
+  assert(old.expired());
+  // ... but not while held
+  std::shared_ptr<const Sp3Dataset> held = pub.snapshot();
+  old = held;
+  pub.publish(argv[2]);
+  assert(!old.expired() && held->version == NUM_SWAPS + 2);
+
+  // published interpolators outlive the Sp3c they were loaded off from;
+  // their checkpoints refer to the file they were read off from
+  {
+    assert(held->source == argv[1]);
+    SvInterpolator intrp(*held->interpolators.find(sv));
+    double pos[3], erpos[3];
+    assert(!intrp.interpolate_at(epochs[0], pos, erpos));
+    Sp3Checkpoint cp;
+    assert(!intrp.checkpoint(cp));
+    assert(cp.fn == argv[1] && cp.fingerprint == Sp3c(argv[1]).fingerprint());
+    SvInterpolator other(*held->interpolators.find(sv));
+    assert(!other.restore(cp));
+  }
+
+  // versions share the interpolators of unchanged satellites; the rest do
+  // not match checkpoints of another file
+  {
+    const auto latest = pub.snapshot();
+    const auto &a = held->interpolators, &b = latest->interpolators;
+    assert(latest->source == argv[2] && a.size() == b.size());
+    int num_changed = 0;
+    for (int i = 0; i < a.size(); i++) {
+      assert(a[i].sv() == b[i].sv());
+      Sp3Checkpoint cp;
+      assert(!a[i].checkpoint(cp));
+      SvInterpolator another(b[i]);
+      if (a.fingerprint(i) == b.fingerprint(i)) {
+        assert(&a[i] == &b[i] && !another.restore(cp));
+      } else {
+        assert(&a[i] != &b[i] && another.restore(cp) == -1);
+        ++num_changed;
+      }
+    }
+    assert(num_changed > 0 && num_changed < a.size());
+  }
+
+  printf("Queries: %ld, failures: %ld\n", (long)queries, (long)failures);
+  printf("All ok!\n");
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include "sp3_shm.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace dso;
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <SP3c FILE>\n", argv[0]);
+    return 1;
+  }
+
+  const std::string name = "/sp3_test_shm_" + std::to_string(::getpid());
+  Sp3c sp3(argv[1]);
+  if (Sp3ShmSegment::publish(name.c_str(), sp3)) {
+    fprintf(stderr, "Failed publishing %s to shared memory\n", argv[1]);
+    return 1;
+  }
+
+  // use (at least) two data points on each side
+  const long num_epochs = sp3.num_epochs();
+  const long interval = sp3.interval().as_underlying_type();
+  const milliseconds window(2 * interval / 1'000'000L + 1000L);
+
+  // a different process maps the segment and interpolates off from it
+  const pid_t pid = ::fork();
+  if (!pid) {
+    Sp3ShmSegment seg(name.c_str());
+    Sp3c file(argv[1]);
+    for (const auto &sv : seg.satellites()) {
+      SvShmInterpolator shm(seg, sv, window);
+      SvInterpolator ref(sv, file, window);
+      for (long i = 0; i < 4 * num_epochs; i++) {
+        const auto t = file.start_epoch() +
+                       datetime_interval<nanoseconds>(
+                           0, nanoseconds(i * interval / 4));
+        double p1[3], e1[3], v1[3], ev1[3], p2[3], e2[3], v2[3], ev2[3];
+        const int s1 = shm.interpolate_at(t, p1, e1, v1, ev1);
+        const int s2 = ref.interpolate_at(t, p2, e2, v2, ev2);
+        if (s1 != s2)
+          ::_exit(1);
+        for (int k = 0; !s1 && k < 3; k++)
+          if (std::abs(p1[k] - p2[k]) > 1e-6 ||
+              std::abs(v1[k] - v2[k]) > 1e-6)
+            ::_exit(2);
+      }
+    }
+    ::_exit(0);
+  }
+  int status;
+  ::waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  // flags are held along with the records
+  {
+    Sp3ShmSegment seg(name.c_str());
+    for (const auto &sv : seg.satellites()) {
+      SvInterpolator ref(sv, sp3);
+      const double *flags = seg.column(sv, Sp3ShmSegment::FLAGS);
+      assert(flags && seg.num_records(sv) == ref.num_data_points());
+      for (int i = 0; i < ref.num_data_points(); i++)
+        assert(flags[i] == ref.data_points()[i].flag.bits_);
+    }
+  }
+
+  // re-publishing never leaves the name missing for readers, and mapped
+  // segments outlive being replaced
+  {
+    Sp3ShmSegment old(name.c_str());
+    const pid_t reader = ::fork();
+    if (!reader) {
+      for (int i = 0; i < 2000; i++) {
+        try {
+          Sp3ShmSegment seg(name.c_str());
+          if (seg.satellites().size() != sp3.sattellite_vector().size())
+            ::_exit(2);
+        } catch (std::exception &) {
+          ::_exit(1);
+        }
+      }
+      ::_exit(0);
+    }
+    for (int i = 0; i < 50; i++)
+      assert(!Sp3ShmSegment::publish(name.c_str(), sp3));
+    ::waitpid(reader, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(old.num_records(old.satellites()[0]) > 0);
+  }
+
+  // a mapped segment outlives its removal
+  {
+    Sp3ShmSegment seg(name.c_str());
+    assert(Sp3ShmSegment::remove(name.c_str()) == 0);
+    assert(seg.num_records(seg.satellites()[0]) > 0);
+  }
+  bool thrown = false;
+  try {
+    Sp3ShmSegment seg(name.c_str());
+  } catch (std::exception &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  printf("All ok!\n");
+  return 0;
+}
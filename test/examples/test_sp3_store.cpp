@@ -0,0 +1,109 @@
+#include "sp3_store.hpp"
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+using namespace dso;
+using dso::sp3::SatelliteId;
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> [<SP3c FILE> ...]\n", argv[0]);
+    return 1;
+  }
+
+  // load all files (e.g. consecutive daily products) into the store
+  Sp3OrbitStore store;
+  std::size_t raw_bytes = 0;
+  for (int i = 1; i < argc; i++) {
+    Sp3c sp3(argv[i]);
+    if (store.load(sp3)) {
+      fprintf(stderr, "Failed loading file %s to store\n", argv[i]);
+      return 1;
+    }
+  }
+
+  // compare against the records read off from the files
+  for (int i = 1; i < argc; i++) {
+    Sp3c sp3(argv[i]);
+    Sp3Cursor cursor(sp3);
+    Sp3EpochBuffer buf;
+    std::vector<Sp3DataBlock> out;
+    while (!cursor.get_next_epoch(buf)) {
+      for (int j = 0; j < buf.size(); j++) {
+        raw_bytes += sizeof(Sp3DataBlock);
+        store.range(buf.sats[j], buf.t, buf.t, out);
+        if (out.size() != 1) {
+          fprintf(stderr, "Record for %s missing from store\n",
+                  buf.sats[j].id);
+          return 1;
+        }
+        for (int k = 0; k < 8; k++)
+          assert(out[0].state[k] == buf.blocks[j].state[k]);
+        assert(out[0].flag.bits_ == buf.blocks[j].flag.bits_);
+      }
+    }
+  }
+
+  printf("Store holds %d satellites in %lu bytes (%lu bytes un-compressed)\n",
+         (int)store.satellites().size(), store.memory_bytes(), raw_bytes);
+  // at (realistic) sampling intervals of up to 5 min, records take up less
+  // than a tenth of their in-memory size; sparser sampling (e.g. of LEOs)
+  // leaves larger differences
+  const bool dense = Sp3c(argv[1]).interval().as_underlying_type() <=
+                     300L * nanoseconds::sec_factor<long>();
+  assert(store.memory_bytes() * (dense ? 10 : 5) < raw_bytes);
+
+  // parallel loading (with every file given twice, i.e. all epochs overlap)
+  // should give the same records
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    files.emplace_back(argv[i]);
+    files.emplace_back(argv[i]);
+  }
+  Sp3OrbitStore pstore;
+  if (pstore.load(files, Sp3OverlapPolicy::last_wins)) {
+    fprintf(stderr, "Failed loading files to store in parallel\n");
+    return 1;
+  }
+  for (const auto &s : store.satellites()) {
+    std::vector<Sp3DataBlock> a, b;
+    dso::datetime<nanoseconds> first, last;
+    store.span(s, first, last);
+    store.range(s, first, last, a);
+    pstore.range(s, first, last, b);
+    assert(a.size() == b.size() && pstore.num_records(s) == (int64_t)a.size());
+    for (std::size_t j = 0; j < a.size(); j++) {
+      assert(a[j].t == b[j].t);
+      for (int k = 0; k < 8; k++)
+        assert(a[j].state[k] == b[j].state[k]);
+    }
+  }
+
+  // interpolate off from the store, at the mid of the (first) file
+  Sp3c sp3(argv[1]);
+  const SatelliteId sv = sp3.sattellite_vector().front();
+  // use (at least) two data points on each side, whatever the interval
+  const dso::milliseconds max_window(
+      2 * sp3.interval().as_underlying_type() / 1000000L + 1000L);
+  SvInterpolator ref(sv, sp3, max_window);
+  SvInterpolator intrp(ref);
+  std::vector<Sp3DataBlock> scratch;
+  dso::datetime<nanoseconds> first, last;
+  if (store.span(sv, first, last))
+    return 1;
+  if (store.load_interpolator(sv, first, last, intrp, scratch))
+    return 1;
+
+  auto t = sp3.start_epoch();
+  t += dso::datetime_interval<nanoseconds>(
+      0, nanoseconds(43200L * nanoseconds::sec_factor<long>() + 1000));
+  double xyz[3], sxyz[3], rxyz[3], rsxyz[3];
+  if (intrp.interpolate_at(t, xyz, sxyz) || ref.interpolate_at(t, rxyz, rsxyz))
+    return 1;
+  for (int k = 0; k < 3; k++)
+    assert(xyz[k] == rxyz[k]);
+
+  printf("All ok!\n");
+  return 0;
+}
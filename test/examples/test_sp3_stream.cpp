@@ -0,0 +1,81 @@
+#include "sp3_stream.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dso;
+using dso::sp3::SatelliteId;
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> [<SP3c FILE> ...]\n", argv[0]);
+    fprintf(stderr, "Files must be consecutive, in chronological order\n");
+    return 1;
+  }
+
+  // reference interpolators, one per file and SV
+  const dso::milliseconds max_window(3600L * 1000L);
+  std::vector<std::unique_ptr<Sp3c>> files;
+  std::vector<std::string> fns;
+  for (int i = 1; i < argc; i++) {
+    files.emplace_back(std::make_unique<Sp3c>(argv[i]));
+    fns.emplace_back(argv[i]);
+  }
+  const auto svs = files[0]->sattellite_vector();
+  const auto interval = files[0]->interval();
+  const long interval_sec =
+      interval.as_underlying_type() / nanoseconds::sec_factor<long>();
+
+  Sp3Stream stream(fns, max_window);
+
+  // every 7 min and 13 sec, all SVs in turn; compare against interpolating
+  // off from the file alone, away from the file's limits
+  const long step = 7L * 60L + 13L;
+  int num_checked = 0;
+  for (std::size_t f = 0; f < files.size(); f++) {
+    std::vector<SvInterpolator> refs;
+    for (const auto &sv : svs)
+      refs.emplace_back(sv, *files[f], max_window);
+    for (long sec = 7200L; sec < 86400L - 7200L; sec += step) {
+      auto t = files[f]->start_epoch();
+      t += dso::datetime_interval<nanoseconds>(
+          0, nanoseconds(sec * nanoseconds::sec_factor<long>()));
+      for (std::size_t k = 0; k < svs.size(); k++) {
+        double pos[3], epos[3], ref[3], eref[3];
+        if (refs[k].interpolate_at(t, ref, eref))
+          continue;
+        const int error = stream.interpolate_at(svs[k], t, pos, epos);
+        if (error) {
+          fprintf(stderr, "Failed interpolating %.3s off from stream: %d\n",
+                  svs[k].id, error);
+          return 1;
+        }
+        for (int j = 0; j < 3; j++)
+          assert(std::abs(pos[j] - ref[j]) < 1e-6);
+        ++num_checked;
+      }
+      // only the window (plus one epoch on each side) is held
+      assert(stream.num_epochs_held() <= 2 * (3600L / interval_sec) + 3);
+    }
+  }
+  assert(num_checked > 0);
+  assert(stream.num_files_opened() == (int)files.size());
+
+  // queries must be chronological
+  double pos[3], epos[3];
+  assert(stream.interpolate_at(svs[0], files[0]->start_epoch(), pos, epos) ==
+         1);
+
+  // past the end of the last file, interpolation fails with the
+  // interpolator's own error code
+  auto t = files.back()->start_epoch();
+  t += dso::datetime_interval<nanoseconds>(2, nanoseconds(0));
+  const int error = stream.interpolate_at(svs[0], t, pos, epos);
+  assert(error == 3 || error > 10);
+
+  printf("All ok!\n");
+  return 0;
+}
@@ -0,0 +1,123 @@
+#include "sp3_tail.hpp"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace dso;
+
+/* An Sp3 file, split in header and data blocks (the 'EOF' line left out) */
+struct Sp3Text {
+  std::string header;
+  std::vector<std::string> blocks;
+};
+
+Sp3Text split(const char *fn) {
+  Sp3Text txt;
+  std::ifstream fin(fn);
+  std::string line;
+  while (std::getline(fin, line)) {
+    if (!line.compare(0, 3, "EOF"))
+      break;
+    if (line[0] == '*')
+      txt.blocks.emplace_back();
+    (txt.blocks.empty() ? txt.header : txt.blocks.back()) += line + '\n';
+  }
+  return txt;
+}
+
+/* Write the header and blocks [b, e) to file fn (appending if b > 0) */
+void write(const std::string &fn, const Sp3Text &txt, int b, int e,
+           bool eof = false) {
+  std::ofstream fout(fn, b ? std::ios::app : std::ios::trunc);
+  if (!b)
+    fout << txt.header;
+  for (int i = b; i < e; i++)
+    fout << txt.blocks[i];
+  if (eof)
+    fout << "EOF\n";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> <OUTPUT DIR>\n", argv[0]);
+    return 1;
+  }
+
+  const Sp3Text txt = split(argv[1]);
+  const int n = txt.blocks.size();
+  assert(n > 10);
+
+  // reference epochs
+  std::vector<dso::datetime<nanoseconds>> ref;
+  {
+    Sp3c sp3(argv[1]);
+    Sp3Cursor cursor(sp3);
+    Sp3EpochBuffer buf;
+    while (!cursor.get_next_epoch(buf))
+      ref.push_back(buf.t);
+  }
+  assert((int)ref.size() == n);
+
+  const std::string fn = std::string(argv[2]) + "/tail.sp3";
+  Sp3Tail tail(fn.c_str());
+  std::vector<Sp3EpochBuffer> epochs;
+  std::vector<dso::datetime<nanoseconds>> got;
+  bool rewritten;
+
+  // the last data block is not reported, until followed by another one
+  write(fn, txt, 0, 3);
+  assert(!tail.poll(epochs, &rewritten) && !rewritten);
+  assert(epochs.size() == 2);
+  for (const auto &e : epochs)
+    got.push_back(e.t);
+  assert(!tail.poll(epochs) && epochs.empty());
+
+  // appended blocks, in pieces, up to the 'EOF' line
+  write(fn, txt, 3, 10);
+  assert(!tail.poll(epochs, &rewritten) && !rewritten);
+  assert(epochs.size() == 7);
+  for (const auto &e : epochs)
+    got.push_back(e.t);
+  write(fn, txt, 10, n, true);
+  assert(!tail.poll(epochs, &rewritten) && !rewritten);
+  for (const auto &e : epochs)
+    got.push_back(e.t);
+  assert(got == ref);
+
+  // nothing changes; wait times out
+  assert(tail.wait(50) == -1);
+
+  // rewritten in place, with a different header; the file is read again
+  {
+    Sp3Text changed(txt);
+    const auto pos = changed.header.find("/*");
+    assert(pos != std::string::npos);
+    changed.header[pos + 3] = (changed.header[pos + 3] == 'x') ? 'y' : 'x';
+    write(fn, changed, 0, n);
+    assert(!tail.poll(epochs, &rewritten) && rewritten);
+    assert((int)epochs.size() == n - 1 && epochs.front().t == ref.front());
+  }
+
+  // truncated in place, past the last data block read; the file is read
+  // again (and never accessed past its end)
+  {
+    write(fn, txt, 0, 5);
+    assert(!tail.poll(epochs, &rewritten) && rewritten);
+    assert(epochs.size() == 4 && epochs.front().t == ref.front());
+  }
+
+  // replaced (via rename) by an identical file; the file is read again
+  {
+    const std::string tmp = fn + ".tmp";
+    write(tmp, txt, 0, n, true);
+    assert(!std::rename(tmp.c_str(), fn.c_str()));
+    assert(!tail.poll(epochs, &rewritten) && rewritten);
+    assert((int)epochs.size() == n);
+  }
+
+  std::remove(fn.c_str());
+  printf("All ok!\n");
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include "sp3_tier.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace dso;
+using dso::sp3::SatelliteId;
+
+/* Copy an Sp3 file, up to data block stop (if stop >= 0); position records
+ * of blocks from predicted on are flagged as predicted (col. 80)
+ */
+void write_copy(const char *fn, const std::string &out, int stop,
+                int predicted) {
+  std::ifstream fin(fn);
+  std::ofstream fout(out);
+  std::string line;
+  int block = -1;
+  while (std::getline(fin, line)) {
+    if (line[0] == '*')
+      ++block;
+    if (stop >= 0 && block >= stop && line.compare(0, 3, "EOF"))
+      continue;
+    if (line[0] == 'P' && block >= predicted) {
+      line.resize(std::max<std::size_t>(line.size(), 80), ' ');
+      line[79] = 'P';
+    }
+    fout << line << '\n';
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> <OUTPUT DIR>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+  const SatelliteId sv = sp3.sattellite_vector().front();
+  const int n = sp3.num_epochs();
+  assert(n > 40);
+  const long interval = sp3.interval().as_underlying_type();
+  const auto epoch = [&](int block) {
+    return sp3.start_epoch() +
+           datetime_interval<nanoseconds>(
+               0, nanoseconds(block * interval + interval / 3));
+  };
+  const milliseconds window(6 * interval / 1'000'000L);
+
+  // final: first half only; ultra-rapid: second half predicted
+  const std::string final_fn = std::string(argv[2]) + "/tier_final.sp3";
+  const std::string ultra_fn = std::string(argv[2]) + "/tier_ultra.sp3";
+  const std::string missing_fn = std::string(argv[2]) + "/no_such_file.sp3";
+  write_copy(argv[1], final_fn, n / 2, n);
+  write_copy(argv[1], ultra_fn, -1, n / 2);
+
+  // the orbit prediction flag is read off from col. 80 ('P')
+  {
+    Sp3c ultra(ultra_fn.c_str());
+    SvInterpolator intrp(sv, ultra, window);
+    const Sp3DataBlock *data = intrp.data_points();
+    assert(intrp.num_data_points() == n);
+    for (int i = 0; i < n; i++)
+      assert(data[i].flag.is_set(Sp3Event::orbit_prediction) == (i >= n / 2));
+  }
+
+  // reference, off from the input file
+  SvInterpolator ref(sv, sp3, window);
+  double pos[3], erpos[3], rpos[3], rerpos[3];
+
+  // best tier first; lower tiers are not opened unless needed
+  {
+    Sp3TierResolver resolver(window);
+    resolver.add_source(ultra_fn.c_str(), Sp3Tier::ultra_rapid);
+    resolver.add_source(missing_fn.c_str(), Sp3Tier::final);
+    resolver.add_source(argv[1], Sp3Tier::rapid);
+    resolver.add_source(final_fn.c_str(), Sp3Tier::final);
+    assert(resolver.num_sources() == 4 && !resolver.num_opened());
+
+    Sp3TierInfo info;
+    assert(!resolver.interpolate_at(sv, epoch(n / 4), pos, erpos, nullptr,
+                                    nullptr, &info));
+    assert(info.tier == Sp3Tier::final && info.source == 3 &&
+           !info.predicted);
+    assert(!ref.interpolate_at(epoch(n / 4), rpos, rerpos));
+    for (int k = 0; k < 3; k++)
+      assert(std::abs(pos[k] - rpos[k]) < 1e-9);
+
+    // past the records of the final product, the rapid one serves
+    assert(!resolver.interpolate_at(sv, epoch(3 * n / 4), pos, erpos,
+                                    nullptr, nullptr, &info));
+    assert(info.tier == Sp3Tier::rapid && info.source == 2);
+    assert(resolver.num_opened() == 2);
+
+    // unknown SVs and epochs not covered
+    assert(resolver.interpolate_at(SatelliteId("X99"), epoch(n / 4), pos,
+                                   erpos) == -1);
+    assert(resolver.interpolate_at(sv, epoch(-2 * n), pos, erpos) == -1);
+  }
+
+  // predicted records serve queries, unless refused
+  {
+    Sp3TierResolver resolver(window);
+    resolver.add_source(ultra_fn.c_str(), Sp3Tier::ultra_rapid);
+    resolver.add_source(final_fn.c_str(), Sp3Tier::final);
+    Sp3TierInfo info;
+    assert(!resolver.interpolate_at(sv, epoch(3 * n / 4), pos, erpos,
+                                    nullptr, nullptr, &info));
+    assert(info.tier == Sp3Tier::ultra_rapid && info.source == 0 &&
+           info.predicted);
+    assert(!ref.interpolate_at(epoch(3 * n / 4), rpos, rerpos));
+    for (int k = 0; k < 3; k++)
+      assert(std::abs(pos[k] - rpos[k]) < 1e-9);
+    resolver.set_accept_predicted(false);
+    assert(resolver.interpolate_at(sv, epoch(3 * n / 4), pos, erpos) == -1);
+    assert(!resolver.interpolate_at(sv, epoch(n / 4), pos, erpos, nullptr,
+                                    nullptr, &info));
+    assert(info.tier == Sp3Tier::final);
+  }
+
+  std::remove(final_fn.c_str());
+  std::remove(ultra_fn.c_str());
+  printf("All ok!\n");
+  return 0;
+}
@@ -0,0 +1,123 @@
+#include "sp3_client.hpp"
+#include "sv_interpolate.hpp"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace dso;
+using dso::sp3::SatelliteId;
+
+/* Connect to the daemon, waiting (up to ~5 sec) for it to start listening */
+Sp3Client *connect(const std::string &socket_path) {
+  for (int i = 0; i < 100; i++) {
+    try {
+      return new Sp3Client(socket_path.c_str());
+    } catch (std::exception &) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+  }
+  return nullptr;
+}
+
+/* Check daemon results against interpolating in-process */
+void check(Sp3Client &client, const std::vector<Sp3ClientQuery> &queries,
+           std::vector<SvInterpolator> &refs, int num_svs) {
+  std::vector<Sp3ClientResult> results(queries.size());
+  assert(!client.interpolate(queries.data(), queries.size(), results.data(),
+                             true));
+  for (std::size_t i = 0; i < queries.size(); i++) {
+    double pos[3], erpos[3], vel[3], ervel[3];
+    assert(!refs[i % num_svs].interpolate_at(queries[i].t, pos, erpos, vel,
+                                             ervel));
+    assert(!results[i].status);
+    for (int j = 0; j < 3; j++) {
+      assert(std::abs(results[i].pos[j] - pos[j]) < 1e-9);
+      assert(std::abs(results[i].vel[j] - vel[j]) < 1e-9);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s <SP3D EXECUTABLE> <SP3c FILE> <OUTPUT DIR>\n",
+            argv[0]);
+    return 1;
+  }
+
+  // use a window wide enough for any sampling interval
+  const long window_sec = 3600;
+  const std::string socket_path = std::string(argv[3]) + "/sp3d_test.sock";
+  const std::string window = std::to_string(window_sec);
+
+  const pid_t pid = ::fork();
+  assert(pid >= 0);
+  if (!pid) {
+    ::execl(argv[1], argv[1], "-s", socket_path.c_str(), "-w", window.c_str(),
+            argv[2], (char *)nullptr);
+    _exit(127);
+  }
+
+  // queries, every 17 min for all SVs, away from the file's edges
+  Sp3c sp3(argv[2]);
+  const auto &svs = sp3.sattellite_vector();
+  const int num_svs = svs.size();
+  std::vector<SvInterpolator> refs;
+  for (const auto &sv : svs)
+    refs.emplace_back(sv, sp3, dso::milliseconds(window_sec * 1000L));
+  std::vector<Sp3ClientQuery> queries;
+  for (long sec = 7200L; sec < 86400L - 7200L; sec += 17L * 60L)
+    for (const auto &sv : svs)
+      queries.push_back(Sp3ClientQuery{
+          sv, sp3.start_epoch() + datetime_interval<nanoseconds>(
+                                      0, nanoseconds(sec * 1'000'000'000L))});
+
+  Sp3Client *client = connect(socket_path);
+  assert(client && !client->ping());
+  check(*client, queries, refs, num_svs);
+
+  // SVs and epochs not covered by the product
+  {
+    std::vector<Sp3ClientQuery> bad(2, queries[0]);
+    bad[0].sv = SatelliteId("X99");
+    bad[1].t += datetime_interval<nanoseconds>(3, nanoseconds(0));
+    std::vector<Sp3ClientResult> results(bad.size());
+    assert(!client->interpolate(bad.data(), bad.size(), results.data()));
+    assert(results[0].status == -1 && results[1].status == -1);
+  }
+
+  // concurrent connections, while the product is re-loaded
+  {
+    std::vector<std::thread> threads;
+    for (int k = 0; k < 4; k++)
+      threads.emplace_back([&]() {
+        Sp3Client c(socket_path.c_str());
+        std::vector<SvInterpolator> my_refs(refs);
+        for (int i = 0; i < 20; i++)
+          check(c, queries, my_refs, num_svs);
+      });
+    assert(!::kill(pid, SIGHUP));
+    for (auto &t : threads)
+      t.join();
+    check(*client, queries, refs, num_svs);
+  }
+
+  // stops on SIGTERM, removing its socket
+  delete client;
+  assert(!::kill(pid, SIGTERM));
+  int status;
+  assert(::waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status) && !WEXITSTATUS(status));
+  struct stat st;
+  assert(::stat(socket_path.c_str(), &st));
+
+  printf("All ok!\n");
+  return 0;
+}
@@ -1,10 +1,42 @@
 #include "sv_interpolate.hpp"
+#include <cassert>
 #include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
 
 using namespace dso;
 using dso::sp3::SatelliteId;
 
+/* Number of calls to (the global) operator new, i.e. of allocations not
+ * going through a memory resource */
+long num_news{0};
+
+void *operator new(std::size_t count) {
+  ++num_news;
+  if (void *p = std::malloc(count ? count : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+/* A memory resource counting allocations */
+struct CountingResource : std::pmr::memory_resource {
+  int allocations{0};
+  void *do_allocate(std::size_t bytes, std::size_t align) override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+  void do_deallocate(void *p, std::size_t bytes, std::size_t align) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+  }
+  bool do_is_equal(const std::pmr::memory_resource &o) const noexcept override {
+    return this == &o;
+  }
+};
+
 int main(int argc, char *argv[]) {
   if (argc < 2 || argc > 3) {
     fprintf(stderr, "Usage: %s <SP3c FILE> [SV]\n", argv[0]);
@@ -71,5 +103,23 @@ int main(int argc, char *argv[]) {
       stop_timer - start_timer);
   printf("Interpolation took about %ld milliseconds\n", duration.count());
 
+  // one interpolator per SV, stored by value; reloading (here off from the
+  // same file) should not allocate any memory, be it off from the memory
+  // resource or elsewhere (e.g. recording the source file)
+  CountingResource mr;
+  std::vector<SvInterpolator> intrps;
+  for (const auto &s : sp3.sattellite_vector())
+    intrps.emplace_back(s, sp3, three_min_in_millisec, &mr);
+  const int allocations = mr.allocations;
+  const long news = num_news;
+  for (auto &intrp : intrps) {
+    if (intrp.reload(sp3))
+      return 1;
+  }
+  assert(mr.allocations == allocations);
+  assert(num_news == news);
+  printf("Reloaded %d interpolators with %d allocations\n",
+         (int)intrps.size(), mr.allocations - allocations);
+
   return 0;
 }
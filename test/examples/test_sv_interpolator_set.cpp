@@ -0,0 +1,132 @@
+#include "sv_interpolator_set.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace dso;
+using dso::sp3::SatelliteId;
+
+/* Write a copy of an Sp3 file, with the x component of all (valid)
+ * Position records of SV sv moved by dx [km]; all other lines are copied
+ * verbatim
+ */
+void write_copy(const char *in, const std::string &fn, const SatelliteId &sv,
+                double dx) {
+  std::ifstream fin(in);
+  std::ofstream fout(fn);
+  std::string line;
+  const std::string tag = std::string("P") + std::string(sv.id, 3);
+  while (std::getline(fin, line)) {
+    if (!line.compare(0, 4, tag) && line.size() >= 18) {
+      const double x = std::stod(line.substr(4, 14));
+      if (std::abs(x) < 999999e0) {
+        char buf[16];
+        std::snprintf(buf, sizeof buf, "%14.6f", x + dx);
+        line.replace(4, 14, buf);
+      }
+    }
+    fout << line << '\n';
+  }
+}
+
+/* Positions of the interpolator at index i of a set, at epochs t */
+std::vector<double>
+positions(const SvInterpolatorSet &set, int i,
+          const std::vector<dso::datetime<nanoseconds>> &t) {
+  std::vector<double> xyz;
+  SvInterpolationState state;
+  for (const auto &ti : t) {
+    double pos[3], err[3];
+    assert(!set[i].interpolate_at(ti, pos, err, nullptr, nullptr, state));
+    xyz.insert(xyz.end(), pos, pos + 3);
+  }
+  return xyz;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <SP3c FILE> <OUTPUT DIR>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+  const auto svs = sp3.sattellite_vector();
+  const int n = svs.size();
+  assert(n > 1);
+
+  // first load: all built
+  SvInterpolatorSet set(dso::milliseconds(3600L * 1000L));
+  std::vector<SatelliteId> rebuilt;
+  assert(!set.load(sp3, &rebuilt));
+  assert(set.size() == n && rebuilt == svs);
+
+  // epochs to compare interpolated positions at, within the product
+  std::vector<dso::datetime<nanoseconds>> t;
+  for (int k = 1; k < 8; k++) {
+    auto tk = sp3.start_epoch();
+    tk += datetime_interval<nanoseconds>(
+        0, nanoseconds(k * (long)sp3.num_epochs() / 8 *
+                       sp3.interval().as_underlying_type()));
+    t.push_back(tk);
+  }
+  std::vector<std::vector<double>> ref;
+  std::vector<uint64_t> hashes;
+  for (int i = 0; i < n; i++) {
+    ref.push_back(positions(set, i, t));
+    hashes.push_back(set.fingerprint(i));
+  }
+
+  // a copy of the set shares its interpolators (and keeps them alive)
+  const SvInterpolatorSet prev(set);
+  for (int i = 0; i < n; i++)
+    assert(&prev[i] == &set[i]);
+
+  // a reissued product, where only one SV's records have changed
+  const SatelliteId sv = svs[n / 2];
+  const std::string fn = std::string(argv[2]) + "/reissued.sp3";
+  write_copy(argv[1], fn, sv, 1e-3);
+  {
+    Sp3c copy(fn.c_str());
+    assert(!set.load(copy, &rebuilt));
+    assert(set.size() == n);
+    assert(rebuilt == std::vector<SatelliteId>{sv});
+
+    for (int i = 0; i < n; i++) {
+      assert(set[i].sv() == svs[i]);
+      Sp3Checkpoint cp;
+      assert(!set[i].checkpoint(cp));
+      const auto xyz = positions(set, i, t);
+      if (svs[i] == sv) {
+        // re-read (off from the copy), and moved; the previous version is
+        // left as it was
+        assert(&set[i] != &prev[i]);
+        assert(set.fingerprint(i) != hashes[i]);
+        assert(cp.fn == fn && cp.fingerprint == copy.fingerprint());
+        for (std::size_t k = 0; k < xyz.size(); k += 3) {
+          assert(std::abs(xyz[k] - ref[i][k] - 1e-3) < 1e-9);
+          assert(xyz[k + 1] == ref[i][k + 1] && xyz[k + 2] == ref[i][k + 2]);
+        }
+        assert(positions(prev, i, t) == ref[i]);
+      } else {
+        // kept (shared with the previous version), not re-read; same
+        // values, and still referring to the file read off from
+        assert(&set[i] == &prev[i]);
+        assert(set.fingerprint(i) == hashes[i]);
+        assert(cp.fn == argv[1] && cp.fingerprint == sp3.fingerprint());
+        assert(xyz == ref[i]);
+      }
+    }
+
+    // loading the same product again rebuilds nothing
+    assert(!set.load(copy, &rebuilt));
+    assert(rebuilt.empty());
+    assert(set.size() == n);
+  }
+
+  std::remove(fn.c_str());
+  printf("All ok!\n");
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include "sv_light_time.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace dso;
+
+constexpr double C_LIGHT = 299792458e0;
+constexpr double OMEGA_EARTH = 7.2921151467e-5;
+
+/* Rotate a vector about Z by the Earth rotation during time tau */
+void rotate(const double *p, double tau, double *out) {
+  const double c = std::cos(OMEGA_EARTH * tau), s = std::sin(OMEGA_EARTH * tau);
+  out[0] = c * p[0] + s * p[1];
+  out[1] = -s * p[0] + c * p[1];
+  out[2] = p[2];
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <SP3c FILE>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+  SvInterpolatorSet set(dso::milliseconds(3600L * 1000L));
+  assert(!set.load(sp3));
+  SvLightTimeSolver solver(set);
+
+  // all satellites, every 37 seconds, for an hour around noon; reception
+  // times are off the data points, so that windows (chosen w.r.t. the
+  // reception time) are the ones SvInterpolator uses at transmission time
+  const double rx[3] = {4595220e0, 2039434e0, 3912625e0};
+  std::vector<SvLightTimeObs> obs;
+  for (const auto &sv : sp3.sattellite_vector()) {
+    for (int k = 0; k < 100; k++) {
+      SvLightTimeObs o;
+      o.sv = sv;
+      o.t_rx = sp3.start_epoch();
+      o.t_rx += dso::datetime_interval<nanoseconds>(
+          0, nanoseconds((43201L + 37L * k) * nanoseconds::sec_factor<long>()));
+      std::memcpy(o.rx, rx, sizeof rx);
+      obs.push_back(o);
+    }
+  }
+  std::vector<SvLightTimeSolution> sol;
+  assert(!solver.solve(obs, sol));
+  assert(sol.size() == obs.size());
+
+  for (std::size_t i = 0; i < obs.size(); i++) {
+    const auto &s = sol[i];
+    assert(!s.status);
+    // the light-time equation holds
+    const double d[3] = {s.pos[0] - rx[0], s.pos[1] - rx[1], s.pos[2] - rx[2]};
+    const double range = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    assert(std::abs(range / C_LIGHT - s.tau) < 1e-11);
+    assert(s.tau > 0e0 && s.tau < .3e0);
+
+    // same as interpolating at transmission time
+    auto t_tx = obs[i].t_rx;
+    t_tx += dso::datetime_interval<nanoseconds>(
+        0, nanoseconds(-std::lround(s.tau * 1e9)));
+    double p[3], ep[3], pr[3];
+    assert(!set.interpolate_at(obs[i].sv, t_tx, p, ep));
+    for (int k = 0; k < 3; k++)
+      p[k] *= 1e3;
+    rotate(p, s.tau, pr);
+    for (int k = 0; k < 3; k++)
+      assert(std::abs(pr[k] - s.pos[k]) < 1e-3);
+
+    // velocity is the derivative of the interpolated positions
+    auto t0 = t_tx, t1 = t_tx;
+    t0 += dso::datetime_interval<nanoseconds>(0, nanoseconds(-500000000L));
+    t1 += dso::datetime_interval<nanoseconds>(0, nanoseconds(500000000L));
+    double p0[3], p1[3], v[3], vr[3];
+    assert(!set.interpolate_at(obs[i].sv, t0, p0, ep));
+    assert(!set.interpolate_at(obs[i].sv, t1, p1, ep));
+    for (int k = 0; k < 3; k++)
+      v[k] = (p1[k] - p0[k]) * 1e3;
+    rotate(v, s.tau, vr);
+    for (int k = 0; k < 3; k++)
+      assert(std::abs(vr[k] - s.vel[k]) < 1e-3);
+
+    assert(s.has_clk);
+    assert(std::abs(s.rel) < 1e-6);
+  }
+
+  // unknown satellites and epochs outside the data are reported
+  std::vector<SvLightTimeObs> bad(2, obs[0]);
+  std::memcpy(bad[0].sv.id, "R99", 3);
+  bad[1].t_rx = sp3.start_epoch();
+  assert(solver.solve(bad, sol));
+  assert(sol[0].status == SvLightTimeSolver::ERROR_NO_SV);
+  assert(sol[1].status == SvLightTimeSolver::ERROR_NO_WINDOW);
+
+  return 0;
+}
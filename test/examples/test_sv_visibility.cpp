@@ -0,0 +1,149 @@
+#include "sv_visibility.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace dso;
+
+constexpr double DEG_TO_RAD = 3.14159265358979323846e0 / 180e0;
+
+/* Time span [sec] from t0 to t1 */
+double span_sec(const dso::datetime<nanoseconds> &t1,
+               const dso::datetime<nanoseconds> &t0) {
+  return t1.diff<dso::DateTimeDifferenceType::FractionalSeconds>(t0)
+      .seconds();
+}
+
+dso::datetime<nanoseconds> add_sec(dso::datetime<nanoseconds> t, long sec) {
+  t += datetime_interval<nanoseconds>(
+      0, nanoseconds(sec * nanoseconds::sec_factor<long>()));
+  return t;
+}
+
+/* Elevation [rad] of SV sv at t from a station, interpolating directly */
+double elevation(const SvInterpolatorSet &set, const sp3::SatelliteId &sv,
+                 const dso::datetime<nanoseconds> &t, const SvStation &sta,
+                 double *range = nullptr) {
+  SvInterpolationState state;
+  double pos[3], err[3];
+  const SvInterpolator *intrp = set.find(sv);
+  assert(intrp && !intrp->interpolate_at(t, pos, err, nullptr, nullptr,
+                                         state));
+  /* station up (geodetic; WGS84) */
+  const double *r = sta.xyz;
+  const double e2 = (1e0 / 298.257223563e0) * (2e0 - 1e0 / 298.257223563e0);
+  const double p = std::sqrt(r[0] * r[0] + r[1] * r[1]);
+  const double lon = std::atan2(r[1], r[0]);
+  double lat = std::atan2(r[2], p * (1e0 - e2));
+  for (int i = 0; i < 5; i++) {
+    const double s = std::sin(lat);
+    lat = std::atan2(r[2] + e2 * 6378137e0 / std::sqrt(1e0 - e2 * s * s) * s,
+                     p);
+  }
+  const double up[3] = {std::cos(lat) * std::cos(lon),
+                        std::cos(lat) * std::sin(lon), std::sin(lat)};
+  double d[3], rho = 0e0, u = 0e0;
+  for (int k = 0; k < 3; k++) {
+    d[k] = pos[k] * 1e3 - r[k];
+    rho += d[k] * d[k];
+    u += up[k] * d[k];
+  }
+  rho = std::sqrt(rho);
+  if (range)
+    *range = rho;
+  return std::asin(u / rho);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <SP3c FILE>\n", argv[0]);
+    return 1;
+  }
+
+  Sp3c sp3(argv[1]);
+  SvInterpolatorSet set(dso::milliseconds(3600L * 1000L));
+  assert(!set.load(sp3));
+  const sp3::SatelliteId sv = set[0].sv();
+
+  // a station right below the SV at noon; the SV culminates (close to the
+  // zenith) around then
+  const auto noon = add_sec(sp3.start_epoch(), 43200L);
+  SvStation sta;
+  sta.name = "ZNTH";
+  {
+    SvInterpolationState state;
+    double pos[3], err[3];
+    assert(!set[0].interpolate_at(noon, pos, err, nullptr, nullptr, state));
+    const double n = std::sqrt(pos[0] * pos[0] + pos[1] * pos[1] +
+                               pos[2] * pos[2]);
+    for (int k = 0; k < 3; k++)
+      sta.xyz[k] = pos[k] / n * 6378137e0;
+  }
+
+  // tabulate (off from a const set) every 5 min (or at the product's
+  // interval, if shorter, e.g. for LEOs), over the middle of the day; grid
+  // look angles match direct interpolation
+  const SvInterpolatorSet &cset = set;
+  SvVisibility vis;
+  const auto t0 = add_sec(sp3.start_epoch(), 7200L);
+  const auto t1 = add_sec(sp3.start_epoch(), 86400L - 7200L);
+  const long step = std::min(300L, (long)(sp3.interval().as_underlying_type() /
+                                          1'000'000'000L));
+  assert(!vis.tabulate(cset, t0, t1,
+                       dso::nanoseconds(step * 1'000'000'000L)));
+  assert(vis.num_satellites() == set.size());
+  assert(vis.num_epochs() == (86400 - 4 * 3600) / step + 1);
+  const int nsv = vis.num_satellites();
+  std::vector<double> el(nsv), az(nsv), range(nsv), rate(nsv);
+  for (int i = 0; i < vis.num_epochs(); i += 17) {
+    vis.look_angles(sta, i, el.data(), az.data(), range.data(), rate.data());
+    for (int s = 0; s < nsv; s++) {
+      const auto &id = vis.satellites()[s];
+      double r0, r1, rho;
+      assert(std::abs(el[s] - elevation(set, id, vis.epoch(i), sta, &rho)) <
+             1e-9);
+      assert(std::abs(range[s] - rho) < 1e-6);
+      assert(az[s] >= 0e0 && az[s] < 2e0 * 3.14159265358979323846e0);
+      // range-rate (off from interpolated velocities) vs differenced range
+      // (LEO orbits are not always sampled densely enough for this)
+      elevation(set, id, add_sec(vis.epoch(i), -1L), sta, &r0);
+      elevation(set, id, add_sec(vis.epoch(i), 1L), sta, &r1);
+      if (id.id[0] != 'L')
+        assert(std::abs(rate[s] - (r1 - r0) / 2e0) < 1e-2);
+    }
+  }
+
+  // the pass over the station
+  const double mask = 10e0 * DEG_TO_RAD;
+  std::vector<SvPass> passes;
+  assert(!vis.passes({sta}, mask, passes));
+  const SvPass *pass = nullptr;
+  for (const auto &p : passes) {
+    assert(!p.station);
+    assert(p.rise <= p.culmination && p.culmination <= p.set);
+    if (p.sv == sv && p.rise < noon && noon < p.set)
+      pass = &p;
+  }
+  assert(pass && pass->has_rise && pass->has_set);
+
+  // rise and set: at the mask, below it before/after
+  for (const auto &t : {pass->rise, pass->set})
+    assert(std::abs(elevation(set, sv, t, sta) - mask) < 1e-5);
+  assert(elevation(set, sv, add_sec(pass->rise, -30L), sta) < mask);
+  assert(elevation(set, sv, add_sec(pass->rise, 30L), sta) > mask);
+  assert(elevation(set, sv, add_sec(pass->set, -30L), sta) > mask);
+  assert(elevation(set, sv, add_sec(pass->set, 30L), sta) < mask);
+
+  // culmination: close to the zenith, around noon, and a max
+  const double emax = elevation(set, sv, pass->culmination, sta);
+  assert(std::abs(pass->max_elevation - emax) < 1e-5);
+  assert(pass->max_elevation > 85e0 * DEG_TO_RAD);
+  assert(std::abs(span_sec(pass->culmination, noon)) < 600e0);
+  assert(elevation(set, sv, add_sec(pass->culmination, -30L), sta) < emax);
+  assert(elevation(set, sv, add_sec(pass->culmination, 30L), sta) < emax);
+
+  printf("All ok!\n");
+  return 0;
+}